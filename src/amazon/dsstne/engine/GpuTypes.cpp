@@ -36,12 +36,14 @@ _totalCPUMemory(0),
 _totalGPUMemory(0),
 _numprocs(1),
 _id(0),
+_comm(MPI_COMM_WORLD),
 _sm_version(SM_3X),
 _warpSize(32),
 _maxSparse(SM_3X_MAXSPARSE),
 _maxSparseAnalog(SM_3X_MAXSPARSEANALOG),
 _cuBLASHandle(0),
 _cuDNNHandle(0),
+_randomSeed(0),
 _pbAccumulator(NULL)
 {
 
@@ -408,6 +410,22 @@ void GpuContext::CopyConstants()
     SetKDeltaGpuData();
 }
 
+// Leaves this process to run networks and datasets on its own, as if it were the only one, while MPI_COMM_WORLD
+// still reaches all processes.  Lets each process of a run work independently, such as for data-parallel prediction
+void GpuContext::Detach()
+{
+    _comm                                           = MPI_COMM_SELF;
+    _numprocs                                       = 1;
+    _id                                             = 0;
+
+    // Redo Startup's P2P test for a lone process: there are no peers to reach, so P2P holds, and the run stays
+    // single node as long as this GPU supports unified addressing
+    cudaDeviceProp deviceProp;
+    cudaGetDeviceProperties(&deviceProp, _device);
+    _bP2P                                           = true;
+    _bSingleNode                                    = (deviceProp.unifiedAddressing != 0);
+}
+
 void GpuContext::Shutdown()
 {   
     // Delete kernel accumulator
@@ -487,12 +505,30 @@ void GpuContext::SetRandomSeed(unsigned long seed)
         exit(-1);
     }
     srand(seed);
+    _randomSeed                                     = seed;
     
     // Report settings
     if (getGpu()._id == 0)
         printf("GpuContext::SetRandomSeed: Random seed set to %lu.\n", seed);
 }
 
+// Restarts the random number streams from the current seed plus an offset (e.g. the training epoch)
+// so that any point in a run can be reproduced from just the seed and the offset
+void GpuContext::ReseedRandom(unsigned long offset)
+{
+    curandStatus_t crstatus                         = curandSetPseudoRandomGeneratorSeed(_RNG, _randomSeed + offset * 1000003ull + (unsigned long)_device * 76801ull);
+    if (crstatus == CURAND_STATUS_SUCCESS)
+        crstatus                                    = curandSetGeneratorOffset(_RNG, 0);
+    if (crstatus != CURAND_STATUS_SUCCESS)
+    {
+        if (getGpu()._id == 0)
+            printf("GpuContext::ReseedRandom: Failed to reseed cuRand on GPU for process %d, exiting.\n", _device);
+        Shutdown();
+        exit(-1);
+    }
+    srand(_randomSeed + offset);
+}
+
 
 // Returns KB of memory in use on CPU and GPU
 void GpuContext::GetMemoryUsage(int* gpuMemory, int* cpuMemory)
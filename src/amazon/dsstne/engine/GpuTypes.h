@@ -334,6 +334,7 @@ struct GpuContext {
     unsigned int                        _warpMask;                  // Masks bits within a warp
     int                                 _numprocs;                  // Number of total processors in run
     int                                 _id;                        // Process ID
+    MPI_Comm                            _comm;                      // Processes networks and datasets are distributed over
     int                                 _device;                    // Device ID
 
     // Fast sparse kernel limits
@@ -345,6 +346,7 @@ struct GpuContext {
 
     // cuRand parameters
     curandGenerator_t                   _RNG;                       // Handle for random number generator
+    unsigned long                       _randomSeed;                // Seed last passed to SetRandomSeed
     
     // cuDNN parameters
     cudnnHandle_t                       _cuDNNHandle;               // handle for cuDNN library   
@@ -364,8 +366,10 @@ struct GpuContext {
     ~GpuContext();
     void GetMemoryUsage(int* gpuMemory, int* cpuMemory);
     void SetRandomSeed(unsigned long seed);
+    void ReseedRandom(unsigned long offset);
     void SetNeuralNetwork(NNNetwork* pNetwork);
     void Startup(int argc, char** argv);
+    void Detach();
     void Shutdown();
     void CopyConstants();
     void SetCPUValidate(bool bCPUValidate);
@@ -0,0 +1,73 @@
+/*
+
+
+   Copyright 2016  Amazon.com, Inc. or its affiliates. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License"). You may not use this file except in compliance with the License. A copy of the License is located at
+
+   http://aws.amazon.com/apache2.0/
+
+   or in the "license" file accompanying this file. This file is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the License for the specific language governing permissions and limitations under the License.
+ */
+
+#ifndef NNALIASTABLE_H
+#define NNALIASTABLE_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+// Vose's alias method for drawing from a discrete distribution in constant time: a draw picks i uniformly, keeps it
+// with probability vThreshold[i] and takes vAlias[i] otherwise.  Host-side only
+
+// Builds tables drawing i with probability vWeight[i] / sum(vWeight)
+inline void BuildAliasTable(const std::vector<double>& vWeight, std::vector<double>& vThreshold, std::vector<uint32_t>& vAlias)
+{
+    uint32_t size                       = vWeight.size();
+    double sum                          = 0.0;
+    for (double w : vWeight)
+        sum                            += w;
+
+    vThreshold.resize(size);
+    vAlias.resize(size);
+    std::vector<uint32_t> vSmall;
+    std::vector<uint32_t> vLarge;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        vThreshold[i]                   = vWeight[i] * size / sum;
+        vAlias[i]                       = i;
+        if (vThreshold[i] < 1.0)
+            vSmall.push_back(i);
+        else
+            vLarge.push_back(i);
+    }
+    while (!vSmall.empty() && !vLarge.empty())
+    {
+        uint32_t small                  = vSmall.back();
+        uint32_t large                  = vLarge.back();
+        vSmall.pop_back();
+        vAlias[small]                   = large;
+        vThreshold[large]              -= 1.0 - vThreshold[small];
+        if (vThreshold[large] < 1.0)
+        {
+            vLarge.pop_back();
+            vSmall.push_back(large);
+        }
+    }
+
+    // Whatever is left over only differs from 1 by rounding error
+    for (uint32_t i : vLarge)
+        vThreshold[i]                   = 1.0;
+    for (uint32_t i : vSmall)
+        vThreshold[i]                   = 1.0;
+}
+
+inline uint32_t DrawAlias(const std::vector<double>& vThreshold, const std::vector<uint32_t>& vAlias)
+{
+    uint32_t index                      = rand() % vThreshold.size();
+    if (rand() / (RAND_MAX + 1.0) >= vThreshold[index])
+        index                           = vAlias[index];
+    return index;
+}
+
+#endif
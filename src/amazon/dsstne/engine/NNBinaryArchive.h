@@ -0,0 +1,111 @@
+/*
+
+
+   Copyright 2016  Amazon.com, Inc. or its affiliates. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License"). You may not use this file except in compliance with the License. A copy of the License is located at
+
+   http://aws.amazon.com/apache2.0/
+
+   or in the "license" file accompanying this file. This file is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the License for the specific language governing permissions and limitations under the License.
+ */
+
+#ifndef NNBINARYARCHIVE_H
+#define NNBINARYARCHIVE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Flat binary encoding of descriptors, used for the metadata of compact model files.  Values are appended in native
+// byte order with no padding, strings and string vectors prefixed by their length, so files are only portable
+// between hosts of the same endianness
+class NNBinaryWriter
+{
+public:
+    template<typename T> void Write(const T& value)
+    {
+        const char* p                       = (const char*)&value;
+        _vBuffer.insert(_vBuffer.end(), p, p + sizeof(T));
+    }
+
+    void Write(const std::string& s)
+    {
+        Write((uint32_t)s.size());
+        _vBuffer.insert(_vBuffer.end(), s.begin(), s.end());
+    }
+
+    void Write(const std::vector<std::string>& v)
+    {
+        Write((uint32_t)v.size());
+        for (const std::string& s : v)
+            Write(s);
+    }
+
+    const std::vector<char>& GetBuffer() const { return _vBuffer; }
+
+private:
+    std::vector<char>   _vBuffer;
+};
+
+// Reads values back in the order NNBinaryWriter wrote them.  Reading past the end of the data leaves the value
+// untouched and marks the reader invalid rather than throwing, so callers check IsValid() once at the end
+class NNBinaryReader
+{
+public:
+    NNBinaryReader(const char* pData, size_t size) :
+    _pData(pData),
+    _pEnd(pData + size),
+    _bValid(true)
+    {
+    }
+
+    template<typename T> void Read(T& value)
+    {
+        if (!_bValid || (GetRemaining() < sizeof(T)))
+        {
+            _bValid                         = false;
+            return;
+        }
+        memcpy(&value, _pData, sizeof(T));
+        _pData                             += sizeof(T);
+    }
+
+    void Read(std::string& s)
+    {
+        uint32_t length                     = 0;
+        Read(length);
+        if (!_bValid || (GetRemaining() < length))
+        {
+            _bValid                         = false;
+            return;
+        }
+        s.assign(_pData, length);
+        _pData                             += length;
+    }
+
+    void Read(std::vector<std::string>& v)
+    {
+        uint32_t size                       = 0;
+        Read(size);
+        if (!_bValid || (GetRemaining() < (size_t)size * sizeof(uint32_t)))
+        {
+            _bValid                         = false;
+            return;
+        }
+        v.resize(size);
+        for (std::string& s : v)
+            Read(s);
+    }
+
+    size_t GetRemaining() const { return _pEnd - _pData; }
+    bool IsValid() const { return _bValid; }
+
+private:
+    const char*         _pData;
+    const char*         _pEnd;
+    bool                _bValid;
+};
+
+#endif
@@ -0,0 +1,412 @@
+/*
+
+
+   Copyright 2016  Amazon.com, Inc. or its affiliates. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License"). You may not use this file except in compliance with the License. A copy of the License is located at
+
+   http://aws.amazon.com/apache2.0/
+
+   or in the "license" file accompanying this file. This file is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the License for the specific language governing permissions and limitations under the License.
+ */
+
+#ifndef NNDATASETSTREAM_H
+#define NNDATASETSTREAM_H
+
+#include <netcdf>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+// Host-side half of streamed datasets: the order shards and examples are visited in, background reading of
+// the next group of shards and the per-dataset buffers of resident groups.  NNStreamingDataSet builds its GPU
+// window from these buffers
+
+// NetCDF is not thread-safe, so every NetCDF access that can overlap a background reader or writer holds this lock
+inline std::mutex& getNetCDFMutex()
+{
+    static std::mutex netCDFMutex;
+    return netCDFMutex;
+}
+
+// Derives an independent generator per (seed, pass, group) so any group can be read in any order on any process
+inline std::mt19937 GetStreamRNG(uint64_t seed, uint64_t pass, uint64_t group)
+{
+    std::seed_seq seq{(uint32_t)seed, (uint32_t)(seed >> 32), (uint32_t)pass, (uint32_t)(pass >> 32), (uint32_t)group, (uint32_t)(group >> 32)};
+    return std::mt19937(seq);
+}
+
+// Interface the stream uses to fill the staging buffers of each dataset read from its shards
+class NNStreamGroupsBase {
+public:
+    virtual ~NNStreamGroupsBase() {}
+    virtual void ClearStaging() = 0;
+    virtual void ReadShard(netCDF::NcFile& nfc, const std::string& fname, uint32_t examples) = 0;
+    virtual void PermuteStaging(const std::vector<uint32_t>& vPermutation) = 0;
+    virtual void CommitStaging(uint64_t sequence) = 0;
+    virtual void ReleaseGroup(uint64_t sequence) = 0;
+};
+
+// Sparse examples of the group being read and of the resident groups, in CSR form.  ReadShard is left to the
+// dataset, which appends each shard it reads with AppendShard
+template<typename T> class NNStreamGroups : public NNStreamGroupsBase {
+public:
+    void ClearStaging();
+    void PermuteStaging(const std::vector<uint32_t>& vPermutation);
+    void CommitStaging(uint64_t sequence);
+    void ReleaseGroup(uint64_t sequence);
+    void AppendShard(const std::vector<uint64_t>& vSparseOffset, const std::vector<uint32_t>& vSparseIndex, const std::vector<T>& vSparseData, uint32_t examples);
+    void GatherResident(const std::vector<uint64_t>& vGroup, bool bSlice, uint32_t minX, uint32_t maxX,
+                        std::vector<uint64_t>& vSparseOffset, std::vector<uint32_t>& vSparseIndex, std::vector<T>& vSparseData);
+    uint64_t GetResidentMemory();
+
+private:
+    struct Block
+    {
+        std::vector<uint64_t>       _vSparseOffset;
+        std::vector<uint32_t>       _vSparseIndex;
+        std::vector<T>              _vSparseData;               // Empty for Boolean datasets
+    };
+
+    Block                           _staging;                   // Group being read
+    std::map<uint64_t, Block>       _mGroup;                    // Resident groups by sequence number
+};
+
+template<typename T> void NNStreamGroups<T>::ClearStaging()
+{
+    _staging                                    = Block();
+    _staging._vSparseOffset.push_back(0);
+}
+
+template<typename T> void NNStreamGroups<T>::AppendShard(const std::vector<uint64_t>& vSparseOffset, const std::vector<uint32_t>& vSparseIndex, const std::vector<T>& vSparseData, uint32_t examples)
+{
+    uint64_t base                               = _staging._vSparseIndex.size();
+    for (uint32_t i = 1; i <= examples; i++)
+        _staging._vSparseOffset.push_back(base + vSparseOffset[i]);
+    _staging._vSparseIndex.insert(_staging._vSparseIndex.end(), vSparseIndex.begin(), vSparseIndex.end());
+    _staging._vSparseData.insert(_staging._vSparseData.end(), vSparseData.begin(), vSparseData.end());
+}
+
+template<typename T> void NNStreamGroups<T>::PermuteStaging(const std::vector<uint32_t>& vPermutation)
+{
+    bool bData                                  = !_staging._vSparseData.empty();
+    Block block;
+    block._vSparseOffset.reserve(_staging._vSparseOffset.size());
+    block._vSparseIndex.reserve(_staging._vSparseIndex.size());
+    block._vSparseData.reserve(_staging._vSparseData.size());
+    block._vSparseOffset.push_back(0);
+    for (auto j : vPermutation)
+    {
+        uint64_t start                          = _staging._vSparseOffset[j];
+        uint64_t end                            = _staging._vSparseOffset[j + 1];
+        block._vSparseIndex.insert(block._vSparseIndex.end(), _staging._vSparseIndex.begin() + start, _staging._vSparseIndex.begin() + end);
+        if (bData)
+            block._vSparseData.insert(block._vSparseData.end(), _staging._vSparseData.begin() + start, _staging._vSparseData.begin() + end);
+        block._vSparseOffset.push_back(block._vSparseIndex.size());
+    }
+    _staging                                    = std::move(block);
+}
+
+template<typename T> void NNStreamGroups<T>::CommitStaging(uint64_t sequence)
+{
+    _mGroup[sequence]                           = std::move(_staging);
+    _staging                                    = Block();
+}
+
+template<typename T> void NNStreamGroups<T>::ReleaseGroup(uint64_t sequence)
+{
+    _mGroup.erase(sequence);
+}
+
+// Bytes held by the resident groups (staging is owned by the prefetch thread)
+template<typename T> uint64_t NNStreamGroups<T>::GetResidentMemory()
+{
+    uint64_t memory                             = 0;
+    for (auto& g : _mGroup)
+    {
+        memory                                 += g.second._vSparseOffset.size() * sizeof(uint64_t);
+        memory                                 += g.second._vSparseIndex.size() * sizeof(uint32_t);
+        memory                                 += g.second._vSparseData.size() * sizeof(T);
+    }
+    return memory;
+}
+
+// Concatenates the examples of groups vGroup in order, keeping only indices in [minX, maxX), shifted down by minX,
+// when bSlice is set
+template<typename T> void NNStreamGroups<T>::GatherResident(const std::vector<uint64_t>& vGroup, bool bSlice, uint32_t minX, uint32_t maxX,
+                                                            std::vector<uint64_t>& vSparseOffset, std::vector<uint32_t>& vSparseIndex, std::vector<T>& vSparseData)
+{
+    vSparseOffset.assign(1, 0);
+    vSparseIndex.clear();
+    vSparseData.clear();
+    for (auto s : vGroup)
+    {
+        const Block& block                      = _mGroup[s];
+        bool bData                              = !block._vSparseData.empty();
+        for (size_t j = 1; j < block._vSparseOffset.size(); j++)
+        {
+            for (uint64_t k = block._vSparseOffset[j - 1]; k < block._vSparseOffset[j]; k++)
+            {
+                uint32_t index                  = block._vSparseIndex[k];
+                if (bSlice && ((index < minX) || (index >= maxX)))
+                    continue;
+                vSparseIndex.push_back(index - (bSlice ? minX : 0));
+                if (bData)
+                    vSparseData.push_back(block._vSparseData[k]);
+            }
+            vSparseOffset.push_back(vSparseIndex.size());
+        }
+    }
+}
+
+// Streams the examples of a directory of NetCDF shards through a bounded window.  Shards are visited in an order
+// reshuffled every pass over the data and grouped windowShards at a time; the examples of each group are shuffled
+// together and the next group is read on a background thread while the current one trains.  Every dataset read
+// from the same shards shares one stream, and the order depends only on the random seed and the shard sizes, so
+// every process, and a second directory of identically sized shards (e.g. outputs), sees the same examples.
+class NNDataSetStream {
+public:
+    NNDataSetStream(const std::vector<std::string>& vShardFile, const std::vector<uint32_t>& vShardExamples, uint32_t windowShards, bool bShuffle);
+    ~NNDataSetStream();
+    void AddDataSet(NNStreamGroupsBase* pDataSet);
+    void RemoveDataSet(NNStreamGroupsBase* pDataSet);
+    bool Advance(uint32_t position, uint32_t batch, uint64_t seed);
+    uint32_t GetWindowPosition(uint32_t position) { return position - _residentStart; };
+    uint64_t GetGeneration() { return _generation; };
+    const std::vector<uint64_t>& GetResidentGroups() { return _vResidentGroup; };
+
+private:
+    void BeginPass(uint64_t pass);
+    void GetShardOrder(uint64_t pass, std::vector<uint32_t>& vOrder);
+    bool ReadGroup(uint64_t sequence);
+    bool LoadGroup(uint64_t sequence);
+    void StartPrefetch(uint64_t sequence);
+
+    std::vector<std::string>        _vShardFile;                // Shard file names
+    std::vector<uint32_t>           _vShardExamples;            // Examples per shard
+    uint32_t                        _windowShards;              // Shards per resident group
+    uint32_t                        _groups;                    // Groups per pass over the data
+    bool                            _bShuffle;                  // Shuffle shard order and examples within each group
+    uint64_t                        _seed;                      // Random seed when the first batch was requested
+    std::vector<NNStreamGroupsBase*> _vDataSet;                 // Datasets read from these shards
+    bool                            _bStarted;                  // Set once the first batch has been requested
+    uint64_t                        _pass;                      // Current pass over the data
+    uint32_t                        _position;                  // Last requested position
+    std::vector<uint32_t>           _vGroupStart;               // First position of each group in the current pass
+    std::vector<uint64_t>           _vResidentGroup;            // Sequence numbers (pass * groups + group) of resident groups
+    uint32_t                        _residentStart;             // First position held by the resident groups
+    uint64_t                        _generation;                // Incremented whenever the resident groups change
+    std::thread                     _prefetchThread;            // Background reader for the next group
+    uint64_t                        _prefetchSequence;          // Group being read by _prefetchThread
+    bool                            _bPrefetchResult;           // Whether the background read succeeded
+};
+
+inline NNDataSetStream::NNDataSetStream(const std::vector<std::string>& vShardFile, const std::vector<uint32_t>& vShardExamples, uint32_t windowShards, bool bShuffle) :
+_vShardFile(vShardFile),
+_vShardExamples(vShardExamples),
+_windowShards(windowShards),
+_groups((vShardFile.size() + windowShards - 1) / windowShards),
+_bShuffle(bShuffle),
+_seed(0),
+_bStarted(false),
+_pass(0),
+_position(0),
+_residentStart(0),
+_generation(0),
+_prefetchSequence(0),
+_bPrefetchResult(false)
+{
+}
+
+inline NNDataSetStream::~NNDataSetStream()
+{
+    if (_prefetchThread.joinable())
+        _prefetchThread.join();
+}
+
+inline void NNDataSetStream::AddDataSet(NNStreamGroupsBase* pDataSet)
+{
+    _vDataSet.push_back(pDataSet);
+}
+
+inline void NNDataSetStream::RemoveDataSet(NNStreamGroupsBase* pDataSet)
+{
+    // Background reader may be filling this dataset's staging buffers
+    if (_prefetchThread.joinable())
+        _prefetchThread.join();
+    _vDataSet.erase(std::remove(_vDataSet.begin(), _vDataSet.end(), pDataSet), _vDataSet.end());
+}
+
+inline void NNDataSetStream::GetShardOrder(uint64_t pass, std::vector<uint32_t>& vOrder)
+{
+    vOrder.resize(_vShardFile.size());
+    for (uint32_t i = 0; i < vOrder.size(); i++)
+        vOrder[i]                               = i;
+    if (_bShuffle)
+    {
+        // Group numbers only go up to _groups - 1, so _groups seeds the shard order
+        std::mt19937 rng                        = GetStreamRNG(_seed, pass, _groups);
+        std::shuffle(vOrder.begin(), vOrder.end(), rng);
+    }
+}
+
+inline void NNDataSetStream::BeginPass(uint64_t pass)
+{
+    // Release the previous pass, keeping any prefetched first group of this one
+    for (auto s : _vResidentGroup)
+    {
+        for (auto d : _vDataSet)
+            d->ReleaseGroup(s);
+    }
+    _vResidentGroup.clear();
+    _pass                                       = pass;
+
+    // Locate the first position of each group in this pass's shard order
+    std::vector<uint32_t> vOrder;
+    GetShardOrder(pass, vOrder);
+    _vGroupStart.resize(_groups + 1);
+    _vGroupStart[0]                             = 0;
+    for (uint32_t g = 0; g < _groups; g++)
+    {
+        _vGroupStart[g + 1]                     = _vGroupStart[g];
+        for (uint32_t i = g * _windowShards; i < std::min((g + 1) * _windowShards, (uint32_t)vOrder.size()); i++)
+            _vGroupStart[g + 1]                += _vShardExamples[vOrder[i]];
+    }
+}
+
+// Reads group (sequence % groups) of pass (sequence / groups) into the staging buffers of every dataset.  Runs
+// on the prefetch thread, so it only reads state that is fixed once streaming starts
+inline bool NNDataSetStream::ReadGroup(uint64_t sequence)
+{
+    uint64_t pass                               = sequence / _groups;
+    uint32_t group                              = sequence % _groups;
+    std::vector<uint32_t> vOrder;
+    GetShardOrder(pass, vOrder);
+    for (auto d : _vDataSet)
+        d->ClearStaging();
+
+    uint32_t examples                           = 0;
+    std::string fname;
+    try
+    {
+        for (uint32_t i = group * _windowShards; i < std::min((group + 1) * _windowShards, (uint32_t)vOrder.size()); i++)
+        {
+            fname                               = _vShardFile[vOrder[i]];
+            std::lock_guard<std::mutex> lock(getNetCDFMutex());
+            netCDF::NcFile nfc(fname.c_str(), netCDF::NcFile::read);
+            for (auto d : _vDataSet)
+                d->ReadShard(nfc, fname, _vShardExamples[vOrder[i]]);
+            examples                           += _vShardExamples[vOrder[i]];
+        }
+    }
+    catch (netCDF::exceptions::NcException& e)
+    {
+        std::cout << "NNDataSetStream::ReadGroup: Error reading NetCDF shard " << fname << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    // Shuffle examples across all shards in the group
+    if (_bShuffle)
+    {
+        std::vector<uint32_t> vPermutation(examples);
+        for (uint32_t i = 0; i < examples; i++)
+            vPermutation[i]                     = i;
+        std::mt19937 rng                        = GetStreamRNG(_seed, pass, group);
+        std::shuffle(vPermutation.begin(), vPermutation.end(), rng);
+        for (auto d : _vDataSet)
+            d->PermuteStaging(vPermutation);
+    }
+    return true;
+}
+
+inline bool NNDataSetStream::LoadGroup(uint64_t sequence)
+{
+    // Use the background read if it fetched this group, otherwise read it now
+    bool bPrefetched                            = _prefetchThread.joinable();
+    if (bPrefetched)
+        _prefetchThread.join();
+    bool bResult                                = (bPrefetched && (_prefetchSequence == sequence)) ? _bPrefetchResult : ReadGroup(sequence);
+    if (!bResult)
+    {
+        printf("NNDataSetStream::LoadGroup: Unable to read group %lu of streamed dataset.\n", (unsigned long)(sequence % _groups));
+        return false;
+    }
+    for (auto d : _vDataSet)
+        d->CommitStaging(sequence);
+    return true;
+}
+
+inline void NNDataSetStream::StartPrefetch(uint64_t sequence)
+{
+    if (_prefetchThread.joinable())
+    {
+        if (_prefetchSequence == sequence)
+            return;
+        _prefetchThread.join();
+    }
+    _prefetchSequence                           = sequence;
+    _prefetchThread                             = std::thread([this, sequence]()
+    {
+        _bPrefetchResult                        = ReadGroup(sequence);
+    });
+}
+
+// Makes positions [position, position + batch) of the current pass resident, returning false if a group could
+// not be read.  Requesting an earlier position than the last one starts the next pass.  The order is fixed by the
+// seed passed with the first request
+inline bool NNDataSetStream::Advance(uint32_t position, uint32_t batch, uint64_t seed)
+{
+    if (!_bStarted)
+    {
+        _seed                                   = seed;
+        _bStarted                               = true;
+        BeginPass(0);
+    }
+    else if (position < _position)
+    {
+        BeginPass(_pass + 1);
+    }
+    _position                                   = position;
+
+    // Find the groups covering this batch
+    uint32_t end                                = std::min(position + batch, _vGroupStart.back());
+    uint32_t first                              = std::upper_bound(_vGroupStart.begin(), _vGroupStart.end(), position) - _vGroupStart.begin() - 1;
+    uint32_t last                               = std::upper_bound(_vGroupStart.begin(), _vGroupStart.end(), std::max(end, position + 1) - 1) - _vGroupStart.begin() - 1;
+    last                                        = std::min(last, _groups - 1);
+    std::vector<uint64_t> vGroup;
+    for (uint32_t g = first; g <= last; g++)
+        vGroup.push_back(_pass * _groups + g);
+    if (vGroup == _vResidentGroup)
+        return true;
+
+    // Load missing groups and release the ones no longer needed
+    for (auto s : vGroup)
+    {
+        if ((std::find(_vResidentGroup.begin(), _vResidentGroup.end(), s) == _vResidentGroup.end()) && !LoadGroup(s))
+            return false;
+    }
+    for (auto s : _vResidentGroup)
+    {
+        if (std::find(vGroup.begin(), vGroup.end(), s) == vGroup.end())
+        {
+            for (auto d : _vDataSet)
+                d->ReleaseGroup(s);
+        }
+    }
+    _vResidentGroup                             = vGroup;
+    _residentStart                              = _vGroupStart[first];
+    _generation++;
+
+    // Read the following group, wrapping into the next pass, while this one trains
+    StartPrefetch(vGroup.back() + 1);
+    return true;
+}
+
+#endif
@@ -0,0 +1,95 @@
+/*
+
+
+   Copyright 2016  Amazon.com, Inc. or its affiliates. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License"). You may not use this file except in compliance with the License. A copy of the License is located at
+
+   http://aws.amazon.com/apache2.0/
+
+   or in the "license" file accompanying this file. This file is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the License for the specific language governing permissions and limitations under the License.
+ */
+
+#ifndef NNDATASHARD_H
+#define NNDATASHARD_H
+
+#include <mpi.h>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+// Host-side layout of data sharded datasets: process i holds the contiguous range of examples starting at
+// (examples / numprocs) * i + min(i, examples % numprocs), the first examples % numprocs processes holding one more
+// example than the rest.  Processes reading their shard from a NetCDF file and process 0 sending shards out produce
+// the same ranges, and appending them in process order restores the original example order
+
+// First example and number of examples of process id's range
+inline void GetDataShard(uint32_t examples, uint32_t id, uint32_t numprocs, uint32_t& first, uint32_t& localExamples)
+{
+    uint32_t segment                    = examples / numprocs;
+    uint32_t remainder                  = examples % numprocs;
+    localExamples                       = segment + (remainder > id);
+    first                               = segment * id + std::min(id, remainder);
+}
+
+// Sends every other process its range of the examples of stride values each held by process 0, which keeps only
+// its own range, and receives this process's range on the others
+template<typename T> void ScatterDataShards(std::vector<T>& vData, uint32_t examples, uint64_t stride, MPI_Datatype type, MPI_Comm comm)
+{
+    int id, numprocs;
+    MPI_Comm_rank(comm, &id);
+    MPI_Comm_size(comm, &numprocs);
+    if (id == 0)
+    {
+        for (int i = 1; i < numprocs; i++)
+        {
+            uint32_t first, localExamples;
+            GetDataShard(examples, i, numprocs, first, localExamples);
+            uint64_t size               = localExamples * stride;
+            MPI_Send(&size, 1, MPI_UINT64_T, i, 0, comm);
+            MPI_Send(vData.data() + first * stride, size, type, i, 0, comm);
+        }
+        uint32_t first, localExamples;
+        GetDataShard(examples, 0, numprocs, first, localExamples);
+        vData.resize(localExamples * stride);
+    }
+    else
+    {
+        uint64_t size;
+        MPI_Status status;
+        MPI_Recv(&size, 1, MPI_UINT64_T, 0, 0, comm, &status);
+        vData.resize(size);
+        MPI_Recv(vData.data(), size, type, 0, 0, comm, &status);
+    }
+}
+
+// Appends the ranges of the other processes to process 0's in process order, leaving it with every example in the
+// original order and the other processes with none
+template<typename T> void GatherDataShards(std::vector<T>& vData, uint32_t examples, uint64_t stride, MPI_Datatype type, MPI_Comm comm)
+{
+    int id, numprocs;
+    MPI_Comm_rank(comm, &id);
+    MPI_Comm_size(comm, &numprocs);
+    if (id == 0)
+    {
+        vData.reserve(examples * stride);
+        for (int i = 1; i < numprocs; i++)
+        {
+            uint64_t size;
+            MPI_Status status;
+            MPI_Recv(&size, 1, MPI_UINT64_T, i, 0, comm, &status);
+            size_t offset               = vData.size();
+            vData.resize(offset + size);
+            MPI_Recv(vData.data() + offset, size, type, i, 0, comm, &status);
+        }
+    }
+    else
+    {
+        uint64_t size                   = vData.size();
+        MPI_Send(&size, 1, MPI_UINT64_T, 0, 0, comm);
+        MPI_Send(vData.data(), size, type, 0, 0, comm);
+        std::vector<T>().swap(vData);
+    }
+}
+
+#endif
@@ -28,6 +28,12 @@ namespace NNDataSetEnums {
         Data = 2,
     };
 
+    enum SparseEncoding
+    {
+        RawIndex = 0,               // sparseStart/sparseEnd per example and 32-bit sparseIndex
+        DeltaVarint = 1,            // sparseOffset per example plus 1 and sorted, delta + varint encoded sparseIndex bytes
+    };
+
     enum DataType
     {
         UInt = 0,
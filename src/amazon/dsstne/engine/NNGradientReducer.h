@@ -0,0 +1,305 @@
+/*
+
+
+   Copyright 2016  Amazon.com, Inc. or its affiliates. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License"). You may not use this file except in compliance with the License. A copy of the License is located at
+
+   http://aws.amazon.com/apache2.0/
+
+   or in the "license" file accompanying this file. This file is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the License for the specific language governing permissions and limitations under the License.
+ */
+
+#ifndef NNGRADIENTREDUCER_H
+#define NNGRADIENTREDUCER_H
+
+#include <mpi.h>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+enum GradientCompression
+{
+    Uncompressed = 0,               // Full precision MPI_Iallreduce
+    HalfPrecision = 1,              // Values rounded to IEEE 754 half precision before reducing
+    SparseTopK = 2,                 // Only the largest magnitude fraction of each gradient is exchanged
+};
+
+// Sums gradients replicated on every process in buckets of roughly bucketSize values, each reduced with a
+// non-blocking MPI_Iallreduce as soon as it is staged, so reducing the gradients of layers that have finished
+// backpropagating overlaps with backpropagating the rest.  Gradients are added in backpropagation order along
+// with the step that completes them, and each bucket is complete at the step of its last gradient.  MPI matches
+// collectives by call order, so every process has to start the buckets in the same order, which Start() enforces
+// by always starting the next one.  Host-side only: callers stage gradients into each bucket's system memory
+// buffer, supplied through SetBuffer(), before starting it and copy them back out after Wait()
+//
+// Buckets can optionally be compressed: HalfPrecision halves the data exchanged, while SparseTopK only sends the
+// (index, value) pairs of the ratio largest magnitude values of each gradient, gathered from every process and summed
+// locally.  Either way whatever a process leaves out, rounding error or unsent values, is kept per gradient as a
+// residual and added to its next gradient (error feedback), so its own contribution is only delayed.  HalfPrecision
+// also rounds every partial sum of the reduction back to half precision, which no process can feed back, so its
+// sums carry up to one half precision rounding per process on top of that
+template<typename T> class NNGradientReducer
+{
+public:
+    NNGradientReducer(MPI_Datatype type, size_t bucketSize, MPI_Comm comm) :
+    _type(type),
+    _comm(comm),
+    _bucketSize(bucketSize),
+    _next(0),
+    _compression(Uncompressed),
+    _ratio(1.0),
+    _halfSum(MPI_OP_NULL)
+    {
+    }
+
+    ~NNGradientReducer()
+    {
+        Wait();
+        int bFinalized;
+        MPI_Finalized(&bFinalized);
+        if ((_halfSum != MPI_OP_NULL) && !bFinalized)
+            MPI_Op_free(&_halfSum);
+    }
+
+    // Sets bucket compression, ratio being the fraction of each gradient SparseTopK sends.  Discards residuals
+    void SetCompression(GradientCompression compression, double ratio = 1.0)
+    {
+        Wait();
+        _compression                        = compression;
+        _ratio                              = ratio;
+        if ((_compression == HalfPrecision) && (_halfSum == MPI_OP_NULL))
+            MPI_Op_create(HalfSum, 1, &_halfSum);
+        for (Bucket& b : _vBucket)
+        {
+            b._vResidual.clear();
+            b._vHalf.clear();
+            b._vEntry.clear();
+            b._vGathered.clear();
+        }
+    }
+
+    // Adds a gradient of size values completed by step, returning the bucket and offset within it to stage it at
+    void Add(size_t size, uint32_t step, uint32_t& bucket, size_t& offset)
+    {
+        if (_vBucket.empty() || (_vBucket.back()._size >= _bucketSize))
+            _vBucket.push_back(Bucket());
+        Bucket& b                           = _vBucket.back();
+        bucket                              = _vBucket.size() - 1;
+        offset                              = b._size;
+        b._size                            += size;
+        b._step                             = step;
+        b._vGradient.push_back(std::make_pair(offset, size));
+    }
+
+    uint32_t GetBuckets() const { return _vBucket.size(); }
+    size_t GetBucketSize(uint32_t bucket) const { return _vBucket[bucket]._size; }
+    uint32_t GetBucketStep(uint32_t bucket) const { return _vBucket[bucket]._step; }
+    void SetBuffer(uint32_t bucket, T* pBuffer) { _vBucket[bucket]._pBuffer = pBuffer; }
+
+    // First bucket not started yet, GetBuckets() once all have been
+    uint32_t GetNextBucket() const { return _next; }
+
+    // Starts reducing the next bucket, whose gradients must already be staged in its buffer
+    void Start()
+    {
+        Bucket& b                           = _vBucket[_next++];
+        if (_compression == Uncompressed)
+        {
+            MPI_Iallreduce(MPI_IN_PLACE, b._pBuffer, b._size, _type, MPI_SUM, _comm, &b._request);
+            return;
+        }
+
+        // Residuals are left over from the previous batch
+        if (b._vResidual.empty())
+            b._vResidual.resize(b._size, (T)0);
+
+        if (_compression == HalfPrecision)
+        {
+            b._vHalf.resize(b._size);
+            CompressHalf(b._pBuffer, b._vResidual.data(), b._vHalf.data(), b._size);
+            MPI_Iallreduce(MPI_IN_PLACE, b._vHalf.data(), b._size, MPI_UINT16_T, _halfSum, _comm, &b._request);
+        }
+        else
+        {
+            // Send the largest magnitude values of each gradient, which every process picks the same number of
+            b._vEntry.clear();
+            for (auto& g : b._vGradient)
+                SelectTopK(b._pBuffer, b._vResidual.data(), g.first, g.second, GetTopK(g.second, _ratio), _vIndex, b._vEntry);
+            int numprocs;
+            MPI_Comm_size(_comm, &numprocs);
+            b._vGathered.resize(b._vEntry.size() * numprocs);
+            MPI_Iallgather(b._vEntry.data(), b._vEntry.size() * sizeof(Entry), MPI_BYTE, b._vGathered.data(), b._vEntry.size() * sizeof(Entry), MPI_BYTE, _comm, &b._request);
+        }
+    }
+
+    // Lets MPI progress the reductions in flight without blocking
+    void Test()
+    {
+        for (uint32_t i = 0; i < _next; i++)
+        {
+            if (_vBucket[i]._request != MPI_REQUEST_NULL)
+            {
+                int flag;
+                MPI_Test(&_vBucket[i]._request, &flag, MPI_STATUS_IGNORE);
+            }
+        }
+    }
+
+    // Waits for every bucket started so far, after which the next batch starts again from the first bucket
+    void Wait()
+    {
+        for (uint32_t i = 0; i < _next; i++)
+        {
+            Bucket& b                       = _vBucket[i];
+            MPI_Wait(&b._request, MPI_STATUS_IGNORE);
+
+            // Decompress into the bucket's buffer, summing gathered values in process order so every process
+            // arrives at the same result
+            if (_compression == HalfPrecision)
+            {
+                for (size_t j = 0; j < b._size; j++)
+                    b._pBuffer[j]           = (T)HalfToFloat(b._vHalf[j]);
+            }
+            else if (_compression == SparseTopK)
+            {
+                memset(b._pBuffer, 0, b._size * sizeof(T));
+                for (const Entry& e : b._vGathered)
+                    b._pBuffer[e._index]   += e._value;
+            }
+        }
+        _next                               = 0;
+    }
+
+    // Rounds to the nearest IEEE 754 half precision value, ties to even, saturating instead of overflowing to
+    // infinity so a single large value cannot poison the sum
+    static uint16_t FloatToHalf(float f)
+    {
+        uint32_t x;
+        memcpy(&x, &f, sizeof(x));
+        uint16_t sign                       = (x >> 16) & 0x8000;
+        uint32_t absx                       = x & 0x7fffffff;
+        if (absx > 0x7f800000)
+            return sign | 0x7e00;
+        if (absx >= 0x477ff000)
+            return sign | 0x7bff;
+        if (absx < 0x38800000)
+        {
+            float a;
+            memcpy(&a, &absx, sizeof(a));
+            return sign | (uint16_t)lrintf(a * 16777216.0f);
+        }
+        uint32_t h                          = (((absx >> 23) - 112) << 10) | ((absx & 0x7fffff) >> 13);
+        uint32_t remainder                  = absx & 0x1fff;
+        if ((remainder > 0x1000) || ((remainder == 0x1000) && (h & 1)))
+            h++;
+        return sign | h;
+    }
+
+    static float HalfToFloat(uint16_t h)
+    {
+        uint32_t sign                       = (uint32_t)(h & 0x8000) << 16;
+        uint32_t exponent                   = (h >> 10) & 0x1f;
+        uint32_t mantissa                   = h & 0x3ff;
+        uint32_t x;
+        if (exponent == 0)
+        {
+            float f                         = mantissa / 16777216.0f;
+            memcpy(&x, &f, sizeof(x));
+            x                              |= sign;
+        }
+        else if (exponent == 31)
+            x                               = sign | 0x7f800000 | (mantissa << 13);
+        else
+            x                               = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        float f;
+        memcpy(&f, &x, sizeof(f));
+        return f;
+    }
+
+    struct Entry
+    {
+        uint32_t        _index;                 // Offset within bucket
+        T               _value;
+
+        Entry() {}
+        Entry(size_t index, T value) : _index(index), _value(value) {}
+    };
+
+    // Values SparseTopK sends of a gradient of size values, at least one
+    static size_t GetTopK(size_t size, double ratio)
+    {
+        return std::min(size, std::max((size_t)1, (size_t)ceil(ratio * size)));
+    }
+
+    // HalfPrecision error feedback: adds size values to their residuals, then moves as much of each residual as
+    // half precision represents into pHalf, leaving the rounding error behind
+    static void CompressHalf(const T* pValue, T* pResidual, uint16_t* pHalf, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            pResidual[i]                   += pValue[i];
+            pHalf[i]                        = FloatToHalf((float)pResidual[i]);
+            pResidual[i]                   -= (T)HalfToFloat(pHalf[i]);
+        }
+    }
+
+    // SparseTopK error feedback: adds the size values at offset to their residuals, then moves the k largest in
+    // magnitude into vEntry, vIndex being scratch space
+    static void SelectTopK(const T* pValue, T* pResidual, size_t offset, size_t size, size_t k, std::vector<size_t>& vIndex, std::vector<Entry>& vEntry)
+    {
+        vIndex.resize(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            pResidual[offset + i]          += pValue[offset + i];
+            vIndex[i]                       = offset + i;
+        }
+        std::nth_element(vIndex.begin(), vIndex.begin() + (k - 1), vIndex.end(),
+                         [pResidual](size_t i, size_t j) { return std::fabs(pResidual[i]) > std::fabs(pResidual[j]); });
+        for (size_t i = 0; i < k; i++)
+        {
+            vEntry.push_back(Entry(vIndex[i], pResidual[vIndex[i]]));
+            pResidual[vIndex[i]]            = (T)0;
+        }
+    }
+
+private:
+
+    struct Bucket
+    {
+        size_t          _size;                  // Values in bucket
+        uint32_t        _step;                  // Step completing the last gradient in the bucket
+        T*              _pBuffer;               // System memory the gradients are staged and reduced in
+        MPI_Request     _request;               // Outstanding MPI_Iallreduce or MPI_Iallgather
+        std::vector<std::pair<size_t, size_t> > _vGradient; // Offset and size of each gradient in bucket
+        std::vector<T>  _vResidual;             // Values left out by compression, added back next batch
+        std::vector<uint16_t> _vHalf;           // Half precision values reduced by HalfPrecision
+        std::vector<Entry> _vEntry;             // Values sent by SparseTopK
+        std::vector<Entry> _vGathered;          // Values sent by every process, in process order
+
+        Bucket() : _size(0), _step(0), _pBuffer(NULL), _request(MPI_REQUEST_NULL) {}
+    };
+
+    // MPI reduction of half precision values, added in single precision and rounded back to half precision
+    static void HalfSum(void* pIn, void* pInOut, int* pLength, MPI_Datatype*)
+    {
+        uint16_t* pA                        = (uint16_t*)pIn;
+        uint16_t* pB                        = (uint16_t*)pInOut;
+        for (int i = 0; i < *pLength; i++)
+            pB[i]                           = FloatToHalf(HalfToFloat(pA[i]) + HalfToFloat(pB[i]));
+    }
+
+    MPI_Datatype        _type;
+    MPI_Comm            _comm;
+    size_t              _bucketSize;
+    std::vector<Bucket> _vBucket;
+    uint32_t            _next;
+    GradientCompression _compression;
+    double              _ratio;                 // Fraction of each gradient SparseTopK sends
+    MPI_Op              _halfSum;               // HalfSum as an MPI operation
+    std::vector<size_t> _vIndex;                // Scratch space for selecting SparseTopK values
+};
+
+#endif
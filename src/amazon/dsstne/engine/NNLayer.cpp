@@ -33,6 +33,18 @@ _vSkip(d._vSkip),
 _pbUnit(NULL),
 _pbDelta(NULL),
 _pbDropout(NULL),
+_sampledNegatives(0),
+_sampledPower((NNFloat)0.75),
+_bSampled(false),
+_samples(0),
+_maxSamples(0),
+_maxSampledTargets(0),
+_pbSampledIndex(NULL),
+_pbSampledCorrection(NULL),
+_pbSampledTargetStart(NULL),
+_pbSampledTarget(NULL),
+_pbSampledUnit(NULL),
+_pbSampledDelta(NULL),
 _Nx(d._Nx),
 _Ny(d._Ny),
 _Nz(d._Nz),
@@ -72,8 +84,8 @@ _localBatch(batch)
     _parallelization                = Serial;
 
     // Model parallel settings
-    _minX                           = ((size_t)_Nx * (size_t)getGpu()._id) / (size_t)getGpu()._numprocs;
-    _maxX                           = ((size_t)_Nx * (size_t)(getGpu()._id + 1)) / (size_t)getGpu()._numprocs;
+    _minX                           = GetSliceStart(_Nx, getGpu()._id, getGpu()._numprocs);
+    _maxX                           = GetSliceStart(_Nx, getGpu()._id + 1, getGpu()._numprocs);
     _localStride                    = (_maxX - _minX) * _Ny * _Nz * _Nw;
     _maxLocalStride                 = (((size_t)_Nx + getGpu()._numprocs - 1) / (size_t)getGpu()._numprocs) * _Ny * _Nz * _Nw;
     
@@ -175,6 +187,21 @@ void NNLayer::Deallocate()
     _pbDelta                    = NULL;
     delete _pbDropout;
     _pbDropout                  = NULL;
+    delete _pbSampledIndex;
+    _pbSampledIndex             = NULL;
+    delete _pbSampledCorrection;
+    _pbSampledCorrection        = NULL;
+    delete _pbSampledTargetStart;
+    _pbSampledTargetStart       = NULL;
+    delete _pbSampledTarget;
+    _pbSampledTarget            = NULL;
+    delete _pbSampledUnit;
+    _pbSampledUnit              = NULL;
+    delete _pbSampledDelta;
+    _pbSampledDelta             = NULL;
+    _maxSamples                 = 0;
+    _maxSampledTargets          = 0;
+    _bSampled                   = false;
 }
 
 cudnnTensorDescriptor_t NNLayer::getTensorDescriptor(uint32_t batch)
@@ -239,6 +266,12 @@ tuple<uint32_t, uint32_t, uint32_t, uint32_t> NNLayer::GetLocalDimensions()
     return make_tuple(_maxX - _minX, _Ny, _Nz, _Nw);
 }
 
+// Index of the first unit of this process under model parallel execution
+uint32_t NNLayer::GetLocalOffset()
+{
+    return _minX * _Ny * _Nz * _Nw;
+}
+
 tuple<uint32_t, uint32_t, uint32_t> NNLayer::GetKernelDimensions()
 {
     return make_tuple(_kernelX, _kernelY, _kernelZ);
@@ -616,7 +649,12 @@ void NNLayer::ForwardPropagate(uint32_t position, uint32_t batch, bool bTraining
     switch (_type)
     {
         case FullyConnected:
-            ForwardPropagateFullyConnected(position, batch, bTraining);
+            // Sampled output layers only calculate their sampled units while training
+            _bSampled                       = false;
+            if (bTraining && (_kind == Output) && (_sampledNegatives > 0))
+                ForwardPropagateSampled(position, batch, bTraining);
+            else
+                ForwardPropagateFullyConnected(position, batch, bTraining);
             break;
             
         case Convolutional:
@@ -638,50 +676,15 @@ void NNLayer::ForwardPropagateFullyConnected(uint32_t position, uint32_t batch,
     {
         if (_kind != Input)
         {         
-            // Initialize units to bias values
-            switch (_vIncomingLayer.size())
-            {
-                case 0: // Only skip layers
-                    cudaMemset(_pbUnit->_pDevData, 0, _stride * batch * sizeof(NNFloat));
-                    break;
-                    
-                case 1:
-                    kClearUnit(_pbUnit->_pDevData, _vIncomingWeight[0]->_pbBias->_pDevData, _stride, batch);
-                    break; 
-                    
-                case 2:
-                    kClearDualSourceUnit(_pbUnit->_pDevData, _vIncomingWeight[0]->_pbBias->_pDevData, 
-                                                             _vIncomingWeight[1]->_pbBias->_pDevData, 
-                                        _stride, batch);
-                    break;                   
-                    
-                case 3:
-                    kClearTripleSourceUnit(_pbUnit->_pDevData, _vIncomingWeight[0]->_pbBias->_pDevData, 
-                                                               _vIncomingWeight[1]->_pbBias->_pDevData, 
-                                                               _vIncomingWeight[2]->_pbBias->_pDevData, 
-                                        _stride, batch);
-                    break;      
-
-                case 4:
-                    kClearQuadSourceUnit(_pbUnit->_pDevData, _vIncomingWeight[0]->_pbBias->_pDevData, 
-                                                             _vIncomingWeight[1]->_pbBias->_pDevData, 
-                                                             _vIncomingWeight[2]->_pbBias->_pDevData, 
-                                                             _vIncomingWeight[3]->_pbBias->_pDevData, 
-                                        _stride, batch);
-                    break;                  
-                    
-                default:
-                    if (getGpu()._id == 0)
-                        printf("NNLayer::ForwardPropagate: Too many input layers for network layer %s\n", _name.c_str());          
-                    getGpu().Shutdown();
-                    exit(-1);
-                    break; 
-            }
-        
-        
-            const NNFloat sgemm_beta                = (NNFloat)1.0;
+            // The first incoming layer overwrites the units, and biases are added along with skip layers,
+            // activation and dropout afterwards in a single pass
+            if (_vIncomingLayer.size() == 0)
+                cudaMemset(_pbUnit->_pDevData, 0, _stride * batch * sizeof(NNFloat));
+
             for (uint32_t i = 0; i < _vIncomingLayer.size(); i++)
             {
+                const NNFloat sgemm_beta            = (i == 0) ? (NNFloat)0.0 : (NNFloat)1.0;
+
                 // Special case sparse input layers with sparse matrix * matrix kernel
                 if (_vIncomingLayer[i]->_bFastSparse)
                 {
@@ -736,18 +739,8 @@ void NNLayer::ForwardPropagateFullyConnected(uint32_t position, uint32_t batch,
                 }
             }
 
-            // Copy data from incoming skip layers
-            for (auto l : _vIncomingSkip)
-            {
-                kAddBuffers(_pbUnit->_pDevData, l->_pbUnit->_pDevData, batch * _stride);
-            }
-           
-            // Calculate activation
-            CalculateActivation(batch);
-            
-            // Apply dropout if active
-            if (bTraining && (_pDropout > (NNFloat)0.0))
-                CalculateDropout(batch);             
+            // Add biases and skip layers, calculate activation and apply dropout if active
+            CalculateFusedEpilogue(batch, bTraining);
        
 #if 0
         string fname = "activation_" + _name;
@@ -830,54 +823,8 @@ void NNLayer::ForwardPropagateFullyConnected(uint32_t position, uint32_t batch,
                 _unitUpdateCount++;
             }
             
-            // Copy data from incoming skip layers
-            for (auto l : _vIncomingSkip)
-            {
-                kAddBuffers(_pbUnit->_pDevData, l->_pbUnit->_pDevData, batch * _localStride);
-            }            
-                   
-            // Add biases and calculate activations
-            switch (_vIncomingLayer.size())
-            {
-                case 0: // Only skip layers
-                    break;
-                
-                case 1:
-                    kAddBias(_pbUnit->_pDevData, _vIncomingWeight[0]->_pbBias->_pDevData, _localStride, batch);
-                    break; 
-                        
-                case 2:
-                    kAddDualBias(_pbUnit->_pDevData, _vIncomingWeight[0]->_pbBias->_pDevData, 
-                                                     _vIncomingWeight[1]->_pbBias->_pDevData, _localStride, batch);
-                    break;                   
-                        
-                case 3:
-                    kAddTripleBias(_pbUnit->_pDevData, _vIncomingWeight[0]->_pbBias->_pDevData, 
-                                                       _vIncomingWeight[1]->_pbBias->_pDevData, 
-                                                       _vIncomingWeight[2]->_pbBias->_pDevData, _localStride, batch);
-                    break;      
-
-                case 4:
-                    kAddQuadBias(_pbUnit->_pDevData, _vIncomingWeight[0]->_pbBias->_pDevData, 
-                                                     _vIncomingWeight[1]->_pbBias->_pDevData, 
-                                                     _vIncomingWeight[2]->_pbBias->_pDevData, 
-                                                     _vIncomingWeight[3]->_pbBias->_pDevData, _localStride, batch);
-                    break;                  
-                        
-                default:
-                    if (getGpu()._id == 0)
-                        printf("NNLayer::ForwardPropagate: Too many input layers for network layer %s\n", _name.c_str());
-                    getGpu().Shutdown();
-                    exit(-1);
-                    break; 
-            }    
-                                      
-            // Calculate activation
-            CalculateActivation(batch);   
-            
-            // Apply dropout if active
-            if (bTraining && (_pDropout > (NNFloat)0.0))
-                CalculateDropout(batch);  
+            // Add biases and skip layers, calculate activation and apply dropout if active
+            CalculateFusedEpilogue(batch, bTraining);
         }
         
 
@@ -964,10 +911,10 @@ void NNLayer::ForwardPropagateFullyConnected(uint32_t position, uint32_t batch,
 #if 0
     // REMOVE
     _pbUnit->Download(_vUnit.data());
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(getGpu()._comm);
     if (getGpu()._id == 0)
         cout << _name << " ";
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(getGpu()._comm);
     for (int i = 0; i < getGpu()._numprocs; i++)
     {
         if (i == getGpu()._id)
@@ -977,7 +924,7 @@ void NNLayer::ForwardPropagateFullyConnected(uint32_t position, uint32_t batch,
             printf("\n");
             fflush(stdout);
         }
-        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Barrier(getGpu()._comm);
     }
     cout << endl;
     exit(-1);
@@ -1140,6 +1087,200 @@ void NNLayer::CalculateDropout(uint32_t batch)
     kCalculateDropout(_pbUnit->_pDevData, _pbDropout->_pDevData, batch, _localStride, _pDropout);
 }
 
+// Finishes the units of a fully connected layer once its incoming layers' SGEMMs have written them, adding biases and
+// skip layers, applying an elementwise activation and dropout in one pass.  SoftMax needs whole rows, so it falls
+// back to separate activation and dropout passes
+void NNLayer::CalculateFusedEpilogue(uint32_t batch, bool bTraining)
+{
+    if (_vIncomingLayer.size() > MaxEpilogueSources)
+    {
+        if (getGpu()._id == 0)
+            printf("NNLayer::ForwardPropagate: Too many input layers for network layer %s\n", _name.c_str());
+        getGpu().Shutdown();
+        exit(-1);
+    }
+
+    EpilogueSources sources;
+    sources._biases                 = _vIncomingLayer.size();
+    for (uint32_t i = 0; i < sources._biases; i++)
+        sources._pBias[i]           = _vIncomingWeight[i]->_pbBias->_pDevData;
+
+    // Skip layers beyond those the epilogue takes are added beforehand
+    sources._skips                  = min((uint32_t)_vIncomingSkip.size(), MaxEpilogueSources);
+    for (uint32_t i = 0; i < sources._skips; i++)
+        sources._pSkip[i]           = _vIncomingSkip[i]->_pbUnit->_pDevData;
+    for (uint32_t i = sources._skips; i < _vIncomingSkip.size(); i++)
+        kAddBuffers(_pbUnit->_pDevData, _vIncomingSkip[i]->_pbUnit->_pDevData, batch * _localStride);
+
+    NNFloat p                       = (bTraining && (_pDropout > (NNFloat)0.0)) ? _pDropout : (NNFloat)0.0;
+    if (_activation == SoftMax)
+    {
+        kCalculateFusedEpilogue(Linear, _pbUnit->_pDevData, _localStride, batch, sources, NULL, (NNFloat)0.0);
+        CalculateActivation(batch);
+        if (p > (NNFloat)0.0)
+            CalculateDropout(batch);
+    }
+    else
+        kCalculateFusedEpilogue(_activation, _pbUnit->_pDevData, _localStride, batch, sources, (p > (NNFloat)0.0) ? _pbDropout->_pDevData : NULL, p);
+}
+
+// Picks the outputs a training batch calculates: every positive of the batch's examples, followed by up to
+// _sampledNegatives distinct negatives drawn in proportion to output frequency raised to _sampledPower, and
+// records each example's positives by their position among the sampled outputs
+void NNLayer::SampleOutputs(uint32_t position, uint32_t batch)
+{
+    // Build alias tables on first use so each draw takes constant time.  Frequencies are smoothed by one so outputs
+    // never seen in the training set still get drawn
+    if (_vSampleProbability.size() != _stride)
+    {
+        vector<double> vWeight(_stride);
+        double sum                                  = 0.0;
+        for (uint32_t i = 0; i < _stride; i++)
+        {
+            uint64_t count                          = (i < _pDataSet->_vSparseDatapointCount.size()) ? _pDataSet->_vSparseDatapointCount[i] : 0;
+            vWeight[i]                              = pow((double)count + 1.0, (double)_sampledPower);
+            sum                                    += vWeight[i];
+        }
+        _vSampleProbability.resize(_stride);
+        for (uint32_t i = 0; i < _stride; i++)
+            _vSampleProbability[i]                  = vWeight[i] / sum;
+        BuildAliasTable(vWeight, _vSampleThreshold, _vSampleAlias);
+        _vSampleSlot.assign(_stride, -1);
+    }
+
+    // Look up which examples make up the batch
+    vector<uint32_t> vExample(batch);
+    if (getGpu()._data._bShuffleIndices)
+        cudaMemcpy(vExample.data(), getGpu()._data._pShuffleIndex + position, batch * sizeof(uint32_t), cudaMemcpyDeviceToHost);
+    else
+        for (uint32_t i = 0; i < batch; i++)
+            vExample[i]                             = position + i;
+
+    // Positives first, each output only sampled once however many examples share it
+    _vSampledIndex.clear();
+    _vSampledTarget.clear();
+    _vSampledTargetStart.resize(batch + 1);
+    for (uint32_t i = 0; i < batch; i++)
+    {
+        _vSampledTargetStart[i]                     = _vSampledTarget.size();
+        for (uint64_t j = _pDataSet->_vSparseOffset[vExample[i]]; j < _pDataSet->_vSparseOffset[vExample[i] + 1]; j++)
+        {
+            uint32_t index                          = _pDataSet->_vSparseIndex[j];
+            if (_vSampleSlot[index] < 0)
+            {
+                _vSampleSlot[index]                 = _vSampledIndex.size();
+                _vSampledIndex.push_back(index);
+            }
+            _vSampledTarget.push_back(_vSampleSlot[index]);
+        }
+    }
+    _vSampledTargetStart[batch]                     = _vSampledTarget.size();
+
+    // Then negatives, giving up after a few rounds of drawing outputs that were already sampled
+    uint32_t positives                              = _vSampledIndex.size();
+    uint32_t draws                                  = 0;
+    while ((_vSampledIndex.size() - positives < _sampledNegatives) && (_vSampledIndex.size() < _stride) && (draws < 4 * _sampledNegatives))
+    {
+        uint32_t index                              = DrawAlias(_vSampleThreshold, _vSampleAlias);
+        if (_vSampleSlot[index] < 0)
+        {
+            _vSampleSlot[index]                     = _vSampledIndex.size();
+            _vSampledIndex.push_back(index);
+        }
+        draws++;
+    }
+    _samples                                        = _vSampledIndex.size();
+
+    // SoftMax normalizes over the sampled outputs alone, so each logit is corrected by how often its output
+    // is expected to be sampled
+    _vSampledCorrection.resize(_samples);
+    for (uint32_t i = 0; i < _samples; i++)
+    {
+        _vSampledCorrection[i]                      = -log((NNFloat)_sampledNegatives * _vSampleProbability[_vSampledIndex[i]]);
+        _vSampleSlot[_vSampledIndex[i]]             = -1;
+    }
+
+    // Grow GPU buffers if needed and upload
+    if ((_samples > _maxSamples) || (_pbSampledTargetStart == NULL))
+    {
+        _maxSamples                                 = max(_samples, max(_maxSamples, 1u));
+        delete _pbSampledIndex;
+        delete _pbSampledCorrection;
+        delete _pbSampledTargetStart;
+        delete _pbSampledUnit;
+        delete _pbSampledDelta;
+        _pbSampledIndex                             = new GpuBuffer<uint32_t>(_maxSamples);
+        _pbSampledCorrection                        = new GpuBuffer<NNFloat>(_maxSamples);
+        _pbSampledTargetStart                       = new GpuBuffer<uint32_t>(_batch + 1);
+        _pbSampledUnit                              = new GpuBuffer<NNFloat>((uint64_t)_batch * _maxSamples);
+        _pbSampledDelta                             = new GpuBuffer<NNFloat>((uint64_t)_batch * _maxSamples);
+    }
+    if ((_vSampledTarget.size() > _maxSampledTargets) || (_pbSampledTarget == NULL))
+    {
+        _maxSampledTargets                          = max((uint32_t)_vSampledTarget.size(), max(_maxSampledTargets, 1u));
+        delete _pbSampledTarget;
+        _pbSampledTarget                            = new GpuBuffer<uint32_t>(_maxSampledTargets);
+    }
+    cudaMemcpy(_pbSampledIndex->_pDevData, _vSampledIndex.data(), _samples * sizeof(uint32_t), cudaMemcpyHostToDevice);
+    cudaMemcpy(_pbSampledCorrection->_pDevData, _vSampledCorrection.data(), _samples * sizeof(NNFloat), cudaMemcpyHostToDevice);
+    cudaMemcpy(_pbSampledTargetStart->_pDevData, _vSampledTargetStart.data(), (batch + 1) * sizeof(uint32_t), cudaMemcpyHostToDevice);
+    cudaMemcpy(_pbSampledTarget->_pDevData, _vSampledTarget.data(), _vSampledTarget.size() * sizeof(uint32_t), cudaMemcpyHostToDevice);
+}
+
+// Calculates only the sampled units of an output layer from the weight columns and biases of the sampled outputs
+void NNLayer::ForwardPropagateSampled(uint32_t position, uint32_t batch, bool bTraining)
+{
+    SampleOutputs(position, batch);
+
+    NNLayer* pInputLayer                            = _vIncomingLayer[0];
+    NNWeight* pWeight                               = _vIncomingWeight[0];
+    pWeight->ReserveSampledColumns(_samples);
+    kGatherColumns(pInputLayer->_localStride, _localStride, _samples, _pbSampledIndex->_pDevData, pWeight->_pbWeight->_pDevData, pWeight->_pbSampledWeight->_pDevData);
+    kGatherColumns(1, _localStride, _samples, _pbSampledIndex->_pDevData, pWeight->_pbBias->_pDevData, pWeight->_pbSampledBias->_pDevData);
+
+    const NNFloat sgemm_alpha                       = (NNFloat)1.0;
+    const NNFloat sgemm_beta                        = (NNFloat)0.0;
+    int m                                           = batch;
+    int n                                           = _samples;
+    int k                                           = pInputLayer->_stride;
+    cublasStatus_t cstatus                          = cublasSgemm(getGpu()._cuBLASHandle, 
+                                                      CUBLAS_OP_N,
+                                                      CUBLAS_OP_N,
+                                                      n,
+                                                      m,
+                                                      k,
+                                                      &sgemm_alpha,
+                                                      pWeight->_pbSampledWeight->_pDevData,
+                                                      n,
+                                                      pInputLayer->_pbUnit->_pDevData,
+                                                      k,
+                                                      &sgemm_beta,
+                                                      _pbSampledUnit->_pDevData,
+                                                      n);
+    if (cstatus != CUBLAS_STATUS_SUCCESS)
+    {
+        if (getGpu()._id == 0)
+            printf("NNLayer::ForwardPropagate: SGEMM failure, aborting, status %d.\n", cstatus);
+        getGpu().Shutdown();
+        exit(-1);
+    }
+
+    EpilogueSources sources;
+    sources._biases                                 = 1;
+    sources._pBias[0]                               = pWeight->_pbSampledBias->_pDevData;
+    sources._skips                                  = 0;
+    if (_activation == SoftMax)
+    {
+        sources._biases                             = 2;
+        sources._pBias[1]                           = _pbSampledCorrection->_pDevData;
+        kCalculateFusedEpilogue(Linear, _pbSampledUnit->_pDevData, _samples, batch, sources, NULL, (NNFloat)0.0);
+        kCalculateSoftMaxActivation(_pbSampledUnit->_pDevData, batch, _samples);
+    }
+    else
+        kCalculateFusedEpilogue(_activation, _pbSampledUnit->_pDevData, _samples, batch, sources, NULL, (NNFloat)0.0);
+    _bSampled                                       = true;
+}
+
 NNFloat NNLayer::CalculateError(uint32_t position, uint32_t batch, ErrorFunction ef)
 {
     if (_kind != Output)
@@ -1150,6 +1291,9 @@ NNFloat NNLayer::CalculateError(uint32_t position, uint32_t batch, ErrorFunction
         exit(-1);
     }
 
+    if (_bSampled)
+        return kCalculateSampledCrossEntropyError(_activation, batch, _samples, _pbSampledUnit->_pDevData, _pbSampledTargetStart->_pDevData, _pbSampledTarget->_pDevData);
+
     switch (ef)
     {
         case L1:
@@ -1196,6 +1340,14 @@ void NNLayer::CalculateOutputDelta(uint32_t position, uint32_t batch, ErrorFunct
         exit(-1);
     }
 
+    if (_bSampled)
+    {
+        kCalculateSampledCrossEntropyOutputDelta(_activation, batch, _samples, _pbSampledUnit->_pDevData, _pbSampledDelta->_pDevData, _pbSampledTargetStart->_pDevData, _pbSampledTarget->_pDevData);
+        if (_deltaNorm > (NNFloat)0.0)
+            kNormalizeDeltas(_deltaNorm, batch, _samples, _pbSampledDelta->_pDevData);
+        return;
+    }
+
     switch (ef)
     {
         case L1:
@@ -1460,6 +1612,12 @@ void NNLayer::BackPropagatePooling(uint32_t position, uint32_t batch, NNFloat al
 // And for efficiency purposes, the local contribution to dW(t-1->t), which is x(t-1)^T * Delta(t)
 void NNLayer::BackPropagateFullyConnected(uint32_t position, uint32_t batch, NNFloat alpha)
 {    
+    if (_bSampled)
+    {
+        BackPropagateSampled(position, batch, alpha);
+        return;
+    }
+
     // Special case single GPU
     if (getGpu()._numprocs == 1)
     {
@@ -1735,10 +1893,10 @@ void NNLayer::BackPropagateFullyConnected(uint32_t position, uint32_t batch, NNF
                     pD++;
                     pW++;
                 }
-                MPI_Allreduce(MPI_IN_PLACE, &sum, 1, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
+                MPI_Allreduce(MPI_IN_PLACE, &sum, 1, MPI_FLOAT, MPI_SUM, getGpu()._comm);
                 if (getGpu()._id == 0)
                     printf("ZAG %16.12f\n", sum);
-                MPI_Barrier(MPI_COMM_WORLD);  
+                MPI_Barrier(getGpu()._comm);  
 #endif
                         
                 // Add subsequent layers
@@ -1919,7 +2077,7 @@ void NNLayer::BackPropagateFullyConnected(uint32_t position, uint32_t batch, NNF
                 printf("\n");
            }
         }
-        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Barrier(getGpu()._comm);
     }   
     if (getGpu()._id == 0)
         cout << endl;
@@ -1928,6 +2086,96 @@ void NNLayer::BackPropagateFullyConnected(uint32_t position, uint32_t batch, NNF
 #endif   
 }
 
+// Calculates the gradient of the sampled weight columns, which NNWeight::UpdateSampledWeights applies, and the
+// delta contribution of the sampled outputs to the incoming layer
+void NNLayer::BackPropagateSampled(uint32_t position, uint32_t batch, NNFloat alpha)
+{
+    NNLayer* pInputLayer                = _vIncomingLayer[0];
+    NNWeight* pWeight                   = _vIncomingWeight[0];
+    NNFloat* pDelta                     = _pbSampledDelta->_pDevData;
+    cublasStatus_t cstatus;
+
+    if (!pWeight->_bLocked)
+    {
+        NNFloat sgemm_alpha             = -(NNFloat)1.0 / (NNFloat)batch;
+        NNFloat sgemm_beta              = (NNFloat)0.0;
+        cstatus                         = cublasSgemm(getGpu()._cuBLASHandle, 
+                                          CUBLAS_OP_N,
+                                          CUBLAS_OP_T,
+                                          _samples,
+                                          pInputLayer->_localStride,
+                                          batch,
+                                          &sgemm_alpha,
+                                          pDelta,
+                                          _samples,
+                                          pInputLayer->_pbUnit->_pDevData,
+                                          pInputLayer->_localStride,
+                                          &sgemm_beta,
+                                          pWeight->_pbSampledWeightGradient->_pDevData,
+                                          _samples);
+        if (cstatus != CUBLAS_STATUS_SUCCESS)
+        {
+            if (getGpu()._id == 0)
+                printf("NNLayer::BackPropagate: SGEMM failure, aborting.\n");
+            getGpu().Shutdown();
+            exit(-1);
+        }
+        pWeight->_updateCount++;
+    }
+
+    if (pInputLayer->_kind != Input)
+    {
+        NNFloat sgemm_alpha             = (NNFloat)1.0;
+        NNFloat sgemm_beta              = (pInputLayer->_deltaUpdateCount == 0) ? (NNFloat)0.0 : (NNFloat)1.0;
+        cstatus                         = cublasSgemm(getGpu()._cuBLASHandle, 
+                                          CUBLAS_OP_T,
+                                          CUBLAS_OP_N,
+                                          pInputLayer->_localStride,
+                                          batch,
+                                          _samples,
+                                          &sgemm_alpha,
+                                          pWeight->_pbSampledWeight->_pDevData,
+                                          _samples,
+                                          pDelta,
+                                          _samples,
+                                          &sgemm_beta,
+                                          pInputLayer->_pbDelta->_pDevData,
+                                          pInputLayer->_localStride);
+        if (cstatus != CUBLAS_STATUS_SUCCESS)
+        {
+            if (getGpu()._id == 0)
+                printf("NNLayer::BackPropagate: SGEMM failure, aborting.\n");
+            getGpu().Shutdown();
+            exit(-1);
+        }
+        pInputLayer->_deltaUpdateCount++;
+    }
+}
+
+// Exchanges an empty message with the neighbouring processes of the P2P ring, in place of a global barrier since
+// each ring stage only depends on the neighbours.  Sending to the next process and receiving from the previous one
+// signals that this process's buffer is free to be written, the other way round that its peer's now holds new data
+static void P2P_Handshake(bool bForward)
+{
+    int next                                        = (getGpu()._id + 1) % getGpu()._numprocs;
+    int previous                                    = (getGpu()._id + getGpu()._numprocs - 1) % getGpu()._numprocs;
+    MPI_Request request[2];
+    MPI_Irecv(NULL, 0, MPI_BYTE, bForward ? previous : next, bForward ? 1 : 2, getGpu()._comm, &request[0]);
+    MPI_Isend(NULL, 0, MPI_BYTE, bForward ? next : previous, bForward ? 1 : 2, getGpu()._comm, &request[1]);
+    MPI_Waitall(2, request, MPI_STATUSES_IGNORE);
+}
+
+// Runs one stage of a P2P ring, copying columns [minX, minX + span) of the local send buffer into the previous
+// process's peer buffer once it has finished with it, then waiting until the next process has done the same here
+static void P2P_RingStage(NNFloat* pPeerBuffer, NNFloat* pSendBuffer, uint32_t stride, uint32_t minX, uint32_t span, uint32_t batch)
+{
+    cudaDeviceSynchronize();
+    P2P_Handshake(true);
+    kCopy2D(pPeerBuffer + minX, stride, pSendBuffer + minX, stride, span, batch);
+    cudaDeviceSynchronize();
+    P2P_Handshake(false);
+}
+
 // Reduces contributions from all GPUs to local component of X(L) or Delta(L)
 void NNLayer::Reduce(uint32_t batch, uint32_t stride, NNFloat* pBuffer, uint32_t localStride, uint32_t updateCount)
 {
@@ -1937,8 +2185,8 @@ void NNLayer::Reduce(uint32_t batch, uint32_t stride, NNFloat* pBuffer, uint32_t
     {
         uint32_t stages                             = getGpu()._numprocs - 1;
         uint64_t pos                                = (getGpu()._id + 1) % getGpu()._numprocs; 
-        uint32_t minX                               = (stride * pos) / getGpu()._numprocs;
-        uint32_t maxX                               = (stride * (pos + 1)) / getGpu()._numprocs;
+        uint32_t minX                               = GetSliceStart(stride, pos, getGpu()._numprocs);
+        uint32_t maxX                               = GetSliceStart(stride, pos + 1, getGpu()._numprocs);
         uint32_t span                               = maxX - minX;
         NNFloat* pSendBuffer                        = getGpu()._pNetwork->GetP2PSendBuffer();
 
@@ -1950,32 +2198,30 @@ void NNLayer::Reduce(uint32_t batch, uint32_t stride, NNFloat* pBuffer, uint32_t
             // Send segments around the adding local contributions from each process
             for (uint32_t i = 0; i < stages; i++)
             {
-                kCopy2D(pPeerBuffer + minX, stride, pSendBuffer + minX, stride, span, batch);
-                cudaDeviceSynchronize();       
-                MPI_Barrier(MPI_COMM_WORLD);
-        
+                P2P_RingStage(pPeerBuffer, pSendBuffer, stride, minX, span, batch);
+
                 // Move to next position and add just arrived contribution
                 pos                                 = (pos + 1) % getGpu()._numprocs;
-                minX                                = (stride * pos) / getGpu()._numprocs;
-                maxX                                = (stride * (pos + 1)) / getGpu()._numprocs;
+                minX                                = GetSliceStart(stride, pos, getGpu()._numprocs);
+                maxX                                = GetSliceStart(stride, pos + 1, getGpu()._numprocs);
                 span                                = maxX - minX;
                 kAddBuffers2D(pSendBuffer + minX, stride, pReceiveBuffer + minX, stride, span, batch);
             }
         }
         else
         {
-            // Download to system memory and use MPI to perform reduction
+            // Download to system memory and use an MPI ring to reduce each process's segment
             NNFloat* pCPUBuffer                     = getGpu()._pNetwork->GetP2PCPUBuffer();
             cudaError_t status                      = cudaMemcpy(pCPUBuffer, pSendBuffer, batch * stride * sizeof(NNFloat), cudaMemcpyDefault);
             RTERROR(status, "NNLayer::Reduce1: cudaMemcpy download failed " + getGpu()._id );
-            MPI_Allreduce(MPI_IN_PLACE, pCPUBuffer, batch * stride, MPI_NNFLOAT, MPI_SUM, MPI_COMM_WORLD);
+            RingReduceScatter(pCPUBuffer, batch, stride, getGpu()._pNetwork->GetP2PCPUReceiveBuffer(), MPI_NNFLOAT, getGpu()._comm);
 
-            // Upload back to GPU memory
-            status = cudaMemcpy(pSendBuffer, pCPUBuffer, batch * stride * sizeof(NNFloat), cudaMemcpyDefault);
-            RTERROR(status, "NNLayer::Reduce: cudaMemcpy upload failed" + getGpu()._id );
-            minX                                    = (stride * getGpu()._id) / getGpu()._numprocs;
-            maxX                                    = (stride * (getGpu()._id + 1)) / getGpu()._numprocs;
+            // Upload local segment back to GPU memory
+            minX                                    = GetSliceStart(stride, getGpu()._id, getGpu()._numprocs);
+            maxX                                    = GetSliceStart(stride, getGpu()._id + 1, getGpu()._numprocs);
             span                                    = maxX - minX;            
+            status                                  = cudaMemcpy2D(pSendBuffer + minX, stride * sizeof(NNFloat), pCPUBuffer + minX, stride * sizeof(NNFloat), span * sizeof(NNFloat), batch, cudaMemcpyDefault);
+            RTERROR(status, "NNLayer::Reduce: cudaMemcpy upload failed" + getGpu()._id );
         }
 
         // Copy data out to pBuffer
@@ -1989,7 +2235,7 @@ void NNLayer::Reduce(uint32_t batch, uint32_t stride, NNFloat* pBuffer, uint32_t
         }
 
 #if 0             
-        MPI_Barrier(MPI_COMM_WORLD
+        MPI_Barrier(getGpu()._comm
        
         vector<NNFloat> vOut(16 * 16);
         cudaMemcpy(vOut.data(), pBuffer, batch * localStride * sizeof(NNFloat), cudaMemcpyDefault);
@@ -2010,7 +2256,7 @@ void NNLayer::Reduce(uint32_t batch, uint32_t stride, NNFloat* pBuffer, uint32_t
                 fflush(stdout);
             }
             
-            MPI_Barrier(MPI_COMM_WORLD);
+            MPI_Barrier(getGpu()._comm);
         } 
         exit(-1);  
 #endif
@@ -2026,8 +2272,8 @@ void NNLayer::Gather(uint32_t batch, uint32_t stride, NNFloat* pBuffer, uint32_t
         uint32_t stages                                 = getGpu()._numprocs - 1;
         uint64_t pos                                    = getGpu()._id;
         NNFloat* pSendBuffer                            = getGpu()._pNetwork->GetP2PSendBuffer();
-        uint32_t minX                                   = (stride * pos) / getGpu()._numprocs;
-        uint32_t maxX                                   = (stride * (pos + 1)) / getGpu()._numprocs;
+        uint32_t minX                                   = GetSliceStart(stride, pos, getGpu()._numprocs);
+        uint32_t maxX                                   = GetSliceStart(stride, pos + 1, getGpu()._numprocs);
         uint32_t span                                   = maxX - minX;
 
         if (getGpu()._bP2P)
@@ -2041,12 +2287,10 @@ void NNLayer::Gather(uint32_t batch, uint32_t stride, NNFloat* pBuffer, uint32_t
             // Send segments around the adding local contributions from each process
             for (uint32_t i = 0; i < stages; i++)
             {                    
-                kCopy2D(pPeerBuffer + minX, stride, pSendBuffer + minX, stride, span, batch);
-                cudaDeviceSynchronize();  
-                MPI_Barrier(MPI_COMM_WORLD);
+                P2P_RingStage(pPeerBuffer, pSendBuffer, stride, minX, span, batch);
                 pos                                     = (pos + 1) % getGpu()._numprocs;
-                minX                                    = (stride * pos) / getGpu()._numprocs;
-                maxX                                    = (stride * (pos + 1)) / getGpu()._numprocs;
+                minX                                    = GetSliceStart(stride, pos, getGpu()._numprocs);
+                maxX                                    = GetSliceStart(stride, pos + 1, getGpu()._numprocs);
                 span                                    = maxX - minX;
             }
         }
@@ -2059,18 +2303,8 @@ void NNLayer::Gather(uint32_t batch, uint32_t stride, NNFloat* pBuffer, uint32_t
             RTERROR(status, "NNLayer::Gather: cudaMemcpy download failed");
 
 
-            // use MPI_Bcast to scatter to all other processes
-            for (uint32_t i = 0; i < getGpu()._numprocs; i++)
-            {
-                uint32_t minX                          = (stride * i) / getGpu()._numprocs;
-                uint32_t maxX                          = (stride * (i + 1)) / getGpu()._numprocs;
-                uint32_t span                          = maxX - minX;
-                MPI_Datatype spanType;
-                MPI_Type_vector(batch, span, stride, MPI_NNFLOAT, &spanType);
-                MPI_Type_commit(&spanType);
-                MPI_Bcast(pCPUBuffer + minX, 1, spanType, i, MPI_COMM_WORLD);
-                MPI_Type_free(&spanType);
-            }
+            // Use an MPI ring to pass segments to all other processes
+            RingAllGather(pCPUBuffer, batch, stride, MPI_NNFLOAT, getGpu()._comm);
  
             // Upload gathered buffer back to GPU memory
             status                                     = cudaMemcpy(pSendBuffer, pCPUBuffer, batch * stride * sizeof(NNFloat), cudaMemcpyDefault);
@@ -2091,7 +2325,7 @@ void NNLayer::Gather(uint32_t batch, uint32_t stride, NNFloat* pBuffer, uint32_t
                 printf("\n");
             }
         }
-        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Barrier(getGpu()._comm);
         exit(-1);
 #endif
     }
@@ -2116,9 +2350,9 @@ void NNLayer::Dump(string fname, NNFloat* pBuffer)
             {                        
                 uint64_t size;
                 MPI_Status status;                
-                MPI_Recv(&size, 1, MPI_UINT64_T, i, 0, MPI_COMM_WORLD, &status);
+                MPI_Recv(&size, 1, MPI_UINT64_T, i, 0, getGpu()._comm, &status);
                 vector<NNFloat> vTemp(size);
-                MPI_Recv(vTemp.data(), size, MPI_FLOAT, i, 0, MPI_COMM_WORLD, &status);
+                MPI_Recv(vTemp.data(), size, MPI_FLOAT, i, 0, getGpu()._comm, &status);
                 uint64_t lstride    = size / _batch;
                 NNFloat* pSrc = vTemp.data();
                 NNFloat* pDst = pData;
@@ -2136,8 +2370,8 @@ void NNLayer::Dump(string fname, NNFloat* pBuffer)
             uint64_t size               = _batch * _localStride;
             vector<NNFloat> vLocalData(size);
             cudaMemcpy(vLocalData.data(), pBuffer, size * sizeof(NNFloat), cudaMemcpyDefault);
-            MPI_Send(&size, 1, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD);
-            MPI_Send(vLocalData.data(), size, MPI_FLOAT, 0, 0, MPI_COMM_WORLD);                  
+            MPI_Send(&size, 1, MPI_UINT64_T, 0, 0, getGpu()._comm);
+            MPI_Send(vLocalData.data(), size, MPI_FLOAT, 0, 0, getGpu()._comm);                  
         }
     }
 
@@ -2621,48 +2855,165 @@ ostream& operator<< (ostream& out, NNLayerDescriptor& d)
 uint32_t MPI_Bcast_NNLayerDescriptor(NNLayerDescriptor& d)
 {
     MPI_Bcast_string(d._name);
-    MPI_Bcast(&d._kind, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._type, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._poolingFunction, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD); 
-    MPI_Bcast(&d._Nx, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._Ny, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._Nz, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._Nw, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._dimensions, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._bDimensionsProvided, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._kernelX, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._kernelY, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._kernelZ, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._kernelStrideX, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._kernelStrideY, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._kernelStrideZ, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._kernelPaddingX, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._kernelPaddingY, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._kernelPaddingZ, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._pDropout, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._weightInit, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._weightInitScale, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._biasInit, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._weightNorm, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._deltaNorm, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._activation, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._sparsenessPenalty_p, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._sparsenessPenalty_beta, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);    
-    MPI_Bcast(&d._attributes, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&d._kind, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._type, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._poolingFunction, 1, MPI_UINT32_T, 0, getGpu()._comm); 
+    MPI_Bcast(&d._Nx, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._Ny, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._Nz, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._Nw, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._dimensions, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._bDimensionsProvided, 1, MPI_C_BOOL, 0, getGpu()._comm);
+    MPI_Bcast(&d._kernelX, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._kernelY, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._kernelZ, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._kernelStrideX, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._kernelStrideY, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._kernelStrideZ, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._kernelPaddingX, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._kernelPaddingY, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._kernelPaddingZ, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._pDropout, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._weightInit, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._weightInitScale, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._biasInit, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._weightNorm, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._deltaNorm, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._activation, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._sparsenessPenalty_p, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._sparsenessPenalty_beta, 1, MPI_FLOAT, 0, getGpu()._comm);    
+    MPI_Bcast(&d._attributes, 1, MPI_UINT32_T, 0, getGpu()._comm);
     MPI_Bcast_string(d._dataSet);
     size_t size                         = d._vSource.size();
-    MPI_Bcast(&size, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&size, 1, MPI_UINT32_T, 0, getGpu()._comm);
     d._vSource.resize(size);
     for (size_t i = 0; i < size; i++)
         MPI_Bcast_string(d._vSource[i]);
     size                                = d._vSkip.size();
-    MPI_Bcast(&size, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&size, 1, MPI_UINT32_T, 0, getGpu()._comm);
     d._vSkip.resize(size);
     for (size_t i = 0; i < size; i++)
         MPI_Bcast_string(d._vSkip[i]);        
     return 0;
 }
 
+void SaveNNLayerDescriptorBinary(NNBinaryWriter& w, const NNLayerDescriptor& d)
+{
+    w.Write(d._name);
+    w.Write(d._kind);
+    w.Write(d._type);
+    w.Write(d._poolingFunction);
+    w.Write(d._Nx);
+    w.Write(d._Ny);
+    w.Write(d._Nz);
+    w.Write(d._Nw);
+    w.Write(d._dimensions);
+    w.Write(d._bDimensionsProvided);
+    w.Write(d._kernelX);
+    w.Write(d._kernelY);
+    w.Write(d._kernelZ);
+    w.Write(d._kernelStrideX);
+    w.Write(d._kernelStrideY);
+    w.Write(d._kernelStrideZ);
+    w.Write(d._kernelPaddingX);
+    w.Write(d._kernelPaddingY);
+    w.Write(d._kernelPaddingZ);
+    w.Write(d._kernelDimensions);
+    w.Write(d._pDropout);
+    w.Write(d._weightInit);
+    w.Write(d._weightInitScale);
+    w.Write(d._biasInit);
+    w.Write(d._weightNorm);
+    w.Write(d._deltaNorm);
+    w.Write(d._activation);
+    w.Write(d._sparsenessPenalty_p);
+    w.Write(d._sparsenessPenalty_beta);
+    w.Write(d._attributes);
+    w.Write(d._dataSet);
+    w.Write(d._vSource);
+    w.Write(d._vSkip);
+}
+
+bool LoadNNLayerDescriptorBinary(NNBinaryReader& r, NNLayerDescriptor& d)
+{
+    r.Read(d._name);
+    r.Read(d._kind);
+    r.Read(d._type);
+    r.Read(d._poolingFunction);
+    r.Read(d._Nx);
+    r.Read(d._Ny);
+    r.Read(d._Nz);
+    r.Read(d._Nw);
+    r.Read(d._dimensions);
+    r.Read(d._bDimensionsProvided);
+    r.Read(d._kernelX);
+    r.Read(d._kernelY);
+    r.Read(d._kernelZ);
+    r.Read(d._kernelStrideX);
+    r.Read(d._kernelStrideY);
+    r.Read(d._kernelStrideZ);
+    r.Read(d._kernelPaddingX);
+    r.Read(d._kernelPaddingY);
+    r.Read(d._kernelPaddingZ);
+    r.Read(d._kernelDimensions);
+    r.Read(d._pDropout);
+    r.Read(d._weightInit);
+    r.Read(d._weightInitScale);
+    r.Read(d._biasInit);
+    r.Read(d._weightNorm);
+    r.Read(d._deltaNorm);
+    r.Read(d._activation);
+    r.Read(d._sparsenessPenalty_p);
+    r.Read(d._sparsenessPenalty_beta);
+    r.Read(d._attributes);
+    r.Read(d._dataSet);
+    r.Read(d._vSource);
+    r.Read(d._vSkip);
+    return r.IsValid();
+}
+
+// Describes the layer as currently configured, including any growth since it was loaded
+void NNLayer::GetDescriptor(NNLayerDescriptor& d)
+{
+    d._name                             = _name;
+    d._kind                             = _kind;
+    d._type                             = _type;
+    d._poolingFunction                  = _poolingFunction;
+    d._dataSet                          = _dataSet;
+    d._vSource                          = _vSource;
+    d._vSkip                            = _vSkip;
+    d._Nx                               = _Nx;
+    d._Ny                               = _Ny;
+    d._Nz                               = _Nz;
+    d._Nw                               = _Nw;
+    d._dimensions                       = _dimensions;
+    d._bDimensionsProvided              = true;
+    d._weightInit                       = _weightInit;
+    d._weightInitScale                  = _weightInitScale;
+    d._biasInit                         = _biasInit;
+    d._kernelX                          = _kernelX;
+    d._kernelY                          = _kernelY;
+    d._kernelZ                          = _kernelZ;
+    d._kernelStrideX                    = _kernelStrideX;
+    d._kernelStrideY                    = _kernelStrideY;
+    d._kernelStrideZ                    = _kernelStrideZ;
+    d._kernelPaddingX                   = _kernelPaddingX;
+    d._kernelPaddingY                   = _kernelPaddingY;
+    d._kernelPaddingZ                   = _kernelPaddingZ;
+    d._kernelDimensions                 = _kernelDimensions;
+    d._weightNorm                       = _weightNorm;
+    d._deltaNorm                        = _deltaNorm;
+    d._pDropout                         = _pDropout;
+    d._activation                       = _activation;
+    d._sparsenessPenalty_p              = _sparsenessPenalty_p;
+    d._sparsenessPenalty_beta           = _sparsenessPenalty_beta;
+    d._attributes                       = 0;
+    if (_bSparse)
+        d._attributes                  |= NNLayer::Attributes::Sparse;
+    if (_bDenoising)
+        d._attributes                  |= NNLayer::Attributes::Denoising;
+}
+
 bool NNLayer::WriteNetCDF(NcFile& nc, uint32_t index)
 {
     bool bResult                        = true;
@@ -127,6 +127,26 @@ private:
     GpuBuffer<NNFloat>*         _pbUnit;                    // GPU memory for unit activations
     GpuBuffer<NNFloat>*         _pbDelta;                   // GPU memory for unit deltas  
     GpuBuffer<NNFloat>*         _pbDropout;                 // Dropout random values if active
+    uint32_t                    _sampledNegatives;          // Negatives sampled per training batch for a sparse output layer, 0 to train on all outputs
+    NNFloat                     _sampledPower;              // Exponent applied to output frequencies when sampling negatives
+    bool                        _bSampled;                  // Did the last forward pass only calculate sampled outputs?
+    uint32_t                    _samples;                   // Outputs sampled for the current batch
+    uint32_t                    _maxSamples;                // Outputs the sampled buffers have room for
+    uint32_t                    _maxSampledTargets;         // Targets the sampled target buffer has room for
+    vector<NNFloat>             _vSampleProbability;        // Probability of drawing each output as a negative
+    vector<double>              _vSampleThreshold;          // Alias method tables for drawing negatives in constant time
+    vector<uint32_t>            _vSampleAlias;
+    vector<int32_t>             _vSampleSlot;               // Position of each output among the sampled ones, -1 if not sampled
+    vector<uint32_t>            _vSampledIndex;             // Outputs sampled for the current batch, positives first
+    vector<NNFloat>             _vSampledCorrection;        // Sampling probability correction of each sampled output's logit
+    vector<uint32_t>            _vSampledTargetStart;       // Start of each example's positives within _vSampledTarget
+    vector<uint32_t>            _vSampledTarget;            // Positions of each example's positives among the sampled outputs
+    GpuBuffer<uint32_t>*        _pbSampledIndex;            // GPU copies of the above
+    GpuBuffer<NNFloat>*         _pbSampledCorrection;
+    GpuBuffer<uint32_t>*        _pbSampledTargetStart;
+    GpuBuffer<uint32_t>*        _pbSampledTarget;
+    GpuBuffer<NNFloat>*         _pbSampledUnit;             // Units of the sampled outputs
+    GpuBuffer<NNFloat>*         _pbSampledDelta;            // Deltas of the sampled outputs
     int32_t                     _priority;                  // Mutable priority for calculating propagation ordering
     NNLayer(NNLayerDescriptor& l, uint32_t batch);
     ~NNLayer();
@@ -142,13 +162,17 @@ private:
     void ForwardPropagateFullyConnected(uint32_t position, uint32_t batch, bool bTraining);    
     void ForwardPropagateConvolutional(uint32_t position, uint32_t batch, bool bTraining);
     void ForwardPropagatePooling(uint32_t position, uint32_t batch, bool bTraining);
+    void SampleOutputs(uint32_t position, uint32_t batch);
+    void ForwardPropagateSampled(uint32_t position, uint32_t batch, bool bTraining);
     void CalculateActivation(uint32_t batch);
     void CalculateDropout(uint32_t batch);
+    void CalculateFusedEpilogue(uint32_t batch, bool bTraining);
     NNFloat CalculateError(uint32_t position, uint32_t batch, ErrorFunction ef);
     void BackPropagate(uint32_t position, uint32_t batch, NNFloat alpha);
     void BackPropagateFullyConnected(uint32_t position, uint32_t batch, NNFloat alpha);    
     void BackPropagateConvolutional(uint32_t position, uint32_t batch, NNFloat alpha);
     void BackPropagatePooling(uint32_t position, uint32_t batch, NNFloat alpha);        
+    void BackPropagateSampled(uint32_t position, uint32_t batch, NNFloat alpha);
     void CalculateOutputDelta(uint32_t position, uint32_t batch, ErrorFunction ef);
     void GenerateDenoisingData();
     void Reduce(uint32_t batch, uint32_t stride, NNFloat* pBuffer, uint32_t localStride, uint32_t updateCount);
@@ -156,6 +180,7 @@ private:
     void ClearUpdates();
     void Dump(string fname, NNFloat* pData);
     bool WriteNetCDF(netCDF::NcFile& nc, uint32_t index);
+    void GetDescriptor(NNLayerDescriptor& d);
     NNFloat* GetUnitBuffer() { return _pbUnit ? _pbUnit->_pDevData : NULL; }
     NNFloat* GetDeltaBuffer() { return _pbDelta ? _pbDelta->_pDevData : NULL; }
     uint64_t GetBufferSize() { return _batch * _stride; }
@@ -164,6 +189,7 @@ private:
 public:
     tuple<uint32_t, uint32_t, uint32_t, uint32_t> GetDimensions();
     tuple<uint32_t, uint32_t, uint32_t, uint32_t> GetLocalDimensions();
+    uint32_t GetLocalOffset();
     tuple<uint32_t, uint32_t, uint32_t> GetKernelDimensions();
     tuple<uint32_t, uint32_t, uint32_t> GetKernelStride();
     //NNFloat GetPDropout();
@@ -220,6 +246,8 @@ struct NNLayerDescriptor
 bool LoadNNLayerDescriptorNetCDF(const string& fname, netCDF::NcFile& nc, uint32_t index, NNLayerDescriptor& ld);
 ostream& operator<< (ostream& out, NNLayerDescriptor& d);
 uint32_t MPI_Bcast_NNLayerDescriptor(NNLayerDescriptor& d);
+void SaveNNLayerDescriptorBinary(NNBinaryWriter& w, const NNLayerDescriptor& d);
+bool LoadNNLayerDescriptorBinary(NNBinaryReader& r, NNLayerDescriptor& d);
 #endif
 #define NNLAYER_H
 #endif
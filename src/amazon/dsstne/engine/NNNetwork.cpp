@@ -19,6 +19,12 @@
 #include <queue>
 #include <set>
 #include <cfloat>
+#include <sstream>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace netCDF;
 using namespace netCDF::exceptions;
@@ -47,6 +53,15 @@ _name(""),
 _checkpoint_name("checkpoint"),
 _checkpoint_interval(0),
 _checkpoint_epochs(0),
+_trainingMode(SGD),
+_epochs(0),
+_movingAverageError((NNFloat)0.0),
+_brakeSteps(0),
+_initSteps(100),
+_bestValidationError((NNFloat)FLT_MAX),
+_validationStalls(0),
+_validationEpochs(0),
+_randomSeed(0),
 _bConvLayersCalculated(false)
 {
 
@@ -76,6 +91,8 @@ ostream& operator<< (ostream& out, NNNetworkDescriptor& d)
     out << "SMCE_zeroScale:          " << d._SMCE_zeroScale << endl;
     out << "checkpoint_name:         " << d._checkpoint_name << endl;
     out << "checkpoint_interval:     " << d._checkpoint_interval << endl;
+    out << "trainingMode:            " << d._trainingMode << endl;
+    out << "epochs:                  " << d._epochs << endl;
             
     // Dump layers
     out << endl << "Layers:" << endl;
@@ -188,6 +205,11 @@ NNFloat* NNNetwork::GetP2PCPUBuffer()
     return _pCPUBuffer;
 }
 
+NNFloat* NNNetwork::GetP2PCPUReceiveBuffer()
+{
+    return _pCPUReceiveBuffer;
+}
+
 NNFloat* NNNetwork::GetPeerBuffer()
 {
     return _pPeerBuffer[_receiveIndex];
@@ -355,11 +377,271 @@ bool NNNetwork::SetCheckpoint(string name, int32_t interval)
     return true;
 }
 
+bool NNNetwork::SetLearningRateSchedule(LearningRateSchedule schedule, uint32_t interval, NNFloat multiplier, uint32_t warmup, NNFloat minAlpha)
+{
+    // Validate parameters
+    if (interval == 0)
+    {
+        if (getGpu()._id == 0)
+            printf("NNNetwork::SetLearningRateSchedule: Interval must be at least 1 epoch.\n");
+        return false;
+    }
+    else if ((multiplier <= (NNFloat)0.0) || (multiplier > (NNFloat)1.0))
+    {
+        if (getGpu()._id == 0)
+            printf("NNNetwork::SetLearningRateSchedule: Illegal value for multiplier (%f).\n", multiplier);
+        return false;
+    }
+    else if (minAlpha < (NNFloat)0.0)
+    {
+        if (getGpu()._id == 0)
+            printf("NNNetwork::SetLearningRateSchedule: Illegal value for minAlpha (%f).\n", minAlpha);
+        return false;
+    }
+
+    _alphaSchedule          = schedule;
+    _alphaInterval          = interval;
+    _alphaMultiplier        = multiplier;
+    _alphaWarmup            = warmup;
+    _alphaMin               = minAlpha;
+
+    // Report new settings
+    if (getGpu()._id == 0)
+        cout << "NNNetwork::SetLearningRateSchedule: schedule set to " << _alphaSchedule << ", interval set to " << interval << " epochs, multiplier set to " << multiplier
+             << ", warmup set to " << warmup << " epochs, minimum alpha set to " << minAlpha << "." << endl;
+    return true;
+}
+
+bool NNNetwork::SetValidationDataSets(vector<NNDataSetBase*>& vData, uint32_t interval, uint32_t k)
+{
+    // Validate parameters
+    if (interval == 0)
+    {
+        if (getGpu()._id == 0)
+            printf("NNNetwork::SetValidationDataSets: Interval must be at least 1 epoch.\n");
+        return false;
+    }
+    else if (k > 128)
+    {
+        if (getGpu()._id == 0)
+            printf("NNNetwork::SetValidationDataSets: Can only calculate metrics for K of 128 or less.\n");
+        return false;
+    }
+
+    // Held-out data must cover every input and output layer with a consistent examples count
+    uint32_t examples                       = 0;
+    vector<NNLayer*> vLayer(_vInputLayer);
+    vLayer.insert(vLayer.end(), _vOutputLayer.begin(), _vOutputLayer.end());
+    for (auto l: vLayer)
+    {
+        NNDataSetBase* pData                = NULL;
+        for (auto d: vData)
+        {
+            if (l->_dataSet.compare(d->_name) == 0)
+            {
+                pData                       = d;
+                break;
+            }
+        }
+
+        if (pData == NULL)
+        {
+            if (getGpu()._id == 0)
+                printf("NNNetwork::SetValidationDataSets: Missing validation data set %s for layer %s.\n", l->_dataSet.c_str(), l->_name.c_str());
+            return false;
+        }
+        
+        if (examples == 0)
+            examples                        = pData->_examples;
+        if ((pData->_examples != examples) || (examples == 0))
+        {
+            if (getGpu()._id == 0)
+                printf("NNNetwork::SetValidationDataSets: Mismatched examples count (%u vs %u) in validation data set %s.\n", examples, pData->_examples, pData->_name.c_str());
+            return false;
+        }
+    }
+
+    // Ranking metrics are calculated against the first output layer's sparse targets
+    if (k > 0)
+    {
+        NNLayer* pLayer                     = _vOutputLayer[0];
+        NNDataSetBase* pData                = NULL;
+        for (auto d: vData)
+        {
+            if (pLayer->_dataSet.compare(d->_name) == 0)
+                pData                       = d;
+        }
+
+        if (!(pData->_attributes & NNDataSetEnums::Sparse))
+        {
+            if (getGpu()._id == 0)
+                printf("NNNetwork::SetValidationDataSets: Ranking metrics require sparse data set for output layer %s.\n", pLayer->_name.c_str());
+            return false;
+        }
+        else if (k > pLayer->_Nx * pLayer->_Ny * pLayer->_Nz)
+        {
+            if (getGpu()._id == 0)
+                printf("NNNetwork::SetValidationDataSets: Output layer %s has fewer elements than K (%u).\n", pLayer->_name.c_str(), k);
+            return false;
+        }
+        else if ((getGpu()._numprocs > 1) && (pLayer->_type != NNLayer::Type::FullyConnected))
+        {
+            if (getGpu()._id == 0)
+                printf("NNNetwork::SetValidationDataSets: Ranking metrics require a model-parallel output layer, %s is data-parallel.\n", pLayer->_name.c_str());
+            return false;
+        }
+    }
+
+    _vValidationData                        = vData;
+    _validationInterval                     = interval;
+    _validationK                            = k;
+
+    // A network restored from a checkpoint carries on with the validation progress it was saved with
+    if (_epochs == 0)
+    {
+        _validationEpochs                   = 0;
+        _bestValidationError                = (NNFloat)FLT_MAX;
+        _validationStalls                   = 0;
+    }
+
+    // Report new settings
+    if (getGpu()._id == 0)
+        printf("NNNetwork::SetValidationDataSets: %u validation examples, interval set to %u epochs, K set to %u.\n", examples, interval, k);
+    return true;
+}
+
+bool NNNetwork::SetGradientCompression(GradientCompression compression, NNFloat ratio)
+{
+    // Validate parameters
+    if ((compression == SparseTopK) && ((ratio <= (NNFloat)0.0) || (ratio > (NNFloat)1.0)))
+    {
+        if (getGpu()._id == 0)
+            printf("NNNetwork::SetGradientCompression: Illegal value for ratio (%f).\n", ratio);
+        return false;
+    }
+
+    _gradientCompression                    = compression;
+    _gradientCompressionRatio               = ratio;
+    if (_pGradientReducer != NULL)
+        _pGradientReducer->SetCompression(_gradientCompression, _gradientCompressionRatio);
+
+    // Report new settings
+    if (getGpu()._id == 0)
+    {
+        if (compression == SparseTopK)
+            printf("NNNetwork::SetGradientCompression: Replicated gradients now send their largest %f of values.\n", ratio);
+        else
+            printf("NNNetwork::SetGradientCompression: Replicated gradients now reduced in %s precision.\n", (compression == HalfPrecision) ? "half" : "full");
+    }
+    return true;
+}
+
+tuple<GradientCompression, NNFloat> NNNetwork::GetGradientCompression()
+{
+    return make_tuple(_gradientCompression, _gradientCompressionRatio);
+}
+
+// Trains sparse output layers on the positives of each batch plus up to negatives other outputs, drawn with probability
+// proportional to their frequency in the training data raised to power, instead of on every output, so the cost of
+// a training batch no longer grows with the number of outputs.  Prediction and validation still calculate every
+// output.  Setting negatives to 0 goes back to training on every output
+bool NNNetwork::SetSampledOutput(uint32_t negatives, NNFloat power)
+{
+    // Validate parameters
+    if (negatives > 0)
+    {
+        if (getGpu()._numprocs > 1)
+        {
+            if (getGpu()._id == 0)
+                printf("NNNetwork::SetSampledOutput: Sampled outputs are only supported on a single process.\n");
+            return false;
+        }
+
+        if (_errorFunction != CrossEntropy)
+        {
+            if (getGpu()._id == 0)
+                printf("NNNetwork::SetSampledOutput: Sampled outputs require the CrossEntropy error function.\n");
+            return false;
+        }
+
+        if (power < (NNFloat)0.0)
+        {
+            if (getGpu()._id == 0)
+                printf("NNNetwork::SetSampledOutput: Illegal value for power (%f).\n", power);
+            return false;
+        }
+
+        for (auto l : _vOutputLayer)
+        {
+            NNWeight* pWeight               = (l->_vIncomingWeight.size() == 1) ? l->_vIncomingWeight[0] : NULL;
+            if ((l->_type != NNLayer::Type::FullyConnected) || ((l->_activation != Sigmoid) && (l->_activation != SoftMax)) ||
+                (pWeight == NULL) || (l->_vIncomingLayer[0]->_kind != NNLayer::Kind::Hidden) || pWeight->_bShared ||
+                pWeight->_bTransposed || (pWeight->_sharingCount > 1) || (l->_vIncomingSkip.size() > 0) || (l->_pDropout > (NNFloat)0.0))
+            {
+                if (getGpu()._id == 0)
+                    printf("NNNetwork::SetSampledOutput: Output layer %s must be a fully connected Sigmoid or SoftMax layer fed by a single hidden layer through unshared weights, without skip layers or dropout.\n", l->_name.c_str());
+                return false;
+            }
+
+            NNDataSetBase* pDataSet         = l->_pDataSet;
+            if ((pDataSet == NULL) || !(pDataSet->_attributes & NNDataSetEnums::Sparse) || (pDataSet->_attributes & NNDataSetEnums::SparseIgnoreZero) || pDataSet->_bStreaming)
+            {
+                if (getGpu()._id == 0)
+                    printf("NNNetwork::SetSampledOutput: Output layer %s needs a loaded sparse data set that is not streamed and does not ignore zeros.\n", l->_name.c_str());
+                return false;
+            }
+        }
+    }
+
+    for (auto l : _vOutputLayer)
+    {
+        l->_sampledNegatives                = negatives;
+        l->_sampledPower                    = power;
+        l->_vSampleProbability.clear();
+    }
+
+    // Report new settings
+    if (getGpu()._id == 0)
+    {
+        if (negatives > 0)
+            printf("NNNetwork::SetSampledOutput: Output layers now trained on their positives and %u negatives sampled with power %f.\n", negatives, power);
+        else
+            printf("NNNetwork::SetSampledOutput: Output layers now trained on every output.\n");
+    }
+    return true;
+}
+
+tuple<uint32_t, NNFloat> NNNetwork::GetSampledOutput()
+{
+    for (auto l : _vOutputLayer)
+    {
+        if (l->_sampledNegatives > 0)
+            return make_tuple(l->_sampledNegatives, l->_sampledPower);
+    }
+    return make_tuple((uint32_t)0, (NNFloat)0.75);
+}
+
+bool NNNetwork::SetEarlyStopping(uint32_t patience, NNFloat minDelta)
+{
+    _earlyStoppingPatience                  = patience;
+    _earlyStoppingMinDelta                  = minDelta;
+    if (_epochs == 0)
+    {
+        _bestValidationError                = (NNFloat)FLT_MAX;
+        _validationStalls                   = 0;
+    }
+
+    // Report new settings
+    if (getGpu()._id == 0)
+        printf("NNNetwork::SetEarlyStopping: patience set to %u validation passes, minimum improvement set to %f.\n", patience, minDelta);
+    return true;
+}
+
 NNNetwork::NNNetwork(NNNetworkDescriptor& d, uint32_t batch) :
 _name(d._name),
 _kind(d._kind),
 _mode(Prediction),
-_trainingMode(SGD),
+_trainingMode(d._trainingMode),
 _batch(batch),
 _localBatch(batch),
 _position(0),
@@ -391,8 +673,27 @@ _SMCE_oneScale(d._SMCE_oneScale),
 _SMCE_zeroScale(d._SMCE_zeroScale),
 _checkpoint_name(d._checkpoint_name),
 _checkpoint_interval(d._checkpoint_interval),
-_checkpoint_epochs(0),
-_epochs(0),
+_checkpoint_epochs(d._checkpoint_epochs),
+_pCheckpointDescriptor(NULL),
+_alphaSchedule(FixedRate),
+_alphaInterval(1),
+_alphaMultiplier((NNFloat)1.0),
+_alphaWarmup(0),
+_alphaMin((NNFloat)0.0),
+_movingAverageError(d._movingAverageError),
+_brakeSteps(d._brakeSteps),
+_initSteps(d._initSteps),
+_validationInterval(1),
+_validationEpochs(d._validationEpochs),
+_validationK(0),
+_pbValidationKey(NULL),
+_pbValidationValue(NULL),
+_earlyStoppingPatience(0),
+_earlyStoppingMinDelta((NNFloat)0.0),
+_bestValidationError(d._bestValidationError),
+_validationStalls(d._validationStalls),
+_bCheckpointResult(true),
+_epochs(d._epochs),
 _bClearVelocity(true),
 _bDirty(true),
 _maxStride(0),
@@ -401,6 +702,10 @@ _pbScratchBuffer(NULL),
 _pPeerBuffer{NULL, NULL},
 _pbP2PBuffer{NULL, NULL},
 _pCPUBuffer(NULL),
+_pCPUReceiveBuffer(NULL),
+_pGradientReducer(NULL),
+_gradientCompression(Uncompressed),
+_gradientCompressionRatio((NNFloat)0.01),
 _sendIndex(0),
 _receiveIndex(1),
 _CUDNNWorkspaceSize(0),
@@ -470,68 +775,60 @@ _pbCUDNNWorkspace(NULL)
     }
 
     // Allocate weights between layers
-    for (auto wd: d._vWeightDescriptor)
+    for (auto& wd: d._vWeightDescriptor)
     {
         NNLayer* pInputLayer                    = _mLayer[wd._inputLayer];
         NNLayer* pOutputLayer                   = _mLayer[wd._outputLayer];
         NNWeight* pWeight                       = new NNWeight(*pInputLayer, *pOutputLayer, wd._bShared, wd._bTransposed, wd._bLocked, wd._norm);
         _vWeight.push_back(pWeight);
 
-        // Initialize weight values if they aren't provided.  In the case of
-        // shared weights, only the biases are set
-        if ((wd._vWeight.size() == 0) || (wd._vBias.size() == 0))
+        // Check if supplied values were trained before input or output layer grew (see GrowLayersToDataSets)
+        bool bGrown                             = (wd._inputStride != 0) && 
+                                                  ((wd._inputStride != pInputLayer->_stride) || (wd._outputStride != pOutputLayer->_stride));
+
+        // Initialize weight values if they aren't provided or only partially provided.  
+        // In the case of shared weights, only the biases are set
+        if ((wd._vWeight.size() == 0) || (wd._vBias.size() == 0) || bGrown)
         {
             pWeight->Randomize();
         }
 
-        // Copy weights if unshared and values are supplied (sharded across input layer if model parallel multi-GPU)
-        if (!wd._bShared && (wd._vWeight.size() != 0))
+        if (bGrown)
         {
-            if (getGpu()._numprocs > 1)
-            {
-                NNFloat* pDst                   = pWeight->_vWeight.data();            
-                uint32_t outgoingSize           = pOutputLayer->_stride * 3;
-                uint32_t incomingSize           = pInputLayer->_stride * 2;
-
-                if (outgoingSize > incomingSize)
-                {
-                    NNFloat* pSrc               = wd._vWeight.data() + pOutputLayer->_minX;
-                    for (size_t i = 0; i < pInputLayer->_stride; i++)
-                    {
-                        memcpy(pDst, pSrc, pOutputLayer->_localStride * sizeof(NNFloat));
-                        pSrc                   += pOutputLayer->_stride;
-                        pDst                   += pOutputLayer->_localStride;
-                    }
-                }
-                else
-                {
-                    NNFloat* pSrc               = wd._vWeight.data() + pInputLayer->_minX * pOutputLayer->_stride;
-                    memcpy(pDst, pSrc, pInputLayer->_localStride * pOutputLayer->_stride * sizeof(NNFloat));
-                }
-            
-            }
-            else
-            {
-                pWeight->_vWeight               = wd._vWeight;
-            }
-            pWeight->_pbWeight->Upload(pWeight->_vWeight.data());
+            pWeight->CopyGrownWeights(wd);
         }
-    
-        // Copy biases if present (sharded across output layer if multi-GPU)
-        if (wd._vBias.size() != 0)
+        else
         {
-            if (getGpu()._numprocs > 1)
+            // Copy weights if unshared and values are supplied (sharded across input layer if model parallel multi-GPU)
+            if (!wd._bShared && (wd._vWeight.size() != 0))
             {
-                NNFloat* pSrc                   = wd._vBias.data() + pOutputLayer->_minX;
-                NNFloat* pDst                   = pWeight->_vBias.data();
-                memcpy(pDst, pSrc, pOutputLayer->_localStride * sizeof(NNFloat));               
+                pWeight->ShardWeights(wd._vWeight, pWeight->_vWeight);
+                pWeight->_pbWeight->Upload(pWeight->_vWeight.data());
             }
-            else
+        
+            // Copy biases if present (sharded across output layer if multi-GPU)
+            if (wd._vBias.size() != 0)
             {
-                pWeight->_vBias                     = wd._vBias;
+                pWeight->ShardBiases(wd._vBias, pWeight->_vBias);
+                pWeight->_pbBias->Upload(pWeight->_vBias.data());
             }
-            pWeight->_pbBias->Upload(pWeight->_vBias.data());
         }
+
+        // Stage optimizer state from a training checkpoint, uploaded once RefreshState allocates velocity buffers
+        if (!wd._bShared && (wd._vWeightVelocity.size() != 0))
+        {
+            pWeight->ShardWeights(wd._vWeightVelocity, pWeight->_vWeightVelocity);
+            _bClearVelocity                     = false;
+        }
+        if (!wd._bShared && (wd._vWeightGradientVelocity.size() != 0))
+            pWeight->ShardWeights(wd._vWeightGradientVelocity, pWeight->_vWeightGradientVelocity);
+        if (wd._vBiasVelocity.size() != 0)
+        {
+            pWeight->ShardBiases(wd._vBiasVelocity, pWeight->_vBiasVelocity);
+            _bClearVelocity                     = false;
+        }
+        if (wd._vBiasGradientVelocity.size() != 0)
+            pWeight->ShardBiases(wd._vBiasGradientVelocity, pWeight->_vBiasGradientVelocity);
     }
 
     // Now locate sources for all shared weights using second
@@ -830,7 +1127,7 @@ void NNNetwork::ShuffleIndices()
     if (getGpu()._numprocs > 1)
     {
         cudaDeviceSynchronize();
-        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Barrier(getGpu()._comm);
     
         // Broadcast from P2P Send buffer
         P2P_Bcast(_pShuffleIndex, _examples * sizeof(uint32_t));
@@ -1036,15 +1333,27 @@ void NNNetwork::LoadDataSets(vector<NNDataSetBase*>& vData)
                     break;
                 }
 
-                // Signal successful location of matching data set
+                // Signal successful location of matching data set, sampling tables following its frequencies
                 l->_pDataSet                    = d;
                 l->_bDirty                      = true; 
+                l->_vSampleProbability.clear();
                 if (getGpu()._id == 0)       
                     printf("NNNetwork::LoadDataSets: Found data set %s for output layer %s\n", d->_name.c_str(), l->_name.c_str());
                 break;
             }
         }
     }
+
+    // Streamed data sets shuffle their own examples and only hold a window of them on the GPU
+    for (auto d: vData)
+    {
+        if (d->_bStreaming && _bShuffleIndices)
+        {
+            if (getGpu()._id == 0)
+                printf("NNNetwork::LoadDataSets: Data set %s is streamed, turning off index shuffling.\n", d->_name.c_str());
+            SetShuffleIndices(false);
+        }
+    }
     _bDirty                                     = true;
 }
 
@@ -1152,7 +1461,7 @@ void NNNetwork::SaveWeights(const string& fname, const string& inputLayer, const
 
     // Check for success
 exit:
-    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, getGpu()._comm);
     if (!bResult)
     {    
         getGpu().Shutdown();
@@ -1189,7 +1498,7 @@ void NNNetwork::SaveLayer(const string& fname, const string& layer)
 
     // Check for success
 exit:
-    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, getGpu()._comm);
     if (!bResult)
     {    
         getGpu().Shutdown();
@@ -1236,7 +1545,7 @@ void NNNetwork::DumpLayer(FILE* fp, const string& layer)
 
     // Check for success
 exit:
-    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, getGpu()._comm);
     if (!bResult)
     {    
         getGpu().Shutdown();
@@ -1264,7 +1573,7 @@ void NNNetwork::SaveBatch(string fname)
 
     // Check for success
 exit:
-    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, getGpu()._comm);
     if (!bResult)
     {    
         getGpu().Shutdown();
@@ -1498,9 +1807,6 @@ NNFloat NNNetwork::Train(uint32_t epochs, NNFloat alpha, NNFloat lambda, NNFloat
     NNFloat total_error_regularization                      = (NNFloat)0.0;
     NNFloat average_error_training                          = (NNFloat)FLT_MAX;
     NNFloat average_error_regularization                    = (NNFloat)0.0;
-    NNFloat moving_average                                  = (NNFloat)0.0;
-    uint32_t brake_steps                                    = 0;
-    uint32_t init_steps                                     = 100;
 
     for (uint32_t epoch = 0; epoch < epochs; epoch++)
     {
@@ -1509,6 +1815,13 @@ NNFloat NNNetwork::Train(uint32_t epochs, NNFloat alpha, NNFloat lambda, NNFloat
         total_error_training                                = (NNFloat)0.0;
         total_error_regularization                          = (NNFloat)0.0;
 
+        // Apply learning rate schedule based on total epochs trained so far
+        NNFloat epoch_alpha                                 = CalculateScheduledAlpha(alpha, _epochs);
+
+        // Derive this epoch's shuffle, denoising and dropout randoms from the seed and epoch alone so
+        // training resumed from a checkpoint replays exactly the same sequence
+        getGpu().ReseedRandom(_epochs);
+
         // Generate denoising randoms if denoising is active
         if (_bDenoising)
         {
@@ -1538,35 +1851,35 @@ NNFloat NNNetwork::Train(uint32_t epochs, NNFloat alpha, NNFloat lambda, NNFloat
             total_error_training                           += error_training;
             total_error_regularization                     += error_regularization * minibatch;                                
             if (getGpu()._id == 0)
-                printf("NNNetwork::Train: Minibatch@%u, average error %f, (%f training, %f regularization), alpha %f\n", pos, error_training / minibatch + error_regularization, error_training / minibatch, error_regularization, alpha);
+                printf("NNNetwork::Train: Minibatch@%u, average error %f, (%f training, %f regularization), alpha %f\n", pos, error_training / minibatch + error_regularization, error_training / minibatch, error_regularization, epoch_alpha);
 
             // Adjust step size if network is diverging (you should probably reduce the step size instead but let's
             // assume you're pretty much asleep at the wheel and the network has to fend for itself).
-            NNFloat step_alpha                              = alpha;
-            moving_average                                  = 0.9 * moving_average + 0.1 * error_training;
-            if (init_steps == 0)
+            NNFloat step_alpha                              = epoch_alpha;
+            _movingAverageError                             = 0.9 * _movingAverageError + 0.1 * error_training;
+            if (_initSteps == 0)
             {
-                if (error_training > 2.0 * moving_average)
+                if (error_training > 2.0 * _movingAverageError)
                 {
-                    brake_steps = 25;
+                    _brakeSteps                             = 25;
                     if (getGpu()._id == 0)                    
                         printf("NNNetwork::Train: Detected network divergence, attempting recovery.\n");
                 }
             }
             else
-                init_steps--;
+                _initSteps--;
             
             // Reduce step size while braking is active
-            if (brake_steps > 0)
+            if (_brakeSteps > 0)
             {
                 step_alpha                                 *= (NNFloat)0.1;
-                brake_steps--;
+                _brakeSteps--;
             }
 
             // Calculate Gradients then update weights
-            if (brake_steps < 24)
+            if (_brakeSteps < 24)
             {
-                BackPropagate(alpha);         
+                BackPropagate(epoch_alpha);         
                 UpdateWeights(step_alpha, lambda, mu);
             }
 
@@ -1584,7 +1897,7 @@ NNFloat NNNetwork::Train(uint32_t epochs, NNFloat alpha, NNFloat lambda, NNFloat
                     printf("\n");
                 }
             }
-            MPI_Barrier(MPI_COMM_WORLD);
+            MPI_Barrier(getGpu()._comm);
 #endif
            //getGpu().Shutdown();
            //exit(-1);
@@ -1593,13 +1906,53 @@ NNFloat NNNetwork::Train(uint32_t epochs, NNFloat alpha, NNFloat lambda, NNFloat
         gettimeofday(&t1, NULL);
         average_error_training                              = total_error_training / GetExamples();
         average_error_regularization                        = total_error_regularization / GetExamples();
+        _epochs++;
         if (getGpu()._id == 0)
-            printf("NNNetwork::Train: Epoch %d, average error %f, average training error %f, average regularization error %f, elapsed time %fs\n", ++_epochs,           
+            printf("NNNetwork::Train: Epoch %d, average error %f, average training error %f, average regularization error %f, elapsed time %fs\n", _epochs,           
                     average_error_training + average_error_regularization, 
                     average_error_training, average_error_regularization, 
                     elapsed_time(t1, t0));
 
-        // Check for checkpoint
+        // Evaluate held-out data and stop early once validation error has plateaued
+        bool bStop                                          = false;
+        if (_vValidationData.size() > 0)
+        {
+            _validationEpochs++;
+            if (_validationEpochs >= _validationInterval)
+            {
+                NNFloat validation_error, precision, recall, ndcg;
+                tie(validation_error, precision, recall, ndcg)  = CalculateValidationMetrics();
+                _validationEpochs                           = 0;
+                if (getGpu()._id == 0)
+                {
+                    if (_validationK > 0)
+                        printf("NNNetwork::Train: Epoch %d, average validation error %f, precision@%u %f, recall@%u %f, NDCG@%u %f\n", _epochs, validation_error, 
+                                _validationK, precision, _validationK, recall, _validationK, ndcg);
+                    else
+                        printf("NNNetwork::Train: Epoch %d, average validation error %f\n", _epochs, validation_error);
+                }
+
+                if (_earlyStoppingPatience > 0)
+                {
+                    if (validation_error < _bestValidationError - _earlyStoppingMinDelta)
+                    {
+                        _bestValidationError                = validation_error;
+                        _validationStalls                   = 0;
+                    }
+                    else
+                        _validationStalls++;
+
+                    if (_validationStalls >= _earlyStoppingPatience)
+                    {
+                        if (getGpu()._id == 0)
+                            printf("NNNetwork::Train: Validation error has not improved below %f for %u validation passes, stopping early.\n", _bestValidationError, _validationStalls);
+                        bStop                               = true;
+                    }
+                }
+            }
+        }
+
+        // Check for checkpoint, after validation so a resumed run picks up its early stopping progress
         if (_checkpoint_interval > 0)        
         {
             _checkpoint_epochs++;
@@ -1609,15 +1962,214 @@ NNFloat NNNetwork::Train(uint32_t epochs, NNFloat alpha, NNFloat lambda, NNFloat
                 if (getGpu()._id == 0)
                     printf("NNNetwork::Train: saving checkpoint %s\n", filename.c_str());
 
-                SaveNetCDF(filename);                
                 _checkpoint_epochs                          = 0;
+                if (!SaveCheckpoint(filename) && (getGpu()._id == 0))
+                    printf("NNNetwork::Train: previous checkpoint failed to save\n");
             }
         }
+        if (bStop)
+            break;
     }
+
+    // Make sure the last checkpoint has landed before handing control back
+    if (!WaitForCheckpoint() && (getGpu()._id == 0))
+        printf("NNNetwork::Train: last checkpoint failed to save\n");
     
     return average_error_training + average_error_regularization;
 }
 
+NNFloat NNNetwork::CalculateScheduledAlpha(NNFloat alpha, uint32_t epoch)
+{
+    // Ramp linearly up to alpha during warmup
+    if (epoch < _alphaWarmup)
+        return alpha * (NNFloat)(epoch + 1) / (NNFloat)_alphaWarmup;
+    epoch                                  -= _alphaWarmup;
+
+    NNFloat scheduled_alpha                 = alpha;
+    switch (_alphaSchedule)
+    {
+        case FixedRate:
+            return alpha;
+
+        case StepDecay:
+            scheduled_alpha                 = alpha * pow(_alphaMultiplier, (NNFloat)(epoch / _alphaInterval));
+            break;
+
+        case ExponentialDecay:
+            scheduled_alpha                 = alpha * pow(_alphaMultiplier, (NNFloat)epoch / (NNFloat)_alphaInterval);
+            break;
+
+        case CosineAnnealing:
+        {
+            NNFloat t                       = (NNFloat)min(epoch, _alphaInterval) / (NNFloat)_alphaInterval;
+            scheduled_alpha                 = _alphaMin + (NNFloat)0.5 * (alpha - _alphaMin) * ((NNFloat)1.0 + cos((NNFloat)M_PI * t));
+            break;
+        }
+    }
+    return max(scheduled_alpha, _alphaMin);
+}
+
+// Calculates average error, and optionally precision, recall and NDCG at K for the first output layer,
+// over the held-out data sets without disturbing the training data sets
+tuple<NNFloat, NNFloat, NNFloat, NNFloat> NNNetwork::CalculateValidationMetrics()
+{
+    // Swap held-out data sets into input and output layers, sharding them like the training data
+    uint32_t examples                       = _examples;
+    uint32_t position                       = _position;
+    vector<NNLayer*> vLayer(_vInputLayer);
+    vLayer.insert(vLayer.end(), _vOutputLayer.begin(), _vOutputLayer.end());
+    vector<NNDataSetBase*> vTrainingData;
+    for (auto l: vLayer)
+    {
+        vTrainingData.push_back(l->_pDataSet);
+        for (auto d: _vValidationData)
+        {
+            if (l->_dataSet.compare(d->_name) == 0)
+            {
+                if (l->_type == NNLayer::Type::FullyConnected)
+                    d->Shard(NNDataSetEnums::Model);
+                else if (l->_type == NNLayer::Type::Convolutional)
+                    d->Shard(NNDataSetEnums::Data);
+                l->_pDataSet                = d;
+                _examples                   = d->_examples;
+                break;
+            }
+        }
+    }
+
+    // Top K buffers persist across validation passes
+    const uint32_t K                        = _validationK;
+    if ((K > 0) && ((_pbValidationKey == NULL) || (_pbValidationKey->_length < _batch * K)))
+    {
+        delete _pbValidationKey;
+        delete _pbValidationValue;
+        _pbValidationKey                    = new GpuBuffer<NNFloat>(_batch * K, true);
+        _pbValidationValue                  = new GpuBuffer<uint32_t>(_batch * K, true);
+    }
+
+    // Switch to prediction mode without marking the network dirty so no buffers are reallocated
+    _mode                                   = Prediction;
+    getGpu().SetNeuralNetwork(this);
+
+    NNLayer* pOutputLayer                   = _vOutputLayer[0];
+    vector<char> vTarget((K > 0) ? pOutputLayer->_localStride : 0, 0);
+    vector<uint8_t> vHit(_batch * K);
+    vector<uint32_t> vTargets(_batch);
+    vector<NNFloat> vAllKey;
+    vector<uint8_t> vAllHit;
+    vector<pair<NNFloat, uint8_t> > vCandidate(getGpu()._numprocs * K);
+    if (getGpu()._id == 0)
+    {
+        vAllKey.resize(getGpu()._numprocs * _batch * K);
+        vAllHit.resize(getGpu()._numprocs * _batch * K);
+    }
+    
+    NNFloat total_error                     = (NNFloat)0.0;
+    double total_precision                  = 0.0;
+    double total_recall                     = 0.0;
+    double total_ndcg                       = 0.0;
+    uint32_t ranked_examples                = 0;
+    for (uint32_t pos = 0; pos < _examples; pos += _batch)
+    {
+        _position                           = pos;
+        uint32_t batch                      = _batch;
+        if (_position + batch > _examples)
+            batch                           = _examples - _position;
+
+        ClearUpdates();
+        LoadBatch();
+        for (auto l: _vFPOrder)
+        {
+            l->ForwardPropagate(_position, batch, false);
+        }
+
+        NNFloat error_training, error_regularization;
+        tie(error_training, error_regularization)   = CalculateError((NNFloat)0.0);
+        total_error                        += error_training;
+
+        if (K == 0)
+            continue;
+
+        // Calculate local top K and flag which entries are targets in this process's slice of the output layer
+        kCalculateTopK(pOutputLayer->_pbUnit->_pDevData, _pbValidationKey->_pDevData, _pbValidationValue->_pDevData, batch, pOutputLayer->_localStride, K);
+        _pbValidationKey->Download();
+        _pbValidationValue->Download();
+        NNDataSetBase* pData                = pOutputLayer->_pDataSet;
+        for (uint32_t i = 0; i < batch; i++)
+        {
+            uint32_t j                      = _position + i;
+            vTargets[i]                     = pData->_vSparseOffset[j + 1] - pData->_vSparseOffset[j];
+            for (uint64_t k = pData->_vSparseOffset[j]; k < pData->_vSparseOffset[j + 1]; k++)
+                vTarget[pData->_vSparseIndex[k]] = 1;
+            for (uint32_t k = 0; k < K; k++)
+            {
+                uint32_t index              = _pbValidationValue->_pSysData[i * K + k];
+                vHit[i * K + k]             = (index < vTarget.size()) ? vTarget[index] : 0;
+            }
+            for (uint64_t k = pData->_vSparseOffset[j]; k < pData->_vSparseOffset[j + 1]; k++)
+                vTarget[pData->_vSparseIndex[k]] = 0;
+        }
+
+        // Gather partial top K lists and target counts on process 0
+        MPI_Gather(_pbValidationKey->_pSysData, batch * K, MPI_NNFLOAT, vAllKey.data(), batch * K, MPI_NNFLOAT, 0, getGpu()._comm);
+        MPI_Gather(vHit.data(), batch * K, MPI_UINT8_T, vAllHit.data(), batch * K, MPI_UINT8_T, 0, getGpu()._comm);
+        MPI_Reduce((getGpu()._id == 0) ? MPI_IN_PLACE : vTargets.data(), vTargets.data(), batch, MPI_UINT32_T, MPI_SUM, 0, getGpu()._comm);
+
+        // Merge into global top K and score it
+        if (getGpu()._id == 0)
+        {
+            for (uint32_t i = 0; i < batch; i++)
+            {
+                if (vTargets[i] == 0)
+                    continue;
+
+                for (uint32_t p = 0; p < getGpu()._numprocs; p++)
+                {
+                    for (uint32_t k = 0; k < K; k++)
+                    {
+                        size_t offset       = ((size_t)p * batch + i) * K + k;
+                        vCandidate[p * K + k] = make_pair(vAllKey[offset], vAllHit[offset]);
+                    }
+                }
+                if (getGpu()._numprocs > 1)
+                    partial_sort(vCandidate.begin(), vCandidate.begin() + K, vCandidate.end(), greater<pair<NNFloat, uint8_t> >());
+
+                double tp                   = 0.0;
+                double dcg                  = 0.0;
+                double idcg                 = 0.0;
+                for (uint32_t k = 0; k < K; k++)
+                {
+                    if (vCandidate[k].second)
+                    {
+                        tp                 += 1.0;
+                        dcg                += 1.0 / log2(k + 2.0);
+                    }
+                    if (k < vTargets[i])
+                        idcg               += 1.0 / log2(k + 2.0);
+                }
+                total_precision            += tp / K;
+                total_recall               += tp / vTargets[i];
+                total_ndcg                 += dcg / idcg;
+                ranked_examples++;
+            }
+        }
+    }
+    NNFloat average_error                   = total_error / _examples;
+    NNFloat precision                       = (ranked_examples > 0) ? total_precision / ranked_examples : (NNFloat)0.0;
+    NNFloat recall                          = (ranked_examples > 0) ? total_recall / ranked_examples : (NNFloat)0.0;
+    NNFloat ndcg                            = (ranked_examples > 0) ? total_ndcg / ranked_examples : (NNFloat)0.0;
+
+    // Restore training data sets and state
+    for (size_t i = 0; i < vLayer.size(); i++)
+        vLayer[i]->_pDataSet                = vTrainingData[i];
+    _examples                               = examples;
+    _position                               = position;
+    _mode                                   = Training;
+    getGpu().SetNeuralNetwork(this);
+
+    return make_tuple(average_error, precision, recall, ndcg);
+}
+
 void NNNetwork::ClearUpdates()
 {
     for (auto w: _vWeight)
@@ -1659,8 +2211,8 @@ tuple<NNFloat, NNFloat> NNNetwork::CalculateError(NNFloat lambda)
     {
         double derror_training              = error_training;
         double derror_regularization        = error_regularization;
-        MPI_Allreduce(MPI_IN_PLACE, &derror_training, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
-        MPI_Allreduce(MPI_IN_PLACE, &derror_regularization, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(MPI_IN_PLACE, &derror_training, 1, MPI_DOUBLE, MPI_SUM, getGpu()._comm);
+        MPI_Allreduce(MPI_IN_PLACE, &derror_regularization, 1, MPI_DOUBLE, MPI_SUM, getGpu()._comm);
         error_training                      = derror_training;
         error_regularization                = derror_regularization;
     }
@@ -1675,8 +2227,9 @@ void NNNetwork::BackPropagate(NNFloat alpha)
     if (_position + batch > _examples)
         batch                               = _examples - _position;
 
-    for (auto l: _vBPOrder)
+    for (uint32_t i = 0; i < _vBPOrder.size(); i++)
     {
+        NNLayer* l                          = _vBPOrder[i];
         switch (l->_kind)
         {
             case NNLayer::Kind::Output:
@@ -1688,7 +2241,11 @@ void NNNetwork::BackPropagate(NNFloat alpha)
                 l->BackPropagate(_position, batch, alpha);
                 break;
         }
+
+        // Start reducing replicated gradients as soon as they are complete
+        StageGradients(i);
     }
+    FinishGradientReduction();
 }
 
 void NNNetwork::UpdateWeights(NNFloat alpha, float lambda, NNFloat mu)
@@ -1740,164 +2297,420 @@ void NNNetwork::CalculateTopK(const string& layer, uint32_t k, GpuBuffer<NNFloat
 
 bool NNNetwork::SaveNetCDF(const string& fname)
 {
-    bool bResult                            = true;     
-    
+    // NetCDF is not thread-safe so finish any checkpoint still being written
+    WaitForCheckpoint();
+
     // Unshard weights and biases to local copy
-    vector< vector<NNFloat> > vvWeight;
-    vector< vector<NNFloat> > vvBias;
+    NNNetworkDescriptor d;
+    d._checkpoint_epochs                    = _checkpoint_epochs;
+    GatherWeights(d._vWeightDescriptor);
+    
+    // Write file from process 0
+    bool bResult                            = true;     
+    if (getGpu()._id == 0)
+        bResult                             = WriteNetCDF(fname, d);
+
+    // Gather and test on result
+    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, getGpu()._comm);
+    if (!bResult)
+    {
+        getGpu().Shutdown();
+        exit(-1);
+    }
+
+    return bResult;
+}
+
+// Compact model files hold a fixed size header, the binary network descriptor, a table locating each weight's
+// values and biases, and finally the values themselves as raw NNFloat blobs aligned to ModelBlobAlignment bytes.
+// Loading memory maps the file so each process copies its own shards straight from the page cache to the GPU
+static const char ModelFileMagic[8]             = { 'D', 'S', 'S', 'T', 'N', 'E', 'M', 'F' };
+static const uint32_t ModelFileVersion          = 3;
+static const uint64_t ModelBlobAlignment        = 64;
+
+struct NNModelFileHeader
+{
+    char                        _magic[8];                  // ModelFileMagic
+    uint32_t                    _version;                   // ModelFileVersion
+    uint32_t                    _floatSize;                 // sizeof(NNFloat) of blobs
+    uint64_t                    _metadataSize;              // Size of descriptor and blob table following header
+    uint64_t                    _fileSize;                  // Total file size, to detect truncated files
+    char                        _pad[32];                   // Pads header to ModelBlobAlignment bytes
+};
+
+static uint64_t AlignModelBlob(uint64_t offset)
+{
+    return (offset + ModelBlobAlignment - 1) & ~(ModelBlobAlignment - 1);
+}
+
+bool WriteModelFile(const string& fname, const NNNetworkDescriptor& d)
+{
+    NNBinaryWriter w;
+    SaveNNNetworkDescriptorBinary(w, d);
+
+    // Lay out blobs after the header, descriptor and blob table
+    vector<NNModelBlob> vBlob(d._vWeightDescriptor.size());
+    uint64_t metadataSize                       = w.GetBuffer().size() + vBlob.size() * sizeof(NNModelBlob);
+    uint64_t offset                             = AlignModelBlob(sizeof(NNModelFileHeader) + metadataSize);
+    for (size_t i = 0; i < vBlob.size(); i++)
+    {
+        const NNWeightDescriptor& wd            = d._vWeightDescriptor[i];
+        vBlob[i]._weights                       = wd._vWeight.size();
+        vBlob[i]._weightOffset                  = (vBlob[i]._weights != 0) ? offset : 0;
+        offset                                  = AlignModelBlob(offset + vBlob[i]._weights * sizeof(NNFloat));
+        vBlob[i]._biases                        = wd._vBias.size();
+        vBlob[i]._biasOffset                    = offset;
+        offset                                  = AlignModelBlob(offset + vBlob[i]._biases * sizeof(NNFloat));
+    }
+    for (auto& b : vBlob)
+        w.Write(b);
+
+    NNModelFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header._magic, ModelFileMagic, sizeof(header._magic));
+    header._version                             = ModelFileVersion;
+    header._floatSize                           = sizeof(NNFloat);
+    header._metadataSize                        = metadataSize;
+    header._fileSize                            = offset;
+
+    FILE* fp                                    = fopen(fname.c_str(), "wb");
+    if (fp == NULL)
+    {
+        printf("NNNetwork::SaveModel: Unable to open model file %s for writing.\n", fname.c_str());
+        return false;
+    }
+
+    // Write everything in file order, zero padding up to each blob
+    static const char zeros[ModelBlobAlignment] = { 0 };
+    bool bResult                                = (fwrite(&header, sizeof(header), 1, fp) == 1) &&
+                                                  (fwrite(w.GetBuffer().data(), 1, w.GetBuffer().size(), fp) == w.GetBuffer().size());
+    uint64_t position                           = sizeof(header) + metadataSize;
+    for (size_t i = 0; bResult && (i < vBlob.size()); i++)
+    {
+        const NNWeightDescriptor& wd            = d._vWeightDescriptor[i];
+        uint64_t padding                        = AlignModelBlob(position) - position;
+        bResult                                 = (fwrite(zeros, 1, padding, fp) == padding) &&
+                                                  (fwrite(wd._vWeight.data(), sizeof(NNFloat), wd._vWeight.size(), fp) == wd._vWeight.size());
+        position                               += padding + wd._vWeight.size() * sizeof(NNFloat);
+        padding                                 = AlignModelBlob(position) - position;
+        bResult                                 = bResult && (fwrite(zeros, 1, padding, fp) == padding) &&
+                                                  (fwrite(wd._vBias.data(), sizeof(NNFloat), wd._vBias.size(), fp) == wd._vBias.size());
+        position                               += padding + wd._vBias.size() * sizeof(NNFloat);
+    }
+    uint64_t padding                            = AlignModelBlob(position) - position;
+    bResult                                     = bResult && (fwrite(zeros, 1, padding, fp) == padding);
+    bResult                                     = (fclose(fp) == 0) && bResult;
+    if (!bResult)
+        printf("NNNetwork::SaveModel: Error writing model file %s.\n", fname.c_str());
+    return bResult;
+}
+
+// Writes the network as a compact model file (see WriteModelFile), which LoadNeuralNetworkModel loads without
+// parsing or broadcasting weights
+bool NNNetwork::SaveModel(const string& fname)
+{
+    // Unshard weights and biases to process 0
+    NNNetworkDescriptor d;
+    GatherWeights(d._vWeightDescriptor);
+    GetDescriptor(d);
+
+    // Write file from process 0
+    bool bResult                            = true;
+    if (getGpu()._id == 0)
+        bResult                             = WriteModelFile(fname, d);
+
+    // Gather and test on result
+    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, getGpu()._comm);
+    if (!bResult)
+    {
+        getGpu().Shutdown();
+        exit(-1);
+    }
+
+    return bResult;
+}
+
+// Describes the network as currently configured, leaving weight values in d._vWeightDescriptor untouched so they
+// can be gathered first
+void NNNetwork::GetDescriptor(NNNetworkDescriptor& d)
+{
+    d._name                                 = _name;
+    d._kind                                 = _kind;
+    d._errorFunction                        = _errorFunction;
+    d._bShuffleIndices                      = _bShuffleIndices;
+    d._maxout_k                             = _maxout_k;
+    d._LRN_k                                = _LRN_k;
+    d._LRN_n                                = _LRN_n;
+    d._LRN_alpha                            = _LRN_alpha;
+    d._LRN_beta                             = _LRN_beta;
+    d._bSparsenessPenalty                   = _bSparsenessPenalty;
+    d._sparsenessPenalty_p                  = _sparsenessPenalty_p;
+    d._sparsenessPenalty_beta               = _sparsenessPenalty_beta;
+    d._bDenoising                           = _bDenoising;
+    d._denoising_p                          = _denoising_p;
+    d._deltaBoost_one                       = _deltaBoost_one;
+    d._deltaBoost_zero                      = _deltaBoost_zero;
+    d._SMCE_oneTarget                       = _SMCE_oneTarget;
+    d._SMCE_zeroTarget                      = _SMCE_zeroTarget;
+    d._SMCE_oneScale                        = _SMCE_oneScale;
+    d._SMCE_zeroScale                       = _SMCE_zeroScale;
+    d._checkpoint_name                      = _checkpoint_name;
+    d._checkpoint_interval                  = _checkpoint_interval;
+    d._checkpoint_epochs                    = _checkpoint_epochs;
+    d._bConvLayersCalculated                = true;
+
+    d._vLayerDescriptor.resize(_vLayer.size());
+    for (size_t i = 0; i < _vLayer.size(); i++)
+        _vLayer[i]->GetDescriptor(d._vLayerDescriptor[i]);
+    d._vWeightDescriptor.resize(_vWeight.size());
+    for (size_t i = 0; i < _vWeight.size(); i++)
+        _vWeight[i]->GetDescriptor(d._vWeightDescriptor[i]);
+}
+
+// Snapshots weights, optimizer velocities and training progress into host staging buffers and hands them to a
+// background thread on process 0, which writes them to a temporary file and renames it into place so readers
+// never see a partial checkpoint.  Checkpoints are only taken between epochs so the shuffle position is always 0
+// and random state is reproduced by reseeding from (seed, epoch)
+bool NNNetwork::SaveCheckpoint(const string& fname)
+{
+    // Only one checkpoint is in flight at a time
+    bool bResult                            = WaitForCheckpoint();
+
+    _pCheckpointDescriptor                  = new NNNetworkDescriptor();
+    _pCheckpointDescriptor->_checkpoint_epochs  = _checkpoint_epochs;
+    _pCheckpointDescriptor->_trainingMode   = _trainingMode;
+    _pCheckpointDescriptor->_epochs         = _epochs;
+    _pCheckpointDescriptor->_movingAverageError = _movingAverageError;
+    _pCheckpointDescriptor->_brakeSteps     = _brakeSteps;
+    _pCheckpointDescriptor->_initSteps      = _initSteps;
+    _pCheckpointDescriptor->_bestValidationError = _bestValidationError;
+    _pCheckpointDescriptor->_validationStalls   = _validationStalls;
+    _pCheckpointDescriptor->_validationEpochs   = _validationEpochs;
+    _pCheckpointDescriptor->_randomSeed     = getGpu()._randomSeed;
+    GatherWeights(_pCheckpointDescriptor->_vWeightDescriptor, (_trainingMode != SGD));
+    if (getGpu()._id == 0)
+    {
+        _checkpointThread                   = std::thread([this, fname]()
+        {
+            string tempname                 = fname + ".tmp";
+            _bCheckpointResult              = WriteNetCDF(tempname, *_pCheckpointDescriptor, true);
+            if (_bCheckpointResult && (rename(tempname.c_str(), fname.c_str()) != 0))
+            {
+                printf("NNNetwork::SaveCheckpoint: Unable to rename %s to %s.\n", tempname.c_str(), fname.c_str());
+                _bCheckpointResult          = false;
+            }
+        });
+    }
+
+    return bResult;
+}
+
+// Waits for any background checkpoint write to finish and returns whether it succeeded
+bool NNNetwork::WaitForCheckpoint()
+{
+    bool bResult                            = true;
+    if (_checkpointThread.joinable())
+    {
+        _checkpointThread.join();
+        bResult                             = _bCheckpointResult;
+    }
+    delete _pCheckpointDescriptor;
+    _pCheckpointDescriptor                  = NULL;
+    return bResult;
+}
+
+// Collects weights and biases (and optionally optimizer velocities) from all processes into host memory on process 0
+void NNNetwork::GatherWeights(vector<NNWeightDescriptor>& vWeightDescriptor, bool bVelocity)
+{
+    vWeightDescriptor.clear();
     for (auto w : _vWeight)
     {
-        // Download weights to local copy on process 0
-        vector<NNFloat> vWeight;
-        vector<NNFloat> vBias;
+        NNWeightDescriptor wd;
 
         // BUG need to account for multi-GPU conv layers and biases
         if (!w->_bShared)
+            GatherWeightBuffer(w, w->_pbWeight, w->_vWeight, wd._vWeight);
+        GatherBiasBuffer(w, w->_pbBias, w->_vBias, wd._vBias);
+
+        // Gather velocities for training checkpoints
+        if (bVelocity)
         {
-            w->_pbWeight->Download(w->_vWeight.data());
-           
-            if (getGpu()._numprocs == 1)
-            {
-                vWeight                         = w->_vWeight;
-            }
-            else
-            {
-                uint32_t outgoingSize           = w->_outputLayer._stride * 3;               
-                uint32_t incomingSize           = w->_inputLayer._stride * 2;
-                if (getGpu()._id == 0)
-                {
-                    vWeight.resize(w->_outputLayer._stride * w->_inputLayer._stride);
-                    NNFloat* pWeight            = vWeight.data();                    
-                    if (outgoingSize > incomingSize)
-                    {
-                        cudaMemcpy2D(pWeight, w->_outputLayer._stride * sizeof(NNFloat), w->_vWeight.data(), w->_outputLayer._localStride * sizeof(NNFloat), w->_outputLayer._localStride * sizeof(NNFloat), w->_inputLayer._stride, cudaMemcpyDefault);
-                        pWeight                += w->_outputLayer._localStride;
-                        for (uint32_t i = 1; i < getGpu()._numprocs; i++)
-                        {                        
-                            uint64_t size;
-                            MPI_Status status;                
-                            MPI_Recv(&size, 1, MPI_UINT64_T, i, 0, MPI_COMM_WORLD, &status);
-                            vector<NNFloat> vTemp(size);
-                            MPI_Recv(vTemp.data(), size, MPI_FLOAT, i, 0, MPI_COMM_WORLD, &status);
-                            uint64_t lstride    = size / w->_inputLayer._stride;
-                            NNFloat* pSrcWeight = vTemp.data();
-                            NNFloat* pDstWeight = pWeight;
-                            for (uint32_t j = 0; j < w->_inputLayer._stride; j++)
-                            {
-                                memcpy(pDstWeight, pSrcWeight, lstride * sizeof(NNFloat));
-                                pSrcWeight     += lstride;
-                                pDstWeight     += w->_outputLayer._stride;
-                            }                          
-                            pWeight            += lstride;
-                        }
-                    }
-                    else
-                    {
-                        cudaMemcpy(pWeight, w->_vWeight.data(), w->_outputLayer._stride * w->_inputLayer._localStride * sizeof(NNFloat), cudaMemcpyDefault);
-                        pWeight                += w->_outputLayer._stride * w->_inputLayer._localStride;
-                        for (uint32_t i = 1; i < getGpu()._numprocs; i++)
-                        {
-                            uint64_t size;
-                            MPI_Status status;                
-                            MPI_Recv(&size, 1, MPI_UINT64_T, i, 0, MPI_COMM_WORLD, &status);
-                            MPI_Recv(pWeight, size, MPI_FLOAT, i, 0, MPI_COMM_WORLD, &status);
-                            pWeight            += size;
-                        }                        
-                    }
-                }              
-                else
-                {
-                    uint64_t size       = w->_vWeight.size();
-                    MPI_Send(&size, 1, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD);
-                    MPI_Send(w->_vWeight.data(), size, MPI_FLOAT, 0, 0, MPI_COMM_WORLD);                  
-                }
-            }
+            vector<NNFloat> vLocal;
+            if (!w->_bShared && w->_pbWeightVelocity)
+                GatherWeightBuffer(w, w->_pbWeightVelocity, vLocal, wd._vWeightVelocity);
+            if (!w->_bShared && w->_pbWeightGradientVelocity)
+                GatherWeightBuffer(w, w->_pbWeightGradientVelocity, vLocal, wd._vWeightGradientVelocity);
+            if (w->_pbBiasVelocity)
+                GatherBiasBuffer(w, w->_pbBiasVelocity, vLocal, wd._vBiasVelocity);
+            if (w->_pbBiasGradientVelocity)
+                GatherBiasBuffer(w, w->_pbBiasGradientVelocity, vLocal, wd._vBiasGradientVelocity);
         }
 
-        // Download biases to local copy on process 0
-        w->_pbBias->Download(w->_vBias.data());
+        // Add to growing weight list
+        vWeightDescriptor.push_back(wd);
+    }
+}
+
+// Downloads a weight-shaped buffer into vLocalWeight and unshards it into vWeight on process 0
+void NNNetwork::GatherWeightBuffer(NNWeight* w, GpuBuffer<NNFloat>* pBuffer, vector<NNFloat>& vLocalWeight, vector<NNFloat>& vWeight)
+{
+    vLocalWeight.resize(w->_size);
+    pBuffer->Download(vLocalWeight.data());
+   
+    if (getGpu()._numprocs == 1)
+    {
+        vWeight                             = vLocalWeight;
+    }
+    else
+    {
+        uint32_t outgoingSize               = w->_outputLayer._stride * 3;               
+        uint32_t incomingSize               = w->_inputLayer._stride * 2;
         if (getGpu()._id == 0)
         {
-            vBias                   = w->_vBias;
-            vBias.resize(w->_outputLayer._stride);
-            uint64_t offset         = w->_vBias.size();
-            for (size_t i = 1; i < getGpu()._numprocs; i++)
+            vWeight.resize(w->_outputLayer._stride * w->_inputLayer._stride);
+            NNFloat* pWeight                = vWeight.data();                    
+            if (outgoingSize > incomingSize)
             {
-                uint64_t size;
-                MPI_Status status;                
-                MPI_Recv(&size, 1, MPI_UINT64_T, i, 0, MPI_COMM_WORLD, &status);
-                MPI_Recv(vBias.data() + offset, size, MPI_FLOAT, i, 0, MPI_COMM_WORLD, &status);
-                offset             += size;   
+                cudaMemcpy2D(pWeight, w->_outputLayer._stride * sizeof(NNFloat), vLocalWeight.data(), w->_outputLayer._localStride * sizeof(NNFloat), w->_outputLayer._localStride * sizeof(NNFloat), w->_inputLayer._stride, cudaMemcpyDefault);
+                pWeight                    += w->_outputLayer._localStride;
+                for (uint32_t i = 1; i < getGpu()._numprocs; i++)
+                {                        
+                    uint64_t size;
+                    MPI_Status status;                
+                    MPI_Recv(&size, 1, MPI_UINT64_T, i, 0, getGpu()._comm, &status);
+                    vector<NNFloat> vTemp(size);
+                    MPI_Recv(vTemp.data(), size, MPI_FLOAT, i, 0, getGpu()._comm, &status);
+                    uint64_t lstride        = size / w->_inputLayer._stride;
+                    NNFloat* pSrcWeight     = vTemp.data();
+                    NNFloat* pDstWeight     = pWeight;
+                    for (uint32_t j = 0; j < w->_inputLayer._stride; j++)
+                    {
+                        memcpy(pDstWeight, pSrcWeight, lstride * sizeof(NNFloat));
+                        pSrcWeight         += lstride;
+                        pDstWeight         += w->_outputLayer._stride;
+                    }                          
+                    pWeight                += lstride;
+                }
             }
-        }
+            else
+            {
+                cudaMemcpy(pWeight, vLocalWeight.data(), w->_outputLayer._stride * w->_inputLayer._localStride * sizeof(NNFloat), cudaMemcpyDefault);
+                pWeight                    += w->_outputLayer._stride * w->_inputLayer._localStride;
+                for (uint32_t i = 1; i < getGpu()._numprocs; i++)
+                {
+                    uint64_t size;
+                    MPI_Status status;                
+                    MPI_Recv(&size, 1, MPI_UINT64_T, i, 0, getGpu()._comm, &status);
+                    MPI_Recv(pWeight, size, MPI_FLOAT, i, 0, getGpu()._comm, &status);
+                    pWeight                += size;
+                }                        
+            }
+        }              
         else
         {
-            uint64_t size           = w->_vBias.size();
-            MPI_Send(&size, 1, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD);
-            MPI_Send(w->_vBias.data(), size, MPI_FLOAT, 0, 0, MPI_COMM_WORLD);
+            uint64_t size                   = vLocalWeight.size();
+            MPI_Send(&size, 1, MPI_UINT64_T, 0, 0, getGpu()._comm);
+            MPI_Send(vLocalWeight.data(), size, MPI_FLOAT, 0, 0, getGpu()._comm);                  
         }
-
-        // Add to growing weight and bias lists
-        vvWeight.push_back(vWeight);
-        vvBias.push_back(vBias);
     }
+}
 
-    // Open output file
+// Downloads a bias-shaped buffer into vLocalBias and unshards it into vBias on process 0
+void NNNetwork::GatherBiasBuffer(NNWeight* w, GpuBuffer<NNFloat>* pBuffer, vector<NNFloat>& vLocalBias, vector<NNFloat>& vBias)
+{
+    vLocalBias.resize(w->_biasSize);
+    pBuffer->Download(vLocalBias.data());
     if (getGpu()._id == 0)
     {
-        try
-        {
-            NcFile nc(fname, NcFile::replace);
-
-            // Write descriptive values
-            nc.putAtt("version", ncFloat, NN_VERSION);
-            nc.putAtt("name", _name);
-            nc.putAtt("kind", ncUint, _kind);
-            nc.putAtt("errorFunction", ncUint, _errorFunction);
-            nc.putAtt("maxout_k", ncInt, _maxout_k);
-            nc.putAtt("LRN_k", ncFloat, _LRN_k);
-            nc.putAtt("LRN_n", ncInt, _LRN_n);
-            nc.putAtt("LRN_alpha", ncFloat, _LRN_alpha);
-            nc.putAtt("LRN_beta", ncFloat, _LRN_beta);
-            nc.putAtt("bSparsenessPenalty", ncUint, (uint32_t)_bSparsenessPenalty);
-            nc.putAtt("sparsenessPenalty_p", ncFloat, _sparsenessPenalty_p);
-            nc.putAtt("sparsenessPenalty_beta", ncFloat, _sparsenessPenalty_beta);
-            nc.putAtt("bDenoising", ncUint, (uint32_t)_bDenoising);
-            nc.putAtt("denoising_p", ncFloat, _denoising_p);
-            nc.putAtt("deltaBoost_one", ncFloat, _deltaBoost_one);
-            nc.putAtt("deltaBoost_zero", ncFloat, _deltaBoost_zero);
-            nc.putAtt("SMCE_oneScale", ncFloat, _SMCE_oneScale);
-            nc.putAtt("SMCE_zeroScale", ncFloat, _SMCE_zeroScale);
-            nc.putAtt("SMCE_oneTarget", ncFloat, _SMCE_oneTarget);
-            nc.putAtt("SMCE_zeroTarget", ncFloat, _SMCE_zeroTarget);
-            nc.putAtt("ShuffleIndices", ncUint, (uint32_t)_bShuffleIndices);
-            nc.putAtt("checkpoint_name", _checkpoint_name);
-            nc.putAtt("checkpoint_interval", ncInt, _checkpoint_interval);
-            nc.putAtt("checkpoint_epochs", ncInt, _checkpoint_epochs);            
-
-            // Write Layers
-            nc.putAtt("layers", ncUint, (uint32_t)_vLayer.size());
-            for (uint32_t i = 0; i < _vLayer.size(); i++)
-                _vLayer[i]->WriteNetCDF(nc, i);
-
-            // Write weights
-            nc.putAtt("weights", ncUint, (uint32_t)_vWeight.size());
-            for (uint32_t i = 0; i < _vWeight.size(); i++)
-                _vWeight[i]->WriteNetCDF(nc, i, vvWeight[i].data(), vvBias[i].data());
+        vBias                               = vLocalBias;
+        vBias.resize(w->_outputLayer._stride);
+        uint64_t offset                     = vLocalBias.size();
+        for (size_t i = 1; i < getGpu()._numprocs; i++)
+        {
+            uint64_t size;
+            MPI_Status status;                
+            MPI_Recv(&size, 1, MPI_UINT64_T, i, 0, getGpu()._comm, &status);
+            MPI_Recv(vBias.data() + offset, size, MPI_FLOAT, i, 0, getGpu()._comm, &status);
+            offset                         += size;   
+        }
+    }
+    else
+    {
+        uint64_t size                       = vLocalBias.size();
+        MPI_Send(&size, 1, MPI_UINT64_T, 0, 0, getGpu()._comm);
+        MPI_Send(vLocalBias.data(), size, MPI_FLOAT, 0, 0, getGpu()._comm);
+    }
+}
+
+// Serializes network and previously gathered weights to NetCDF, called only on process 0.  Training
+// state (epoch count, optimizer, random seed and velocities) is only written for checkpoints
+bool NNNetwork::WriteNetCDF(const string& fname, const NNNetworkDescriptor& d, bool bTrainingState)
+{
+    bool bResult                            = true;     
+
+    // Checkpoints are written on a background thread, which may overlap streamed dataset reads
+    std::lock_guard<std::mutex> lock(getNetCDFMutex());
+    try
+    {
+        NcFile nc(fname, NcFile::replace);
+
+        // Write descriptive values
+        nc.putAtt("version", ncFloat, NN_VERSION);
+        nc.putAtt("name", _name);
+        nc.putAtt("kind", ncUint, _kind);
+        nc.putAtt("errorFunction", ncUint, _errorFunction);
+        nc.putAtt("maxout_k", ncInt, _maxout_k);
+        nc.putAtt("LRN_k", ncFloat, _LRN_k);
+        nc.putAtt("LRN_n", ncInt, _LRN_n);
+        nc.putAtt("LRN_alpha", ncFloat, _LRN_alpha);
+        nc.putAtt("LRN_beta", ncFloat, _LRN_beta);
+        nc.putAtt("bSparsenessPenalty", ncUint, (uint32_t)_bSparsenessPenalty);
+        nc.putAtt("sparsenessPenalty_p", ncFloat, _sparsenessPenalty_p);
+        nc.putAtt("sparsenessPenalty_beta", ncFloat, _sparsenessPenalty_beta);
+        nc.putAtt("bDenoising", ncUint, (uint32_t)_bDenoising);
+        nc.putAtt("denoising_p", ncFloat, _denoising_p);
+        nc.putAtt("deltaBoost_one", ncFloat, _deltaBoost_one);
+        nc.putAtt("deltaBoost_zero", ncFloat, _deltaBoost_zero);
+        nc.putAtt("SMCE_oneScale", ncFloat, _SMCE_oneScale);
+        nc.putAtt("SMCE_zeroScale", ncFloat, _SMCE_zeroScale);
+        nc.putAtt("SMCE_oneTarget", ncFloat, _SMCE_oneTarget);
+        nc.putAtt("SMCE_zeroTarget", ncFloat, _SMCE_zeroTarget);
+        nc.putAtt("ShuffleIndices", ncUint, (uint32_t)_bShuffleIndices);
+        nc.putAtt("checkpoint_name", _checkpoint_name);
+        nc.putAtt("checkpoint_interval", ncInt, _checkpoint_interval);
+        nc.putAtt("checkpoint_epochs", ncInt, d._checkpoint_epochs);
+        if (bTrainingState)
+        {
+            nc.putAtt("trainingMode", ncUint, (uint32_t)d._trainingMode);
+            nc.putAtt("epochs", ncUint, d._epochs);
+            nc.putAtt("movingAverageError", ncFloat, d._movingAverageError);
+            nc.putAtt("brakeSteps", ncUint, d._brakeSteps);
+            nc.putAtt("initSteps", ncUint, d._initSteps);
+            nc.putAtt("bestValidationError", ncFloat, d._bestValidationError);
+            nc.putAtt("validationStalls", ncUint, d._validationStalls);
+            nc.putAtt("validationEpochs", ncUint, d._validationEpochs);
+            nc.putAtt("randomSeed", ncUint64, (unsigned long long int)d._randomSeed);
         }
-        catch (NcException& e)
+
+        // Write Layers
+        nc.putAtt("layers", ncUint, (uint32_t)_vLayer.size());
+        for (uint32_t i = 0; i < _vLayer.size(); i++)
+            _vLayer[i]->WriteNetCDF(nc, i);
+
+        // Write weights
+        nc.putAtt("weights", ncUint, (uint32_t)_vWeight.size());
+        for (uint32_t i = 0; i < _vWeight.size(); i++)
         {
-            printf("NNNetwork::SaveNetCDF Error opening binary output file %s to save neural network %s.\n", fname.c_str(), _name.c_str());
-            bResult             = false;
+            const NNWeightDescriptor& wd    = d._vWeightDescriptor[i];
+            _vWeight[i]->WriteNetCDF(nc, i, (NNFloat*)wd._vWeight.data(), (NNFloat*)wd._vBias.data());
+            if (bTrainingState)
+                _vWeight[i]->WriteVelocityNetCDF(nc, i, wd);
         }
     }
-
-    // Gather and test on result
-    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
-    if (!bResult)
+    catch (NcException& e)
     {
-        getGpu().Shutdown();
-        exit(-1);
+        printf("NNNetwork::WriteNetCDF: Error opening binary output file %s to save neural network %s.\n", fname.c_str(), _name.c_str());
+        bResult                             = false;
     }
 
     return bResult;
@@ -2013,6 +2826,9 @@ NNFloat* NNNetwork::GetWeightBuffer(const string& inputLayer, const string& outp
 
 NNNetwork::~NNNetwork()
 {
+    // Finish any outstanding checkpoint
+    WaitForCheckpoint();
+
     // Delete P2P data
     DeallocatePeerBuffers();
 
@@ -2033,6 +2849,10 @@ NNNetwork::~NNNetwork()
     
     // Delete CUDNN workspace
     delete _pbCUDNNWorkspace;
+
+    // Delete validation top K buffers
+    delete _pbValidationKey;
+    delete _pbValidationValue;
 }
 
 uint32_t CalculateConvolutionDimensions(uint32_t width, uint32_t filter, uint32_t stride)
@@ -2508,7 +3328,7 @@ void NNNetwork::DeallocatePeerBuffers()
     {
         // make sure buffers aren't in use
         cudaDeviceSynchronize();
-        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Barrier(getGpu()._comm);
         
         // Release peer data
         for (size_t i = 0; i < 2; i++)
@@ -2519,7 +3339,7 @@ void NNNetwork::DeallocatePeerBuffers()
                 RTERROR(status, "NNNetwork::DeallocatePeerBuffers: Error closing IpcMemHandle");
             }
         }
-        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Barrier(getGpu()._comm);
         
         // Release local data
         for (size_t i = 0; i < 2; i++)
@@ -2531,6 +3351,11 @@ void NNNetwork::DeallocatePeerBuffers()
         // Release MPI work buffer
         delete[] _pCPUBuffer;
         _pCPUBuffer = NULL;
+        delete[] _pCPUReceiveBuffer;
+        _pCPUReceiveBuffer = NULL;
+
+        // Release gradient all-reduce buckets
+        DeallocateGradientBuckets();
     }
 
 }
@@ -2571,7 +3396,7 @@ void NNNetwork::AllocatePeerBuffers()
             RTERROR(status, "NNNetwork::AllocatePeerBuffers: Error getting first P2P IPCMemHandle");
             status                              = cudaIpcGetMemHandle(&(pMemHandle[pos + 1]), _pbP2PBuffer[1]->_pDevData);
             RTERROR(status, "NNNetwork::AllocatePeerBuffers: Error getting second P2P IPCMemHandle");
-            MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, pMemHandle, 2 * sizeof(cudaIpcMemHandle_t), MPI_BYTE, MPI_COMM_WORLD);
+            MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, pMemHandle, 2 * sizeof(cudaIpcMemHandle_t), MPI_BYTE, getGpu()._comm);
             unsigned int peer                   = 2 * ((getGpu()._id + getGpu()._numprocs - 1) % getGpu()._numprocs);   
             status = cudaIpcOpenMemHandle((void**)&(_pPeerBuffer[0]), pMemHandle[peer], cudaIpcMemLazyEnablePeerAccess);
             RTERROR(status, "NNNetwork::AllocatePeerBuffers: Unable to open first peer IPCMemHandle");        
@@ -2581,7 +3406,11 @@ void NNNetwork::AllocatePeerBuffers()
         else
         {
             _pCPUBuffer = new NNFloat[maxMemory];
+            _pCPUReceiveBuffer = new NNFloat[maxMemory];
         }
+
+        // Set up all-reduce buckets for replicated gradients
+        AllocateGradientBuckets();
     }
 }
 
@@ -2592,6 +3421,151 @@ void NNNetwork::SwapPeerBuffers()
     _receiveIndex                           = 1 - _receiveIndex;
 }
 
+// Number of gradient values per all-reduce bucket
+static const size_t GradientBucketSize      = 4 * 1024 * 1024;
+
+// Sorts the weight gradients replicated on every process into all-reduce buckets in backpropagation order.  Fully
+// connected layers are model-parallel, so only weights into data-parallel layers have replicated gradients, each
+// complete once the last layer sharing the weights has backpropagated
+void NNNetwork::AllocateGradientBuckets()
+{
+    // Find the step of backpropagation completing each replicated weight gradient
+    map<NNWeight*, uint32_t> mLastStep;
+    for (uint32_t i = 0; i < _vBPOrder.size(); i++)
+    {
+        if (_vBPOrder[i]->_parallelization == NNLayer::Parallelization::Data)
+        {
+            for (auto w : _vBPOrder[i]->_vIncomingWeight)
+                mLastStep[w->_bShared ? w->_pSharedWeight : w] = i;
+        }
+    }
+    if (mLastStep.empty())
+        return;
+
+    // Assign gradients to buckets as they complete, biases being unshared
+    _pGradientReducer                       = new NNGradientReducer<NNFloat>(MPI_NNFLOAT, GradientBucketSize, getGpu()._comm);
+    for (uint32_t i = 0; i < _vBPOrder.size(); i++)
+    {
+        if (_vBPOrder[i]->_parallelization != NNLayer::Parallelization::Data)
+            continue;
+        for (auto w : _vBPOrder[i]->_vIncomingWeight)
+        {
+            NNWeight* pSrcWeight            = w->_bShared ? w->_pSharedWeight : w;
+            auto it                         = mLastStep.find(pSrcWeight);
+            uint32_t bucket;
+            size_t offset;
+            if ((it != mLastStep.end()) && (it->second == i))
+            {
+                _pGradientReducer->Add(pSrcWeight->_size, i, bucket, offset);
+                _vReducedGradient.push_back(make_tuple(pSrcWeight->_pbWeightGradient->_pDevData, pSrcWeight->_size, bucket, offset));
+                mLastStep.erase(it);
+            }
+            if (w->_pbBiasGradient != NULL)
+            {
+                _pGradientReducer->Add(w->_biasSize, i, bucket, offset);
+                _vReducedGradient.push_back(make_tuple(w->_pbBiasGradient->_pDevData, w->_biasSize, bucket, offset));
+            }
+        }
+    }
+
+    // Allocate pinned staging buffers, and a stream to copy gradients out on without waiting for backpropagation
+    cudaError_t status;
+    for (uint32_t i = 0; i < _pGradientReducer->GetBuckets(); i++)
+    {
+        _vGradientBucketBuffer.push_back(new GpuBuffer<NNFloat>(_pGradientReducer->GetBucketSize(i), false, true));
+        _pGradientReducer->SetBuffer(i, _vGradientBucketBuffer.back()->_pSysData);
+        cudaEvent_t event;
+        status                              = cudaEventCreateWithFlags(&event, cudaEventDisableTiming);
+        RTERROR(status, "NNNetwork::AllocateGradientBuckets: Unable to create bucket event");
+        _vGradientBucketEvent.push_back(event);
+    }
+    _pGradientReducer->SetCompression(_gradientCompression, _gradientCompressionRatio);
+    status                                  = cudaEventCreateWithFlags(&_gradientReadyEvent, cudaEventDisableTiming);
+    RTERROR(status, "NNNetwork::AllocateGradientBuckets: Unable to create gradient event");
+    status                                  = cudaStreamCreateWithFlags(&_gradientStream, cudaStreamNonBlocking);
+    RTERROR(status, "NNNetwork::AllocateGradientBuckets: Unable to create gradient stream");
+    if (getGpu()._id == 0)
+        printf("NNNetwork::AllocateGradientBuckets: Reducing %lu replicated gradients in %u buckets.\n", _vReducedGradient.size(), _pGradientReducer->GetBuckets());
+}
+
+void NNNetwork::DeallocateGradientBuckets()
+{
+    if (_pGradientReducer == NULL)
+        return;
+    delete _pGradientReducer;
+    _pGradientReducer                       = NULL;
+    _vReducedGradient.clear();
+    for (size_t i = 0; i < _vGradientBucketBuffer.size(); i++)
+    {
+        delete _vGradientBucketBuffer[i];
+        cudaEventDestroy(_vGradientBucketEvent[i]);
+    }
+    _vGradientBucketBuffer.clear();
+    _vGradientBucketEvent.clear();
+    cudaEventDestroy(_gradientReadyEvent);
+    cudaStreamDestroy(_gradientStream);
+}
+
+// Copies out the buckets completed by this step of backpropagation behind the kernels that calculated them, then
+// starts reducing, in order, every bucket whose copy has already arrived
+void NNNetwork::StageGradients(uint32_t step)
+{
+    if (_pGradientReducer == NULL)
+        return;
+
+    bool bComplete                          = false;
+    for (uint32_t i = 0; i < _pGradientReducer->GetBuckets(); i++)
+        bComplete                          |= (_pGradientReducer->GetBucketStep(i) == step);
+    if (bComplete)
+    {
+        cudaEventRecord(_gradientReadyEvent, 0);
+        cudaStreamWaitEvent(_gradientStream, _gradientReadyEvent, 0);
+        for (auto& g : _vReducedGradient)
+        {
+            uint32_t bucket                 = get<2>(g);
+            if (_pGradientReducer->GetBucketStep(bucket) == step)
+            {
+                cudaError_t status          = cudaMemcpyAsync(_vGradientBucketBuffer[bucket]->_pSysData + get<3>(g), get<0>(g), get<1>(g) * sizeof(NNFloat), cudaMemcpyDeviceToHost, _gradientStream);
+                RTERROR(status, "NNNetwork::StageGradients: Failed to copy gradient to bucket");
+            }
+        }
+        for (uint32_t i = 0; i < _pGradientReducer->GetBuckets(); i++)
+        {
+            if (_pGradientReducer->GetBucketStep(i) == step)
+                cudaEventRecord(_vGradientBucketEvent[i], _gradientStream);
+        }
+    }
+
+    uint32_t bucket;
+    while (((bucket = _pGradientReducer->GetNextBucket()) < _pGradientReducer->GetBuckets()) &&
+           (_pGradientReducer->GetBucketStep(bucket) <= step) && (cudaEventQuery(_vGradientBucketEvent[bucket]) == cudaSuccess))
+        _pGradientReducer->Start();
+    _pGradientReducer->Test();
+}
+
+// Starts the buckets still waiting on their copies, keeping the reductions already in flight moving meanwhile, then
+// waits for all of them and copies the summed gradients back
+void NNNetwork::FinishGradientReduction()
+{
+    if (_pGradientReducer == NULL)
+        return;
+
+    uint32_t bucket;
+    while ((bucket = _pGradientReducer->GetNextBucket()) < _pGradientReducer->GetBuckets())
+    {
+        if (cudaEventQuery(_vGradientBucketEvent[bucket]) == cudaSuccess)
+            _pGradientReducer->Start();
+        else
+            _pGradientReducer->Test();
+    }
+    _pGradientReducer->Wait();
+    for (auto& g : _vReducedGradient)
+    {
+        cudaError_t status                  = cudaMemcpy(get<0>(g), _vGradientBucketBuffer[get<2>(g)]->_pSysData + get<3>(g), get<1>(g) * sizeof(NNFloat), cudaMemcpyHostToDevice);
+        RTERROR(status, "NNNetwork::FinishGradientReduction: Failed to copy reduced gradient");
+    }
+}
+
 std::pair<NNNetwork::Kind, string> NNNetwork::_sKindPair[] =
 {
     std::pair<NNNetwork::Kind, string>(NNNetwork::Kind::FeedForward, "FeedForward"),
@@ -2614,34 +3588,43 @@ uint32_t MPI_Bcast_NNNetworkDescriptor(NNNetworkDescriptor& d)
     MPI_Bcast_string(d._name);   
 
     // Broadcast network (inefficient, but simple and only done once)
-    MPI_Bcast(&d._kind, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._errorFunction, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._maxout_k, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);   
-    MPI_Bcast(&d._LRN_k, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);    
-    MPI_Bcast(&d._LRN_n, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);    
-    MPI_Bcast(&d._LRN_alpha, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);    
-    MPI_Bcast(&d._LRN_beta, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._bSparsenessPenalty, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._sparsenessPenalty_beta, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._sparsenessPenalty_p, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._bDenoising, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._denoising_p, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._deltaBoost_one, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._deltaBoost_zero, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._SMCE_oneScale, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._SMCE_zeroScale, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._SMCE_oneTarget, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._SMCE_zeroTarget, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._checkpoint_interval, 1, MPI_INT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._checkpoint_epochs, 1, MPI_INT32_T, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&d._kind, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._errorFunction, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._maxout_k, 1, MPI_UINT32_T, 0, getGpu()._comm);   
+    MPI_Bcast(&d._LRN_k, 1, MPI_FLOAT, 0, getGpu()._comm);    
+    MPI_Bcast(&d._LRN_n, 1, MPI_UINT32_T, 0, getGpu()._comm);    
+    MPI_Bcast(&d._LRN_alpha, 1, MPI_FLOAT, 0, getGpu()._comm);    
+    MPI_Bcast(&d._LRN_beta, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._bSparsenessPenalty, 1, MPI_C_BOOL, 0, getGpu()._comm);
+    MPI_Bcast(&d._sparsenessPenalty_beta, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._sparsenessPenalty_p, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._bDenoising, 1, MPI_C_BOOL, 0, getGpu()._comm);
+    MPI_Bcast(&d._denoising_p, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._deltaBoost_one, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._deltaBoost_zero, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._SMCE_oneScale, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._SMCE_zeroScale, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._SMCE_oneTarget, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._SMCE_zeroTarget, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._checkpoint_interval, 1, MPI_INT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._checkpoint_epochs, 1, MPI_INT32_T, 0, getGpu()._comm);
     MPI_Bcast_string(d._checkpoint_name);
-    MPI_Bcast(&d._bShuffleIndices, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&d._bShuffleIndices, 1, MPI_C_BOOL, 0, getGpu()._comm);
+    MPI_Bcast(&d._trainingMode, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._epochs, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._movingAverageError, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._brakeSteps, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._initSteps, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._bestValidationError, 1, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast(&d._validationStalls, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._validationEpochs, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._randomSeed, 1, MPI_UINT64_T, 0, getGpu()._comm);
     
 
 
     // Broadcast layers
     uint32_t layers                             = d._vLayerDescriptor.size();
-    MPI_Bcast(&layers, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&layers, 1, MPI_UINT32_T, 0, getGpu()._comm);
     d._vLayerDescriptor.resize(layers);
     for (uint32_t i = 0; i < layers; i++)
     {
@@ -2650,7 +3633,7 @@ uint32_t MPI_Bcast_NNNetworkDescriptor(NNNetworkDescriptor& d)
     
     // Broadcast weights if present
     uint32_t weights                            = d._vWeightDescriptor.size();
-    MPI_Bcast(&weights, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&weights, 1, MPI_UINT32_T, 0, getGpu()._comm);
     d._vWeightDescriptor.resize(weights);
     
     for (uint32_t i = 0; i < weights; i++)
@@ -2661,10 +3644,116 @@ uint32_t MPI_Bcast_NNNetworkDescriptor(NNNetworkDescriptor& d)
     return 0;
 }
 
-NNNetwork* LoadNeuralNetworkJSON(const string& fname, const uint32_t batch, const vector<NNDataSetBase*>& vDataSet)
+void SaveNNNetworkDescriptorBinary(NNBinaryWriter& w, const NNNetworkDescriptor& d)
+{
+    w.Write(d._name);
+    w.Write(d._kind);
+    w.Write(d._errorFunction);
+    w.Write(d._maxout_k);
+    w.Write(d._LRN_k);
+    w.Write(d._LRN_n);
+    w.Write(d._LRN_alpha);
+    w.Write(d._LRN_beta);
+    w.Write(d._bSparsenessPenalty);
+    w.Write(d._sparsenessPenalty_beta);
+    w.Write(d._sparsenessPenalty_p);
+    w.Write(d._bDenoising);
+    w.Write(d._denoising_p);
+    w.Write(d._deltaBoost_one);
+    w.Write(d._deltaBoost_zero);
+    w.Write(d._SMCE_oneScale);
+    w.Write(d._SMCE_zeroScale);
+    w.Write(d._SMCE_oneTarget);
+    w.Write(d._SMCE_zeroTarget);
+    w.Write(d._checkpoint_interval);
+    w.Write(d._checkpoint_epochs);
+    w.Write(d._checkpoint_name);
+    w.Write(d._bShuffleIndices);
+    w.Write(d._trainingMode);
+    w.Write(d._epochs);
+    w.Write(d._movingAverageError);
+    w.Write(d._brakeSteps);
+    w.Write(d._initSteps);
+    w.Write(d._bestValidationError);
+    w.Write(d._validationStalls);
+    w.Write(d._validationEpochs);
+    w.Write(d._randomSeed);
+    w.Write(d._bConvLayersCalculated);
+
+    w.Write((uint32_t)d._vLayerDescriptor.size());
+    for (const NNLayerDescriptor& ld : d._vLayerDescriptor)
+        SaveNNLayerDescriptorBinary(w, ld);
+    w.Write((uint32_t)d._vWeightDescriptor.size());
+    for (const NNWeightDescriptor& wd : d._vWeightDescriptor)
+        SaveNNWeightDescriptorBinary(w, wd);
+}
+
+bool LoadNNNetworkDescriptorBinary(NNBinaryReader& r, NNNetworkDescriptor& d)
+{
+    r.Read(d._name);
+    r.Read(d._kind);
+    r.Read(d._errorFunction);
+    r.Read(d._maxout_k);
+    r.Read(d._LRN_k);
+    r.Read(d._LRN_n);
+    r.Read(d._LRN_alpha);
+    r.Read(d._LRN_beta);
+    r.Read(d._bSparsenessPenalty);
+    r.Read(d._sparsenessPenalty_beta);
+    r.Read(d._sparsenessPenalty_p);
+    r.Read(d._bDenoising);
+    r.Read(d._denoising_p);
+    r.Read(d._deltaBoost_one);
+    r.Read(d._deltaBoost_zero);
+    r.Read(d._SMCE_oneScale);
+    r.Read(d._SMCE_zeroScale);
+    r.Read(d._SMCE_oneTarget);
+    r.Read(d._SMCE_zeroTarget);
+    r.Read(d._checkpoint_interval);
+    r.Read(d._checkpoint_epochs);
+    r.Read(d._checkpoint_name);
+    r.Read(d._bShuffleIndices);
+    r.Read(d._trainingMode);
+    r.Read(d._epochs);
+    r.Read(d._movingAverageError);
+    r.Read(d._brakeSteps);
+    r.Read(d._initSteps);
+    r.Read(d._bestValidationError);
+    r.Read(d._validationStalls);
+    r.Read(d._validationEpochs);
+    r.Read(d._randomSeed);
+    r.Read(d._bConvLayersCalculated);
+
+    // Bound counts by the data left so a corrupt count can't trigger a huge allocation
+    uint32_t layers                             = 0;
+    r.Read(layers);
+    if (!r.IsValid() || (layers > r.GetRemaining()))
+        return false;
+    d._vLayerDescriptor.resize(layers);
+    for (uint32_t i = 0; i < layers; i++)
+    {
+        if (!LoadNNLayerDescriptorBinary(r, d._vLayerDescriptor[i]))
+            return false;
+    }
+
+    uint32_t weights                            = 0;
+    r.Read(weights);
+    if (!r.IsValid() || (weights > r.GetRemaining()))
+        return false;
+    d._vWeightDescriptor.resize(weights);
+    for (uint32_t i = 0; i < weights; i++)
+    {
+        if (!LoadNNWeightDescriptorBinary(r, d._vWeightDescriptor[i]))
+            return false;
+    }
+    return true;
+}
+
+// Builds the fully resolved descriptor of the network a JSON config describes, sizing automatically sized layers
+// from vDataSet and deriving convolution and pooling layer dimensions.  Only process 0 parses the config, which it
+// reports the validity of, CreateNeuralNetwork broadcasting the descriptor to the others
+bool LoadNNNetworkDescriptorJSON(const string& fname, const vector<NNDataSetBase*>& vDataSet, NNNetworkDescriptor& nd)
 {
-    NNNetwork* pNetwork                             = NULL;
-    NNNetworkDescriptor nd;
     Json::Value index;
     Json::Reader reader;
     bool bValid                                     = true;
@@ -3540,32 +4629,234 @@ NNNetwork* LoadNeuralNetworkJSON(const string& fname, const uint32_t batch, cons
     // Calculate dimensions for unspecified convolution and pooling layers
     CalculateConvolutionLayerDimensions(nd);
 
-    // Check for success, shut down upon failure
 exit:
-    MPI_Bcast(&bValid, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
-    if (!bValid)
-    {    
-        getGpu().Shutdown();
-        exit(-1);
+    return bValid;
+}
+
+// Compiled descriptor caches hold a header followed by the binary network descriptor.  They are named and keyed by a
+// hash of everything the descriptor is derived from, the JSON config and the dimensions of the data sets it's sized
+// from, so any change to either simply misses the cache
+static const char DescriptorCacheMagic[8]       = { 'D', 'S', 'S', 'T', 'N', 'E', 'N', 'D' };
+static const uint32_t DescriptorCacheVersion    = 3;
+
+struct NNDescriptorCacheHeader
+{
+    char                        _magic[8];                  // DescriptorCacheMagic
+    uint32_t                    _version;                   // DescriptorCacheVersion
+    uint32_t                    _floatSize;                 // sizeof(NNFloat)
+    uint64_t                    _key;                       // Hash of config and data set dimensions
+    uint64_t                    _size;                      // Size of descriptor following header
+};
+
+// 64-bit FNV-1a
+static uint64_t HashBytes(uint64_t hash, const void* pData, size_t size)
+{
+    const unsigned char* p                      = (const unsigned char*)pData;
+    for (size_t i = 0; i < size; i++)
+        hash                                    = (hash ^ p[i]) * 1099511628211ull;
+    return hash;
+}
+
+// Returns the key of the descriptor built from config fname and data sets vDataSet, false if fname can't be read
+static bool GetDescriptorCacheKey(const string& fname, const vector<NNDataSetBase*>& vDataSet, uint64_t& key)
+{
+    std::ifstream stream(fname, std::ifstream::binary);
+    if (!stream)
+        return false;
+    string config((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+    key                                         = 14695981039346656037ull;
+    key                                         = HashBytes(key, &DescriptorCacheVersion, sizeof(DescriptorCacheVersion));
+    key                                         = HashBytes(key, &NN_VERSION, sizeof(NN_VERSION));
+    key                                         = HashBytes(key, config.data(), config.size());
+    for (auto p : vDataSet)
+    {
+        key                                     = HashBytes(key, p->_name.data(), p->_name.size() + 1);
+        key                                     = HashBytes(key, &p->_dimensions, sizeof(p->_dimensions));
+        key                                     = HashBytes(key, &p->_width, sizeof(p->_width));
+        key                                     = HashBytes(key, &p->_height, sizeof(p->_height));
+        key                                     = HashBytes(key, &p->_length, sizeof(p->_length));
     }
-    
+    return true;
+}
+
+static bool LoadDescriptorCache(const string& fname, uint64_t key, NNNetworkDescriptor& nd)
+{
+    FILE* fp                                    = fopen(fname.c_str(), "rb");
+    if (fp == NULL)
+        return false;
 
+    NNDescriptorCacheHeader header;
+    vector<char> vBuffer;
+    bool bResult                                = (fread(&header, sizeof(header), 1, fp) == 1) &&
+                                                  (memcmp(header._magic, DescriptorCacheMagic, sizeof(DescriptorCacheMagic)) == 0) &&
+                                                  (header._version == DescriptorCacheVersion) && (header._floatSize == sizeof(NNFloat)) &&
+                                                  (header._key == key) && (header._size < (1ull << 32));
+    if (bResult)
+    {
+        vBuffer.resize(header._size);
+        bResult                                 = (fread(vBuffer.data(), 1, vBuffer.size(), fp) == vBuffer.size());
+    }
+    fclose(fp);
+
+    // A stale or damaged cache is simply rebuilt
+    NNNetworkDescriptor d;
+    NNBinaryReader r(vBuffer.data(), vBuffer.size());
+    if (!bResult || !LoadNNNetworkDescriptorBinary(r, d) || (r.GetRemaining() != 0))
+        return false;
+    nd                                          = d;
+    return true;
+}
+
+// Written to a temporary file renamed into place so concurrent jobs sharing the cache never read a partial one
+static void SaveDescriptorCache(const string& fname, uint64_t key, const NNNetworkDescriptor& nd)
+{
+    NNBinaryWriter w;
+    SaveNNNetworkDescriptorBinary(w, nd);
+
+    NNDescriptorCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header._magic, DescriptorCacheMagic, sizeof(header._magic));
+    header._version                             = DescriptorCacheVersion;
+    header._floatSize                           = sizeof(NNFloat);
+    header._key                                 = key;
+    header._size                                = w.GetBuffer().size();
+
+    string tempname                             = fname + ".tmp" + to_string(getpid());
+    FILE* fp                                    = fopen(tempname.c_str(), "wb");
+    if (fp == NULL)
+    {
+        printf("LoadNeuralNetworkJSON: Unable to write network descriptor cache %s.\n", fname.c_str());
+        return;
+    }
+    bool bResult                                = (fwrite(&header, sizeof(header), 1, fp) == 1) &&
+                                                  (fwrite(w.GetBuffer().data(), 1, w.GetBuffer().size(), fp) == w.GetBuffer().size());
+    bResult                                     = (fclose(fp) == 0) && bResult;
+    if (!bResult || (rename(tempname.c_str(), fname.c_str()) != 0))
+    {
+        printf("LoadNeuralNetworkJSON: Unable to write network descriptor cache %s.\n", fname.c_str());
+        remove(tempname.c_str());
+    }
+}
+
+// Broadcasts a descriptor built on process 0 and instantiates the network it describes on every process
+NNNetwork* CreateNeuralNetwork(NNNetworkDescriptor& nd, const uint32_t batch)
+{
     MPI_Bcast_NNNetworkDescriptor(nd);
     
     // Enumerate network
     if (getGpu()._id == 0)
     {
-        cout << "LoadNeuralNetworkJSON: Enumerating network:" << endl;
+        cout << "CreateNeuralNetwork: Enumerating network:" << endl;
         cout << nd << endl;
     }
     
     // Now create network;
-    pNetwork                                            = new NNNetwork(nd, batch);
+    NNNetwork* pNetwork                                 = new NNNetwork(nd, batch);
     pNetwork->RefreshState();
     return pNetwork;
 }
 
-NNNetwork* LoadNeuralNetworkNetCDF(const string& fname, const uint32_t batch)
+// Builds the descriptor of JSON config fname sized from vDataSet like LoadNNNetworkDescriptorJSON.  If cacheDirectory
+// is set, descriptors are compiled to binary caches there so later runs with the same config and data sets, such as
+// repeated hyperparameter sweep jobs, skip parsing the config and deriving the network's layout.  bCached reports
+// whether nd came from a cache
+bool LoadNNNetworkDescriptorCached(const string& fname, const vector<NNDataSetBase*>& vDataSet, const string& cacheDirectory, NNNetworkDescriptor& nd, bool& bCached)
+{
+    uint64_t key                                        = 0;
+    string cacheName;
+    if (!cacheDirectory.empty() && GetDescriptorCacheKey(fname, vDataSet, key))
+    {
+        std::ostringstream os;
+        os << cacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".nnd";
+        cacheName                                       = os.str();
+    }
+
+    bCached                                             = !cacheName.empty() && LoadDescriptorCache(cacheName, key, nd);
+    if (bCached)
+    {
+        printf("LoadNeuralNetworkJSON: Using network descriptor cache %s.\n", cacheName.c_str());
+        return true;
+    }
+    bool bValid                                         = LoadNNNetworkDescriptorJSON(fname, vDataSet, nd);
+    if (bValid && !cacheName.empty())
+        SaveDescriptorCache(cacheName, key, nd);
+    return bValid;
+}
+
+// Loads a network from a JSON config, through a descriptor cache in cacheDirectory if set (see
+// LoadNNNetworkDescriptorCached)
+NNNetwork* LoadNeuralNetworkJSON(const string& fname, const uint32_t batch, const vector<NNDataSetBase*>& vDataSet, const string& cacheDirectory)
+{
+    NNNetworkDescriptor nd;
+    bool bValid                                         = true;
+
+    if (getGpu()._id == 0)
+    {
+        bool bCached                                    = false;
+        bValid                                          = LoadNNNetworkDescriptorCached(fname, vDataSet, cacheDirectory, nd, bCached);
+    }
+
+    // Check for success, shut down upon failure
+    MPI_Bcast(&bValid, 1, MPI_C_BOOL, 0, getGpu()._comm);
+    if (!bValid)
+    {    
+        getGpu().Shutdown();
+        exit(-1);
+    }
+
+    return CreateNeuralNetwork(nd, batch);
+}
+
+// Grows input and output layers to the width of their data sets, e.g. after generateNetCDF -m has merged
+// new features into the feature index.  Trained weights and biases are kept and the rows and columns of
+// new units are initialized by each layer's weight initialization when the network is constructed
+bool GrowLayersToDataSets(NNNetworkDescriptor& d, const vector<NNDataSetBase*>& vDataSet)
+{
+    map<string, uint64_t> mStride;
+    bool bGrown                                 = false;
+    for (auto& ld : d._vLayerDescriptor)
+    {
+        mStride[ld._name]                       = (uint64_t)ld._Nx * ld._Ny * ld._Nz * ld._Nw;
+        if ((ld._kind != NNLayer::Kind::Input) && (ld._kind != NNLayer::Kind::Output))
+            continue;
+            
+        for (auto p : vDataSet)
+        {
+            if ((p->_name != ld._dataSet) || (p->_width == ld._Nx))
+                continue;
+                
+            // Only flat fully connected layers can grow without reshuffling existing units
+            if ((p->_width < ld._Nx) || (p->_dimensions != 1) || (ld._type != NNLayer::Type::FullyConnected) || (ld._Ny * ld._Nz * ld._Nw != 1))
+            {
+                if (getGpu()._id == 0)
+                    printf("GrowLayersToDataSets: Unable to resize layer %s from %u to %u units to match data set %s.\n", ld._name.c_str(), ld._Nx, p->_width, p->_name.c_str());
+                return false;
+            }
+            if (getGpu()._id == 0)
+                printf("GrowLayersToDataSets: Growing layer %s from %u to %u units to match data set %s.\n", ld._name.c_str(), ld._Nx, p->_width, p->_name.c_str());
+            ld._Nx                              = p->_width;
+            bGrown                              = true;
+        }
+    }
+    
+    // Record layer sizes weights were trained with.  Optimizer state doesn't carry over to the grown network
+    if (bGrown)
+    {
+        for (auto& wd : d._vWeightDescriptor)
+        {
+            wd._inputStride                     = mStride[wd._inputLayer];
+            wd._outputStride                    = mStride[wd._outputLayer];
+            wd._vWeightVelocity.clear();
+            wd._vBiasVelocity.clear();
+            wd._vWeightGradientVelocity.clear();
+            wd._vBiasGradientVelocity.clear();
+        }
+    }
+    return true;
+}
+
+NNNetwork* LoadNeuralNetworkNetCDF(const string& fname, const uint32_t batch, const vector<NNDataSetBase*>& vDataSet)
 {
     NNNetwork* pNetwork                         = NULL;
     NNNetworkDescriptor nd;
@@ -3776,6 +5067,51 @@ NNNetwork* LoadNeuralNetworkNetCDF(const string& fname, const uint32_t batch)
             shuffleIndicesAtt.getValues(&bShuffleIndices);
             nd._bShuffleIndices                 = (bShuffleIndices != 0);
 
+            // Read training state, only present in training checkpoints
+            NcGroupAtt trainingModeAtt          = nc.getAtt("trainingMode");
+            if (!trainingModeAtt.isNull())
+            {
+                uint32_t trainingMode;
+                trainingModeAtt.getValues(&trainingMode);
+                nd._trainingMode                = (TrainingMode)trainingMode;
+            }
+
+            NcGroupAtt epochsAtt                = nc.getAtt("epochs");
+            if (!epochsAtt.isNull())
+                epochsAtt.getValues(&(nd._epochs));
+
+            NcGroupAtt movingAverageErrorAtt    = nc.getAtt("movingAverageError");
+            if (!movingAverageErrorAtt.isNull())
+                movingAverageErrorAtt.getValues(&(nd._movingAverageError));
+
+            NcGroupAtt brakeStepsAtt            = nc.getAtt("brakeSteps");
+            if (!brakeStepsAtt.isNull())
+                brakeStepsAtt.getValues(&(nd._brakeSteps));
+
+            NcGroupAtt initStepsAtt             = nc.getAtt("initSteps");
+            if (!initStepsAtt.isNull())
+                initStepsAtt.getValues(&(nd._initSteps));
+
+            NcGroupAtt bestValidationErrorAtt   = nc.getAtt("bestValidationError");
+            if (!bestValidationErrorAtt.isNull())
+                bestValidationErrorAtt.getValues(&(nd._bestValidationError));
+
+            NcGroupAtt validationStallsAtt      = nc.getAtt("validationStalls");
+            if (!validationStallsAtt.isNull())
+                validationStallsAtt.getValues(&(nd._validationStalls));
+
+            NcGroupAtt validationEpochsAtt      = nc.getAtt("validationEpochs");
+            if (!validationEpochsAtt.isNull())
+                validationEpochsAtt.getValues(&(nd._validationEpochs));
+
+            NcGroupAtt randomSeedAtt            = nc.getAtt("randomSeed");
+            if (!randomSeedAtt.isNull())
+            {
+                unsigned long long int randomSeed;
+                randomSeedAtt.getValues(&randomSeed);
+                nd._randomSeed                  = randomSeed;
+            }
+
             // Read network layer count
             NcGroupAtt layersAtt                = nc.getAtt("layers");
             if (layersAtt.isNull())
@@ -3833,7 +5169,7 @@ NNNetwork* LoadNeuralNetworkNetCDF(const string& fname, const uint32_t batch)
     }   
 
     // Gather and test on result
-    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, getGpu()._comm);
     if (!bResult)
     {
         getGpu().Shutdown();
@@ -3842,6 +5178,13 @@ NNNetwork* LoadNeuralNetworkNetCDF(const string& fname, const uint32_t batch)
 
     // Finally build network from descriptor and return
     MPI_Bcast_NNNetworkDescriptor(nd);
+
+    // Grow input and output layers if data sets have gained features since network was saved
+    if (!GrowLayersToDataSets(nd, vDataSet))
+    {
+        getGpu().Shutdown();
+        exit(-1);
+    }
     
     // Enumerate network
     if (getGpu()._id == 0)
@@ -3853,6 +5196,148 @@ NNNetwork* LoadNeuralNetworkNetCDF(const string& fname, const uint32_t batch)
     // Create network
     pNetwork                                    = new NNNetwork(nd, batch);
     pNetwork->RefreshState();
+
+    // Resume the random number streams of the run that wrote a training checkpoint
+    if (nd._epochs > 0)
+        getGpu().SetRandomSeed(nd._randomSeed);
+    return pNetwork;
+}
+
+// Parses the header, descriptor and blob table of the fileSize byte model file at pFile, checking that it is a
+// complete file of this version and that every blob lies within it, so truncated or corrupt files are rejected
+// rather than misread
+bool ReadModelFile(const string& fname, const char* pFile, uint64_t fileSize, NNNetworkDescriptor& nd, vector<NNModelBlob>& vBlob)
+{
+    const NNModelFileHeader* pHeader            = (const NNModelFileHeader*)pFile;
+    if ((fileSize < sizeof(NNModelFileHeader)) || (memcmp(pHeader->_magic, ModelFileMagic, sizeof(ModelFileMagic)) != 0) ||
+        (pHeader->_version != ModelFileVersion) || (pHeader->_floatSize != sizeof(NNFloat)) || (pHeader->_fileSize > fileSize) ||
+        (pHeader->_metadataSize > fileSize - sizeof(NNModelFileHeader)))
+    {
+        printf("LoadNeuralNetworkModel: %s is not a valid version %u model file or is truncated.\n", fname.c_str(), ModelFileVersion);
+        return false;
+    }
+
+    NNBinaryReader r(pFile + sizeof(NNModelFileHeader), pHeader->_metadataSize);
+    bool bResult                                = LoadNNNetworkDescriptorBinary(r, nd);
+    vBlob.resize(nd._vWeightDescriptor.size());
+    for (auto& b : vBlob)
+        r.Read(b);
+    bResult                                     = bResult && r.IsValid();
+
+    // Check that every blob lies within the file
+    for (auto& b : vBlob)
+    {
+        if ((b._weightOffset > fileSize) || (b._weights > (fileSize - b._weightOffset) / sizeof(NNFloat)) ||
+            (b._biasOffset > fileSize) || (b._biases > (fileSize - b._biasOffset) / sizeof(NNFloat)) ||
+            (b._weightOffset % ModelBlobAlignment != 0) || (b._biasOffset % ModelBlobAlignment != 0))
+            bResult                             = false;
+    }
+    if (!bResult)
+        printf("LoadNeuralNetworkModel: Corrupt descriptor in model file %s.\n", fname.c_str());
+    return bResult;
+}
+
+// Loads a compact model file written by NNNetwork::SaveModel.  Every process maps the file itself, so it must be
+// visible to all of them, parses the small descriptor locally and uploads its own weight shards straight from the
+// mapping, so no process ever holds a full copy of the weights in host memory
+NNNetwork* LoadNeuralNetworkModel(const string& fname, const uint32_t batch, const vector<NNDataSetBase*>& vDataSet)
+{
+    NNNetwork* pNetwork                         = NULL;
+    NNNetworkDescriptor nd;
+    vector<NNModelBlob> vBlob;
+    bool bResult                                = true;
+
+    // Map file read-only, the mapping outliving the descriptor
+    const char* pFile                           = NULL;
+    uint64_t fileSize                           = 0;
+    int fd                                      = open(fname.c_str(), O_RDONLY);
+    struct stat st;
+    if ((fd < 0) || (fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(NNModelFileHeader)))
+    {
+        printf("LoadNeuralNetworkModel: Process %d unable to open model file %s.\n", getGpu()._id, fname.c_str());
+        bResult                                 = false;
+    }
+    else
+    {
+        fileSize                                = st.st_size;
+        void* pMap                              = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (pMap == MAP_FAILED)
+        {
+            printf("LoadNeuralNetworkModel: Process %d unable to map model file %s.\n", getGpu()._id, fname.c_str());
+            bResult                             = false;
+        }
+        else
+        {
+            pFile                               = (const char*)pMap;
+            madvise(pMap, fileSize, MADV_WILLNEED);
+        }
+    }
+    if (fd >= 0)
+        close(fd);
+
+    // Read header, descriptor and blob table
+    bResult                                     = bResult && ReadModelFile(fname, pFile, fileSize, nd, vBlob);
+
+    // Gather and test on result
+    MPI_Allreduce(MPI_IN_PLACE, &bResult, 1, MPI_C_BOOL, MPI_LAND, getGpu()._comm);
+    if (!bResult)
+    {
+        if (pFile)
+            munmap((void*)pFile, fileSize);
+        getGpu().Shutdown();
+        exit(-1);
+    }
+
+    // Grow input and output layers if data sets have gained features since network was saved
+    if (!GrowLayersToDataSets(nd, vDataSet))
+    {
+        getGpu().Shutdown();
+        exit(-1);
+    }
+
+    // Weights trained before layers grew are copied to make room for new units, which needs them in the descriptor
+    for (size_t i = 0; i < vBlob.size(); i++)
+    {
+        NNWeightDescriptor& wd                  = nd._vWeightDescriptor[i];
+        if (wd._inputStride != 0)
+        {
+            const NNFloat* pWeight              = (const NNFloat*)(pFile + vBlob[i]._weightOffset);
+            const NNFloat* pBias                = (const NNFloat*)(pFile + vBlob[i]._biasOffset);
+            wd._vWeight.assign(pWeight, pWeight + vBlob[i]._weights);
+            wd._vBias.assign(pBias, pBias + vBlob[i]._biases);
+        }
+    }
+
+    // Enumerate network
+    if (getGpu()._id == 0)
+    {
+        cout << "LoadNeuralNetworkModel: Enumerating network:" << endl;
+        cout << nd << endl;
+    }
+
+    // Create network, then overwrite its initial weights with this process's shards of the mapped ones
+    pNetwork                                    = new NNNetwork(nd, batch);
+    for (size_t i = 0; i < vBlob.size(); i++)
+    {
+        NNWeight* pWeight                       = pNetwork->_vWeight[i];
+        if (nd._vWeightDescriptor[i]._inputStride != 0)
+            continue;
+        if (!pWeight->_bShared && (vBlob[i]._weights != 0))
+            bResult                             = bResult && pWeight->UploadShardedWeights((const NNFloat*)(pFile + vBlob[i]._weightOffset), vBlob[i]._weights);
+        if (vBlob[i]._biases != 0)
+            bResult                             = bResult && pWeight->UploadShardedBiases((const NNFloat*)(pFile + vBlob[i]._biasOffset), vBlob[i]._biases);
+    }
+    munmap((void*)pFile, fileSize);
+    if (!bResult)
+    {
+        getGpu().Shutdown();
+        exit(-1);
+    }
+    pNetwork->RefreshState();
+
+    // Resume the random number streams of the run that wrote a training checkpoint
+    if (nd._epochs > 0)
+        getGpu().SetRandomSeed(nd._randomSeed);
     return pNetwork;
 }
 
@@ -3874,7 +5359,7 @@ bool NNNetwork::P2P_Bcast(void* pBuffer, size_t size)
                     RTERROR(status, "NNNetwork::P2P_Bcast: Failure to copy source data to P2P backbuffer");
                 }
                 cudaDeviceSynchronize();
-                MPI_Barrier(MPI_COMM_WORLD);
+                MPI_Barrier(getGpu()._comm);
             }
             else // Scatter data to all other CPUs in numprocs chunks for numprocs * 2 - 2 stages
             {
@@ -3902,7 +5387,7 @@ bool NNNetwork::P2P_Bcast(void* pBuffer, size_t size)
                     
                     // Wait for all copies to complete
                     cudaDeviceSynchronize();
-                    MPI_Barrier(MPI_COMM_WORLD);                
+                    MPI_Barrier(getGpu()._comm);                
                 }
             }
 
@@ -3916,7 +5401,7 @@ bool NNNetwork::P2P_Bcast(void* pBuffer, size_t size)
         else
         {
             cudaMemcpy(_pCPUBuffer, pBuffer, size, cudaMemcpyDefault);
-            MPI_Bcast(_pCPUBuffer, size, MPI_BYTE, 0, MPI_COMM_WORLD);
+            MPI_Bcast(_pCPUBuffer, size, MPI_BYTE, 0, getGpu()._comm);
             cudaMemcpy(pBuffer, _pCPUBuffer, size, cudaMemcpyDefault);           
         }
     }
@@ -3936,7 +5421,7 @@ bool NNNetwork::P2P_Allreduce(NNFloat* pBuffer, size_t size)
             {
                 cudaMemcpy(GetPeerBuffer(), pBuffer, size * sizeof(NNFloat), cudaMemcpyDefault);
                 cudaDeviceSynchronize();
-                MPI_Barrier(MPI_COMM_WORLD);
+                MPI_Barrier(getGpu()._comm);
                 kAddBuffers(pBuffer, GetP2PReceiveBuffer(), size);
             }
             else
@@ -3957,7 +5442,7 @@ bool NNNetwork::P2P_Allreduce(NNFloat* pBuffer, size_t size)
                    
                     // Wait for completion
                     cudaDeviceSynchronize();              
-                    MPI_Barrier(MPI_COMM_WORLD);
+                    MPI_Barrier(getGpu()._comm);
                     SwapPeerBuffers();
                     segment                             = (segment + 1) % getGpu()._numprocs;
                     start                               = (size * segment) / getGpu()._numprocs;
@@ -3973,7 +5458,7 @@ bool NNNetwork::P2P_Allreduce(NNFloat* pBuffer, size_t size)
                    
                     // Wait for completion  
                     cudaDeviceSynchronize();              
-                    MPI_Barrier(MPI_COMM_WORLD);
+                    MPI_Barrier(getGpu()._comm);
                     SwapPeerBuffers();
                     segment                             = (segment + 1) % getGpu()._numprocs;
                     start                               = (size * segment) / getGpu()._numprocs;
@@ -3989,7 +5474,7 @@ bool NNNetwork::P2P_Allreduce(NNFloat* pBuffer, size_t size)
             // run a bajillion GPUs over MPI, not very efficiently, but you could have
             // thousands of GPUs if you so desired.
             cudaMemcpy(_pCPUBuffer, pBuffer, size * sizeof(NNFloat), cudaMemcpyDefault);
-            MPI_Allreduce(MPI_IN_PLACE, _pCPUBuffer, size, MPI_NNFLOAT, MPI_SUM, MPI_COMM_WORLD);
+            MPI_Allreduce(MPI_IN_PLACE, _pCPUBuffer, size, MPI_NNFLOAT, MPI_SUM, getGpu()._comm);
             cudaMemcpy(pBuffer, _pCPUBuffer, size * sizeof(NNFloat), cudaMemcpyDefault);
         }
     }
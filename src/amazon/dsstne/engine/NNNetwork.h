@@ -27,8 +27,9 @@ public:
     static std::map<NNNetwork::Kind, string> _sKindMap;
     
 private:
-    friend NNNetwork* LoadNeuralNetworkJSON(const string& fname, const uint32_t batch, const vector<NNDataSetBase*>& vDataSet);
-    friend NNNetwork* LoadNeuralNetworkNetCDF(const string& fname, const uint32_t batch);
+    friend NNNetwork* CreateNeuralNetwork(NNNetworkDescriptor& nd, const uint32_t batch);
+    friend NNNetwork* LoadNeuralNetworkNetCDF(const string& fname, const uint32_t batch, const vector<NNDataSetBase*>& vDataSet);
+    friend NNNetwork* LoadNeuralNetworkModel(const string& fname, const uint32_t batch, const vector<NNDataSetBase*>& vDataSet);
     friend NNNetwork* ImportAutoEncoder(const string& fname, uint32_t batch);
     string                      _name;                      // ASCII name for network
     uint32_t                    _batch;                     // Overall batch size
@@ -84,6 +85,33 @@ private:
     string                      _checkpoint_name;           // Name of checkpoint file
     int32_t                     _checkpoint_interval;       // Number of epochs between training checkpoints
     int32_t                     _checkpoint_epochs;         // Number of epochs since last checkpoint written
+    std::thread                 _checkpointThread;          // Background thread writing most recent checkpoint
+    NNNetworkDescriptor*        _pCheckpointDescriptor;     // Host staging copy of checkpoint weights and training state
+    bool                        _bCheckpointResult;         // Result of last background checkpoint write
+
+    // Learning rate schedule
+    LearningRateSchedule        _alphaSchedule;             // Per-epoch learning rate schedule
+    uint32_t                    _alphaInterval;             // Epochs between decays (annealing period for cosine)
+    NNFloat                     _alphaMultiplier;           // Learning rate decay per interval
+    uint32_t                    _alphaWarmup;               // Epochs of linear warmup before schedule starts
+    NNFloat                     _alphaMin;                  // Lower bound on scheduled learning rate
+
+    // Divergence braking, carried across epochs and checkpoints
+    NNFloat                     _movingAverageError;        // Moving average of minibatch training error
+    uint32_t                    _brakeSteps;                // Minibatches left to train at reduced step size
+    uint32_t                    _initSteps;                 // Minibatches left before divergence is checked for
+
+    // Held-out validation and early stopping
+    vector<NNDataSetBase*>      _vValidationData;           // Held-out data sets evaluated during training
+    uint32_t                    _validationInterval;        // Number of epochs between validation passes
+    uint32_t                    _validationEpochs;          // Number of epochs since last validation pass
+    uint32_t                    _validationK;               // K for precision/recall/NDCG@K (0 disables ranking metrics)
+    GpuBuffer<NNFloat>*         _pbValidationKey;           // Top K output values for validation batches
+    GpuBuffer<uint32_t>*        _pbValidationValue;         // Top K output indices for validation batches
+    uint32_t                    _earlyStoppingPatience;     // Validation passes without improvement before stopping (0 disables)
+    NNFloat                     _earlyStoppingMinDelta;     // Minimum decrease in validation error to count as improvement
+    NNFloat                     _bestValidationError;       // Lowest validation error seen so far
+    uint32_t                    _validationStalls;          // Consecutive validation passes without improvement
 
     // Network data
     vector<NNLayer*>            _vLayer;                    // List of all layers in network
@@ -110,6 +138,17 @@ private:
     GpuBuffer<NNFloat>*         _pbP2PBuffer[2];            // Peer buffer for sending/calculating peer data
     NNFloat*                    _pPeerBuffer[2];            // Peer for receiving/reducing peer data
     NNFloat*                    _pCPUBuffer;                // System memory work buffer for MPI copies
+    NNFloat*                    _pCPUReceiveBuffer;         // System memory buffer for segments arriving from MPI ring exchanges
+
+    // Overlapped all-reduce of the weight gradients data-parallel layers replicate on every process
+    NNGradientReducer<NNFloat>* _pGradientReducer;          // Buckets of replicated gradients, reduced while backpropagation continues
+    vector<tuple<NNFloat*, uint64_t, uint32_t, size_t> > _vReducedGradient; // Device gradient, its size, and its bucket and offset within it
+    vector<GpuBuffer<NNFloat>*> _vGradientBucketBuffer;     // Pinned system memory each bucket is staged and reduced in
+    vector<cudaEvent_t>         _vGradientBucketEvent;      // Recorded once each bucket is staged
+    cudaStream_t                _gradientStream;            // Stream copying gradients out while backpropagation continues
+    cudaEvent_t                 _gradientReadyEvent;        // Recorded after each layer's gradients are calculated
+    GradientCompression         _gradientCompression;       // Compression applied to replicated gradient buckets
+    NNFloat                     _gradientCompressionRatio;  // Fraction of each gradient sent by SparseTopK compression
     
     // CUDNN parameters
     size_t                      _CUDNNWorkspaceSize;        // Current size of cuDNN workspace
@@ -139,11 +178,13 @@ public:
     unsigned int GetBatch();
     void SetPosition(uint32_t position);
     uint32_t GetPosition() { return _position; }
+    uint32_t GetEpochs() { return _epochs; }
     void SetTrainingMode(TrainingMode mode);
     void SetShuffleIndices(bool bShuffleIndices);
     void SetCPUValidate(bool bValidate);
     void SetClearVelocity(bool bClear) { _bClearVelocity = bClear; };
     bool SaveNetCDF(const string& fname);
+    bool SaveModel(const string& fname);
 
     // Getters
     NNFloat* GetUnitBuffer(const string& layer);
@@ -162,10 +203,13 @@ public:
     tuple<NNFloat, NNFloat, NNFloat, NNFloat> GetSMCE();                                // Returns oneTarget, zeroTarget, oneScale, zeroScale
     tuple<bool> GetShuffleIndices();                                                    // Returns ShuffleIndices boolean
     tuple<string, int32_t> GetCheckPoint();                                             // Returns Checkpoint name and interval
+    tuple<GradientCompression, NNFloat> GetGradientCompression();                       // Returns gradient compression and ratio
+    tuple<uint32_t, NNFloat> GetSampledOutput();                                        // Returns sampled negatives and power
     NNFloat* GetScratchBuffer(size_t size = 0);                                         // Gets current scratch buffer, resizing if too small
     NNFloat* GetP2PSendBuffer();                                                        // Returns current local send buffer
     NNFloat* GetP2PReceiveBuffer();                                                     // Returns current local receive buffer
     NNFloat* GetP2PCPUBuffer();                                                         // Returns system memory work buffer    
+    NNFloat* GetP2PCPUReceiveBuffer();                                                  // Returns system memory ring receive buffer
     NNFloat* GetPeerBuffer();                                                           // Returns current adjacent peer receive buffer
     NNFloat* GetPeerBackBuffer();                                                       // Returns current adjacent peer send buffer
     bool P2P_Bcast(void* pBuffer, size_t size);                                         // Broadcasts data from process 0 to all other
@@ -180,6 +224,11 @@ public:
     bool SetDeltaBoost(NNFloat one = 1.0f, NNFloat zero = 1.0f);
     bool SetSMCE(NNFloat oneTarget = 0.9f, NNFloat zeroTarget = 0.1f, NNFloat oneScale = 1.0f, NNFloat zeroScale = 1.0f);
     bool SetCheckpoint(string name, int32_t interval);
+    bool SetLearningRateSchedule(LearningRateSchedule schedule, uint32_t interval = 1, NNFloat multiplier = 0.9f, uint32_t warmup = 0, NNFloat minAlpha = 0.0f);
+    bool SetValidationDataSets(vector<NNDataSetBase*>& vData, uint32_t interval = 1, uint32_t k = 0);
+    bool SetEarlyStopping(uint32_t patience = 3, NNFloat minDelta = 0.0f);
+    bool SetGradientCompression(GradientCompression compression, NNFloat ratio = 0.01f);
+    bool SetSampledOutput(uint32_t negatives = 0, NNFloat power = 0.75f);
 
 private:
     void CalculatePropagationOrder();
@@ -187,12 +236,18 @@ private:
     void AllocatePeerBuffers();
     void DeallocatePeerBuffers();
     void SwapPeerBuffers();
+    void AllocateGradientBuckets();
+    void DeallocateGradientBuckets();
+    void StageGradients(uint32_t step);
+    void FinishGradientReduction();
     void LoadBatch();
     void PredictTrainingBatch(uint32_t layers = 0);
     void PredictValidationBatch(uint32_t layers = 0);
     void RefreshShuffleBuffers();
     void ShuffleIndices();
     tuple<NNFloat, NNFloat> CalculateError(NNFloat lambda);
+    NNFloat CalculateScheduledAlpha(NNFloat alpha, uint32_t epoch);
+    tuple<NNFloat, NNFloat, NNFloat, NNFloat> CalculateValidationMetrics();
     void ClearUpdates();
     void BackPropagate(NNFloat alpha);
     void UpdateWeights(NNFloat alpha, NNFloat lambda, NNFloat mu);
@@ -200,6 +255,13 @@ private:
     void RefreshState();
     void Shuffle();
     void SetCUDNNWorkspace(size_t size);
+    void GatherWeights(vector<NNWeightDescriptor>& vWeightDescriptor, bool bVelocity = false);
+    void GetDescriptor(NNNetworkDescriptor& d);
+    void GatherWeightBuffer(NNWeight* pWeight, GpuBuffer<NNFloat>* pBuffer, vector<NNFloat>& vLocalWeight, vector<NNFloat>& vWeight);
+    void GatherBiasBuffer(NNWeight* pWeight, GpuBuffer<NNFloat>* pBuffer, vector<NNFloat>& vLocalBias, vector<NNFloat>& vBias);
+    bool WriteNetCDF(const string& fname, const NNNetworkDescriptor& d, bool bTrainingState = false);
+    bool SaveCheckpoint(const string& fname);
+    bool WaitForCheckpoint();
 };
 
 ostream& operator<< (ostream& out, NNNetwork::Kind& k);
@@ -232,16 +294,42 @@ struct NNNetworkDescriptor
     string                      _checkpoint_name;           // Checkpoint file name
     int32_t                     _checkpoint_interval;       // Number of epochs between checkpoints
     int32_t                     _checkpoint_epochs;         // Number of epochs since last checkpoint
+    TrainingMode                _trainingMode;              // Optimizer in use when checkpoint was written
+    uint32_t                    _epochs;                    // Total epochs trained when checkpoint was written
+    NNFloat                     _movingAverageError;        // Moving average of minibatch training error when checkpoint was written
+    uint32_t                    _brakeSteps;                // Minibatches left to train at reduced step size
+    uint32_t                    _initSteps;                 // Minibatches left before divergence is checked for
+    NNFloat                     _bestValidationError;       // Lowest validation error seen so far
+    uint32_t                    _validationStalls;          // Consecutive validation passes without improvement
+    uint32_t                    _validationEpochs;          // Number of epochs since last validation pass
+    uint64_t                    _randomSeed;                // Random seed of the run that wrote the checkpoint
     bool                        _bConvLayersCalculated;     // Have convolution layer dimensions been calculated?
     NNNetworkDescriptor();
 };
 
+// Locates the values of one weight in a compact model file
+struct NNModelBlob
+{
+    uint64_t                    _weightOffset;              // File offset of weights (0 if shared)
+    uint64_t                    _weights;                   // Number of weights
+    uint64_t                    _biasOffset;                // File offset of biases
+    uint64_t                    _biases;                    // Number of biases
+};
+
 ostream& operator<< (ostream& out, NNNetworkDescriptor& d);
-NNNetwork* LoadNeuralNetworkNetCDF(const string& fname, const uint32_t batch = DefaultBatch);
-NNNetwork* LoadNeuralNetworkJSON(const string &fname, const uint32_t batch = DefaultBatch, const vector<NNDataSetBase*>& vDataSet = vector<NNDataSetBase*>());
+NNNetwork* LoadNeuralNetworkNetCDF(const string& fname, const uint32_t batch = DefaultBatch, const vector<NNDataSetBase*>& vDataSet = vector<NNDataSetBase*>());
+NNNetwork* LoadNeuralNetworkModel(const string& fname, const uint32_t batch = DefaultBatch, const vector<NNDataSetBase*>& vDataSet = vector<NNDataSetBase*>());
+NNNetwork* LoadNeuralNetworkJSON(const string &fname, const uint32_t batch = DefaultBatch, const vector<NNDataSetBase*>& vDataSet = vector<NNDataSetBase*>(), const string& cacheDirectory = "");
+bool LoadNNNetworkDescriptorJSON(const string& fname, const vector<NNDataSetBase*>& vDataSet, NNNetworkDescriptor& nd);
+bool LoadNNNetworkDescriptorCached(const string& fname, const vector<NNDataSetBase*>& vDataSet, const string& cacheDirectory, NNNetworkDescriptor& nd, bool& bCached);
+NNNetwork* CreateNeuralNetwork(NNNetworkDescriptor& nd, const uint32_t batch = DefaultBatch);
 bool SaveNeuralNetworkJSON(const NNNetwork& net, const string& fname);
 bool SaveNeuralNetworkNetCDF(const NNNetwork& net, const string& jname);
 NNNetwork* ImportAutoEncoder(const string& fname, uint32_t batch = DefaultBatch);
+void SaveNNNetworkDescriptorBinary(NNBinaryWriter& w, const NNNetworkDescriptor& d);
+bool LoadNNNetworkDescriptorBinary(NNBinaryReader& r, NNNetworkDescriptor& d);
+bool WriteModelFile(const string& fname, const NNNetworkDescriptor& d);
+bool ReadModelFile(const string& fname, const char* pFile, uint64_t fileSize, NNNetworkDescriptor& nd, vector<NNModelBlob>& vBlob);
 #endif // __NVCC__
 #define NNNETWORK_H
 #endif
@@ -0,0 +1,160 @@
+/*
+
+
+   Copyright 2016  Amazon.com, Inc. or its affiliates. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License"). You may not use this file except in compliance with the License. A copy of the License is located at
+
+   http://aws.amazon.com/apache2.0/
+
+   or in the "license" file accompanying this file. This file is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the License for the specific language governing permissions and limitations under the License.
+ */
+
+#ifndef NNRINGCOLLECTIVES_H
+#define NNRINGCOLLECTIVES_H
+
+#include <mpi.h>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+// Host-side ring collectives over the column slices of a rows x stride row-major matrix, process i owning columns
+// [(stride * i) / numprocs, (stride * (i + 1)) / numprocs) as in model-parallel layers.  Each of the numprocs - 1
+// steps only exchanges one slice with the neighbouring processes through MPI_Isend/MPI_Irecv, so a process never
+// waits on any process but its neighbours and each moves 1/numprocs of the matrix per step
+
+// First column of slice of the slices column slices a width wide matrix is split into, slice i spanning
+// [GetSliceStart(width, i, slices), GetSliceStart(width, i + 1, slices)).  Slice widths differ by at most one, so
+// none is wider than (width + slices - 1) / slices
+inline uint32_t GetSliceStart(uint64_t width, uint32_t slice, uint32_t slices)
+{
+    return (uint32_t)((width * slice) / slices);
+}
+
+// Sends column slice sendSlice to the next process while receiving slice receiveSlice from the previous one, into
+// pReceive packed rows x slice width if set and in place otherwise
+template<typename T> void RingExchangeSlice(T* pBuffer, uint32_t rows, uint32_t stride, uint32_t sendSlice, uint32_t receiveSlice, T* pReceive, MPI_Datatype type, MPI_Comm comm)
+{
+    int id, numprocs;
+    MPI_Comm_rank(comm, &id);
+    MPI_Comm_size(comm, &numprocs);
+    uint32_t sendMinX                   = GetSliceStart(stride, sendSlice, numprocs);
+    uint32_t sendMaxX                   = GetSliceStart(stride, sendSlice + 1, numprocs);
+    uint32_t receiveMinX                = GetSliceStart(stride, receiveSlice, numprocs);
+    uint32_t receiveMaxX                = GetSliceStart(stride, receiveSlice + 1, numprocs);
+
+    MPI_Datatype sendType, receiveType;
+    MPI_Type_vector(rows, sendMaxX - sendMinX, stride, type, &sendType);
+    MPI_Type_commit(&sendType);
+    if (pReceive)
+        MPI_Type_contiguous(rows * (receiveMaxX - receiveMinX), type, &receiveType);
+    else
+        MPI_Type_vector(rows, receiveMaxX - receiveMinX, stride, type, &receiveType);
+    MPI_Type_commit(&receiveType);
+
+    MPI_Request request[2];
+    MPI_Irecv(pReceive ? pReceive : pBuffer + receiveMinX, 1, receiveType, (id + numprocs - 1) % numprocs, 0, comm, &request[0]);
+    MPI_Isend(pBuffer + sendMinX, 1, sendType, (id + 1) % numprocs, 0, comm, &request[1]);
+    MPI_Waitall(2, request, MPI_STATUSES_IGNORE);
+    MPI_Type_free(&sendType);
+    MPI_Type_free(&receiveType);
+}
+
+// Sums the matrix over all processes, leaving only this process's column slice of pBuffer with the total.  pReceive
+// is scratch space for rows x the widest slice
+template<typename T> void RingReduceScatter(T* pBuffer, uint32_t rows, uint32_t stride, T* pReceive, MPI_Datatype type, MPI_Comm comm)
+{
+    int id, numprocs;
+    MPI_Comm_rank(comm, &id);
+    MPI_Comm_size(comm, &numprocs);
+
+    // Pass partial sums around the ring, each process adding its own contribution to the slice it just received
+    // and forwarding it, so after numprocs - 1 steps every process holds the full sum of its own slice
+    for (int step = 0; step < numprocs - 1; step++)
+    {
+        uint32_t sendSlice              = (id + 2 * numprocs - step - 1) % numprocs;
+        uint32_t receiveSlice           = (id + 2 * numprocs - step - 2) % numprocs;
+        RingExchangeSlice(pBuffer, rows, stride, sendSlice, receiveSlice, pReceive, type, comm);
+        uint32_t minX                   = GetSliceStart(stride, receiveSlice, numprocs);
+        uint32_t span                   = GetSliceStart(stride, receiveSlice + 1, numprocs) - minX;
+        for (uint32_t i = 0; i < rows; i++)
+            for (uint32_t j = 0; j < span; j++)
+                pBuffer[(uint64_t)i * stride + minX + j] += pReceive[(uint64_t)i * span + j];
+    }
+}
+
+// Copies every process's column slice of pBuffer to all other processes
+template<typename T> void RingAllGather(T* pBuffer, uint32_t rows, uint32_t stride, MPI_Datatype type, MPI_Comm comm)
+{
+    int id, numprocs;
+    MPI_Comm_rank(comm, &id);
+    MPI_Comm_size(comm, &numprocs);
+
+    // Forward the slice received in the previous step, starting with this process's own
+    for (int step = 0; step < numprocs - 1; step++)
+        RingExchangeSlice(pBuffer, rows, stride, (id + numprocs - step) % numprocs, (id + 2 * numprocs - step - 1) % numprocs, (T*)NULL, type, comm);
+}
+
+// Merges the descending top k keys and their values of each of batch rows found by every process, after which
+// rows [(batch * id) / numprocs, (batch * (id + 1)) / numprocs) of pKey and pValue hold the exact top k over all
+// processes, each process owning the merged results for a disjoint block of rows.  Row blocks travel around the
+// ring like slices in RingReduceScatter, merging the partial list received with the local one at each step, which
+// is exact because the top k of a union is the top k of the merged top k lists of its parts
+template<typename T> void RingMergeTopK(float* pKey, T* pValue, uint32_t batch, uint32_t k, MPI_Datatype valueType, MPI_Comm comm)
+{
+    int id, numprocs;
+    MPI_Comm_rank(comm, &id);
+    MPI_Comm_size(comm, &numprocs);
+    uint32_t maxRows                    = (batch + numprocs - 1) / numprocs;
+    std::vector<float> vReceiveKey((size_t)maxRows * k);
+    std::vector<T> vReceiveValue((size_t)maxRows * k);
+    std::vector<float> vKey(k);
+    std::vector<T> vValue(k);
+
+    for (int step = 0; step < numprocs - 1; step++)
+    {
+        uint32_t sendBlock              = (id + 2 * numprocs - step - 1) % numprocs;
+        uint32_t receiveBlock           = (id + 2 * numprocs - step - 2) % numprocs;
+        uint32_t sendStart              = GetSliceStart(batch, sendBlock, numprocs);
+        uint32_t sendRows               = GetSliceStart(batch, sendBlock + 1, numprocs) - sendStart;
+        uint32_t receiveStart           = GetSliceStart(batch, receiveBlock, numprocs);
+        uint32_t receiveRows            = GetSliceStart(batch, receiveBlock + 1, numprocs) - receiveStart;
+        int previous                    = (id + numprocs - 1) % numprocs;
+        int next                        = (id + 1) % numprocs;
+
+        MPI_Request request[4];
+        MPI_Irecv(vReceiveKey.data(), receiveRows * k, MPI_FLOAT, previous, 0, comm, &request[0]);
+        MPI_Irecv(vReceiveValue.data(), receiveRows * k, valueType, previous, 1, comm, &request[1]);
+        MPI_Isend(pKey + (size_t)sendStart * k, sendRows * k, MPI_FLOAT, next, 0, comm, &request[2]);
+        MPI_Isend(pValue + (size_t)sendStart * k, sendRows * k, valueType, next, 1, comm, &request[3]);
+        MPI_Waitall(4, request, MPI_STATUSES_IGNORE);
+
+        // Merge received lists into local ones
+        for (uint32_t i = 0; i < receiveRows; i++)
+        {
+            float* pRowKey              = pKey + (size_t)(receiveStart + i) * k;
+            T* pRowValue                = pValue + (size_t)(receiveStart + i) * k;
+            const float* pInKey         = vReceiveKey.data() + (size_t)i * k;
+            const T* pInValue           = vReceiveValue.data() + (size_t)i * k;
+            uint32_t a                  = 0;
+            uint32_t b                  = 0;
+            for (uint32_t j = 0; j < k; j++)
+            {
+                if (pRowKey[a] >= pInKey[b])
+                {
+                    vKey[j]             = pRowKey[a];
+                    vValue[j]           = pRowValue[a++];
+                }
+                else
+                {
+                    vKey[j]             = pInKey[b];
+                    vValue[j]           = pInValue[b++];
+                }
+            }
+            std::copy(vKey.begin(), vKey.end(), pRowKey);
+            std::copy(vValue.begin(), vValue.end(), pRowValue);
+        }
+    }
+}
+
+#endif
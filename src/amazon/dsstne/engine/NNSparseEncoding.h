@@ -0,0 +1,98 @@
+/*
+
+
+   Copyright 2016  Amazon.com, Inc. or its affiliates. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License"). You may not use this file except in compliance with the License. A copy of the License is located at
+
+   http://aws.amazon.com/apache2.0/
+
+   or in the "license" file accompanying this file. This file is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the License for the specific language governing permissions and limitations under the License.
+ */
+
+#ifndef NNSPARSEENCODING_H
+#define NNSPARSEENCODING_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Host-side codec for the NNDataSetEnums::DeltaVarint sparse index encoding.  Examples are
+// described by a single offsets array of examples + 1 entries, and the indices of each example
+// are sorted and stored as LEB128 varint deltas from the previous index, restarting from 0 at
+// the start of every example.  Sorted feature indices are mostly close together, so most
+// deltas fit in a single byte instead of 4.
+
+// Encodes sorted per-example indices, replacing the contents of vEncoded
+inline void EncodeSparseIndexDeltaVarint(const uint64_t* pOffset, size_t examples, const uint32_t* pIndex, std::vector<uint8_t>& vEncoded)
+{
+    vEncoded.clear();
+    vEncoded.reserve(pOffset[examples] - pOffset[0]);
+    for (size_t i = 0; i < examples; i++)
+    {
+        uint32_t previous               = 0;
+        for (uint64_t j = pOffset[i]; j < pOffset[i + 1]; j++)
+        {
+            uint32_t delta              = pIndex[j] - previous;
+            previous                    = pIndex[j];
+            while (delta >= 0x80)
+            {
+                vEncoded.push_back((uint8_t)((delta & 0x7f) | 0x80));
+                delta                 >>= 7;
+            }
+            vEncoded.push_back((uint8_t)delta);
+        }
+    }
+}
+
+// Decodes pOffset[examples] - pOffset[0] indices into pIndex, returning false on truncated or
+// malformed input.  Runs of 8 single-byte deltas, the common case, are detected with one 64-bit
+// test and decoded without per-byte branching
+inline bool DecodeSparseIndexDeltaVarint(const uint8_t* pEncoded, size_t encodedSize, const uint64_t* pOffset, size_t examples, uint32_t* pIndex)
+{
+    size_t pos                          = 0;
+    for (size_t i = 0; i < examples; i++)
+    {
+        uint32_t value                  = 0;
+        uint64_t j                      = pOffset[i];
+        uint64_t end                    = pOffset[i + 1];
+        while (j < end)
+        {
+            if ((end - j >= 8) && (pos + 8 <= encodedSize))
+            {
+                uint64_t word;
+                memcpy(&word, pEncoded + pos, sizeof(word));
+                if ((word & 0x8080808080808080ull) == 0)
+                {
+                    const uint8_t* pDelta   = pEncoded + pos;
+                    for (int k = 0; k < 8; k++)
+                    {
+                        value          += pDelta[k];
+                        pIndex[j + k]   = value;
+                    }
+                    j                  += 8;
+                    pos                += 8;
+                    continue;
+                }
+            }
+
+            uint32_t delta              = 0;
+            uint32_t shift              = 0;
+            uint8_t byte;
+            do
+            {
+                if ((pos >= encodedSize) || (shift > 28))
+                    return false;
+                byte                    = pEncoded[pos++];
+                delta                  |= (uint32_t)(byte & 0x7f) << shift;
+                shift                  += 7;
+            }
+            while (byte & 0x80);
+            value                      += delta;
+            pIndex[j++]                 = value;
+        }
+    }
+    return (pos == encodedSize);
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*
+
+
+   Copyright 2016  Amazon.com, Inc. or its affiliates. All Rights Reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License"). You may not use this file except in compliance with the License. A copy of the License is located at
+
+   http://aws.amazon.com/apache2.0/
+
+   or in the "license" file accompanying this file. This file is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the License for the specific language governing permissions and limitations under the License.
+ */
+
+#ifndef NNSTREAMINGDATASET_H
+#define NNSTREAMINGDATASET_H
+#ifndef __NVCC__
+#include <memory>
+
+#include "NNDataSetStream.h"
+
+// Dataset read from the shards of a stream
+class NNStreamingDataSetBase : public NNDataSetBase {
+protected:
+    uint32_t                        _index;                     // Index of this dataset within each shard file
+};
+
+// Sparse dataset whose resident examples are an NNDataSet<T> rebuilt from the stream's current groups.  Positions
+// are global to the pass and translated into the window, so network-level index shuffling must be off
+template<typename T> class NNStreamingDataSet : public NNStreamingDataSetBase, public NNStreamGroups<T> {
+public:
+    friend vector<NNDataSetBase*> LoadStreamingNetCDF(const string& directory, uint32_t windowShards, bool bShuffle);
+
+private:
+    std::shared_ptr<NNDataSetStream> _pStream;                  // Stream shared with the other datasets in the shards
+    NNDataSet<T>*                   _pWindow;                   // Resident examples
+    uint64_t                        _windowGeneration;          // Stream generation _pWindow was built from
+
+    NNStreamingDataSet(std::shared_ptr<NNDataSetStream> pStream, uint32_t index);
+    uint32_t EnsureResident(uint32_t position, uint32_t batch);
+    void RefreshWindow();
+    void ReadShard(netCDF::NcFile& nfc, const string& fname, uint32_t examples);
+
+    bool SaveNetCDF(const string& fname);
+    bool WriteNetCDF(netCDF::NcFile& nfc, const string& fname, const uint32_t n);
+    void RefreshState(uint32_t batch) {}
+    bool Shard(NNDataSetEnums::Sharding sharding);
+    bool UnShard();
+    vector<tuple<uint64_t, uint64_t> > getMemoryUsage();
+    bool CalculateSparseDatapointCounts() { return true; };
+    bool GenerateSparseTransposedMatrix(uint32_t batch, NNLayer* pLayer) { return true; };
+    bool SetDenoising(bool flag);
+    bool GenerateDenoisingData();
+
+    bool CalculateSparseTransposedMatrix(uint32_t position, uint32_t batch, NNLayer* pLayer)
+    {
+        return _pWindow->CalculateSparseTransposedMatrix(EnsureResident(position, batch), batch, pLayer);
+    }
+    bool CalculateSparseTransposedDenoisedMatrix(uint32_t position, uint32_t batch, NNLayer* pLayer)
+    {
+        return _pWindow->CalculateSparseTransposedDenoisedMatrix(EnsureResident(position, batch), batch, pLayer);
+    }
+    bool CalculateSparseTransposedWeightGradient(NNFloat alpha, NNFloat beta, uint32_t m, uint32_t n, NNFloat* pDelta, NNFloat* pWeightGradient)
+    {
+        return _pWindow->CalculateSparseTransposedWeightGradient(alpha, beta, m, n, pDelta, pWeightGradient);
+    }
+    bool LoadInputUnit(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit)
+    {
+        return _pWindow->LoadInputUnit(EnsureResident(position, batch), batch, stride, pUnit);
+    }
+    bool LoadSparseInputUnit(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit)
+    {
+        return _pWindow->LoadSparseInputUnit(EnsureResident(position, batch), batch, stride, pUnit);
+    }
+    bool LoadSparseDenoisedInputUnit(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit)
+    {
+        return _pWindow->LoadSparseDenoisedInputUnit(EnsureResident(position, batch), batch, stride, pUnit);
+    }
+    bool CalculateSparseZ(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pWeight, NNFloat* pUnit, NNFloat beta)
+    {
+        return _pWindow->CalculateSparseZ(EnsureResident(position, batch), batch, stride, pWeight, pUnit, beta);
+    }
+    bool CalculateSparseDenoisedZ(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pWeight, NNFloat* pUnit, NNFloat beta)
+    {
+        return _pWindow->CalculateSparseDenoisedZ(EnsureResident(position, batch), batch, stride, pWeight, pUnit, beta);
+    }
+    float CalculateL1Error(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit)
+    {
+        return _pWindow->CalculateL1Error(EnsureResident(position, batch), batch, stride, pUnit);
+    }
+    float CalculateL2Error(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit)
+    {
+        return _pWindow->CalculateL2Error(EnsureResident(position, batch), batch, stride, pUnit);
+    }
+    float CalculateCrossEntropyError(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit)
+    {
+        return _pWindow->CalculateCrossEntropyError(EnsureResident(position, batch), batch, stride, pUnit);
+    }
+    float CalculateScaledMarginalCrossEntropyError(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit)
+    {
+        return _pWindow->CalculateScaledMarginalCrossEntropyError(EnsureResident(position, batch), batch, stride, pUnit);
+    }
+    float CalculateMultinomialCrossEntropyError(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit)
+    {
+        return _pWindow->CalculateMultinomialCrossEntropyError(EnsureResident(position, batch), batch, stride, pUnit);
+    }
+    float CalculateMultinomialScaledMarginalCrossEntropyError(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit)
+    {
+        return _pWindow->CalculateMultinomialScaledMarginalCrossEntropyError(EnsureResident(position, batch), batch, stride, pUnit);
+    }
+    bool CalculateL1OutputDelta(Activation activation, uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit, NNFloat* pDelta)
+    {
+        return _pWindow->CalculateL1OutputDelta(activation, EnsureResident(position, batch), batch, stride, pUnit, pDelta);
+    }
+    bool CalculateCrossEntropyOutputDelta(Activation activation, uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit, NNFloat* pDelta)
+    {
+        return _pWindow->CalculateCrossEntropyOutputDelta(activation, EnsureResident(position, batch), batch, stride, pUnit, pDelta);
+    }
+    bool CalculateScaledMarginalCrossEntropyOutputDelta(Activation activation, uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit, NNFloat* pDelta)
+    {
+        return _pWindow->CalculateScaledMarginalCrossEntropyOutputDelta(activation, EnsureResident(position, batch), batch, stride, pUnit, pDelta);
+    }
+    bool CalculateOutputDelta(Activation activation, uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit, NNFloat* pDelta)
+    {
+        return _pWindow->CalculateOutputDelta(activation, EnsureResident(position, batch), batch, stride, pUnit, pDelta);
+    }
+    float CalculateDataScaledMarginalCrossEntropyError(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit)
+    {
+        return _pWindow->CalculateDataScaledMarginalCrossEntropyError(EnsureResident(position, batch), batch, stride, pUnit);
+    }
+    bool CalculateDataScaledMarginalCrossEntropyOutputDelta(Activation activation, uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit, NNFloat* pDelta)
+    {
+        return _pWindow->CalculateDataScaledMarginalCrossEntropyOutputDelta(activation, EnsureResident(position, batch), batch, stride, pUnit, pDelta);
+    }
+
+public:
+    ~NNStreamingDataSet();
+};
+
+#endif // __NVCC__
+#endif
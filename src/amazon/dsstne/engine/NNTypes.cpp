@@ -13,6 +13,10 @@
 #include "GpuTypes.h"
 #include "NNTypes.h"
 #include "kernels.h"
+#include <dirent.h>
+#include <random>
+#include <atomic>
+#include <functional>
 
 using namespace std;
 using namespace netCDF;
@@ -38,6 +42,23 @@ ostream& operator<< (ostream& out, const TrainingMode& e)
     return out;
 }
 
+static std::pair<LearningRateSchedule, string> sLearningRateSchedulePair[] =
+{
+    std::pair<LearningRateSchedule, string>(LearningRateSchedule::FixedRate,        "FixedRate"),
+    std::pair<LearningRateSchedule, string>(LearningRateSchedule::StepDecay,        "StepDecay"),
+    std::pair<LearningRateSchedule, string>(LearningRateSchedule::ExponentialDecay, "ExponentialDecay"),
+    std::pair<LearningRateSchedule, string>(LearningRateSchedule::CosineAnnealing,  "CosineAnnealing"),
+};
+
+static std::map<LearningRateSchedule, string> sLearningRateScheduleMap =
+std::map<LearningRateSchedule, string>(sLearningRateSchedulePair, sLearningRateSchedulePair + sizeof(sLearningRateSchedulePair) / sizeof(sLearningRateSchedulePair[0]));
+
+ostream& operator<< (ostream& out, const LearningRateSchedule& s)
+{
+    out << sLearningRateScheduleMap[s];
+    return out;
+}
+
 static std::pair<ErrorFunction, string> sErrorFunctionPair[] =
 {
     std::pair<ErrorFunction, string>(ErrorFunction::L1,                             "L1"),
@@ -271,10 +292,10 @@ static inline bool has_suffix(const std::string &str, const std::string &suffix)
 int MPI_Bcast_string(string& s)
 {
     int length                          = s.size();
-    MPI_Bcast(&length, 1, MPI_INT, 0, MPI_COMM_WORLD); 
+    MPI_Bcast(&length, 1, MPI_INT, 0, getGpu()._comm); 
     char buff[length + 1];
     strcpy(buff, s.c_str());
-    int result                          = MPI_Bcast(&buff, length, MPI_CHAR, 0, MPI_COMM_WORLD); 
+    int result                          = MPI_Bcast(&buff, length, MPI_CHAR, 0, getGpu()._comm); 
     buff[length]                        = '\0';  
     s                                   = buff;    
     return result;
@@ -296,16 +317,17 @@ _sparseDataSize(0),
 _sparseTransposedIndices(0),
 _maxSparseDatapoints(0),
 _sparseDensity(0),
+_bSparseStatistics(false),
 _bDenoising(false),
-_pbSparseStart(NULL),
-_pbSparseEnd(NULL),
+_pbSparseOffset(NULL),
 _pbSparseIndex(NULL),
 _pbSparseTransposedStart(NULL),
 _pbSparseTransposedEnd(NULL),
 _pbSparseTransposedIndex(NULL),
 _batch(0),
 _pbDenoisingRandom(NULL),
-_bDirty(true)
+_bDirty(true),
+_bStreaming(false)
 {
 
 
@@ -330,8 +352,8 @@ template<typename T> vector<tuple<uint64_t, uint64_t> > NNDataSet<T>::getMemoryU
     uint64_t gpuMemory                          = 0;
     if (_attributes & NNDataSetEnums::Sparse)
     {
-        cpuMemory                              += _examples * 2 * sizeof(uint64_t);
-        gpuMemory                              += _examples * 2 * sizeof(uint64_t);
+        cpuMemory                              += (_examples + 1) * sizeof(uint64_t);
+        gpuMemory                              += (_examples + 1) * sizeof(uint64_t);
         cpuMemory                              += _vSparseIndex.size() * sizeof(uint32_t);
         gpuMemory                              += _vSparseIndex.size() * sizeof(uint32_t);
         if (!(_attributes & NNDataSetEnums::Boolean))
@@ -349,12 +371,15 @@ template<typename T> vector<tuple<uint64_t, uint64_t> > NNDataSet<T>::getMemoryU
     // Gather and return memory usage per process
     vector<tuple<uint64_t, uint64_t> > vResult(getGpu()._numprocs);
     vResult[getGpu()._id]                       = make_tuple(cpuMemory, gpuMemory);   
-    MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, vResult.data(), sizeof(tuple<uint64_t, uint64_t>), MPI_BYTE, MPI_COMM_WORLD);
+    MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, vResult.data(), sizeof(tuple<uint64_t, uint64_t>), MPI_BYTE, getGpu()._comm);
     return vResult;  
 }
 
 template<typename T> T NNDataSet<T>::GetDataPoint(uint32_t n, uint32_t x, uint32_t y, uint32_t z)
 {
+    // Examples still in the NetCDF file are read by process 0
+    ReadDeferredNetCDF();
+
     // Illegal to call on sparse data set
     if (_attributes & NNDataSetEnums::Sparse)
     {
@@ -393,6 +418,10 @@ template<typename T> T NNDataSet<T>::GetDataPoint(uint32_t n, uint32_t x, uint32
 
 template<typename T> bool NNDataSet<T>::SetDataPoint(T v, uint32_t n, uint32_t x, uint32_t y, uint32_t z)
 {
+    // Examples still in the NetCDF file are read by process 0, and no longer match it once changed
+    ReadDeferredNetCDF();
+    _fileName.clear();
+
     // Illegal to call on sparse data set
     if (_attributes & NNDataSetEnums::Sparse)
     {
@@ -431,6 +460,9 @@ template<typename T> bool NNDataSet<T>::SetDataPoint(T v, uint32_t n, uint32_t x
 
 template<typename T> uint32_t NNDataSet<T>::GetSparseDataPoints(uint32_t n)
 {
+    // Examples still in the NetCDF file are read by process 0
+    ReadDeferredNetCDF();
+
     // Illegal to call on non-sparse data set
     if (!(_attributes & NNDataSetEnums::Sparse))
     {
@@ -453,11 +485,14 @@ template<typename T> uint32_t NNDataSet<T>::GetSparseDataPoints(uint32_t n)
         exit(-1);
     }
 
-    return _vSparseEnd[n] - _vSparseStart[n];
+    return _vSparseOffset[n + 1] - _vSparseOffset[n];
 }
 
 template<typename T> uint32_t NNDataSet<T>::GetSparseIndex(uint32_t n, uint32_t i)
 {
+    // Examples still in the NetCDF file are read by process 0
+    ReadDeferredNetCDF();
+
     // Illegal to call on non-sparse data set
     if (!(_attributes & NNDataSetEnums::Sparse))
     {
@@ -481,21 +516,25 @@ template<typename T> uint32_t NNDataSet<T>::GetSparseIndex(uint32_t n, uint32_t
     }
 
     // Make sure index is within bounds
-    if (i >= _vSparseEnd[n] - _vSparseStart[n])
+    if (i >= _vSparseOffset[n + 1] - _vSparseOffset[n])
     {
         if (getGpu()._id == 0)
         {
-            printf("NNDataSet::GetSparseIndex: Sparse index %u out of range (0, %u).\n", i, _vSparseEnd[n] - _vSparseStart[n]);
+            printf("NNDataSet::GetSparseIndex: Sparse index %u out of range (0, %u).\n", i, _vSparseOffset[n + 1] - _vSparseOffset[n]);
         }
         getGpu().Shutdown();
         exit(-1);
     }
 
-    return _vSparseIndex[_vSparseStart[n] + i];
+    return _vSparseIndex[_vSparseOffset[n] + i];
 }
 
 template<typename T> bool NNDataSet<T>::SetSparseIndex(uint32_t n, uint32_t i, uint32_t v)
 {
+    // Examples still in the NetCDF file are read by process 0, and no longer match it once changed
+    ReadDeferredNetCDF();
+    _fileName.clear();
+
     // Illegal to call on non-sparse data set
     if (!(_attributes & NNDataSetEnums::Sparse))
     {
@@ -518,13 +557,17 @@ template<typename T> bool NNDataSet<T>::SetSparseIndex(uint32_t n, uint32_t i, u
         exit(-1);
     }
 
-    _vSparseIndex[_vSparseStart[n] + i]         = v;
+    _vSparseIndex[_vSparseOffset[n] + i]         = v;
     _bDirty                                     = true;
+    _bSparseStatistics                          = false;
     return true;
 }
 
 template<typename T> T NNDataSet<T>::GetSparseDataPoint(uint32_t n, uint32_t i)
 {
+    // Examples still in the NetCDF file are read by process 0
+    ReadDeferredNetCDF();
+
     // Illegal to call on non-sparse data set
     if (!(_attributes & NNDataSetEnums::Sparse))
     {
@@ -548,11 +591,15 @@ template<typename T> T NNDataSet<T>::GetSparseDataPoint(uint32_t n, uint32_t i)
     }
 
 
-    return _vSparseData[_vSparseStart[n] + i];
+    return _vSparseData[_vSparseOffset[n] + i];
 }
 
 template<typename T> bool NNDataSet<T>::SetSparseDataPoint(uint32_t n, uint32_t i, T v)
 {
+    // Examples still in the NetCDF file are read by process 0, and no longer match it once changed
+    ReadDeferredNetCDF();
+    _fileName.clear();
+
     // Illegal to call on non-sparse data set
     if (!(_attributes & NNDataSetEnums::Sparse))
     {
@@ -575,262 +622,645 @@ template<typename T> bool NNDataSet<T>::SetSparseDataPoint(uint32_t n, uint32_t
         exit(-1);
     }
 
-    _vSparseData[_vSparseStart[n] + i]         = v;
+    _vSparseData[_vSparseOffset[n] + i]         = v;
     _bDirty                                    = true;
     return true;
 }
 
-template<typename T> NNDataSet<T>::NNDataSet(const string& fname, uint32_t n) :
-_pbData(NULL),
-_pbSparseData(NULL),
-_pbSparseTransposedData(NULL)
+// Sparse variables of one dataset as read from NetCDF, before index decoding and range compaction
+struct NNSparseNetCDFBuffers
 {
-    // Read File entirely with process 0
-    bool bResult                                = true;
-    if (getGpu()._id == 0)
+    uint32_t                    _encoding;                      // NNDataSetEnums::SparseEncoding of the indices
+    uint64_t                    _sparseDataSize;                // Total sparse datapoints
+    vector<uint8_t>             _vEncodedIndex;                 // DeltaVarint encoded indices
+    vector<uint64_t>            _vSparseStart;                  // RawIndex per-example start
+    vector<uint64_t>            _vSparseEnd;                    // RawIndex per-example end
+};
+
+// Reads the sparse variables of dataset n.  Only this step touches the NetCDF file, so when several datasets
+// are read concurrently it is the only part that has to hold the NetCDF lock
+template<typename T> static void ReadSparseNetCDF(NcFile& nfc, const string& fname, uint32_t n, uint32_t attributes, uint64_t examples,
+                                                  vector<uint64_t>& vSparseOffset, vector<uint32_t>& vSparseIndex, vector<T>& vSparseData, NNSparseNetCDFBuffers& buffers)
+{
+    string nstring                      = to_string(n);
+    string vname                        = "sparseDataDim" + nstring;
+    NcDim sparseDataDim                 = nfc.getDim(vname); 
+    if (sparseDataDim.isNull())
     {
-        bool bOpened                            = false;
-        try
+        throw NcException("NcException", "ReadSparseNetCDF: No sparse data dimensions supplied in NetCDF input file " + fname, __FILE__, __LINE__);          
+    }
+    uint64_t sparseDataSize             = sparseDataDim.getSize();
+    buffers._sparseDataSize             = sparseDataSize;
+    
+    // Check for at least one datapoint
+    if (sparseDataSize == 0)
+    {
+        throw NcException("NcException", "ReadSparseNetCDF: Sparse data set with no actual data in NetCDF input file " + fname, __FILE__, __LINE__);    
+    }
+    vSparseOffset.resize(examples + 1);
+    vSparseIndex.resize(sparseDataSize);
+
+    // Check for compressed sparse index encoding
+    buffers._encoding                   = NNDataSetEnums::RawIndex;
+    vname                               = "sparseEncoding" + nstring;
+    NcGroupAtt sparseEncodingAtt        = nfc.getAtt(vname);
+    if (!sparseEncodingAtt.isNull())
+        sparseEncodingAtt.getValues(&buffers._encoding);
+
+    if (buffers._encoding == NNDataSetEnums::DeltaVarint)
+    {
+        vname                           = "sparseOffset" + nstring;
+        NcVar sparseOffsetVar           = nfc.getVar(vname);
+        if (sparseOffsetVar.isNull())
         {
-            // Work around poor exception throwing design here
-            NcFile nfc(fname.c_str(), NcFile::read);
-            bOpened                             = true;
-            
-            string nstring                      = to_string(n);
-            string vname                        = "name" + nstring;
-            NcGroupAtt nameAtt                  = nfc.getAtt(vname);
-            if (nameAtt.isNull())
-            {
-                throw NcException("NcException", "NNDataSet::NNDataSet: No dataset name supplied in NetCDF input file " + fname, __FILE__, __LINE__);
-            }
-            nameAtt.getValues(_name);
-            cout << "NNDataSet<T>::NNDataSet: Name of data set: " << _name << endl;
+            throw NcException("NcException", "ReadSparseNetCDF: No sparse offsets supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+        if (sparseOffsetVar.getDim(0).getSize() != vSparseOffset.size())
+        {
+            throw NcException("NcException", "ReadSparseNetCDF: Sparse offsets don't match example count in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+        vname                           = "sparseIndex" + nstring;
+        NcVar sparseIndexVar            = nfc.getVar(vname);
+        if (sparseIndexVar.isNull())
+        {
+            throw NcException("NcException", "ReadSparseNetCDF: No sparse data indices supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
 
-            
-            vname                               = "dataType" + nstring;
-            NcGroupAtt dataTypeAtt              = nfc.getAtt(vname);
-            if (dataTypeAtt.isNull())
+        // Read single offsets array (32-bit when it fits)
+        if (sparseOffsetVar.getType() == ncUint)
+        {
+            vector<uint32_t> vTempSparseOffset(vSparseOffset.size());
+            sparseOffsetVar.getVar((uint32_t*)vTempSparseOffset.data());
+            copy(vTempSparseOffset.begin(), vTempSparseOffset.end(), vSparseOffset.begin());
+        }
+        else
+            sparseOffsetVar.getVar((uint64_t*)vSparseOffset.data());
+        if (vSparseOffset.back() != sparseDataSize)
+        {
+            throw NcException("NcException", "ReadSparseNetCDF: Sparse offsets don't match sparse data size in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+
+        // Read index bytes
+        buffers._vEncodedIndex.resize(sparseIndexVar.getDim(0).getSize());
+        sparseIndexVar.getVar(buffers._vEncodedIndex.data());
+    }
+    else if (buffers._encoding == NNDataSetEnums::RawIndex)
+    {
+        vname                           = "sparseStart" + nstring;
+        NcVar sparseStartVar            = nfc.getVar(vname);
+        if (sparseStartVar.isNull())
+        {
+            throw NcException("NcException", "ReadSparseNetCDF: No sparse offset start supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+        vname                           = "sparseEnd" + nstring;
+        NcVar sparseEndVar              = nfc.getVar(vname);
+        if (sparseEndVar.isNull())
+        {
+            throw NcException("NcException", "ReadSparseNetCDF: No sparse data end supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+        vname                           = "sparseIndex" + nstring;
+        NcVar sparseIndexVar            = nfc.getVar(vname);
+        if (sparseIndexVar.isNull())
+        {
+            throw NcException("NcException", "ReadSparseNetCDF: No sparse data indices supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+
+        // Read data into CPU memory (account for old datasets using 32-bit indices)
+        vector<uint64_t>& vSparseStart  = buffers._vSparseStart;
+        vector<uint64_t>& vSparseEnd    = buffers._vSparseEnd;
+        vSparseStart.resize(examples);
+        vSparseEnd.resize(examples);
+        NcType vStartType               = sparseStartVar.getType();
+        if (vStartType == ncUint)
+        {
+            vector<uint32_t> vTempSparseStart(examples);
+            sparseStartVar.getVar((uint32_t*)vTempSparseStart.data());
+            copy(vTempSparseStart.begin(), vTempSparseStart.end(), vSparseStart.begin());
+        }
+        else
+            sparseStartVar.getVar((uint64_t*)vSparseStart.data());
+        
+        NcType vEndType                 = sparseEndVar.getType();    
+        if (vEndType == ncUint)
+        {
+            vector<uint32_t> vTempSparseEnd(examples);
+            sparseEndVar.getVar((uint32_t*)vTempSparseEnd.data());
+            copy(vTempSparseEnd.begin(), vTempSparseEnd.end(), vSparseEnd.begin());
+        }
+        else                    
+            sparseEndVar.getVar((uint64_t*)vSparseEnd.data());
+        sparseIndexVar.getVar((uint32_t*)vSparseIndex.data());
+    }
+    else
+    {
+        throw NcException("NcException", "ReadSparseNetCDF: Unknown sparse encoding (" + to_string(buffers._encoding) + ") in NetCDF input file " + fname, __FILE__, __LINE__);
+    }
+                  
+    // If not Boolean, then read templated point values
+    if (!(attributes & NNDataSetEnums::Boolean))
+    {                     
+        vname                           = "sparseData" + nstring;
+        NcVar sparseDataVar             = nfc.getVar(vname);
+        if (sparseDataVar.isNull())
+        {
+            throw NcException("NcException", "ReadSparseNetCDF: No sparse data located in NetCDF input file " + fname, __FILE__, __LINE__);
+        }  
+        vSparseData.resize(sparseDataSize);
+        sparseDataVar.getVar(vSparseData.data());                     
+    }
+}
+
+// Turns what ReadSparseNetCDF read into CSR offsets, indices and (unless Boolean) values, decoding compressed
+// indices and compacting the gapped start/end ranges older files may contain.  Doesn't touch the NetCDF file
+template<typename T> static void DecodeSparseNetCDF(const string& fname, uint32_t attributes, uint64_t examples, NNSparseNetCDFBuffers& buffers,
+                                                    vector<uint64_t>& vSparseOffset, vector<uint32_t>& vSparseIndex, vector<T>& vSparseData)
+{
+    if (buffers._encoding == NNDataSetEnums::DeltaVarint)
+    {
+        if (!DecodeSparseIndexDeltaVarint(buffers._vEncodedIndex.data(), buffers._vEncodedIndex.size(), vSparseOffset.data(), examples, vSparseIndex.data()))
+        {
+            throw NcException("NcException", "DecodeSparseNetCDF: Corrupt sparse data indices in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+        buffers._vEncodedIndex.clear();
+        return;
+    }
+
+    // Use start/end directly as CSR offsets when examples are stored back to back
+    vector<uint64_t>& vSparseStart      = buffers._vSparseStart;
+    vector<uint64_t>& vSparseEnd        = buffers._vSparseEnd;
+    uint64_t sparseDataSize             = buffers._sparseDataSize;
+    bool bContiguous                    = true;
+    vSparseOffset[0]                    = 0;
+    for (size_t i = 0; i < vSparseStart.size(); i++)
+    {
+        if ((vSparseStart[i] != vSparseOffset[i]) || (vSparseEnd[i] < vSparseStart[i]) || (vSparseEnd[i] > sparseDataSize))
+            bContiguous                 = false;
+        vSparseOffset[i + 1]            = vSparseOffset[i] + ((vSparseEnd[i] > vSparseStart[i]) ? vSparseEnd[i] - vSparseStart[i] : 0);
+    }
+
+    // Compact gapped or out of order start/end ranges into CSR order
+    if (!bContiguous)
+    {
+        vector<uint32_t> vTempSparseIndex(vSparseOffset.back());
+        vector<T> vTempSparseData;
+        if (!(attributes & NNDataSetEnums::Boolean))
+            vTempSparseData.resize(vSparseOffset.back());
+        for (size_t i = 0; i < vSparseStart.size(); i++)
+        {
+            if (vSparseEnd[i] > sparseDataSize)
             {
-                throw NcException("NcException", "NNDataSet::NNDataSet: No datatype supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+                throw NcException("NcException", "DecodeSparseNetCDF: Sparse start/end out of range in NetCDF input file " + fname, __FILE__, __LINE__);
             }
-            int dataType;
-            dataTypeAtt.getValues(&dataType);
-            _dataType                           = (NNDataSetEnums::DataType)dataType;
-                 
-            vname                               = "attributes" + nstring;
-            NcGroupAtt attributesAtt            = nfc.getAtt(vname);
-            if (attributesAtt.isNull())
+            for (uint64_t j = vSparseOffset[i]; j < vSparseOffset[i + 1]; j++)
             {
-                throw NcException("NcException", "NNDataSet::NNDataSet: No attributes supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+                vTempSparseIndex[j]     = vSparseIndex[vSparseStart[i] + j - vSparseOffset[i]];
+                if (!(attributes & NNDataSetEnums::Boolean))
+                    vTempSparseData[j]  = vSparseData[vSparseStart[i] + j - vSparseOffset[i]];
             }
-            attributesAtt.getValues(&_attributes);
-            if (_attributes != 0)
+        }
+        vSparseIndex                    = vTempSparseIndex;
+        vSparseData                     = vTempSparseData;
+    }
+    buffers._vSparseStart.clear();
+    buffers._vSparseEnd.clear();
+}
+
+// Reads and decodes the sparse datapoints of dataset n in one step
+template<typename T> static void ReadSparseNetCDF(NcFile& nfc, const string& fname, uint32_t n, uint32_t attributes, uint64_t examples,
+                                                  vector<uint64_t>& vSparseOffset, vector<uint32_t>& vSparseIndex, vector<T>& vSparseData)
+{
+    NNSparseNetCDFBuffers buffers;
+    ReadSparseNetCDF(nfc, fname, n, attributes, examples, vSparseOffset, vSparseIndex, vSparseData, buffers);
+    DecodeSparseNetCDF(fname, attributes, examples, buffers, vSparseOffset, vSparseIndex, vSparseData);
+}
+
+// Reads the datapoint counts, maximum datapoints per example and density generateNetCDF stores for sparse dataset n,
+// returning false for files written before they were stored or whose counts don't cover the N datapoints
+static bool ReadSparseStatisticsNetCDF(NcFile& nfc, uint32_t n, uint64_t N, vector<uint64_t>& vSparseDatapointCount, uint32_t& maxSparseDatapoints, double& sparseDensity)
+{
+    string nstring                      = to_string(n);
+    NcVar sparseDatapointCountVar       = nfc.getVar("sparseDatapointCount" + nstring);
+    NcGroupAtt maxSparseDatapointsAtt   = nfc.getAtt("maxSparseDatapoints" + nstring);
+    NcGroupAtt sparseDensityAtt         = nfc.getAtt("sparseDensity" + nstring);
+    if (sparseDatapointCountVar.isNull() || maxSparseDatapointsAtt.isNull() || sparseDensityAtt.isNull() || (sparseDatapointCountVar.getDim(0).getSize() != N))
+        return false;
+
+    vSparseDatapointCount.resize(N);
+    if (sparseDatapointCountVar.getType() == ncUint)
+    {
+        vector<uint32_t> vTempSparseDatapointCount(N);
+        sparseDatapointCountVar.getVar((uint32_t*)vTempSparseDatapointCount.data());
+        copy(vTempSparseDatapointCount.begin(), vTempSparseDatapointCount.end(), vSparseDatapointCount.begin());
+    }
+    else
+        sparseDatapointCountVar.getVar((uint64_t*)vSparseDatapointCount.data());
+    maxSparseDatapointsAtt.getValues(&maxSparseDatapoints);
+    sparseDensityAtt.getValues(&sparseDensity);
+    return true;
+}
+
+// Datapoints each process reads from NetCDF at once when reading its own shard
+static const uint64_t ShardReadChunk            = 16 * 1024 * 1024;
+
+// Reads count 32-bit or 64-bit offsets of a 1-dimensional NetCDF variable, starting at start
+static void GetOffsetsNetCDF(NcVar& var, uint64_t start, uint64_t count, uint64_t* pOffset)
+{
+    vector<size_t> vStart(1, start);
+    vector<size_t> vCount(1, count);
+    if (var.getType() == ncUint)
+    {
+        vector<uint32_t> vTempOffset(count);
+        var.getVar(vStart, vCount, (uint32_t*)vTempOffset.data());
+        copy(vTempOffset.begin(), vTempOffset.end(), pOffset);
+    }
+    else
+        var.getVar(vStart, vCount, (void*)pOffset);
+}
+
+// Reads the datapoints of examples [first, last) of uncompressed sparse dataset n that lie within [minX, maxX), in CSR
+// order with indices relative to minX.  Datapoints are read a chunk at a time, so only the shard itself has to fit in memory
+template<typename T> static void ReadSparseShardNetCDF(NcFile& nfc, const string& fname, uint32_t n, uint32_t attributes, uint32_t first, uint32_t last,
+                                                       uint32_t minX, uint32_t maxX, vector<uint64_t>& vSparseOffset, vector<uint32_t>& vSparseIndex, vector<T>& vSparseData)
+{
+    string nstring                      = to_string(n);
+    bool bBoolean                       = (attributes & NNDataSetEnums::Boolean);
+    NcVar sparseStartVar                = nfc.getVar("sparseStart" + nstring);
+    NcVar sparseEndVar                  = nfc.getVar("sparseEnd" + nstring);
+    NcVar sparseIndexVar                = nfc.getVar("sparseIndex" + nstring);
+    NcVar sparseDataVar;
+    if (!bBoolean)
+        sparseDataVar                   = nfc.getVar("sparseData" + nstring);
+    if (sparseStartVar.isNull() || sparseEndVar.isNull() || sparseIndexVar.isNull() || (!bBoolean && sparseDataVar.isNull()))
+    {
+        throw NcException("NcException", "ReadSparseShardNetCDF: Missing sparse variables in NetCDF input file " + fname, __FILE__, __LINE__);
+    }
+
+    uint32_t examples                   = last - first;
+    vector<uint64_t> vSparseStart(examples);
+    vector<uint64_t> vSparseEnd(examples);
+    if (examples > 0)
+    {
+        GetOffsetsNetCDF(sparseStartVar, first, examples, vSparseStart.data());
+        GetOffsetsNetCDF(sparseEndVar, first, examples, vSparseEnd.data());
+    }
+
+    // Examples stored in order are streamed a chunk at a time, anything else needs their whole span read at once
+    uint64_t sparseDataSize             = sparseIndexVar.getDim(0).getSize();
+    uint64_t lo                         = sparseDataSize;
+    uint64_t hi                         = 0;
+    bool bOrdered                       = true;
+    for (uint32_t i = 0; i < examples; i++)
+    {
+        if (vSparseEnd[i] > sparseDataSize)
+        {
+            throw NcException("NcException", "ReadSparseShardNetCDF: Sparse start/end out of range in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+        if (vSparseEnd[i] > vSparseStart[i])
+        {
+            bOrdered                   &= (vSparseStart[i] >= hi);
+            lo                          = min(lo, vSparseStart[i]);
+            hi                          = max(hi, vSparseEnd[i]);
+        }
+    }
+    uint64_t chunk                      = bOrdered ? ShardReadChunk : hi - lo;
+
+    vector<uint32_t> vChunkIndex;
+    vector<T> vChunkData;
+    uint64_t chunkStart                 = 0;
+    uint64_t chunkEnd                   = 0;
+    vSparseOffset.resize(examples + 1);
+    vSparseOffset[0]                    = 0;
+    vSparseIndex.resize(0);
+    vSparseData.resize(0);
+    for (uint32_t i = 0; i < examples; i++)
+    {
+        for (uint64_t j = vSparseStart[i]; j < vSparseEnd[i]; j++)
+        {
+            if ((j < chunkStart) || (j >= chunkEnd))
             {
-                int tempAtt                     = _attributes;
-                cout << "NNDataSet<T>::NNDataSet: Attributes:";
-                while (tempAtt != 0)
+                chunkStart              = bOrdered ? j : lo;
+                chunkEnd                = min(hi, chunkStart + chunk);
+                vector<size_t> vStart(1, chunkStart);
+                vector<size_t> vCount(1, chunkEnd - chunkStart);
+                vChunkIndex.resize(chunkEnd - chunkStart);
+                sparseIndexVar.getVar(vStart, vCount, (uint32_t*)vChunkIndex.data());
+                if (!bBoolean)
                 {
-                    NNDataSetEnums::Attributes a = (NNDataSetEnums::Attributes)(1 << (ffs(tempAtt) - 1));
-                    cout << " " << a;
-                    tempAtt                    ^= 1 << (ffs(tempAtt) - 1);
+                    vChunkData.resize(chunkEnd - chunkStart);
+                    sparseDataVar.getVar(vStart, vCount, vChunkData.data());
                 }
-                cout << endl;
             }
-            
-            vname                               = "examplesDim" + nstring;
-            NcDim examplesDim                   = nfc.getDim(vname);
-            if (examplesDim.isNull())
-            {
-                throw NcException("NcException", "NNDataSet::NNDataSet: No examples count supplied in NetCDF input file " + fname, __FILE__, __LINE__);
-            }
-            _examples                           = examplesDim.getSize();
-            
-            // Check for nonzero examples count
-            if (_examples == 0)
-            {
-                throw NcException("NcException", "NNDataSet::NNDataSet: Zero-valued Examples count in NetCDF input file " + fname, __FILE__, __LINE__);
-            }
-            
-            vname                               = "dimensions" + nstring;
-            NcGroupAtt dimensionsAtt            = nfc.getAtt(vname);
-            if (dimensionsAtt.isNull())
+            uint32_t index              = vChunkIndex[j - chunkStart];
+            if ((index >= minX) && (index < maxX))
             {
-                throw NcException("NcException", "NNDataSet::NNDataSet: No dimension count supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+                vSparseIndex.push_back(index - minX);
+                if (!bBoolean)
+                    vSparseData.push_back(vChunkData[j - chunkStart]);
             }
-            dimensionsAtt.getValues(&_dimensions);
-            
-            // Check for valid dimensions count
-            if ((_dimensions < 1) || (_dimensions > 3))
+        }
+        vSparseOffset[i + 1]            = vSparseIndex.size();
+    }
+}
+
+// Reads x coordinates [minX, maxX) of examples [first, last) of non-sparse dataset n, each example being stride long.
+// Boolean datasets store the one set coordinate of each example and are expanded here
+template<typename T> static void ReadDataShardNetCDF(NcFile& nfc, const string& fname, uint32_t n, uint32_t attributes, uint64_t stride, uint32_t first, uint32_t last,
+                                                     uint64_t minX, uint64_t maxX, vector<T>& vData)
+{
+    string nstring                      = to_string(n);
+    NcVar dataVar                       = nfc.getVar("data" + nstring);
+    if (dataVar.isNull())
+    {
+        throw NcException("NcException", "ReadDataShardNetCDF: No data located in NetCDF input file " + fname, __FILE__, __LINE__);
+    }
+
+    uint64_t examples                   = last - first;
+    uint64_t slice                      = maxX - minX;
+    vData.assign(examples * slice, (T)0);
+    if (examples == 0)
+        return;
+
+    if (attributes & NNDataSetEnums::Boolean)
+    {
+        vector<T> vBooleanData(examples);
+        dataVar.getVar(vector<size_t>(1, first), vector<size_t>(1, examples), vBooleanData.data());
+        for (uint64_t i = 0; i < examples; i++)
+        {
+            uint64_t x                  = (uint64_t)vBooleanData[i];
+            if ((x >= minX) && (x < maxX))
+                vData[i * slice + x - minX] = (T)1.0;
+        }
+    }
+    else if (slice == stride)
+    {
+        // Whole examples
+        dataVar.getVar(vector<size_t>(1, first * stride), vector<size_t>(1, examples * stride), vData.data());
+    }
+    else
+    {
+        // Read whole examples a chunk at a time and keep the slice of each
+        uint64_t rows                   = max((uint64_t)1, ShardReadChunk / stride);
+        vector<T> vChunk;
+        for (uint64_t i = 0; i < examples; i += rows)
+        {
+            uint64_t count              = min(rows, examples - i);
+            vChunk.resize(count * stride);
+            dataVar.getVar(vector<size_t>(1, (first + i) * stride), vector<size_t>(1, count * stride), vChunk.data());
+            for (uint64_t j = 0; j < count; j++)
+                copy(vChunk.begin() + j * stride + minX, vChunk.begin() + j * stride + maxX, vData.begin() + (i + j) * slice);
+        }
+    }
+}
+
+template<typename T> NNDataSet<T>::NNDataSet(const string& fname, uint32_t n) :
+_pbData(NULL),
+_pbSparseData(NULL),
+_pbSparseTransposedData(NULL),
+_fileDataSet(0),
+_bDeferred(false)
+{
+    // Read File entirely with process 0
+    bool bResult                                = true;
+    if (getGpu()._id == 0)
+        bResult                                 = ReadNetCDF(fname, n);
+    FinishNetCDF(bResult);
+}
+
+// Reads dataset n with process 0.  Several datasets can be read at once: NetCDF isn't thread-safe, so the file
+// is only open under the NetCDF lock, but decoding and expanding the data run concurrently with other reads.
+// With bDefer and several processes, examples every process can later read its own shard of are left in the file
+template<typename T> bool NNDataSet<T>::ReadNetCDF(const string& fname, uint32_t n, bool bDefer)
+{
+    bool bResult                                = true;
+    bool bOpened                                = false;
+    NNSparseNetCDFBuffers sparseBuffers;
+    vector<T> vBooleanData;
+    try
+    {
+        std::unique_lock<std::mutex> lock(getNetCDFMutex());
+
+        // Work around poor exception throwing design here
+        std::unique_ptr<NcFile> pNfc(new NcFile(fname.c_str(), NcFile::read));
+        NcFile& nfc                             = *pNfc;
+        bOpened                                 = true;
+        
+        string nstring                          = to_string(n);
+        string vname                            = "name" + nstring;
+        NcGroupAtt nameAtt                      = nfc.getAtt(vname);
+        if (nameAtt.isNull())
+        {
+            throw NcException("NcException", "NNDataSet::NNDataSet: No dataset name supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+        nameAtt.getValues(_name);
+        cout << "NNDataSet<T>::NNDataSet: Name of data set: " << _name << endl;
+
+        
+        vname                                   = "dataType" + nstring;
+        NcGroupAtt dataTypeAtt                  = nfc.getAtt(vname);
+        if (dataTypeAtt.isNull())
+        {
+            throw NcException("NcException", "NNDataSet::NNDataSet: No datatype supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+        int dataType;
+        dataTypeAtt.getValues(&dataType);
+        _dataType                               = (NNDataSetEnums::DataType)dataType;
+             
+        vname                                   = "attributes" + nstring;
+        NcGroupAtt attributesAtt                = nfc.getAtt(vname);
+        if (attributesAtt.isNull())
+        {
+            throw NcException("NcException", "NNDataSet::NNDataSet: No attributes supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+        attributesAtt.getValues(&_attributes);
+        if (_attributes != 0)
+        {
+            int tempAtt                         = _attributes;
+            cout << "NNDataSet<T>::NNDataSet: Attributes:";
+            while (tempAtt != 0)
             {
-                throw NcException("NcException", "NNDataSet::NNDataSet: Invalid dimension count (" + to_string(_dimensions) + ") supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+                NNDataSetEnums::Attributes a = (NNDataSetEnums::Attributes)(1 << (ffs(tempAtt) - 1));
+                cout << " " << a;
+                tempAtt                        ^= 1 << (ffs(tempAtt) - 1);
             }
+            cout << endl;
+        }
+        
+        vname                                   = "examplesDim" + nstring;
+        NcDim examplesDim                       = nfc.getDim(vname);
+        if (examplesDim.isNull())
+        {
+            throw NcException("NcException", "NNDataSet::NNDataSet: No examples count supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+        _examples                               = examplesDim.getSize();
+        
+        // Check for nonzero examples count
+        if (_examples == 0)
+        {
+            throw NcException("NcException", "NNDataSet::NNDataSet: Zero-valued Examples count in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+        
+        vname                                   = "dimensions" + nstring;
+        NcGroupAtt dimensionsAtt                = nfc.getAtt(vname);
+        if (dimensionsAtt.isNull())
+        {
+            throw NcException("NcException", "NNDataSet::NNDataSet: No dimension count supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+        dimensionsAtt.getValues(&_dimensions);
+        
+        // Check for valid dimensions count
+        if ((_dimensions < 1) || (_dimensions > 3))
+        {
+            throw NcException("NcException", "NNDataSet::NNDataSet: Invalid dimension count (" + to_string(_dimensions) + ") supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
 
-            vname                               = "width" + nstring;
-            NcGroupAtt widthAtt                 = nfc.getAtt(vname);
-            if (widthAtt.isNull())
+        vname                                   = "width" + nstring;
+        NcGroupAtt widthAtt                     = nfc.getAtt(vname);
+        if (widthAtt.isNull())
+        {
+            throw NcException("NcException", "NNDataSet::NNDataSet: No datapoint width supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+        widthAtt.getValues(&_width);
+
+        if (_dimensions > 1)
+        {
+            vname                               = "height" + nstring;
+            NcGroupAtt heightAtt                = nfc.getAtt(vname);
+            if (heightAtt.isNull())
             {
-                throw NcException("NcException", "NNDataSet::NNDataSet: No datapoint width supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+                throw NcException("NcException", "NNDataSet::NNDataSet: No datapoint height supplied in NetCDF input file " + fname, __FILE__, __LINE__);
             }
-            widthAtt.getValues(&_width);
+            heightAtt.getValues(&_height);
+        }
+        else
+            _height                             = 1;
 
-            if (_dimensions > 1)
+        if (_dimensions > 2)
+        {
+            vname                               = "length" + nstring;
+            NcGroupAtt lengthAtt                = nfc.getAtt(vname);
+            if (lengthAtt.isNull())
             {
-                vname                           = "height" + nstring;
-                NcGroupAtt heightAtt            = nfc.getAtt(vname);
-                if (heightAtt.isNull())
-                {
-                    throw NcException("NcException", "NNDataSet::NNDataSet: No datapoint height supplied in NetCDF input file " + fname, __FILE__, __LINE__);
-                }
-                heightAtt.getValues(&_height);
+                throw NcException("NcException", "NNDataSet::NNDataSet: No datapoint length supplied in NetCDF input file " + fname, __FILE__, __LINE__);
             }
-            else
-                _height                         = 1;
-
-            if (_dimensions > 2)
+            lengthAtt.getValues(&_length);
+        }
+        else
+            _length                             = 1;
+        cout << "NNDataSet<T>::NNDataSet: " << _dimensions << "-dimensional data comprised of (" << _width << ", " << _height << ", " << _length << ") datapoints." << endl;
+        
+        // Make sure all dimensions are at least 1
+        if ((_width == 0) || (_height == 0) || (_length == 0))
+        {
+            throw NcException("NcException", "NNDataSet::NNDataSet: Invalid dataset dimensions in NetCDF input file " + fname, __FILE__, __LINE__);            
+        }
+                    
+        // Read sparse data (type is irrelevant here)
+        bool bShardable                         = true;
+        if (_attributes & NNDataSetEnums::Sparse)
+        {
+            double sparseDensity;
+            _bSparseStatistics                  = ReadSparseStatisticsNetCDF(nfc, n, (uint64_t)_width * _height * _length, _vSparseDatapointCount, _maxSparseDatapoints, sparseDensity);
+            if (_bSparseStatistics)
+                _sparseDensity                  = sparseDensity;
+
+            // Only uncompressed indices can be read a shard at a time, and the datapoint counts have to be known up front
+            uint32_t encoding                   = NNDataSetEnums::RawIndex;
+            NcGroupAtt sparseEncodingAtt        = nfc.getAtt("sparseEncoding" + nstring);
+            if (!sparseEncodingAtt.isNull())
+                sparseEncodingAtt.getValues(&encoding);
+            bShardable                          = (encoding == NNDataSetEnums::RawIndex);
+            _bDeferred                          = bDefer && bShardable && _bSparseStatistics && (getGpu()._numprocs > 1);
+            if (_bDeferred)
             {
-                vname                           = "length" + nstring;
-                NcGroupAtt lengthAtt            = nfc.getAtt(vname);
-                if (lengthAtt.isNull())
+                NcDim sparseDataDim             = nfc.getDim("sparseDataDim" + nstring);
+                if (sparseDataDim.isNull() || (sparseDataDim.getSize() == 0))
                 {
-                    throw NcException("NcException", "NNDataSet::NNDataSet: No datapoint length supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+                    throw NcException("NcException", "NNDataSet::NNDataSet: No sparse data supplied in NetCDF input file " + fname, __FILE__, __LINE__);
                 }
-                lengthAtt.getValues(&_length);
+                _sparseDataSize                 = sparseDataDim.getSize();
             }
             else
-                _length                         = 1;
-            cout << "NNDataSet<T>::NNDataSet: " << _dimensions << "-dimensional data comprised of (" << _width << ", " << _height << ", " << _length << ") datapoints." << endl;
+                ReadSparseNetCDF(nfc, fname, n, _attributes, _examples, _vSparseOffset, _vSparseIndex, _vSparseData, sparseBuffers);
+        }
+        else if (bDefer && (getGpu()._numprocs > 1))
+        {
+            // Non-sparse data, left for the processes to read once sharded
+            _stride                             = _width * _height * _length;
+            _bDeferred                          = true;
+        }
+        else
+        {
+            // Non-sparse data
+            _stride                             = _width * _height * _length;
+            vname                               = "dataDim" + nstring;
+            NcDim dataDim                       = nfc.getDim(vname); 
+            if (dataDim.isNull())
+            {
+                    throw NcException("NcException", "NNDataSet::NNDataSet: No data dimensons located in NetCDF input file " + fname, __FILE__, __LINE__);
+            }  
+            vname                               = "data" + nstring;
+            NcVar dataVar                       = nfc.getVar(vname);
             
-            // Make sure all dimensions are at least 1
-            if ((_width == 0) || (_height == 0) || (_length == 0))
+            if (_attributes & NNDataSetEnums::Boolean)
             {
-                throw NcException("NcException", "NNDataSet::NNDataSet: Invalid dataset dimensions in NetCDF input file " + fname, __FILE__, __LINE__);            
-            }
-                        
-            // Read sparse data (type is irrelevant here)
-            if (_attributes & NNDataSetEnums::Sparse)
-            {
-                _vSparseStart.resize(examplesDim.getSize());
-                _vSparseEnd.resize(examplesDim.getSize());
-                vname                           = "sparseDataDim" + nstring;
-                NcDim sparseDataDim             = nfc.getDim(vname); 
-                if (sparseDataDim.isNull())
-                {
-                    throw NcException("NcException", "NNDataSet::NNDataSet: No sparse data dimensions supplied in NetCDF input file " + fname, __FILE__, __LINE__);          
-                }
-                _sparseDataSize                 = sparseDataDim.getSize();
-                
-                // Check for at least one datapoint
-                if (_sparseDataSize == 0)
-                {
-                    throw NcException("NcException", "NNDataSet::NNDataSet: Sparse data set with no actual data in NetCDF input file " + fname, __FILE__, __LINE__);    
-                }
-                
-                _vSparseIndex.resize(_sparseDataSize);
-                cout << "NNDataSet<T>::NNDataSet: " << _sparseDataSize << " total datapoints." << endl;
-                vname                           = "sparseStart" + nstring;
-                NcVar sparseStartVar            = nfc.getVar(vname);
-                if (sparseStartVar.isNull())
-                {
-                    throw NcException("NcException", "NNDataSet::NNDataSet: No sparse offset start supplied in NetCDF input file " + fname, __FILE__, __LINE__);
-                }
-                vname                           = "sparseEnd" + nstring;
-                NcVar sparseEndVar              = nfc.getVar(vname);
-                if (sparseEndVar.isNull())
-                {
-                    throw NcException("NcException", "NNDataSet::NNDataSet: No sparse data end supplied in NetCDF input file " + fname, __FILE__, __LINE__);
-                }
-                vname                           = "sparseIndex" + nstring;
-                NcVar sparseIndexVar            = nfc.getVar(vname);
-                if (sparseIndexVar.isNull())
-                {
-                    throw NcException("NcException", "NNDataSet::NNDataSet: No sparse data indices supplied in NetCDF input file " + fname, __FILE__, __LINE__);
-                }
-
-                // Read data into CPU memory (account for old datasets using 32-bit indices)
-                NcType vStartType               = sparseStartVar.getType();
-                if (vStartType == ncUint)
-                {
-                    vector<uint32_t> vTempSparseStart(examplesDim.getSize());
-                    sparseStartVar.getVar((uint32_t*)vTempSparseStart.data());
-                    copy(vTempSparseStart.begin(), vTempSparseStart.end(), _vSparseStart.begin());
-                }
-                else
-                    sparseStartVar.getVar((uint64_t*)_vSparseStart.data());
-                    
-                NcType vEndType                 = sparseEndVar.getType();    
-                if (vEndType == ncUint)
-                {
-                    vector<uint32_t> vTempSparseEnd(examplesDim.getSize());
-                    sparseEndVar.getVar((uint32_t*)vTempSparseEnd.data());
-                    copy(vTempSparseEnd.begin(), vTempSparseEnd.end(), _vSparseEnd.begin());
-                }
-                else                    
-                    sparseEndVar.getVar((uint64_t*)_vSparseEnd.data());
-                sparseIndexVar.getVar((uint32_t*)_vSparseIndex.data());
-                              
-                // If not Boolean, then read templated point values
-                if (!(_attributes & NNDataSetEnums::Boolean))
-                {                     
-                    vname                       = "sparseData" + nstring;
-                    NcVar sparseDataVar         = nfc.getVar(vname);
-                    if (sparseDataVar.isNull())
-                    {
-                        throw NcException("NcException", "NNDataSet::NNDataSet: No sparse data located in NetCDF input file " + fname, __FILE__, __LINE__);
-                    }  
-                    _vSparseData.resize(sparseDataDim.getSize());
-                    sparseDataVar.getVar(_vSparseData.data());                     
-                }
+                // Read compressed boolean data, expanded below
+                vBooleanData.resize(dataDim.getSize());
+                dataVar.getVar(vBooleanData.data());
             }
             else
             {
-                // Non-sparse data
-                _stride                         = _width * _height * _length;
-                vname                           = "dataDim" + nstring;
-                NcDim dataDim                   = nfc.getDim(vname); 
-                if (dataDim.isNull())
-                {
-                        throw NcException("NcException", "NNDataSet::NNDataSet: No data dimensons located in NetCDF input file " + fname, __FILE__, __LINE__);
-                }  
-                vname                           = "data" + nstring;
-                NcVar dataVar                   = nfc.getVar(vname);
-                
-                if (_attributes & NNDataSetEnums::Boolean)
-                {
+                _vData.resize(dataDim.getSize());   
+                dataVar.getVar(_vData.data());
+            }   
+        }
 
-                    // Read compressed boolean data then expand it
-                    uint64_t size               = (uint64_t)_width * (uint64_t)_height * (uint64_t)_length;
-                    _vData.resize(dataDim.getSize() * size);
-                    memset(_vData.data(), 0, _vData.size() * sizeof(T));
-                    vector<T> vData(dataDim.getSize());
-                    dataVar.getVar(vData.data());
-                    for (int i = 0; i < dataDim.getSize(); i++)
-                        _vData[i * size + vData[i]] = (T)1.0;
-                }
-                else
-                {
-                    _vData.resize(dataDim.getSize());   
-                    dataVar.getVar(_vData.data());
-                }   
-            }
-            cout << "NNDataSet<T>::NNDataSet: " << examplesDim.getSize() << " examples." << endl;
+        _fileName                               = bShardable ? fname : "";
+        _fileDataSet                            = n;
+
+        // Close the file and let other datasets read while this one is decoded or expanded
+        pNfc.reset();
+        lock.unlock();
+        if (_bDeferred)
+        {
+            cout << "NNDataSet<T>::NNDataSet: Examples left in " << fname << " for each process to read its own shard." << endl;
         }
-        catch (NcException& e)
+        else if (_attributes & NNDataSetEnums::Sparse)
         {
+            DecodeSparseNetCDF(fname, _attributes, _examples, sparseBuffers, _vSparseOffset, _vSparseIndex, _vSparseData);
+            _sparseDataSize                     = _vSparseIndex.size();
+            cout << "NNDataSet<T>::NNDataSet: " << _sparseDataSize << " total datapoints." << endl;
+        }
+        else if (_attributes & NNDataSetEnums::Boolean)
+        {
+            uint64_t size                       = (uint64_t)_width * (uint64_t)_height * (uint64_t)_length;
+            _vData.resize(vBooleanData.size() * size);
+            memset(_vData.data(), 0, _vData.size() * sizeof(T));
+            for (size_t i = 0; i < vBooleanData.size(); i++)
+                _vData[i * size + vBooleanData[i]] = (T)1.0;
+        }
+        cout << "NNDataSet<T>::NNDataSet: " << _examples << " examples." << endl;
+    }
+    catch (NcException& e)
+    {
 
-            if (!bOpened)
-            {
-                cout << "Exception: NNDataSet::NNDataSet: Error opening NetCDF input file " << fname << endl;
-            }
-            else
-            {
-                cout << "Exception: " << e.what() << endl;
-            }
-            bResult                             = false;                             
+        if (!bOpened)
+        {
+            cout << "Exception: NNDataSet::NNDataSet: Error opening NetCDF input file " << fname << endl;
         }
+        else
+        {
+            cout << "Exception: " << e.what() << endl;
+        }
+        bResult                                 = false;                             
     }
-    
+    return bResult;
+}
+
+// Shares the header read by process 0 with every process, exiting if any dataset failed to read
+template<typename T> void NNDataSet<T>::FinishNetCDF(bool bResult)
+{
     // Gather and test on result
-    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, getGpu()._comm);
     if (!bResult)
     {
         getGpu().Shutdown();
@@ -839,64 +1269,193 @@ _pbSparseTransposedData(NULL)
 
     // Receive data attributes from master process
     MPI_Bcast_string(_name);
-    MPI_Bcast(&_dataType, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&_attributes, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&_examples, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&_dimensions, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&_width, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&_height, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&_length, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&_sparseDataSize, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&_dataType, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&_attributes, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&_examples, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&_dimensions, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&_width, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&_height, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&_length, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&_sparseDataSize, 1, MPI_UINT64_T, 0, getGpu()._comm);
+    MPI_Bcast(&_bSparseStatistics, 1, MPI_C_BOOL, 0, getGpu()._comm);
+    MPI_Bcast_string(_fileName);
+    MPI_Bcast(&_fileDataSet, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(&_bDeferred, 1, MPI_C_BOOL, 0, getGpu()._comm);
     
     
-    // Generate sparse data lookup tables if data is sparse
+    // Generate sparse data lookup tables if data is sparse, unless they were stored in the file.  Only process 0
+    // holds any examples until the dataset is sharded, so the other processes just need the maximum and density
     if (_attributes & NNDataSetEnums::Sparse)
     {
-        CalculateSparseDatapointCounts();
+        if (_bSparseStatistics)
+        {
+            double sparseDensity                = _sparseDensity;
+            MPI_Bcast(&_maxSparseDatapoints, 1, MPI_UINT32_T, 0, getGpu()._comm);
+            MPI_Bcast(&sparseDensity, 1, MPI_DOUBLE, 0, getGpu()._comm);
+            _sparseDensity                      = sparseDensity;
+            _vSparseDatapointCount.resize((uint64_t)_width * _height * _length);
+            if (getGpu()._id == 0)
+                printf("NNDataSet::NNDataSet: Using stored sparse datapoint counts for dataset %s.\n", _name.c_str());
+        }
+        else
+            CalculateSparseDatapointCounts();
     }
 }
 
+// One-dimensional sparse dataset built from examples already in memory, example i spanning [vSparseStart[i], vSparseEnd[i])
+// of vSparseIndex and, unless the dataset is Boolean (pvSparseData is NULL), of *pvSparseData.  Like a dataset read from
+// NetCDF, only process 0 holds the examples until the dataset is sharded
+template<typename T> NNDataSet<T>::NNDataSet(const string& name, NNDataSetEnums::DataType dataType, uint32_t width, const vector<uint32_t>& vSparseStart,
+                                             const vector<uint32_t>& vSparseEnd, const vector<uint32_t>& vSparseIndex, const vector<T>* pvSparseData) :
+_pbData(NULL),
+_pbSparseData(NULL),
+_pbSparseTransposedData(NULL),
+_fileDataSet(0),
+_bDeferred(false)
+{
+    bool bResult                                = true;
+    if (getGpu()._id == 0)
+    {
+        _name                                   = name;
+        _dataType                               = dataType;
+        _attributes                             = NNDataSetEnums::Sparse | (pvSparseData ? 0 : NNDataSetEnums::Boolean);
+        _examples                               = vSparseStart.size();
+        _dimensions                             = 1;
+        _width                                  = width;
+        _height                                 = 1;
+        _length                                 = 1;
+        if ((_examples == 0) || (vSparseEnd.size() != _examples) || (_width == 0))
+        {
+            printf("NNDataSet::NNDataSet: Invalid sparse examples supplied for dataset %s.\n", _name.c_str());
+            bResult                             = false;
+        }
+
+        // Copy examples into CSR order
+        _vSparseOffset.resize(_examples + 1);
+        _vSparseOffset[0]                       = 0;
+        for (uint32_t i = 0; bResult && (i < _examples); i++)
+        {
+            if ((vSparseEnd[i] < vSparseStart[i]) || (vSparseEnd[i] > vSparseIndex.size()) || (pvSparseData && (vSparseEnd[i] > pvSparseData->size())))
+            {
+                printf("NNDataSet::NNDataSet: Sparse start/end out of range for example %u of dataset %s.\n", i, _name.c_str());
+                bResult                         = false;
+                break;
+            }
+            _vSparseIndex.insert(_vSparseIndex.end(), vSparseIndex.begin() + vSparseStart[i], vSparseIndex.begin() + vSparseEnd[i]);
+            if (pvSparseData)
+                _vSparseData.insert(_vSparseData.end(), pvSparseData->begin() + vSparseStart[i], pvSparseData->begin() + vSparseEnd[i]);
+            _vSparseOffset[i + 1]               = _vSparseIndex.size();
+        }
+        _sparseDataSize                         = _vSparseIndex.size();
+    }
+    FinishNetCDF(bResult);
+}
+
+// Empty dataset filled in by ReadNetCDF for LoadNetCDF, or directly by NNStreamingDataSet
+template<typename T> NNDataSet<T>::NNDataSet() :
+_pbData(NULL),
+_pbSparseData(NULL),
+_pbSparseTransposedData(NULL),
+_fileDataSet(0),
+_bDeferred(false)
+{
+}
+
 template<typename T> bool NNDataSet<T>::Rename(const string& name)
 {
     _name                                       = name;
     return true;
 }
 
+// Smallest amount of work (indices or datapoints) worth handing to another host thread
+static const uint64_t MinHostThreadWork         = 1 << 20;
+
+// Returns how many host threads to use for the given number of MinHostThreadWork-sized pieces of work
+static uint32_t GetHostThreads(uint64_t pieces)
+{
+    return max((uint32_t)1, (uint32_t)min(pieces, (uint64_t)std::thread::hardware_concurrency()));
+}
+
+// Runs f(t) for t in [0, threads), on the calling thread for t == 0
+static void RunHostThreads(uint32_t threads, const std::function<void(uint32_t)>& f)
+{
+    vector<std::thread> vThread;
+    for (uint32_t t = 1; t < threads; t++)
+        vThread.push_back(std::thread(f, t));
+    f(0);
+    for (auto& t : vThread)
+        t.join();
+}
+
 // Counts the number of each type of sparse datapoint for generating transposed matrices during backpropagation
 template<typename T> bool NNDataSet<T>::CalculateSparseDatapointCounts()
 {
     if (_attributes & NNDataSetEnums::Sparse)
     {
-        // Calculate individual counts for each datapoint
+        // Counts stored at ingest stay valid until the examples are edited or split across processes
+        if (_bSparseStatistics)
+            return true;
+
+        // Calculate individual counts for each datapoint, histogramming slices of the indices on separate threads.
+        // Each thread gets at least N indices so partial counts stay proportional to the indices themselves
         uint64_t N                              = _width * _height * _length;
-        _vSparseDatapointCount.resize(N);     
-        std::fill(_vSparseDatapointCount.begin(), _vSparseDatapointCount.end(), 0);    
-        for (auto x : _vSparseIndex)
+        uint64_t size                           = _vSparseIndex.size();
+        uint32_t threads                        = GetHostThreads(size / max(N, (uint64_t)MinHostThreadWork));
+        vector<vector<uint64_t> > vPartialCount(threads);
+        vector<uint32_t> vOutOfRange(threads, 0);
+        RunHostThreads(threads, [&](uint32_t t)
         {
-            // Check for boundary violation and stop before it corrupts CPU memory
-            if (x >= _width)
+            vector<uint64_t>& vCount            = vPartialCount[t];
+            vCount.resize(N, 0);
+            for (uint64_t i = (size * t) / threads; i < (size * (t + 1)) / threads; i++)
+            {
+                // Check for boundary violation and stop before it corrupts CPU memory
+                uint32_t x                      = _vSparseIndex[i];
+                if (x >= _width)
+                {
+                    vOutOfRange[t]              = x;
+                    return;
+                }
+                vCount[x]++;
+            }
+        });
+        for (uint32_t t = 0; t < threads; t++)
+        {
+            if (vOutOfRange[t] != 0)
             {
                 if (getGpu()._id == 0)
                 {
-                    printf("NNDataSet::CalculateSparseDatapointCounts: Out of range index (%u) in sparse dataset %s.\n", x, _name.c_str());
+                    printf("NNDataSet::CalculateSparseDatapointCounts: Out of range index (%u) in sparse dataset %s.\n", vOutOfRange[t], _name.c_str());
                 }
                 getGpu().Shutdown();
                 exit(-1);
             }
-            _vSparseDatapointCount[x]++;
         }
+
+        // Sum partial counts, each thread owning a slice of the datapoints
+        _vSparseDatapointCount.resize(N);
+        RunHostThreads(threads, [&](uint32_t t)
+        {
+            for (uint64_t x = (N * t) / threads; x < (N * (t + 1)) / threads; x++)
+            {
+                uint64_t count                  = 0;
+                for (auto& vCount : vPartialCount)
+                    count                      += vCount[x];
+                _vSparseDatapointCount[x]       = count;
+            }
+        });
         
         // Locate example with the highest datapoint count to test eligibility for forward SparseCalculateZ kernel
         _maxSparseDatapoints                    = 0;
-        for (size_t i = 0; i < _vSparseStart.size(); i++)
+        for (size_t i = 1; i < _vSparseOffset.size(); i++)
         {
-            uint64_t count                      = _vSparseEnd[i] - _vSparseStart[i];
+            uint64_t count                      = _vSparseOffset[i] - _vSparseOffset[i - 1];
             if (count > _maxSparseDatapoints) 
             {
                 _maxSparseDatapoints            = count;
             }
         }
-        MPI_Allreduce(MPI_IN_PLACE, &_maxSparseDatapoints, 1, MPI_UINT32_T, MPI_MAX, MPI_COMM_WORLD);
+        MPI_Allreduce(MPI_IN_PLACE, &_maxSparseDatapoints, 1, MPI_UINT32_T, MPI_MAX, getGpu()._comm);
 
         // Print warning message if too many datapoints for sparse kernels
         uint32_t maxSparse      = (_attributes & NNDataSetEnums::Boolean) ? getGpu()._maxSparse : getGpu()._maxSparseAnalog;
@@ -928,6 +1487,7 @@ template<typename T> bool NNDataSet<T>::GenerateSparseTransposedMatrix(uint32_t
     if (_bDirty)
     {
         CalculateSparseDatapointCounts();
+        _mSparseTransposedStartCache.clear();
         _bDirty                             = false;
     }
     
@@ -942,15 +1502,44 @@ template<typename T> bool NNDataSet<T>::GenerateSparseTransposedMatrix(uint32_t
     if (_pbSparseTransposedEnd == NULL)
         _pbSparseTransposedEnd              = new GpuBuffer<uint32_t>(N);      
   
-    // Set batch and calculate new sparse matrix data
+    // Set batch and reuse the sparse matrix layout if it was already calculated for this batch size and layer,
+    // as happens when switching between training and validation batch sizes
     _batch                                  = batch;
+    NNSparseTransposedKey key               = make_tuple(batch, Nx, Ny, Nz, Nw);
     uint32_t offset                         = 0;
-    for (size_t i = 0; i < _vSparseDatapointCount.size(); i++)
+    auto it                                 = _mSparseTransposedStartCache.find(key);
+    if (it != _mSparseTransposedStartCache.end())
     {
-        _vSparseTransposedStart[i]          = offset;
-        
-        offset                             += (batch < _vSparseDatapointCount[i]) ? batch : _vSparseDatapointCount[i];
-        offset                              = ((offset + 31) >> 5) << 5;
+        _vSparseTransposedStart             = it->second.first;
+        offset                              = it->second.second;
+    }
+    else
+    {
+        // Each datapoint's column holds up to batch entries padded to 32, so its start is a prefix sum computed
+        // with one pass per thread over a slice of the datapoints, summing slice totals in between
+        uint64_t size                       = _vSparseDatapointCount.size();
+        uint32_t threads                    = GetHostThreads(size / MinHostThreadWork);
+        vector<uint32_t> vSliceOffset(threads + 1, 0);
+        RunHostThreads(threads, [&](uint32_t t)
+        {
+            uint32_t sliceOffset            = 0;
+            for (uint64_t i = (size * t) / threads; i < (size * (t + 1)) / threads; i++)
+                sliceOffset                += (((batch < _vSparseDatapointCount[i]) ? batch : _vSparseDatapointCount[i]) + 31) & ~31;
+            vSliceOffset[t + 1]             = sliceOffset;
+        });
+        for (uint32_t t = 0; t < threads; t++)
+            vSliceOffset[t + 1]            += vSliceOffset[t];
+        RunHostThreads(threads, [&](uint32_t t)
+        {
+            uint32_t sliceOffset            = vSliceOffset[t];
+            for (uint64_t i = (size * t) / threads; i < (size * (t + 1)) / threads; i++)
+            {
+                _vSparseTransposedStart[i]  = sliceOffset;
+                sliceOffset                += (((batch < _vSparseDatapointCount[i]) ? batch : _vSparseDatapointCount[i]) + 31) & ~31;
+            }
+        });
+        offset                              = vSliceOffset[threads];
+        _mSparseTransposedStartCache[key]   = make_pair(_vSparseTransposedStart, offset);
     }
     _pbSparseTransposedStart->Upload(_vSparseTransposedStart.data());
         
@@ -1003,25 +1592,177 @@ template<typename T> bool NNDataSet<T>::GenerateDenoisingData()
         }
         return false;
     }
-    curandGenerateUniform(getGpu()._RNG, _pbDenoisingRandom->_pDevData, _vSparseIndex.size());
-    return true;
-}
+    curandGenerateUniform(getGpu()._RNG, _pbDenoisingRandom->_pDevData, _vSparseIndex.size());
+    return true;
+}
+
+// Reads the examples left in the NetCDF file with process 0, as if they had been read when the dataset was loaded
+template<typename T> void NNDataSet<T>::ReadDeferredNetCDF()
+{
+    if (!_bDeferred)
+        return;
+    _bDeferred                                  = false;
+    if ((getGpu()._id == 0) && !ReadNetCDF(_fileName, _fileDataSet, false))
+    {
+        getGpu().Shutdown();
+        exit(-1);
+    }
+}
+
+// True when there are several processes and none of them has changed its examples since they were read from the
+// NetCDF file, so every process can read its own shard from it
+template<typename T> bool NNDataSet<T>::ReadsShardsFromFile()
+{
+    bool bFile                                  = !_fileName.empty();
+    MPI_Allreduce(MPI_IN_PLACE, &bFile, 1, MPI_C_BOOL, MPI_LAND, getGpu()._comm);
+    return bFile && (getGpu()._numprocs > 1);
+}
+
+// Frees the examples held by this process, on the CPU and the GPU
+template<typename T> void NNDataSet<T>::DeleteShard()
+{
+    delete _pbData;
+    delete _pbSparseOffset;
+    delete _pbSparseIndex;
+    delete _pbSparseData;
+    _pbData                                     = NULL;
+    _pbSparseOffset                             = NULL;
+    _pbSparseIndex                              = NULL;
+    _pbSparseData                               = NULL;
+    vector<T>().swap(_vData);
+    vector<uint64_t>().swap(_vSparseOffset);
+    vector<uint32_t>().swap(_vSparseIndex);
+    vector<T>().swap(_vSparseData);
+}
+
+// Every process reads its own shard straight from the NetCDF file: a contiguous range of examples for data sharding,
+// or the datapoints of every example within [_minX, _maxX) for model sharding.  This replaces whatever the process
+// held before, so process 0 never has to hold the whole dataset or send each process its shard
+template<typename T> bool NNDataSet<T>::ReadShardNetCDF(NNDataSetEnums::Sharding sharding)
+{
+    DeleteShard();
+    _bDeferred                                  = false;
+    _bSparseStatistics                          = false;
+    _bDirty                                     = true;
+    _sharding                                   = sharding;
+    uint64_t stride                             = (uint64_t)_width * _height * _length;
+    uint32_t first                              = 0;
+    uint32_t last                               = _examples;
+    uint64_t minX                               = 0;
+    uint64_t maxX                               = stride;
+    if (sharding == NNDataSetEnums::Model)
+    {
+        _minX                                   = ((size_t)_width * (size_t)getGpu()._id) / (size_t)getGpu()._numprocs;
+        _maxX                                   = ((size_t)_width * (size_t)(getGpu()._id + 1)) / (size_t)getGpu()._numprocs;
+        minX                                    = _minX;
+        maxX                                    = _maxX;
+        if (getGpu()._id == 0)
+            printf("NNDataSet<T>::Shard: Model Sharding dataset %s across all GPUs from %s.\n", _name.c_str(), _fileName.c_str());
+    }
+    else
+    {
+        GetDataShard(_examples, getGpu()._id, getGpu()._numprocs, first, _localExamples);
+        last                                    = first + _localExamples;
+        if (getGpu()._id == 0)
+            printf("NNDataSet<T>::Shard: Data Sharding dataset %s across all GPUs from %s.\n", _name.c_str(), _fileName.c_str());
+    }
+
+    bool bResult                                = true;
+    try
+    {
+        std::unique_lock<std::mutex> lock(getNetCDFMutex());
+        NcFile nfc(_fileName.c_str(), NcFile::read);
+        if (_attributes & NNDataSetEnums::Sparse)
+        {
+            ReadSparseShardNetCDF(nfc, _fileName, _fileDataSet, _attributes, first, last, minX, maxX, _vSparseOffset, _vSparseIndex, _vSparseData);
+        }
+        else
+        {
+            _stride                             = stride;
+            ReadDataShardNetCDF(nfc, _fileName, _fileDataSet, _attributes, stride, first, last, minX, maxX, _vData);
+        }
+    }
+    catch (NcException& e)
+    {
+        cout << "Exception: NNDataSet::Shard: Error reading shard of dataset " << _name << " from NetCDF input file " << _fileName << ": " << e.what() << endl;
+        bResult                                 = false;
+    }
+
+    // Gather and test on result
+    MPI_Allreduce(MPI_IN_PLACE, &bResult, 1, MPI_C_BOOL, MPI_LAND, getGpu()._comm);
+    if (!bResult)
+    {
+        getGpu().Shutdown();
+        exit(-1);
+    }
+
+    // Allocate GPU buffers and upload
+    if (_attributes & NNDataSetEnums::Sparse)
+    {
+        _pbSparseOffset                         = new GpuBuffer<uint64_t>((uint64_t)_vSparseOffset.size());
+        _pbSparseIndex                          = new GpuBuffer<uint32_t>((uint64_t)_vSparseIndex.size());
+        _pbSparseOffset->Upload(_vSparseOffset.data());
+        _pbSparseIndex->Upload(_vSparseIndex.data());
+        if (!(_attributes & NNDataSetEnums::Boolean))
+        {
+            _pbSparseData                       = new GpuBuffer<T>((uint64_t)_vSparseData.size());
+            _pbSparseData->Upload(_vSparseData.data());
+        }
+    }
+    else
+    {
+        _pbData                                 = new GpuBuffer<T>((uint64_t)_vData.size());
+        _pbData->Upload(_vData.data());
+    }
+    return true;
+}
+
+template<typename T> bool NNDataSet<T>::UnShard()
+{
+    // Examples still in the NetCDF file are read by process 0
+    ReadDeferredNetCDF();
+
+    // Shards read from the NetCDF file are dropped and process 0 reads the whole file again
+    if ((_sharding != NNDataSetEnums::None) && ReadsShardsFromFile())
+    {
+        DeleteShard();
+        _sharding                               = NNDataSetEnums::None;
+        _bDeferred                              = true;
+        _bDirty                                 = true;
+        ReadDeferredNetCDF();
+        if (getGpu()._id == 0)
+        {
+            if (_attributes & NNDataSetEnums::Sparse)
+            {
+                _pbSparseOffset                 = new GpuBuffer<uint64_t>((uint64_t)_examples + 1);
+                _pbSparseIndex                  = new GpuBuffer<uint32_t>((uint64_t)_vSparseIndex.size());
+                _pbSparseOffset->Upload(_vSparseOffset.data());
+                _pbSparseIndex->Upload(_vSparseIndex.data());
+                if (!(_attributes & NNDataSetEnums::Boolean))
+                {
+                    _pbSparseData               = new GpuBuffer<T>((uint64_t)_vSparseData.size());
+                    _pbSparseData->Upload(_vSparseData.data());
+                }
+            }
+            else
+            {
+                _pbData                         = new GpuBuffer<T>((uint64_t)_vData.size());
+                _pbData->Upload(_vData.data());
+            }
+        }
+        return true;
+    }
 
-template<typename T> bool NNDataSet<T>::UnShard()
-{
     if (_sharding == NNDataSetEnums::Model)
     {
         if (_attributes & NNDataSetEnums::Sparse)
         {
             // Download all current data from all GPUs
-            _pbSparseStart->Download(_vSparseStart.data());
-            _pbSparseEnd->Download(_vSparseEnd.data());
+            _pbSparseOffset->Download(_vSparseOffset.data());
             _pbSparseIndex->Download(_vSparseIndex.data());
-            delete _pbSparseStart;
-            delete _pbSparseEnd;
+            delete _pbSparseOffset;
             delete _pbSparseIndex;
-            _pbSparseStart                      = NULL;
-            _pbSparseEnd                        = NULL;
+            _pbSparseOffset                     = NULL;
             _pbSparseIndex                      = NULL;                 
             if (!(_attributes & NNDataSetEnums::Boolean))
             {
@@ -1040,30 +1781,29 @@ template<typename T> bool NNDataSet<T>::UnShard()
             vector<uint32_t> vSparseCount(_examples);
             for (uint32_t i = 0; i < _examples; i++)
             {
-                vSparseCount[i]                 = _vSparseEnd[i] - _vSparseStart[i];
+                vSparseCount[i]                 = _vSparseOffset[i + 1] - _vSparseOffset[i];
             }
             uint64_t datapoints                 = _vSparseIndex.size();
-            MPI_Reduce((getGpu()._id == 0) ? MPI_IN_PLACE : &datapoints, &datapoints, 1, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
-            MPI_Reduce((getGpu()._id == 0) ? MPI_IN_PLACE : vSparseCount.data(), vSparseCount.data(), _examples, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
+            MPI_Reduce((getGpu()._id == 0) ? MPI_IN_PLACE : &datapoints, &datapoints, 1, MPI_UINT64_T, MPI_SUM, 0, getGpu()._comm);
+            MPI_Reduce((getGpu()._id == 0) ? MPI_IN_PLACE : vSparseCount.data(), vSparseCount.data(), _examples, MPI_UINT32_T, MPI_SUM, 0, getGpu()._comm);
             
             // Unshard
             if (getGpu()._id == 0)
             {
-                vector<uint64_t> vTempSparseStart(_examples);
+                vector<uint64_t> vTempSparseOffset(_examples + 1);
                 vector<uint64_t> vTempSparseEnd(_examples);
                 vector<uint32_t> vTempSparseIndex(datapoints);
                 vector<T> vTempSparseData;
                 if (!(_attributes & NNDataSetEnums::Boolean))
                     vTempSparseData.resize(datapoints);
-                vTempSparseStart[0]             = 0;
                 uint64_t start                  = 0;
                 
                 // Initialize counts and generate local shard
                 for (int i = 0; i < _examples; i++)
                 {
-                    vTempSparseStart[i]         = start;
+                    vTempSparseOffset[i]        = start;
                     vTempSparseEnd[i]           = start;
-                    for (uint64_t j = _vSparseStart[i]; j < _vSparseEnd[i]; j++)
+                    for (uint64_t j = _vSparseOffset[i]; j < _vSparseOffset[i + 1]; j++)
                     {
                         vTempSparseIndex[vTempSparseEnd[i]] 
                                                 = _vSparseIndex[vTempSparseEnd[i]];
@@ -1076,21 +1816,22 @@ template<typename T> bool NNDataSet<T>::UnShard()
                     }
                     start                      += vSparseCount[i];
                 }
+                vTempSparseOffset[_examples]    = start;
                 
                 // Gather remaining shards
                 for (uint32_t i = 1; i < getGpu()._numprocs; i++)
                 {
                     uint64_t size;
                     MPI_Status status;
-                    MPI_Recv(vSparseCount.data(), _examples, MPI_UINT32_T, i, 0, MPI_COMM_WORLD, &status);
-                    MPI_Recv(&size, 1, MPI_UINT64_T, i, 0, MPI_COMM_WORLD, &status);
+                    MPI_Recv(vSparseCount.data(), _examples, MPI_UINT32_T, i, 0, getGpu()._comm, &status);
+                    MPI_Recv(&size, 1, MPI_UINT64_T, i, 0, getGpu()._comm, &status);
                     vector<uint32_t> vPeerSparseIndex(size);
-                    MPI_Recv(&vPeerSparseIndex, size, MPI_UINT32_T, i, 0, MPI_COMM_WORLD, &status);
+                    MPI_Recv(&vPeerSparseIndex, size, MPI_UINT32_T, i, 0, getGpu()._comm, &status);
                     vector<T> vPeerSparseData;
                     if (!(_attributes & NNDataSetEnums::Boolean))
                     {
                         vPeerSparseData.resize(size);
-                        MPI_Recv(vPeerSparseData.data(), size, getMPIDataType(_dataType), i, 0, MPI_COMM_WORLD, &status);
+                        MPI_Recv(vPeerSparseData.data(), size, getMPIDataType(_dataType), i, 0, getGpu()._comm, &status);
                     }
                     
                     // Merge local data                
@@ -1111,18 +1852,15 @@ template<typename T> bool NNDataSet<T>::UnShard()
                         }
                     }                
                 }
-                _vSparseStart                   = vTempSparseStart;
-                _vSparseEnd                     = vTempSparseEnd;
+                _vSparseOffset                  = vTempSparseOffset;
                 _vSparseIndex                   = vTempSparseIndex;
                 if (!(_attributes & NNDataSetEnums::Boolean))
                     _vSparseData                = vTempSparseData;
                     
                 // Reallocate GPU data
-                _pbSparseStart                  = new GpuBuffer<uint64_t>(_examples);
-                _pbSparseEnd                    = new GpuBuffer<uint64_t>(_examples);
+                _pbSparseOffset                 = new GpuBuffer<uint64_t>((uint64_t)_examples + 1);
                 _pbSparseIndex                  = new GpuBuffer<uint32_t>((uint64_t)_vSparseIndex.size());
-                _pbSparseStart->Upload(_vSparseStart.data());
-                _pbSparseEnd->Upload(_vSparseEnd.data());
+                _pbSparseOffset->Upload(_vSparseOffset.data());
                 _pbSparseIndex->Upload(_vSparseIndex.data());
                 if (!(_attributes & NNDataSetEnums::Boolean))
                 {
@@ -1134,12 +1872,12 @@ template<typename T> bool NNDataSet<T>::UnShard()
             {
                 // Send all data to master
                 uint64_t size                   = _vSparseIndex.size();
-                MPI_Send(vSparseCount.data(), _examples, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD);
-                MPI_Send(&size, 1, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD);
-                MPI_Send(_vSparseIndex.data(), size, MPI_UINT32_T, 0, 0, MPI_COMM_WORLD);
+                MPI_Send(vSparseCount.data(), _examples, MPI_UINT64_T, 0, 0, getGpu()._comm);
+                MPI_Send(&size, 1, MPI_UINT64_T, 0, 0, getGpu()._comm);
+                MPI_Send(_vSparseIndex.data(), size, MPI_UINT32_T, 0, 0, getGpu()._comm);
                 if (!(_attributes & NNDataSetEnums::Boolean))
                 {
-                    MPI_Send(_vSparseData.data(), size, getMPIDataType(_dataType), 0, 0, MPI_COMM_WORLD);
+                    MPI_Send(_vSparseData.data(), size, getMPIDataType(_dataType), 0, 0, getGpu()._comm);
                 }              
             }
         }
@@ -1172,7 +1910,7 @@ template<typename T> bool NNDataSet<T>::UnShard()
                     int size                    = _examples * slice;
                     vTempData.resize(size);
                     MPI_Status status;
-                    MPI_Recv(vTempData.data(), size, getMPIDataType(_dataType), i, 0, MPI_COMM_WORLD, &status);
+                    MPI_Recv(vTempData.data(), size, getMPIDataType(_dataType), i, 0, getGpu()._comm, &status);
                     for (int j = 0; j < _examples; j++)
                         for (int k = 0; k < slice; k++)
                             _vData[j * _width + xmin + k]  
@@ -1187,14 +1925,26 @@ template<typename T> bool NNDataSet<T>::UnShard()
             else
             {
                 // Send all data to master
-                MPI_Send(_vData.data(), _vData.size(), getMPIDataType(_dataType), 0, 0, MPI_COMM_WORLD);
+                MPI_Send(_vData.data(), _vData.size(), getMPIDataType(_dataType), 0, 0, getGpu()._comm);
             }       
             
         }
     }
-    else if (_sharding == NNDataSetEnums::Data)
+    else if ((_sharding == NNDataSetEnums::Data) && !(_attributes & NNDataSetEnums::Sparse))
     {
-    
+        // Drop GPU copy of the local examples
+        delete _pbData;
+        _pbData                                 = NULL;
+
+        // Append the example ranges of the remaining processes to process 0's, in order
+        GatherDataShards(_vData, _examples, _stride, getMPIDataType(_dataType), getGpu()._comm);
+
+        // Reallocate GPU data
+        if (getGpu()._id == 0)
+        {
+            _pbData                             = new GpuBuffer<T>((uint64_t)_vData.size());
+            _pbData->Upload(_vData.data());
+        }
     }
     _sharding = NNDataSetEnums::None;
 
@@ -1211,9 +1961,17 @@ template<typename T> bool NNDataSet<T>::Shard(NNDataSetEnums::Sharding sharding)
     if (sharding == _sharding)
         return true;
 
+    // Read each process's shard straight from the NetCDF file when the examples still match it
+    if ((sharding != NNDataSetEnums::None) && ReadsShardsFromFile())
+        return ReadShardNetCDF(sharding);
+
     // Merge previously sharded data to process 0, undoing any existing sharding
     UnShard();
 
+    // Split examples no longer match the datapoint counts stored at ingest
+    if (getGpu()._numprocs > 1)
+        _bSparseStatistics                      = false;
+
     // Shard data out to all processes
     if (sharding == NNDataSetEnums::Model)
     {
@@ -1230,14 +1988,13 @@ template<typename T> bool NNDataSet<T>::Shard(NNDataSetEnums::Sharding sharding)
                 {
                     uint32_t xmin               = ((size_t)_width * i) / (size_t)getGpu()._numprocs;
                     uint32_t xmax               = ((size_t)_width * (i + 1)) / (size_t)getGpu()._numprocs;
-                    vector<uint64_t> vLocalSparseStart(_examples);
-                    vector<uint64_t> vLocalSparseEnd(_examples);
+                    vector<uint64_t> vLocalSparseOffset(_examples + 1);
                     vector<uint32_t> vLocalSparseIndex;
                     vector<T> vLocalSparseData;
+                    vLocalSparseOffset[0]       = 0;
                     for (int j = 0; j < _examples; j++)
                     {
-                        vLocalSparseStart[j]    = vLocalSparseIndex.size();
-                        for (uint64_t k = _vSparseStart[j]; k < _vSparseEnd[j]; k++)
+                        for (uint64_t k = _vSparseOffset[j]; k < _vSparseOffset[j + 1]; k++)
                         {
                             if ((_vSparseIndex[k] >= xmin) && (_vSparseIndex[k] < xmax)) 
                             {
@@ -1248,36 +2005,33 @@ template<typename T> bool NNDataSet<T>::Shard(NNDataSetEnums::Sharding sharding)
                                 }
                             }
                         }               
-                        vLocalSparseEnd[j]          = vLocalSparseIndex.size(); 
+                        vLocalSparseOffset[j + 1]   = vLocalSparseIndex.size(); 
                     }
 
                     // Broadcast index data to appropriate process
                     uint64_t size                   = vLocalSparseIndex.size();
 
-                    MPI_Send(&size, 1, MPI_UINT64_T, i, 0, MPI_COMM_WORLD);
-                    MPI_Send(vLocalSparseStart.data(), _examples, MPI_UINT64_T, i, 0, MPI_COMM_WORLD);
-                    MPI_Send(vLocalSparseEnd.data(), _examples, MPI_UINT64_T, i, 0, MPI_COMM_WORLD);
-                    MPI_Send(vLocalSparseIndex.data(), size, MPI_UINT32_T, i, 0, MPI_COMM_WORLD);
+                    MPI_Send(&size, 1, MPI_UINT64_T, i, 0, getGpu()._comm);
+                    MPI_Send(vLocalSparseOffset.data(), _examples + 1, MPI_UINT64_T, i, 0, getGpu()._comm);
+                    MPI_Send(vLocalSparseIndex.data(), size, MPI_UINT32_T, i, 0, getGpu()._comm);
                     if (!(_attributes & NNDataSetEnums::Boolean))
                     {
                         MPI_Datatype mpiType        = getMPIDataType(_dataType);
-                        MPI_Send(vLocalSparseData.data(), size, mpiType, i, 0, MPI_COMM_WORLD);
+                        MPI_Send(vLocalSparseData.data(), size, mpiType, i, 0, getGpu()._comm);
                     }
                 }
 
                 // Finally derive local shard
-                vector<uint64_t> vTempSparseStart	= _vSparseStart;
-                vector<uint64_t> vTempSparseEnd     = _vSparseEnd;
+                vector<uint64_t> vTempSparseOffset  = _vSparseOffset;
                 vector<uint32_t> vTempSparseIndex   = _vSparseIndex;
                 vector<T> vTempSparseData           = _vSparseData;
                 _vSparseIndex.resize(0);
                 _vSparseData.resize(0);
-                _vSparseStart.resize(_examples);
-                _vSparseEnd.resize(_examples);
+                _vSparseOffset.resize(_examples + 1);
+                _vSparseOffset[0]                   = 0;
                 for (uint32_t j = 0; j < _examples; j++)
                 {
-                    _vSparseStart[j]                = _vSparseIndex.size();
-                    for (uint64_t k = vTempSparseStart[j]; k < vTempSparseEnd[j]; k++)
+                    for (uint64_t k = vTempSparseOffset[j]; k < vTempSparseOffset[j + 1]; k++)
                     {
                         if ((vTempSparseIndex[k] >= _minX) && (vTempSparseIndex[k] < _maxX))
                         {
@@ -1288,7 +2042,7 @@ template<typename T> bool NNDataSet<T>::Shard(NNDataSetEnums::Sharding sharding)
                             }
                         }
                     }               
-                    _vSparseEnd[j]                  = _vSparseIndex.size(); 
+                    _vSparseOffset[j + 1]           = _vSparseIndex.size(); 
                 }
             }
             else
@@ -1296,29 +2050,25 @@ template<typename T> bool NNDataSet<T>::Shard(NNDataSetEnums::Sharding sharding)
                 // Receive sharded data from master process
                 uint64_t size;
                 MPI_Status status;
-                MPI_Recv(&size, 1, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD, &status);
-                _vSparseStart.resize(_examples);
-                _vSparseEnd.resize(_examples);
+                MPI_Recv(&size, 1, MPI_UINT64_T, 0, 0, getGpu()._comm, &status);
+                _vSparseOffset.resize(_examples + 1);
                 _vSparseIndex.resize(size);
-                MPI_Recv(_vSparseStart.data(), _examples, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD, &status);
-                MPI_Recv(_vSparseEnd.data(), _examples, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD, &status);
-                MPI_Recv(_vSparseIndex.data(), size, MPI_UINT32_T, 0, 0, MPI_COMM_WORLD, &status); 
+                MPI_Recv(_vSparseOffset.data(), _examples + 1, MPI_UINT64_T, 0, 0, getGpu()._comm, &status);
+                MPI_Recv(_vSparseIndex.data(), size, MPI_UINT32_T, 0, 0, getGpu()._comm, &status); 
                 if (!(_attributes & NNDataSetEnums::Boolean))
                 {
                     MPI_Datatype mpiType            = getMPIDataType(_dataType);
                     _vSparseData.resize(size);
-                    MPI_Recv(_vSparseData.data(), size, mpiType, 0, 0, MPI_COMM_WORLD, &status);
+                    MPI_Recv(_vSparseData.data(), size, mpiType, 0, 0, getGpu()._comm, &status);
                 }
             }
 
             // Allocate GPU buffers and upload
-            _pbSparseStart                          = new GpuBuffer<uint64_t>(_examples);
-            _pbSparseEnd                            = new GpuBuffer<uint64_t>(_examples);
+            _pbSparseOffset                         = new GpuBuffer<uint64_t>((uint64_t)_examples + 1);
             _pbSparseIndex                          = new GpuBuffer<uint32_t>((uint64_t)_vSparseIndex.size());
-            _pbSparseStart->Upload(_vSparseStart.data());
-            _pbSparseEnd->Upload(_vSparseEnd.data());
+            _pbSparseOffset->Upload(_vSparseOffset.data());
             //for (int i = 0; i < 100; i++)
-            //    printf("%6d %12d %12d\n", i, _vSparseStart[i], _vSparseEnd[i]);
+            //    printf("%6d %12d %12d\n", i, _vSparseOffset[i], _vSparseOffset[i + 1]);
             //exit(-1);
             _pbSparseIndex->Upload(_vSparseIndex.data());
             if (!(_attributes & NNDataSetEnums::Boolean))
@@ -1350,9 +2100,9 @@ template<typename T> bool NNDataSet<T>::Shard(NNDataSetEnums::Sharding sharding)
 
                     // Broadcast index data to appropriate process
                     uint64_t size                   = vLocalData.size();
-                    MPI_Send(&size, 1, MPI_UINT64_T, i, 0, MPI_COMM_WORLD);
+                    MPI_Send(&size, 1, MPI_UINT64_T, i, 0, getGpu()._comm);
                     MPI_Datatype mpiType            = getMPIDataType(_dataType);
-                    MPI_Send(vLocalData.data(), _examples * slice, mpiType, i, 0, MPI_COMM_WORLD);
+                    MPI_Send(vLocalData.data(), _examples * slice, mpiType, i, 0, getGpu()._comm);
                 }
 
                 // Finally derive local shard
@@ -1372,10 +2122,10 @@ template<typename T> bool NNDataSet<T>::Shard(NNDataSetEnums::Sharding sharding)
                 // Receive sharded data from master process
                 uint64_t size;
                 MPI_Status status;
-                MPI_Recv(&size, 1, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD, &status);
+                MPI_Recv(&size, 1, MPI_UINT64_T, 0, 0, getGpu()._comm, &status);
                 _vData.resize(size);
                 MPI_Datatype mpiType                = getMPIDataType(_dataType);
-                MPI_Recv(_vData.data(), size, mpiType, 0, 0, MPI_COMM_WORLD, &status);
+                MPI_Recv(_vData.data(), size, mpiType, 0, 0, getGpu()._comm, &status);
             }
 
 
@@ -1386,47 +2136,13 @@ template<typename T> bool NNDataSet<T>::Shard(NNDataSetEnums::Sharding sharding)
     }
     else if (sharding == NNDataSetEnums::Data)
     {
-        // Interleave examples
+        // Split examples into contiguous ranges, as when each process reads its own from NetCDF
         _sharding                                   = NNDataSetEnums::Data;
-        uint32_t segment                            = _examples / getGpu()._numprocs;
-        uint32_t remainder                          = _examples % getGpu()._numprocs;  
-        _localExamples                              = segment + (remainder > getGpu()._id);         
+        uint32_t first;
+        GetDataShard(_examples, getGpu()._id, getGpu()._numprocs, first, _localExamples);
         if (getGpu()._id == 0)
-        {
-            // Send sharded data to other processes
             printf("NNDataSet<T>::Shard: Data Sharding dataset %s across all GPUs.\n", _name.c_str());
-            for (size_t i = 1; i < getGpu()._numprocs; i++)
-            {
-                uint32_t localExamples          = segment + (remainder > i);
-                vector<T> vLocalData(localExamples * _stride);
-                T* pData                        = vLocalData.data();
-                uint32_t position               = i;
-                for (size_t j = position; j < _examples; j+= getGpu()._numprocs)
-                {
-                    memcpy(pData, &_vData[j * _stride], _stride * sizeof(T));
-                    pData                      += _stride;
-                }
-                
-                // Broadcast index data to appropriate process
-                uint64_t size                   = vLocalData.size();
-                MPI_Send(&size, 1, MPI_UINT64_T, i, 0, MPI_COMM_WORLD);
-                MPI_Datatype mpiType            = getMPIDataType(_dataType);
-                MPI_Send(vLocalData.data(), localExamples * _stride, mpiType, i, 0, MPI_COMM_WORLD);
-            }
-            
-            // Finally, derive local segment
-            _vData.resize(_localExamples * _stride);
-        }
-        else
-        {
-                // Receive sharded data from master process
-                uint64_t size;
-                MPI_Status status;
-                MPI_Recv(&size, 1, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD, &status);
-                _vData.resize(size);
-                MPI_Datatype mpiType                = getMPIDataType(_dataType);
-                MPI_Recv(_vData.data(), size, mpiType, 0, 0, MPI_COMM_WORLD, &status);
-        }
+        ScatterDataShards(_vData, _examples, _stride, getMPIDataType(_dataType), getGpu()._comm);
         
         // Allocate space then upload data to GPU memory
         _pbData                                 = new GpuBuffer<T>((uint64_t)_vData.size());
@@ -1480,7 +2196,7 @@ template<typename T> bool NNDataSet<T>::SaveNetCDF(const string& fname)
     }
 
     // Gather and test on result
-    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, getGpu()._comm);
     if (!bResult)
     {
         getGpu().Shutdown();
@@ -1587,7 +2303,7 @@ template<typename T> bool NNDataSet<T>::WriteNetCDF(NcFile& nfc, const string& f
                 {
                     throw NcException("NcException", "NNDataSet::WriteNetCDF: Failed to create dataset sparse start variable NetCDF file " + fname, __FILE__, __LINE__);
                 }
-                sparseStartVar.putVar(_vSparseStart.data());
+                sparseStartVar.putVar(_vSparseOffset.data());
                 
                 vname                       = "sparseEnd" + nstring;
                 NcVar sparseEndVar          = nfc.addVar(vname, ncUint, examplesDim);
@@ -1595,7 +2311,7 @@ template<typename T> bool NNDataSet<T>::WriteNetCDF(NcFile& nfc, const string& f
                 {
                     throw NcException("NcException", "NNDataSet::WriteNetCDF: Failed to create dataset sparse end variable NetCDF file " + fname, __FILE__, __LINE__);
                 }
-                sparseEndVar.putVar(_vSparseEnd.data());
+                sparseEndVar.putVar(_vSparseOffset.data() + 1);
  
                 vname                       = "sparseIndex" + nstring;
                 NcVar sparseIndexVar        = nfc.addVar(vname, ncUint64, sparseDataDim);
@@ -1636,8 +2352,7 @@ template<typename T> NNDataSet<T>::~NNDataSet()
 {
     if (_attributes & NNDataSetEnums::Sparse)
     {
-        delete _pbSparseStart;
-        delete _pbSparseEnd;
+        delete _pbSparseOffset;
         delete _pbSparseTransposedStart;
         delete _pbSparseTransposedEnd;
         delete _pbSparseIndex;
@@ -1705,7 +2420,7 @@ bool SaveNetCDF(const string& fname, vector<NNDataSetBase*> vDataSet)
     }
 
     // Gather and test on result
-    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, getGpu()._comm);
     if (!bResult)
     {
         getGpu().Shutdown();
@@ -1721,6 +2436,19 @@ bool SaveNetCDF(const string& fname, vector<NNDataSetBase*> vDataSet)
     return bResult;
 }
 
+// Creates an empty NNDataSet<T> for LoadNetCDF along with the steps that read it on process 0 and share it with
+// every process, so data sets of different types can be read by the same pool of threads
+template<typename T> struct NNDataSetLoader
+{
+    static NNDataSetBase* Create(const string& fname, uint32_t n, vector<std::function<bool()> >& vRead, vector<std::function<void(bool)> >& vFinish)
+    {
+        NNDataSet<T>* pDataSet              = new NNDataSet<T>();
+        vRead.push_back([pDataSet, fname, n]() { return pDataSet->ReadNetCDF(fname, n); });
+        vFinish.push_back([pDataSet](bool bResult) { pDataSet->FinishNetCDF(bResult); });
+        return pDataSet;
+    }
+};
+
 vector<NNDataSetBase*> LoadNetCDF(const string& fname) 
 {
     vector<NNDataSetBase*> vDataSet;
@@ -1790,7 +2518,7 @@ vector<NNDataSetBase*> LoadNetCDF(const string& fname)
     }
 
     // Gather and test on result
-    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, getGpu()._comm);
     if (!bResult)
     {
         getGpu().Shutdown();
@@ -1798,12 +2526,14 @@ vector<NNDataSetBase*> LoadNetCDF(const string& fname)
     }
 
     uint32_t size                           = vDataType.size();
-    MPI_Bcast(&size, 1, MPI_UINT32_T, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&size, 1, MPI_UINT32_T, 0, getGpu()._comm);
     vDataType.resize(size);
-    MPI_Bcast(vDataType.data(), size, MPI_UINT32_T, 0, MPI_COMM_WORLD);
+    MPI_Bcast(vDataType.data(), size, MPI_UINT32_T, 0, getGpu()._comm);
 
     
-    // Read data sets into vDataSet
+    // Create empty data sets of the right types in vDataSet
+    vector<std::function<bool()> > vRead;
+    vector<std::function<void(bool)> > vFinish;
     for (int i = 0; i < vDataType.size(); i++)
     {
 
@@ -1813,28 +2543,28 @@ vector<NNDataSetBase*> LoadNetCDF(const string& fname)
         switch (vDataType[i])
         {
             case NNDataSetEnums::UInt:
-                pDataSet                    = new NNDataSet<uint32_t>(fname, i);
+                pDataSet                    = NNDataSetLoader<uint32_t>::Create(fname, i, vRead, vFinish);
                 break;
 
             case NNDataSetEnums::Int:
-                pDataSet                    = new NNDataSet<long>(fname, i);
+                pDataSet                    = NNDataSetLoader<long>::Create(fname, i, vRead, vFinish);
                 break;
 
             case NNDataSetEnums::Float:
-                pDataSet                    = new NNDataSet<float>(fname, i);
+                pDataSet                    = NNDataSetLoader<float>::Create(fname, i, vRead, vFinish);
                 break;
 
             case NNDataSetEnums::Double:
-                pDataSet                    = new NNDataSet<double>(fname, i);
+                pDataSet                    = NNDataSetLoader<double>::Create(fname, i, vRead, vFinish);
                 break;
 
             case NNDataSetEnums::Char:
-                pDataSet                    = new NNDataSet<char>(fname, i);
+                pDataSet                    = NNDataSetLoader<char>::Create(fname, i, vRead, vFinish);
                 break;
 
             case NNDataSetEnums::UChar:
             case NNDataSetEnums::RGB8:
-                pDataSet                    = new NNDataSet<uint8_t>(fname, i);
+                pDataSet                    = NNDataSetLoader<uint8_t>::Create(fname, i, vRead, vFinish);
                 break;
 
             default:
@@ -1845,8 +2575,554 @@ vector<NNDataSetBase*> LoadNetCDF(const string& fname)
         vDataSet.push_back(pDataSet);
     }
 
+    // Read all data sets with a pool of threads on process 0.  Reads from the file are serialized by the
+    // NetCDF lock, but each data set's decoding and expansion overlaps the reads of the others
+    vector<uint8_t> vResult(vDataSet.size(), 1);
+    if (getGpu()._id == 0)
+    {
+        uint32_t threads                    = min((uint32_t)vDataSet.size(), max(1u, std::thread::hardware_concurrency()));
+        std::atomic<uint32_t> next(0);
+        vector<std::thread> vThread;
+        for (uint32_t t = 0; t < threads; t++)
+        {
+            vThread.push_back(std::thread([&]()
+            {
+                uint32_t i;
+                while ((i = next++) < vRead.size())
+                    vResult[i]              = vRead[i]();
+            }));
+        }
+        for (auto& t : vThread)
+            t.join();
+    }
+
+    // Share headers in order with all processes
+    for (uint32_t i = 0; i < vFinish.size(); i++)
+        vFinish[i](vResult[i] != 0);
+
+    return vDataSet;
+}
+
+vector<NNDataSetBase*> LoadSparseData(const string& name, uint32_t width, const vector<uint32_t>& vSparseStart, const vector<uint32_t>& vSparseEnd, const vector<uint32_t>& vSparseIndex, const vector<float>* pvSparseData)
+{
+    vector<NNDataSetBase*> vDataSet;
+    if (pvSparseData)
+        vDataSet.push_back(new NNDataSet<float>(name, NNDataSetEnums::Float, width, vSparseStart, vSparseEnd, vSparseIndex, pvSparseData));
+    else
+        vDataSet.push_back(new NNDataSet<uint32_t>(name, NNDataSetEnums::UInt, width, vSparseStart, vSparseEnd, vSparseIndex, NULL));
+    return vDataSet;
+}
+
+template<typename T> NNStreamingDataSet<T>::NNStreamingDataSet(std::shared_ptr<NNDataSetStream> pStream, uint32_t index) :
+_pStream(pStream),
+_pWindow(NULL),
+_windowGeneration(0)
+{
+    _index                                      = index;
+    _bStreaming                                 = true;
+    _pStream->AddDataSet(this);
+}
+
+template<typename T> NNStreamingDataSet<T>::~NNStreamingDataSet()
+{
+    _pStream->RemoveDataSet(this);
+    delete _pWindow;
+}
+
+template<typename T> void NNStreamingDataSet<T>::ReadShard(NcFile& nfc, const string& fname, uint32_t examples)
+{
+    vector<uint64_t> vSparseOffset;
+    vector<uint32_t> vSparseIndex;
+    vector<T> vSparseData;
+    ReadSparseNetCDF(nfc, fname, _index, _attributes, examples, vSparseOffset, vSparseIndex, vSparseData);
+    this->AppendShard(vSparseOffset, vSparseIndex, vSparseData, examples);
+}
+
+template<typename T> uint32_t NNStreamingDataSet<T>::EnsureResident(uint32_t position, uint32_t batch)
+{
+    if (!_pStream->Advance(position, batch, getGpu()._randomSeed))
+    {
+        printf("NNStreamingDataSet::EnsureResident: Unable to stream dataset %s on process %d.\n", _name.c_str(), getGpu()._id);
+        getGpu().Shutdown();
+        exit(-1);
+    }
+    if ((_pWindow == NULL) || (_windowGeneration != _pStream->GetGeneration()))
+    {
+        RefreshWindow();
+        _windowGeneration                       = _pStream->GetGeneration();
+    }
+    return _pStream->GetWindowPosition(position);
+}
+
+// Rebuilds the GPU-resident window from the stream's resident groups, keeping only this process's slice of
+// each example when model sharded
+template<typename T> void NNStreamingDataSet<T>::RefreshWindow()
+{
+    if (_pWindow == NULL)
+    {
+        _pWindow                                = new NNDataSet<T>();
+        _pWindow->_name                         = _name;
+        _pWindow->_dataType                     = _dataType;
+        _pWindow->_attributes                   = _attributes;
+        _pWindow->_dimensions                   = _dimensions;
+        _pWindow->_width                        = _width;
+        _pWindow->_height                       = _height;
+        _pWindow->_length                       = _length;
+    }
+    NNDataSet<T>* w                             = _pWindow;
+    w->_sharding                                = _sharding;
+    w->_minX                                    = _minX;
+    w->_maxX                                    = _maxX;
+    bool bBoolean                               = _attributes & NNDataSetEnums::Boolean;
+    this->GatherResident(_pStream->GetResidentGroups(), (_sharding == NNDataSetEnums::Model), _minX, _maxX, w->_vSparseOffset, w->_vSparseIndex, w->_vSparseData);
+    w->_examples                                = w->_vSparseOffset.size() - 1;
+    w->_localExamples                           = w->_examples;
+    w->_sparseDataSize                          = w->_vSparseIndex.size();
+
+    // Upload, reallocating only when sizes change
+    if ((w->_pbSparseOffset == NULL) || (w->_pbSparseOffset->_length != w->_vSparseOffset.size()))
+    {
+        delete w->_pbSparseOffset;
+        w->_pbSparseOffset                      = new GpuBuffer<uint64_t>((uint64_t)w->_vSparseOffset.size());
+    }
+    w->_pbSparseOffset->Upload(w->_vSparseOffset.data());
+    if ((w->_pbSparseIndex == NULL) || (w->_pbSparseIndex->_length != w->_vSparseIndex.size()))
+    {
+        delete w->_pbSparseIndex;
+        w->_pbSparseIndex                       = new GpuBuffer<uint32_t>((uint64_t)w->_vSparseIndex.size());
+    }
+    w->_pbSparseIndex->Upload(w->_vSparseIndex.data());
+    if (!bBoolean)
+    {
+        if ((w->_pbSparseData == NULL) || (w->_pbSparseData->_length != w->_vSparseData.size()))
+        {
+            delete w->_pbSparseData;
+            w->_pbSparseData                    = new GpuBuffer<T>((uint64_t)w->_vSparseData.size());
+        }
+        w->_pbSparseData->Upload(w->_vSparseData.data());
+    }
+
+    // Denoising randoms are per datapoint, so regenerate them for the new window
+    if (w->_bDenoising)
+    {
+        delete w->_pbDenoisingRandom;
+        w->_pbDenoisingRandom                   = NULL;
+        w->_bDenoising                          = false;
+    }
+    if (_bDenoising)
+    {
+        w->_pbDenoisingRandom                   = new GpuBuffer<NNFloat>((uint64_t)w->_vSparseIndex.size());
+        w->_bDenoising                          = true;
+        w->GenerateDenoisingData();
+    }
+
+    // Force the transposed matrix to be regenerated
+    w->_bDirty                                  = true;
+}
+
+template<typename T> bool NNStreamingDataSet<T>::SetDenoising(bool flag)
+{
+    if (flag != _bDenoising)
+    {
+        _bDenoising                             = flag;
+        _windowGeneration                       = 0;
+    }
+    return true;
+}
+
+template<typename T> bool NNStreamingDataSet<T>::GenerateDenoisingData()
+{
+    if (_pWindow && _bDenoising)
+        return _pWindow->GenerateDenoisingData();
+    return true;
+}
+
+template<typename T> bool NNStreamingDataSet<T>::Shard(NNDataSetEnums::Sharding sharding)
+{
+    if (sharding == _sharding)
+        return true;
+
+    if (sharding == NNDataSetEnums::Data)
+    {
+        if (getGpu()._id == 0)
+            printf("NNStreamingDataSet::Shard: Data sharding is not supported for streamed dataset %s.\n", _name.c_str());
+        return false;
+    }
+
+    // Every process reads the shards itself, so only the window has to change
+    _sharding                                   = sharding;
+    if (sharding == NNDataSetEnums::Model)
+    {
+        _minX                                   = ((size_t)_width * (size_t)getGpu()._id) / (size_t)getGpu()._numprocs;
+        _maxX                                   = ((size_t)_width * (size_t)(getGpu()._id + 1)) / (size_t)getGpu()._numprocs;
+    }
+    else
+    {
+        _minX                                   = 0;
+        _maxX                                   = _width;
+    }
+    _windowGeneration                           = 0;
+    return true;
+}
+
+template<typename T> bool NNStreamingDataSet<T>::UnShard()
+{
+    return Shard(NNDataSetEnums::None);
+}
+
+template<typename T> vector<tuple<uint64_t, uint64_t> > NNStreamingDataSet<T>::getMemoryUsage()
+{
+    // Resident groups live in CPU memory, the window on the GPU (staging is owned by the prefetch thread)
+    uint64_t cpuMemory                          = this->GetResidentMemory();
+    uint64_t gpuMemory                          = 0;
+    if (_pWindow)
+    {
+        gpuMemory                              += _pWindow->_vSparseOffset.size() * sizeof(uint64_t);
+        gpuMemory                              += _pWindow->_vSparseIndex.size() * sizeof(uint32_t);
+        gpuMemory                              += _pWindow->_vSparseData.size() * sizeof(T);
+    }
+
+    // Gather and return memory usage per process
+    vector<tuple<uint64_t, uint64_t> > vResult(getGpu()._numprocs);
+    vResult[getGpu()._id]                       = make_tuple(cpuMemory, gpuMemory);
+    MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, vResult.data(), sizeof(tuple<uint64_t, uint64_t>), MPI_BYTE, getGpu()._comm);
+    return vResult;
+}
+
+template<typename T> bool NNStreamingDataSet<T>::SaveNetCDF(const string& fname)
+{
+    if (getGpu()._id == 0)
+        printf("NNStreamingDataSet::SaveNetCDF: Streamed dataset %s cannot be saved to %s.\n", _name.c_str(), fname.c_str());
+    return false;
+}
+
+template<typename T> bool NNStreamingDataSet<T>::WriteNetCDF(NcFile& nfc, const string& fname, const uint32_t n)
+{
+    if (getGpu()._id == 0)
+        printf("NNStreamingDataSet::WriteNetCDF: Streamed dataset %s cannot be written to %s.\n", _name.c_str(), fname.c_str());
+    return false;
+}
+
+// Returns the largest number of datapoints in any one example of sparse dataset n without reading its indices
+static uint32_t ReadMaxSparseDatapointsNetCDF(NcFile& nfc, const string& fname, uint32_t n, uint64_t examples)
+{
+    string nstring                              = to_string(n);
+
+    // Use the maximum stored at ingest when there is one
+    NcGroupAtt maxSparseDatapointsAtt           = nfc.getAtt("maxSparseDatapoints" + nstring);
+    if (!maxSparseDatapointsAtt.isNull())
+    {
+        uint32_t maxSparseDatapoints;
+        maxSparseDatapointsAtt.getValues(&maxSparseDatapoints);
+        return maxSparseDatapoints;
+    }
+
+    uint32_t sparseEncoding                     = NNDataSetEnums::RawIndex;
+    NcGroupAtt sparseEncodingAtt                = nfc.getAtt("sparseEncoding" + nstring);
+    if (!sparseEncodingAtt.isNull())
+        sparseEncodingAtt.getValues(&sparseEncoding);
+
+    vector<uint64_t> vStart(examples);
+    vector<uint64_t> vEnd(examples);
+    vector<string> vName;
+    if (sparseEncoding == NNDataSetEnums::DeltaVarint)
+        vName                                   = { "sparseOffset" + nstring };
+    else
+        vName                                   = { "sparseStart" + nstring, "sparseEnd" + nstring };
+    for (size_t i = 0; i < vName.size(); i++)
+    {
+        NcVar var                               = nfc.getVar(vName[i]);
+        if (var.isNull())
+        {
+            throw NcException("NcException", "ReadMaxSparseDatapointsNetCDF: No " + vName[i] + " supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+        vector<uint64_t> vValue(var.getDim(0).getSize());
+        if (var.getType() == ncUint)
+        {
+            vector<uint32_t> vTempValue(vValue.size());
+            var.getVar((uint32_t*)vTempValue.data());
+            copy(vTempValue.begin(), vTempValue.end(), vValue.begin());
+        }
+        else
+            var.getVar((uint64_t*)vValue.data());
+        // Offsets hold one more entry than there are examples
+        uint64_t entries                        = (vName.size() == 1) ? examples + 1 : examples;
+        if (vValue.size() < entries)
+        {
+            throw NcException("NcException", "ReadMaxSparseDatapointsNetCDF: Too few entries in " + vName[i] + " in NetCDF input file " + fname, __FILE__, __LINE__);
+        }
+
+        // A single offsets array supplies both starts and ends
+        if (vName.size() == 1)
+        {
+            copy(vValue.begin(), vValue.begin() + examples, vStart.begin());
+            copy(vValue.begin() + 1, vValue.begin() + examples + 1, vEnd.begin());
+        }
+        else
+            copy(vValue.begin(), vValue.begin() + examples, (i == 0) ? vStart.begin() : vEnd.begin());
+    }
+
+    uint64_t maxDatapoints                      = 0;
+    for (uint64_t i = 0; i < examples; i++)
+    {
+        if (vEnd[i] > vStart[i])
+            maxDatapoints                       = max(maxDatapoints, vEnd[i] - vStart[i]);
+    }
+    return (uint32_t)maxDatapoints;
+}
+
+vector<NNDataSetBase*> LoadStreamingNetCDF(const string& directory, uint32_t windowShards, bool bShuffle)
+{
+    vector<NNDataSetBase*> vDataSet;
+    vector<string> vShardFile;
+    vector<uint32_t> vShardExamples;
+    vector<string> vName;
+    vector<uint32_t> vDataType;
+    vector<uint32_t> vAttributes;
+    vector<uint32_t> vDimensions;
+    vector<uint32_t> vWidth;
+    vector<uint32_t> vHeight;
+    vector<uint32_t> vLength;
+    vector<uint64_t> vSparseDataSize;
+    vector<uint32_t> vMaxSparseDatapoints;
+    bool bResult                                = true;
+
+    // Scan shard headers with process 0
+    if (getGpu()._id == 0)
+    {
+        DIR* pDir                               = opendir(directory.c_str());
+        if (pDir == NULL)
+        {
+            cout << "LoadStreamingNetCDF: Unable to open shard directory " << directory << endl;
+            bResult                             = false;
+        }
+        else
+        {
+            struct dirent* pEntry;
+            while ((pEntry = readdir(pDir)) != NULL)
+            {
+                string name                     = pEntry->d_name;
+                if (has_suffix(name, ".nc"))
+                    vShardFile.push_back(directory + "/" + name);
+            }
+            closedir(pDir);
+            sort(vShardFile.begin(), vShardFile.end());
+            if (vShardFile.size() == 0)
+            {
+                cout << "LoadStreamingNetCDF: No NetCDF shards found in directory " << directory << endl;
+                bResult                         = false;
+            }
+        }
+
+        string fname;
+        try
+        {
+            for (size_t f = 0; bResult && (f < vShardFile.size()); f++)
+            {
+                fname                           = vShardFile[f];
+                NcFile nfc(fname.c_str(), NcFile::read);
+                NcGroupAtt dataSetsAtt          = nfc.getAtt("datasets");
+                if (dataSetsAtt.isNull())
+                {
+                    throw NcException("NcException", "LoadStreamingNetCDF: No datasets count supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+                }
+                uint32_t datasets;
+                dataSetsAtt.getValues(&datasets);
+                if ((f > 0) && (datasets != vName.size()))
+                {
+                    throw NcException("NcException", "LoadStreamingNetCDF: Mismatched datasets count in NetCDF input file " + fname, __FILE__, __LINE__);
+                }
+
+                uint32_t shardExamples          = 0;
+                for (uint32_t i = 0; i < datasets; i++)
+                {
+                    string nstring              = to_string(i);
+                    string name;
+                    uint32_t dataType, attributes, dimensions, width, height = 1, length = 1;
+                    NcGroupAtt nameAtt          = nfc.getAtt("name" + nstring);
+                    NcGroupAtt dataTypeAtt      = nfc.getAtt("dataType" + nstring);
+                    NcGroupAtt attributesAtt    = nfc.getAtt("attributes" + nstring);
+                    NcGroupAtt dimensionsAtt    = nfc.getAtt("dimensions" + nstring);
+                    NcGroupAtt widthAtt         = nfc.getAtt("width" + nstring);
+                    NcDim examplesDim           = nfc.getDim("examplesDim" + nstring);
+                    if (nameAtt.isNull() || dataTypeAtt.isNull() || attributesAtt.isNull() || dimensionsAtt.isNull() || widthAtt.isNull() || examplesDim.isNull())
+                    {
+                        throw NcException("NcException", "LoadStreamingNetCDF: Incomplete header for dataset " + nstring + " in NetCDF input file " + fname, __FILE__, __LINE__);
+                    }
+                    nameAtt.getValues(name);
+                    dataTypeAtt.getValues(&dataType);
+                    attributesAtt.getValues(&attributes);
+                    dimensionsAtt.getValues(&dimensions);
+                    widthAtt.getValues(&width);
+                    if (dimensions > 1)
+                        nfc.getAtt("height" + nstring).getValues(&height);
+                    if (dimensions > 2)
+                        nfc.getAtt("length" + nstring).getValues(&length);
+                    if (!(attributes & NNDataSetEnums::Sparse))
+                    {
+                        throw NcException("NcException", "LoadStreamingNetCDF: Dataset " + name + " is not sparse in NetCDF input file " + fname, __FILE__, __LINE__);
+                    }
+
+                    // All datasets in a shard describe the same examples
+                    uint32_t examples           = examplesDim.getSize();
+                    if (examples == 0)
+                    {
+                        throw NcException("NcException", "LoadStreamingNetCDF: Zero-valued Examples count in NetCDF input file " + fname, __FILE__, __LINE__);
+                    }
+                    if ((i > 0) && (examples != shardExamples))
+                    {
+                        throw NcException("NcException", "LoadStreamingNetCDF: Mismatched examples count for dataset " + name + " in NetCDF input file " + fname, __FILE__, __LINE__);
+                    }
+                    shardExamples               = examples;
+
+                    // First shard defines each dataset and later ones must agree with it
+                    if (f == 0)
+                    {
+                        vName.push_back(name);
+                        vDataType.push_back(dataType);
+                        vAttributes.push_back(attributes);
+                        vDimensions.push_back(dimensions);
+                        vWidth.push_back(width);
+                        vHeight.push_back(height);
+                        vLength.push_back(length);
+                        vSparseDataSize.push_back(0);
+                        vMaxSparseDatapoints.push_back(0);
+                    }
+                    else if ((name != vName[i]) || (dataType != vDataType[i]) || (attributes != vAttributes[i]) ||
+                             (dimensions != vDimensions[i]) || (width != vWidth[i]) || (height != vHeight[i]) || (length != vLength[i]))
+                    {
+                        throw NcException("NcException", "LoadStreamingNetCDF: Dataset " + name + " in NetCDF input file " + fname + " doesn't match " + vShardFile[0], __FILE__, __LINE__);
+                    }
+
+                    NcDim sparseDataDim         = nfc.getDim("sparseDataDim" + nstring);
+                    if (sparseDataDim.isNull())
+                    {
+                        throw NcException("NcException", "LoadStreamingNetCDF: No sparse data dimensions supplied in NetCDF input file " + fname, __FILE__, __LINE__);
+                    }
+                    vSparseDataSize[i]         += sparseDataDim.getSize();
+                    vMaxSparseDatapoints[i]     = max(vMaxSparseDatapoints[i], ReadMaxSparseDatapointsNetCDF(nfc, fname, i, examples));
+                }
+                vShardExamples.push_back(shardExamples);
+            }
+        }
+        catch (NcException& e)
+        {
+            cout << "Exception: " << e.what() << endl;
+            bResult                             = false;
+        }
+
+        uint64_t examples                       = 0;
+        for (auto e : vShardExamples)
+            examples                           += e;
+        if (bResult && (examples > UINT32_MAX))
+        {
+            cout << "LoadStreamingNetCDF: Too many examples (" << examples << ") in shard directory " << directory << endl;
+            bResult                             = false;
+        }
+    }
+
+    // Gather and test on result
+    MPI_Bcast(&bResult, 1, MPI_C_BOOL, 0, getGpu()._comm);
+    if (!bResult)
+    {
+        getGpu().Shutdown();
+        exit(-1);
+    }
+
+    // Every process reads the shards itself, so share the shard list and dataset headers
+    uint32_t shards                             = vShardFile.size();
+    MPI_Bcast(&shards, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    vShardFile.resize(shards);
+    vShardExamples.resize(shards);
+    for (uint32_t i = 0; i < shards; i++)
+        MPI_Bcast_string(vShardFile[i]);
+    MPI_Bcast(vShardExamples.data(), shards, MPI_UINT32_T, 0, getGpu()._comm);
+
+    uint32_t datasets                           = vName.size();
+    MPI_Bcast(&datasets, 1, MPI_UINT32_T, 0, getGpu()._comm);
+    vName.resize(datasets);
+    vDataType.resize(datasets);
+    vAttributes.resize(datasets);
+    vDimensions.resize(datasets);
+    vWidth.resize(datasets);
+    vHeight.resize(datasets);
+    vLength.resize(datasets);
+    vSparseDataSize.resize(datasets);
+    vMaxSparseDatapoints.resize(datasets);
+    for (uint32_t i = 0; i < datasets; i++)
+        MPI_Bcast_string(vName[i]);
+    MPI_Bcast(vDataType.data(), datasets, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(vAttributes.data(), datasets, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(vDimensions.data(), datasets, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(vWidth.data(), datasets, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(vHeight.data(), datasets, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(vLength.data(), datasets, MPI_UINT32_T, 0, getGpu()._comm);
+    MPI_Bcast(vSparseDataSize.data(), datasets, MPI_UINT64_T, 0, getGpu()._comm);
+    MPI_Bcast(vMaxSparseDatapoints.data(), datasets, MPI_UINT32_T, 0, getGpu()._comm);
+
+    uint32_t examples                           = 0;
+    for (auto e : vShardExamples)
+        examples                               += e;
+    if (windowShards == 0)
+        windowShards                            = 1;
+    std::shared_ptr<NNDataSetStream> pStream(new NNDataSetStream(vShardFile, vShardExamples, windowShards, bShuffle));
+    if (getGpu()._id == 0)
+        printf("LoadStreamingNetCDF: Streaming %u examples from %u shards in %s, %u shards at a time.\n", examples, shards, directory.c_str(), windowShards);
+
+    for (uint32_t i = 0; i < datasets; i++)
+    {
+        NNStreamingDataSetBase* pDataSet        = NULL;
+        switch (vDataType[i])
+        {
+            case NNDataSetEnums::UInt:
+                pDataSet                        = new NNStreamingDataSet<uint32_t>(pStream, i);
+                break;
+
+            case NNDataSetEnums::Int:
+                pDataSet                        = new NNStreamingDataSet<long>(pStream, i);
+                break;
+
+            case NNDataSetEnums::Float:
+                pDataSet                        = new NNStreamingDataSet<float>(pStream, i);
+                break;
+
+            case NNDataSetEnums::Double:
+                pDataSet                        = new NNStreamingDataSet<double>(pStream, i);
+                break;
+
+            case NNDataSetEnums::Char:
+                pDataSet                        = new NNStreamingDataSet<char>(pStream, i);
+                break;
+
+            case NNDataSetEnums::UChar:
+            case NNDataSetEnums::RGB8:
+                pDataSet                        = new NNStreamingDataSet<uint8_t>(pStream, i);
+                break;
+
+            default:
+                printf("LoadStreamingNetCDF: invalid dataset type in shard directory %s.\n", directory.c_str());
+                getGpu().Shutdown();
+                exit(-1);
+        }
+        pDataSet->_name                         = vName[i];
+        pDataSet->_dataType                     = (NNDataSetEnums::DataType)vDataType[i];
+        pDataSet->_attributes                   = vAttributes[i];
+        pDataSet->_examples                     = examples;
+        pDataSet->_localExamples                = examples;
+        pDataSet->_dimensions                   = vDimensions[i];
+        pDataSet->_width                        = vWidth[i];
+        pDataSet->_height                       = vHeight[i];
+        pDataSet->_length                       = vLength[i];
+        pDataSet->_maxX                         = vWidth[i];
+        pDataSet->_sparseDataSize               = vSparseDataSize[i];
+        pDataSet->_maxSparseDatapoints          = vMaxSparseDatapoints[i];
+        pDataSet->_sparseDensity                = (double_t)vSparseDataSize[i] / ((double_t)examples * vWidth[i] * vHeight[i] * vLength[i]);
+        vDataSet.push_back(pDataSet);
+    }
+
     return vDataSet;
 }
+
 vector<NNDataSetBase*> LoadImageData(const string& fname) {}
 vector<NNDataSetBase*> LoadCSVData(const string& fname) {}
 vector<NNDataSetBase*> LoadJSONData(const string& fname) {}
@@ -13,6 +13,7 @@
 #ifndef NNTYPES_H
 #include <vector>
 #include <set>
+#include <map>
 
 #include <string>
 #include <iostream>
@@ -22,6 +23,7 @@
 #include <netcdf>
 #ifndef __NVCC__
 #include <tuple>
+#include <thread>
 #include <json/json.h>
 #endif
 #include <sys/time.h>
@@ -74,6 +76,16 @@ enum TrainingMode
 
 ostream& operator<< (ostream& out, const TrainingMode& e);
 
+enum LearningRateSchedule
+{
+    FixedRate = 0,
+    StepDecay = 1,
+    ExponentialDecay = 2,
+    CosineAnnealing = 3,
+};
+
+ostream& operator<< (ostream& out, const LearningRateSchedule& s);
+
 enum ErrorFunction 
 {
     L1,
@@ -129,6 +141,12 @@ ostream& operator<< (ostream& out, const PoolingFunction& p);
 #include "kernels.h"
 #include "GpuSort.h"
 #include "NNEnum.h"
+#include "NNSparseEncoding.h"
+#include "NNGradientReducer.h"
+#include "NNRingCollectives.h"
+#include "NNDataShard.h"
+#include "NNAliasTable.h"
+#include "NNBinaryArchive.h"
 #include "NNWeight.h"
 #include "NNLayer.h"
 #include "NNNetwork.h"
@@ -144,6 +162,9 @@ struct NNDataSetDimensions
     uint32_t _length;
 };
 
+// Batch size and local layer dimensions (Nx, Ny, Nz, Nw) a transposed sparse matrix layout was generated for
+typedef tuple<uint32_t, uint32_t, uint32_t, uint32_t, uint32_t> NNSparseTransposedKey;
+
 struct NNDataSetBase {
 
     string                      _name;                          // Dataset name
@@ -162,10 +183,9 @@ struct NNDataSetBase {
     uint64_t                    _sparseDataSize;                // Total sparse datapoints
     uint32_t                    _maxSparseDatapoints;           // Maximum observed sparse datapoints per example
     NNFloat                     _sparseDensity;                 // Overall sparse density (0.0 - 1.0)
-    vector<uint64_t>            _vSparseStart;                  // Vector of sparse datapoint starts per example
-    GpuBuffer<uint64_t>*        _pbSparseStart;                 // GPU copy of _vSparseStart
-    vector<uint64_t>            _vSparseEnd;                    // Vector of sparse datapoint ends per example
-    GpuBuffer<uint64_t>*        _pbSparseEnd;                   // GPU copy of _vSparseEnd
+    bool                        _bSparseStatistics;             // Datapoint counts, maximum and density are the ones stored at ingest
+    vector<uint64_t>            _vSparseOffset;                 // CSR offsets of sparse datapoints, example n spans [_vSparseOffset[n], _vSparseOffset[n + 1])
+    GpuBuffer<uint64_t>*        _pbSparseOffset;                // GPU copy of _vSparseOffset, passed to kernels as start (offset) and end (offset + 1)
     vector<uint32_t>            _vSparseIndex;                  // Vector of sparse indices
     GpuBuffer<uint32_t>*        _pbSparseIndex;                 // GPU copy of _vSparseIndex
     GpuBuffer<NNFloat>*         _pbDenoisingRandom;             // Denoising randoms 
@@ -177,10 +197,12 @@ struct NNDataSetBase {
     GpuBuffer<uint32_t>*        _pbSparseTransposedStart;
     GpuBuffer<uint32_t>*        _pbSparseTransposedEnd;
     GpuBuffer<uint32_t>*        _pbSparseTransposedIndex;
+    map<NNSparseTransposedKey, pair<vector<uint32_t>, uint32_t> > _mSparseTransposedStartCache; // Earlier _vSparseTransposedStart and index totals
 
     // States
     bool                        _bDenoising;
     bool                        _bDirty;
+    bool                        _bStreaming;                    // Examples are streamed from disk through a bounded window
     uint32_t                    _batch;
     
       
@@ -236,6 +258,9 @@ public:
     friend class NNLayer;
     friend vector<NNDataSetBase*> LoadNetCDF(const string& fname);
     friend bool SaveNetCDF(const string& fname, vector<NNDataSetBase*> vDataSet);
+    template<typename U> friend class NNStreamingDataSet;
+    template<typename U> friend struct NNDataSetLoader;
+    friend vector<NNDataSetBase*> LoadSparseData(const string& name, uint32_t width, const vector<uint32_t>& vSparseStart, const vector<uint32_t>& vSparseEnd, const vector<uint32_t>& vSparseIndex, const vector<float>* pvSparseData);
 
 private:
 
@@ -244,10 +269,21 @@ private:
     vector<T>               _vSparseData;
     GpuBuffer<T>*           _pbSparseData;
     GpuBuffer<T>*           _pbSparseTransposedData;
+    string                  _fileName;                      // NetCDF file every process can read its own shard from, empty if examples don't match one
+    uint32_t                _fileDataSet;                   // Index of this dataset within _fileName
+    bool                    _bDeferred;                     // Examples are left in _fileName until sharded or accessed
 
 
     // Force constructor private
     NNDataSet(const string& fname, uint32_t n);
+    NNDataSet();
+    NNDataSet(const string& name, NNDataSetEnums::DataType dataType, uint32_t width, const vector<uint32_t>& vSparseStart, const vector<uint32_t>& vSparseEnd, const vector<uint32_t>& vSparseIndex, const vector<T>* pvSparseData);
+    bool ReadNetCDF(const string& fname, uint32_t n, bool bDefer = true);
+    void FinishNetCDF(bool bResult);
+    void ReadDeferredNetCDF();
+    bool ReadsShardsFromFile();
+    bool ReadShardNetCDF(NNDataSetEnums::Sharding sharding);
+    void DeleteShard();
     bool Rename(const string& name);
     bool SaveNetCDF(const string& fname);
     bool WriteNetCDF(netCDF::NcFile& nfc, const string& fname, const uint32_t n);
@@ -302,36 +338,36 @@ template<typename T> bool NNDataSet<T>::LoadInputUnit(uint32_t position, uint32_
 template<typename T> bool NNDataSet<T>::LoadSparseInputUnit(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit) 
 {
     if (_attributes & NNDataSetEnums::Boolean)
-        kLoadSparseInputUnit(position, batch, stride, pUnit, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData);
+        kLoadSparseInputUnit(position, batch, stride, pUnit, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData);
     else
-        kLoadSparseAnalogInputUnit(position, batch, stride, pUnit, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, _pbSparseData->_pDevData);
+        kLoadSparseAnalogInputUnit(position, batch, stride, pUnit, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, _pbSparseData->_pDevData);
     return true;
 }
 
 template<typename T> bool NNDataSet<T>::LoadSparseDenoisedInputUnit(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit) 
 {
     if (_attributes & NNDataSetEnums::Boolean)
-        kLoadSparseDenoisedInputUnit(position, batch, stride, pUnit, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, _pbDenoisingRandom->_pDevData);
+        kLoadSparseDenoisedInputUnit(position, batch, stride, pUnit, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, _pbDenoisingRandom->_pDevData);
     else
-        kLoadSparseAnalogDenoisedInputUnit(position, batch, stride, pUnit, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, _pbSparseData->_pDevData, _pbDenoisingRandom->_pDevData);
+        kLoadSparseAnalogDenoisedInputUnit(position, batch, stride, pUnit, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, _pbSparseData->_pDevData, _pbDenoisingRandom->_pDevData);
     return true;
 }
 
 template<typename T> bool NNDataSet<T>::CalculateSparseZ(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pWeight, NNFloat* pUnit, NNFloat beta) 
 {
     if (_attributes & NNDataSetEnums::Boolean)
-        kCalculateSparseZ(position, batch, stride, pWeight, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, pUnit, beta);
+        kCalculateSparseZ(position, batch, stride, pWeight, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, pUnit, beta);
     else
-        kCalculateSparseAnalogZ(position, batch, stride, pWeight, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, _pbSparseData->_pDevData, pUnit, beta);
+        kCalculateSparseAnalogZ(position, batch, stride, pWeight, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, _pbSparseData->_pDevData, pUnit, beta);
     return true;
 }
 
 template<typename T> bool NNDataSet<T>::CalculateSparseDenoisedZ(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pWeight, NNFloat* pUnit, NNFloat beta) 
 {
     if (_attributes & NNDataSetEnums::Boolean)
-        kCalculateSparseDenoisedZ(position, batch, stride, pWeight, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, _pbDenoisingRandom->_pDevData, pUnit, beta);
+        kCalculateSparseDenoisedZ(position, batch, stride, pWeight, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, _pbDenoisingRandom->_pDevData, pUnit, beta);
     else
-        kCalculateSparseAnalogDenoisedZ(position, batch, stride, pWeight, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, _pbSparseData->_pDevData, _pbDenoisingRandom->_pDevData, pUnit, beta);
+        kCalculateSparseAnalogDenoisedZ(position, batch, stride, pWeight, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, _pbSparseData->_pDevData, _pbDenoisingRandom->_pDevData, pUnit, beta);
     return true;
 }
 
@@ -348,9 +384,9 @@ template<typename T> bool NNDataSet<T>::CalculateSparseTransposedMatrix(uint32_t
     
     // Call appropriate matrix generation kernel
     if (_attributes & NNDataSetEnums::Boolean)
-        kCalculateSparseTransposedMatrix(position, batch, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, _pbSparseTransposedEnd->_pDevData, _pbSparseTransposedIndex->_pDevData);
+        kCalculateSparseTransposedMatrix(position, batch, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, _pbSparseTransposedEnd->_pDevData, _pbSparseTransposedIndex->_pDevData);
     else
-        kCalculateSparseTransposedAnalogMatrix(position, batch, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, _pbSparseData->_pDevData, _pbSparseTransposedEnd->_pDevData, _pbSparseTransposedIndex->_pDevData, _pbSparseTransposedData->_pDevData); 
+        kCalculateSparseTransposedAnalogMatrix(position, batch, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, _pbSparseData->_pDevData, _pbSparseTransposedEnd->_pDevData, _pbSparseTransposedIndex->_pDevData, _pbSparseTransposedData->_pDevData); 
         
     return true;
 }
@@ -369,9 +405,9 @@ template<typename T> bool NNDataSet<T>::CalculateSparseTransposedDenoisedMatrix(
     
     // Call appropriate matrix generation kernel    
     if (_attributes & NNDataSetEnums::Boolean)
-        kCalculateSparseTransposedDenoisedMatrix(position, batch, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, _pbDenoisingRandom->_pDevData, _pbSparseTransposedEnd->_pDevData, _pbSparseTransposedIndex->_pDevData);
+        kCalculateSparseTransposedDenoisedMatrix(position, batch, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, _pbDenoisingRandom->_pDevData, _pbSparseTransposedEnd->_pDevData, _pbSparseTransposedIndex->_pDevData);
     else
-        kCalculateSparseTransposedAnalogDenoisedMatrix(position, batch, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, _pbSparseData->_pDevData, _pbDenoisingRandom->_pDevData, _pbSparseTransposedEnd->_pDevData, _pbSparseTransposedIndex->_pDevData, _pbSparseTransposedData->_pDevData);  
+        kCalculateSparseTransposedAnalogDenoisedMatrix(position, batch, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, _pbSparseData->_pDevData, _pbDenoisingRandom->_pDevData, _pbSparseTransposedEnd->_pDevData, _pbSparseTransposedIndex->_pDevData, _pbSparseTransposedData->_pDevData);  
     
     
 #if 0    
@@ -403,14 +439,14 @@ template<typename T> float NNDataSet<T>::CalculateL1Error(uint32_t position, uin
         bool bSparseIgnoreZero = _attributes & NNDataSetEnums::SparseIgnoreZero;
         if (_attributes & NNDataSetEnums::Boolean)
            return kCalculateSparseL1Error(position, batch, stride, pUnit, 
-                  _pbSparseStart->_pDevData, 
-                  _pbSparseEnd->_pDevData, 
+                  _pbSparseOffset->_pDevData, 
+                  _pbSparseOffset->_pDevData + 1, 
                   _pbSparseIndex->_pDevData,
                   bSparseIgnoreZero);
         else
            return kCalculateSparseAnalogL1Error(position, batch, stride, pUnit, 
-                  _pbSparseStart->_pDevData, 
-                  _pbSparseEnd->_pDevData, 
+                  _pbSparseOffset->_pDevData, 
+                  _pbSparseOffset->_pDevData + 1, 
                   _pbSparseIndex->_pDevData,
                   _pbSparseData->_pDevData,
                   bSparseIgnoreZero);  
@@ -426,14 +462,14 @@ template<typename T> float NNDataSet<T>::CalculateL2Error(uint32_t position, uin
         bool bSparseIgnoreZero = _attributes & NNDataSetEnums::SparseIgnoreZero;        
         if (_attributes & NNDataSetEnums::Boolean)
             return kCalculateSparseL2Error(position, batch, stride, pUnit, 
-                   _pbSparseStart->_pDevData, 
-                   _pbSparseEnd->_pDevData, 
+                   _pbSparseOffset->_pDevData, 
+                   _pbSparseOffset->_pDevData + 1, 
                    _pbSparseIndex->_pDevData,
                    bSparseIgnoreZero);
         else
             return kCalculateSparseAnalogL2Error(position, batch, stride, pUnit, 
-                   _pbSparseStart->_pDevData, 
-                   _pbSparseEnd->_pDevData, 
+                   _pbSparseOffset->_pDevData, 
+                   _pbSparseOffset->_pDevData + 1, 
                    _pbSparseIndex->_pDevData,
                    _pbSparseData->_pDevData,
                    bSparseIgnoreZero);    
@@ -448,8 +484,8 @@ template<typename T> float NNDataSet<T>::CalculateCrossEntropyError(uint32_t pos
     {
         bool bSparseIgnoreZero = _attributes & NNDataSetEnums::SparseIgnoreZero;    
         return kCalculateSparseCrossEntropyError(position, batch, stride, pUnit,
-               _pbSparseStart->_pDevData, 
-               _pbSparseEnd->_pDevData, 
+               _pbSparseOffset->_pDevData, 
+               _pbSparseOffset->_pDevData + 1, 
                _pbSparseIndex->_pDevData,
                bSparseIgnoreZero);
     }
@@ -463,8 +499,8 @@ template<typename T> float NNDataSet<T>::CalculateScaledMarginalCrossEntropyErro
     {
         bool bSparseIgnoreZero = _attributes & NNDataSetEnums::SparseIgnoreZero;   
         return kCalculateSparseScaledMarginalCrossEntropyError(position, batch, stride, pUnit,
-               _pbSparseStart->_pDevData, 
-               _pbSparseEnd->_pDevData, 
+               _pbSparseOffset->_pDevData, 
+               _pbSparseOffset->_pDevData + 1, 
                _pbSparseIndex->_pDevData,
                bSparseIgnoreZero);
     }
@@ -479,14 +515,14 @@ template<typename T> float NNDataSet<T>::CalculateMultinomialCrossEntropyError(u
         if (_attributes & NNDataSetEnums::Boolean)
         {
             return kCalculateSparseMultinomialCrossEntropyError(position, batch, stride, pUnit,
-                   _pbSparseStart->_pDevData, 
-                   _pbSparseEnd->_pDevData, 
+                   _pbSparseOffset->_pDevData, 
+                   _pbSparseOffset->_pDevData + 1, 
                    _pbSparseIndex->_pDevData);
         }
         else
             return kCalculateSparseAnalogMultinomialCrossEntropyError(position, batch, stride, pUnit,
-                   _pbSparseStart->_pDevData, 
-                   _pbSparseEnd->_pDevData, 
+                   _pbSparseOffset->_pDevData, 
+                   _pbSparseOffset->_pDevData + 1, 
                    _pbSparseIndex->_pDevData,
                    _pbSparseData->_pDevData);
     }
@@ -500,13 +536,13 @@ template<typename T> float NNDataSet<T>::CalculateMultinomialScaledMarginalCross
     {
         if (_attributes & NNDataSetEnums::Boolean)
             return kCalculateSparseMultinomialScaledMarginalCrossEntropyError(position, batch, stride, pUnit,
-                   _pbSparseStart->_pDevData, 
-                   _pbSparseEnd->_pDevData, 
+                   _pbSparseOffset->_pDevData, 
+                   _pbSparseOffset->_pDevData + 1, 
                    _pbSparseIndex->_pDevData);
         else
             return kCalculateSparseAnalogMultinomialScaledMarginalCrossEntropyError(position, batch, stride, pUnit,
-                   _pbSparseStart->_pDevData, 
-                   _pbSparseEnd->_pDevData, 
+                   _pbSparseOffset->_pDevData, 
+                   _pbSparseOffset->_pDevData + 1, 
                    _pbSparseIndex->_pDevData,
                    _pbSparseData->_pDevData);
     }
@@ -528,7 +564,7 @@ template<typename T> float NNDataSet<T>::CalculateDataScaledMarginalCrossEntropy
         {
             bool bSparseIgnoreZero = _attributes & NNDataSetEnums::SparseIgnoreZero;
             return kCalculateSparseDataScaledMarginalCrossEntropyError(position, batch, stride, pUnit,
-                            _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData,
+                            _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData,
                             _pbSparseData->_pDevData, bSparseIgnoreZero);
         }
     }
@@ -545,7 +581,7 @@ template<typename T> bool NNDataSet<T>::CalculateL1OutputDelta(Activation activa
     if (_attributes & NNDataSetEnums::Sparse)
     {
         bool bSparseIgnoreZero = _attributes & NNDataSetEnums::SparseIgnoreZero;
-        kCalculateSparseL1OutputDelta(activation, position, batch, stride, pUnit, pDelta, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, bSparseIgnoreZero);
+        kCalculateSparseL1OutputDelta(activation, position, batch, stride, pUnit, pDelta, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, bSparseIgnoreZero);
     }
     else
     {
@@ -559,7 +595,7 @@ template<typename T> bool NNDataSet<T>::CalculateCrossEntropyOutputDelta(Activat
     if (_attributes & NNDataSetEnums::Sparse)
     {
         bool bSparseIgnoreZero = _attributes & NNDataSetEnums::SparseIgnoreZero;
-        kCalculateSparseCrossEntropyOutputDelta(activation, position, batch, stride, pUnit, pDelta, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, bSparseIgnoreZero);
+        kCalculateSparseCrossEntropyOutputDelta(activation, position, batch, stride, pUnit, pDelta, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, bSparseIgnoreZero);
     }
     else
     {
@@ -573,7 +609,7 @@ template<typename T> bool NNDataSet<T>::CalculateScaledMarginalCrossEntropyOutpu
     if (_attributes & NNDataSetEnums::Sparse)
     {
         bool bSparseIgnoreZero = _attributes & NNDataSetEnums::SparseIgnoreZero;
-        kCalculateSparseScaledMarginalCrossEntropyOutputDelta(activation, position, batch, stride, pUnit, pDelta, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, bSparseIgnoreZero);
+        kCalculateSparseScaledMarginalCrossEntropyOutputDelta(activation, position, batch, stride, pUnit, pDelta, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, bSparseIgnoreZero);
     }
     else
     {
@@ -588,11 +624,11 @@ template<typename T> bool NNDataSet<T>::CalculateOutputDelta(Activation activati
         bool bSparseIgnoreZero = _attributes & NNDataSetEnums::SparseIgnoreZero;        
         if (_attributes & NNDataSetEnums::Boolean) 
         {
-            kCalculateSparseOutputDelta(activation, position, batch, stride, pUnit, pDelta, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, bSparseIgnoreZero);       
+            kCalculateSparseOutputDelta(activation, position, batch, stride, pUnit, pDelta, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, bSparseIgnoreZero);       
         } 
         else 
         {
-            kCalculateSparseAnalogOutputDelta(activation, position, batch, stride, pUnit,  pDelta, _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData, _pbSparseData->_pDevData, bSparseIgnoreZero);
+            kCalculateSparseAnalogOutputDelta(activation, position, batch, stride, pUnit,  pDelta, _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData, _pbSparseData->_pDevData, bSparseIgnoreZero);
         }
     } 
     else 
@@ -609,7 +645,7 @@ template<typename T> bool NNDataSet<T>::CalculateDataScaledMarginalCrossEntropyO
     {
         bool bSparseIgnoreZero = _attributes & NNDataSetEnums::SparseIgnoreZero;
         kCalculateSparseDataScaledMarginalCrossEntropyOutputDelta(activation, position, batch, stride, pUnit, pDelta,
-                        _pbSparseStart->_pDevData, _pbSparseEnd->_pDevData, _pbSparseIndex->_pDevData,
+                        _pbSparseOffset->_pDevData, _pbSparseOffset->_pDevData + 1, _pbSparseIndex->_pDevData,
                         _pbSparseData->_pDevData, bSparseIgnoreZero);
     } else {
         cout << "unsupported data format of this cost function" << endl;
@@ -625,6 +661,10 @@ vector<NNDataSetBase*> LoadImageData(const string& fname);
 vector<NNDataSetBase*> LoadCSVData(const string& fname);
 vector<NNDataSetBase*> LoadJSONData(const string& fname);
 vector<NNDataSetBase*> LoadAudioData(const string& name);
+vector<NNDataSetBase*> LoadStreamingNetCDF(const string& directory, uint32_t windowShards = 4, bool bShuffle = true);
+vector<NNDataSetBase*> LoadSparseData(const string& name, uint32_t width, const vector<uint32_t>& vSparseStart, const vector<uint32_t>& vSparseEnd, const vector<uint32_t>& vSparseIndex, const vector<float>* pvSparseData = NULL);
+
+#include "NNStreamingDataSet.h"
 
 #define NNTYPES_H
 #endif
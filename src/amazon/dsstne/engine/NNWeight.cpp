@@ -28,7 +28,9 @@ _depth(1),
 _bShared(false),
 _bTransposed(false),
 _bLocked(false),
-_norm((NNFloat)0.0)
+_norm((NNFloat)0.0),
+_inputStride(0),
+_outputStride(0)
 {
     
 }
@@ -158,6 +160,36 @@ bool LoadNNWeightDescriptorNetCDF(const string& fname, netCDF::NcFile& nc, uint3
                 wd._vWeight.resize(weightDim.getSize()); 
                 weightVar.getVar(wd._vWeight.data());
             }
+
+            // Read optimizer state if this is a training checkpoint
+            NcVar biasVelocityVar               = nc.getVar(wstring + "biasVelocity");
+            if (!biasVelocityVar.isNull())
+            {
+                wd._vBiasVelocity.resize(biasDim.getSize());
+                biasVelocityVar.getVar(wd._vBiasVelocity.data());
+            }
+            NcVar biasGradientVelocityVar       = nc.getVar(wstring + "biasGradientVelocity");
+            if (!biasGradientVelocityVar.isNull())
+            {
+                wd._vBiasGradientVelocity.resize(biasDim.getSize());
+                biasGradientVelocityVar.getVar(wd._vBiasGradientVelocity.data());
+            }
+            if (!wd._bShared)
+            {
+                NcDim weightDim                 = nc.getDim(wstring + "weightDim");
+                NcVar weightVelocityVar         = nc.getVar(wstring + "weightVelocity");
+                if (!weightVelocityVar.isNull())
+                {
+                    wd._vWeightVelocity.resize(weightDim.getSize());
+                    weightVelocityVar.getVar(wd._vWeightVelocity.data());
+                }
+                NcVar weightGradientVelocityVar = nc.getVar(wstring + "weightGradientVelocity");
+                if (!weightGradientVelocityVar.isNull())
+                {
+                    wd._vWeightGradientVelocity.resize(weightDim.getSize());
+                    weightGradientVelocityVar.getVar(wd._vWeightGradientVelocity.data());
+                }
+            }
 #if 0
             printf("Weights %d %lu %lu\n", index, _vWeight.size(), _vBias.size());
             for (int i = 0; i < 20; i++)
@@ -175,33 +207,81 @@ bool LoadNNWeightDescriptorNetCDF(const string& fname, netCDF::NcFile& nc, uint3
     return bResult;
 }
 
+static void MPI_Bcast_NNFloatVector(vector<NNFloat>& v)
+{
+    uint64_t size                           = v.size();
+    MPI_Bcast(&size, 1, MPI_UINT64_T, 0, getGpu()._comm);
+    v.resize(size);
+    MPI_Bcast(v.data(), size, MPI_FLOAT, 0, getGpu()._comm);
+}
+
 uint32_t MPI_Bcast_NNWeightDescriptor(NNWeightDescriptor& d)
 {
     MPI_Bcast_string(d._inputLayer);
     MPI_Bcast_string(d._outputLayer);
-    MPI_Bcast(&d._bShared, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._bTransposed, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._bLocked, 1, MPI_C_BOOL, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._norm, 1, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&d._bShared, 1, MPI_C_BOOL, 0, getGpu()._comm);
+    MPI_Bcast(&d._bTransposed, 1, MPI_C_BOOL, 0, getGpu()._comm);
+    MPI_Bcast(&d._bLocked, 1, MPI_C_BOOL, 0, getGpu()._comm);
+    MPI_Bcast(&d._norm, 1, MPI_FLOAT, 0, getGpu()._comm);
     MPI_Bcast_string(d._sourceInputLayer);
     MPI_Bcast_string(d._sourceOutputLayer);
-    MPI_Bcast(&d._width, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._height, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._length, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._depth, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&d._breadth, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);    
+    MPI_Bcast(&d._width, 1, MPI_UINT64_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._height, 1, MPI_UINT64_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._length, 1, MPI_UINT64_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._depth, 1, MPI_UINT64_T, 0, getGpu()._comm);
+    MPI_Bcast(&d._breadth, 1, MPI_UINT64_T, 0, getGpu()._comm);    
     
     uint64_t weights                        = d._vWeight.size(); 
-    MPI_Bcast(&weights, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&weights, 1, MPI_UINT64_T, 0, getGpu()._comm);
     d._vWeight.resize(weights);
-    MPI_Bcast(d._vWeight.data(), weights, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(d._vWeight.data(), weights, MPI_FLOAT, 0, getGpu()._comm);
     uint64_t biases                         = d._vBias.size();
-    MPI_Bcast(&biases, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&biases, 1, MPI_UINT64_T, 0, getGpu()._comm);
     d._vBias.resize(biases);
-    MPI_Bcast(d._vBias.data(), biases, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(d._vBias.data(), biases, MPI_FLOAT, 0, getGpu()._comm);
+    MPI_Bcast_NNFloatVector(d._vWeightVelocity);
+    MPI_Bcast_NNFloatVector(d._vBiasVelocity);
+    MPI_Bcast_NNFloatVector(d._vWeightGradientVelocity);
+    MPI_Bcast_NNFloatVector(d._vBiasGradientVelocity);
     return 0;
 }
 
+// Weight and bias values are stored separately from the descriptor in compact model files
+void SaveNNWeightDescriptorBinary(NNBinaryWriter& w, const NNWeightDescriptor& d)
+{
+    w.Write(d._inputLayer);
+    w.Write(d._outputLayer);
+    w.Write(d._bShared);
+    w.Write(d._bTransposed);
+    w.Write(d._bLocked);
+    w.Write(d._norm);
+    w.Write(d._sourceInputLayer);
+    w.Write(d._sourceOutputLayer);
+    w.Write(d._width);
+    w.Write(d._height);
+    w.Write(d._length);
+    w.Write(d._depth);
+    w.Write(d._breadth);
+}
+
+bool LoadNNWeightDescriptorBinary(NNBinaryReader& r, NNWeightDescriptor& d)
+{
+    r.Read(d._inputLayer);
+    r.Read(d._outputLayer);
+    r.Read(d._bShared);
+    r.Read(d._bTransposed);
+    r.Read(d._bLocked);
+    r.Read(d._norm);
+    r.Read(d._sourceInputLayer);
+    r.Read(d._sourceOutputLayer);
+    r.Read(d._width);
+    r.Read(d._height);
+    r.Read(d._length);
+    r.Read(d._depth);
+    r.Read(d._breadth);
+    return r.IsValid();
+}
+
 ostream& operator<< (ostream& out, NNWeightDescriptor& d)
 {
     if (getGpu()._id == 0)
@@ -254,7 +334,15 @@ _pbBiasGradient(NULL),
 _pbWeightVelocity(NULL),
 _pbBiasVelocity(NULL),
 _pbWeightGradientVelocity(NULL),
-_pbBiasGradientVelocity(NULL)
+_pbBiasGradientVelocity(NULL),
+_sampledColumns(0),
+_pbSampledWeight(NULL),
+_pbSampledBias(NULL),
+_pbSampledWeightGradient(NULL),
+_pbSampledWeightVelocity(NULL),
+_pbSampledBiasVelocity(NULL),
+_pbSampledWeightGradientVelocity(NULL),
+_pbSampledBiasGradientVelocity(NULL)
 {
     // Add to input and output layer lists
     inputLayer._vOutgoingLayer.push_back(&outputLayer);
@@ -427,6 +515,13 @@ NNWeight::~NNWeight()
     delete _pbBiasVelocity;    
     delete _pbBiasGradient;
     delete _pbBiasGradientVelocity;
+    delete _pbSampledWeight;
+    delete _pbSampledBias;
+    delete _pbSampledWeightGradient;
+    delete _pbSampledWeightVelocity;
+    delete _pbSampledBiasVelocity;
+    delete _pbSampledWeightGradientVelocity;
+    delete _pbSampledBiasGradientVelocity;
 }
 
 void NNWeight::ClearVelocity()
@@ -520,6 +615,14 @@ void NNWeight::RefreshState(NNNetwork* pNetwork, TrainingMode mode)
             _pbWeightVelocity               = new GpuBuffer<NNFloat>(_size);
         if (!_pbBiasVelocity)
             _pbBiasVelocity                 = new GpuBuffer<NNFloat>(_biasSize);
+
+        // Upload optimizer state restored from a training checkpoint
+        if (_vWeightVelocity.size() == _size)
+            _pbWeightVelocity->Upload(_vWeightVelocity.data());
+        if (_vBiasVelocity.size() == _biasSize)
+            _pbBiasVelocity->Upload(_vBiasVelocity.data());
+        _vWeightVelocity.clear();
+        _vBiasVelocity.clear();
             
         // Add additional buffers for AdaDelta and Adam
         if (mode == TrainingMode::AdaDelta)
@@ -528,6 +631,12 @@ void NNWeight::RefreshState(NNNetwork* pNetwork, TrainingMode mode)
                 _pbWeightGradientVelocity   = new GpuBuffer<NNFloat>(_size);
             if (!_pbBiasGradientVelocity)
                 _pbBiasGradientVelocity     = new GpuBuffer<NNFloat>(_biasSize);            
+            if (_vWeightGradientVelocity.size() == _size)
+                _pbWeightGradientVelocity->Upload(_vWeightGradientVelocity.data());
+            if (_vBiasGradientVelocity.size() == _biasSize)
+                _pbBiasGradientVelocity->Upload(_vBiasGradientVelocity.data());
+            _vWeightGradientVelocity.clear();
+            _vBiasGradientVelocity.clear();
         }
         else
         {
@@ -658,6 +767,13 @@ void NNWeight::UpdateWeights(TrainingMode trainingMode, uint32_t batch, NNFloat
     if (_bLocked)
         return; 
 
+    // Only the output units sampled for this batch have gradients when training a sampled output layer
+    if (_outputLayer._bSampled)
+    {
+        UpdateSampledWeights(trainingMode, batch, alpha, lambda, mu);
+        return;
+    }
+
     // Update weights if the original holder or unshared in general
     if (!_bShared)
     {
@@ -773,6 +889,113 @@ void NNWeight::UpdateWeights(TrainingMode trainingMode, uint32_t batch, NNFloat
     }
 }
 
+// Makes room for the weight columns of the given number of sampled output units, along with their share of
+// whatever optimizer state the training mode keeps
+void NNWeight::ReserveSampledColumns(uint32_t columns)
+{
+    bool bVelocity                              = (_pbWeightVelocity != NULL) && (_pbSampledWeightVelocity == NULL);
+    bool bGradientVelocity                      = (_pbWeightGradientVelocity != NULL) && (_pbSampledWeightGradientVelocity == NULL);
+    if ((columns <= _sampledColumns) && !bVelocity && !bGradientVelocity)
+        return;
+
+    _sampledColumns                             = max(columns, _sampledColumns);
+    uint64_t size                               = (uint64_t)_inputLayer._localStride * (uint64_t)_sampledColumns;
+    delete _pbSampledWeight;
+    delete _pbSampledBias;
+    delete _pbSampledWeightGradient;
+    delete _pbSampledWeightVelocity;
+    delete _pbSampledBiasVelocity;
+    delete _pbSampledWeightGradientVelocity;
+    delete _pbSampledBiasGradientVelocity;
+    _pbSampledWeight                            = new GpuBuffer<NNFloat>(size);
+    _pbSampledBias                              = new GpuBuffer<NNFloat>(_sampledColumns);
+    _pbSampledWeightGradient                    = new GpuBuffer<NNFloat>(size);
+    _pbSampledWeightVelocity                    = (_pbWeightVelocity != NULL) ? new GpuBuffer<NNFloat>(size) : NULL;
+    _pbSampledBiasVelocity                      = (_pbBiasVelocity != NULL) ? new GpuBuffer<NNFloat>(_sampledColumns) : NULL;
+    _pbSampledWeightGradientVelocity            = (_pbWeightGradientVelocity != NULL) ? new GpuBuffer<NNFloat>(size) : NULL;
+    _pbSampledBiasGradientVelocity              = (_pbBiasGradientVelocity != NULL) ? new GpuBuffer<NNFloat>(_sampledColumns) : NULL;
+}
+
+// Updates only the weight columns and biases of the output units sampled for this batch, which forward propagation
+// already gathered.  The optimizer state of the other units, and their weight decay, waits until they are sampled
+void NNWeight::UpdateSampledWeights(TrainingMode trainingMode, uint32_t batch, NNFloat alpha, NNFloat lambda, NNFloat mu)
+{
+    uint32_t rows                               = _inputLayer._localStride;
+    uint32_t stride                             = _outputLayer._localStride;
+    uint32_t samples                            = _outputLayer._samples;
+    uint64_t size                               = (uint64_t)rows * (uint64_t)samples;
+    uint32_t* pSample                           = _outputLayer._pbSampledIndex->_pDevData;
+    NNFloat* pDelta                             = _outputLayer._pbSampledDelta->_pDevData;
+    NNFloat* pWeight                            = _pbSampledWeight->_pDevData;
+    NNFloat* pBias                              = _pbSampledBias->_pDevData;
+    NNFloat* pWeightGradient                    = _pbSampledWeightGradient->_pDevData;
+    NNFloat* pWeightVelocity                    = _pbSampledWeightVelocity ? _pbSampledWeightVelocity->_pDevData : NULL;
+    NNFloat* pBiasVelocity                      = _pbSampledBiasVelocity ? _pbSampledBiasVelocity->_pDevData : NULL;
+    NNFloat* pWeightGradientVelocity            = _pbSampledWeightGradientVelocity ? _pbSampledWeightGradientVelocity->_pDevData : NULL;
+    NNFloat* pBiasGradientVelocity              = _pbSampledBiasGradientVelocity ? _pbSampledBiasGradientVelocity->_pDevData : NULL;
+
+    if (trainingMode != SGD)
+    {
+        kGatherColumns(rows, stride, samples, pSample, _pbWeightVelocity->_pDevData, pWeightVelocity);
+        kGatherColumns(1, stride, samples, pSample, _pbBiasVelocity->_pDevData, pBiasVelocity);
+    }
+    if (trainingMode == AdaDelta)
+    {
+        kGatherColumns(rows, stride, samples, pSample, _pbWeightGradientVelocity->_pDevData, pWeightGradientVelocity);
+        kGatherColumns(1, stride, samples, pSample, _pbBiasGradientVelocity->_pDevData, pBiasGradientVelocity);
+    }
+
+    switch (trainingMode)
+    {
+        case SGD:
+            kSGDUpdateWeights(alpha, lambda, size, pWeightGradient, pWeight);
+            kSGDUpdateBiases(alpha, batch, samples, pDelta, pBias);
+            break;
+
+        case Momentum:
+            kMomentumUpdateWeights(alpha, lambda, mu, size, pWeightVelocity, pWeightGradient, pWeight);
+            kMomentumUpdateBiases(alpha, mu, batch, samples, pDelta, pBiasVelocity, pBias);
+            break;
+
+        case AdaGrad:
+            kAdaGradUpdateWeights(alpha, lambda, size, pWeightVelocity, pWeightGradient, pWeight);
+            kAdaGradUpdateBiases(alpha, batch, samples, pDelta, pBiasVelocity, pBias);
+            break;
+
+        case Nesterov:
+            kNesterovUpdateWeights(alpha, lambda, mu, size, pWeightVelocity, pWeightGradient, pWeight);
+            kNesterovUpdateBiases(alpha, mu, batch, samples, pDelta, pBiasVelocity, pBias);
+            break;
+
+        case RMSProp:
+            kRMSPropUpdateWeights(alpha, lambda, mu, size, pWeightVelocity, pWeightGradient, pWeight);
+            kRMSPropUpdateBiases(alpha, mu, batch, samples, pDelta, pBiasVelocity, pBias);
+            break;
+
+        case AdaDelta:
+            kAdaDeltaUpdateWeights(lambda, mu, size, pWeightVelocity, pWeightGradient, pWeightGradientVelocity, pWeight);
+            kAdaDeltaUpdateBiases(mu, batch, samples, pDelta, pBiasVelocity, pBiasGradientVelocity, pBias);
+            break;
+    }
+
+    if (_norm > (NNFloat)0.0)
+        kNormalizeWeights(_norm, samples, rows, pWeight);
+
+    // Write everything back
+    kScatterColumns(rows, stride, samples, pSample, pWeight, _pbWeight->_pDevData);
+    kScatterColumns(1, stride, samples, pSample, pBias, _pbBias->_pDevData);
+    if (trainingMode != SGD)
+    {
+        kScatterColumns(rows, stride, samples, pSample, pWeightVelocity, _pbWeightVelocity->_pDevData);
+        kScatterColumns(1, stride, samples, pSample, pBiasVelocity, _pbBiasVelocity->_pDevData);
+    }
+    if (trainingMode == AdaDelta)
+    {
+        kScatterColumns(rows, stride, samples, pSample, pWeightGradientVelocity, _pbWeightGradientVelocity->_pDevData);
+        kScatterColumns(1, stride, samples, pSample, pBiasGradientVelocity, _pbBiasGradientVelocity->_pDevData);
+    }
+}
+
 bool NNWeight::WriteNetCDF(netCDF::NcFile& nc, uint32_t index, NNFloat* pWeight, NNFloat* pBias)
 {
     bool bResult                = true;
@@ -822,6 +1045,203 @@ bool NNWeight::WriteNetCDF(netCDF::NcFile& nc, uint32_t index, NNFloat* pWeight,
     return bResult;
 }
 
+// Writes optimizer state gathered into wd alongside the weights written by WriteNetCDF
+bool NNWeight::WriteVelocityNetCDF(netCDF::NcFile& nc, uint32_t index, const NNWeightDescriptor& wd)
+{
+    bool bResult                = true;
+    if (getGpu()._id == 0)
+    {
+        string wstring          = "weight" + std::to_string(index) + "_";
+        NcDim biasDim           = nc.getDim(wstring + "biasDim");
+        if (wd._vBiasVelocity.size() != 0)
+        {
+            NcVar biasVelocityVar   = nc.addVar(wstring + "biasVelocity", ncFloat, biasDim);
+            biasVelocityVar.putVar(wd._vBiasVelocity.data());
+        }
+        if (wd._vBiasGradientVelocity.size() != 0)
+        {
+            NcVar biasGradientVelocityVar = nc.addVar(wstring + "biasGradientVelocity", ncFloat, biasDim);
+            biasGradientVelocityVar.putVar(wd._vBiasGradientVelocity.data());
+        }
+        if (!_bShared)
+        {
+            NcDim weightDim     = nc.getDim(wstring + "weightDim");
+            if (wd._vWeightVelocity.size() != 0)
+            {
+                NcVar weightVelocityVar = nc.addVar(wstring + "weightVelocity", ncFloat, weightDim);
+                weightVelocityVar.putVar(wd._vWeightVelocity.data());
+            }
+            if (wd._vWeightGradientVelocity.size() != 0)
+            {
+                NcVar weightGradientVelocityVar = nc.addVar(wstring + "weightGradientVelocity", ncFloat, weightDim);
+                weightGradientVelocityVar.putVar(wd._vWeightGradientVelocity.data());
+            }
+        }
+    }
+
+    return bResult;
+}
+
+// Copies this process's slice of a full weight matrix (sharded across input layer or output layer if model parallel multi-GPU)
+void NNWeight::ShardWeights(const vector<NNFloat>& vWeight, vector<NNFloat>& vLocalWeight)
+{
+    if (getGpu()._numprocs > 1)
+    {
+        vLocalWeight.resize(_size);
+        NNFloat* pDst                   = vLocalWeight.data();
+        uint32_t outgoingSize           = _outputLayer._stride * 3;
+        uint32_t incomingSize           = _inputLayer._stride * 2;
+
+        if (outgoingSize > incomingSize)
+        {
+            const NNFloat* pSrc         = vWeight.data() + _outputLayer._minX;
+            for (size_t i = 0; i < _inputLayer._stride; i++)
+            {
+                memcpy(pDst, pSrc, _outputLayer._localStride * sizeof(NNFloat));
+                pSrc                   += _outputLayer._stride;
+                pDst                   += _outputLayer._localStride;
+            }
+        }
+        else
+        {
+            const NNFloat* pSrc         = vWeight.data() + _inputLayer._minX * _outputLayer._stride;
+            memcpy(pDst, pSrc, _inputLayer._localStride * _outputLayer._stride * sizeof(NNFloat));
+        }
+    }
+    else
+    {
+        vLocalWeight                    = vWeight;
+    }
+}
+
+// Copies this process's slice of a full bias vector (sharded across output layer if multi-GPU)
+void NNWeight::ShardBiases(const vector<NNFloat>& vBias, vector<NNFloat>& vLocalBias)
+{
+    if (getGpu()._numprocs > 1)
+    {
+        vLocalBias.resize(_biasSize);
+        memcpy(vLocalBias.data(), vBias.data() + _outputLayer._minX, _outputLayer._localStride * sizeof(NNFloat));
+    }
+    else
+    {
+        vLocalBias                      = vBias;
+    }
+}
+
+// Uploads this process's shard of size unsharded weights straight from pWeight, such as a memory-mapped model file,
+// without staging them in _vWeight, which is left stale as after Randomize()
+bool NNWeight::UploadShardedWeights(const NNFloat* pWeight, uint64_t size)
+{
+    cudaError_t status;
+    if (getGpu()._numprocs > 1)
+    {
+        if (size != (uint64_t)_inputLayer._stride * _outputLayer._stride)
+        {
+            if (getGpu()._id == 0)
+                printf("NNWeight::UploadShardedWeights: Expected %" PRIu64 " weights between layers %s and %s, found %" PRIu64 ".\n", (uint64_t)_inputLayer._stride * _outputLayer._stride,
+                       _inputLayer._name.c_str(), _outputLayer._name.c_str(), size);
+            return false;
+        }
+
+        uint32_t outgoingSize           = _outputLayer._stride * 3;
+        uint32_t incomingSize           = _inputLayer._stride * 2;
+        if (outgoingSize > incomingSize)
+            status                      = cudaMemcpy2D(_pbWeight->_pDevData, _outputLayer._localStride * sizeof(NNFloat), pWeight + _outputLayer._minX, _outputLayer._stride * sizeof(NNFloat),
+                                                       _outputLayer._localStride * sizeof(NNFloat), _inputLayer._stride, cudaMemcpyDefault);
+        else
+            status                      = cudaMemcpy(_pbWeight->_pDevData, pWeight + (uint64_t)_inputLayer._minX * _outputLayer._stride,
+                                                     (uint64_t)_inputLayer._localStride * _outputLayer._stride * sizeof(NNFloat), cudaMemcpyDefault);
+    }
+    else
+    {
+        if (size != _size)
+        {
+            if (getGpu()._id == 0)
+                printf("NNWeight::UploadShardedWeights: Expected %" PRIu64 " weights between layers %s and %s, found %" PRIu64 ".\n", _size, _inputLayer._name.c_str(), _outputLayer._name.c_str(), size);
+            return false;
+        }
+        status                          = cudaMemcpy(_pbWeight->_pDevData, pWeight, _size * sizeof(NNFloat), cudaMemcpyDefault);
+    }
+    RTERROR(status, "NNWeight::UploadShardedWeights: Failed to upload weights");
+    return true;
+}
+
+bool NNWeight::UploadShardedBiases(const NNFloat* pBias, uint64_t size)
+{
+    uint64_t expected                   = (getGpu()._numprocs > 1) ? _outputLayer._stride : _biasSize;
+    if (size != expected)
+    {
+        if (getGpu()._id == 0)
+            printf("NNWeight::UploadShardedBiases: Expected %" PRIu64 " biases between layers %s and %s, found %" PRIu64 ".\n", expected, _inputLayer._name.c_str(), _outputLayer._name.c_str(), size);
+        return false;
+    }
+    if (getGpu()._numprocs > 1)
+        pBias                          += _outputLayer._minX;
+    cudaError_t status                  = cudaMemcpy(_pbBias->_pDevData, pBias, _biasSize * sizeof(NNFloat), cudaMemcpyDefault);
+    RTERROR(status, "NNWeight::UploadShardedBiases: Failed to upload biases");
+    return true;
+}
+
+// Describes the weights' configuration, leaving values to GatherWeights
+void NNWeight::GetDescriptor(NNWeightDescriptor& d)
+{
+    d._inputLayer                       = _inputLayer._name;
+    d._outputLayer                      = _outputLayer._name;
+    d._width                            = _width;
+    d._height                           = _height;
+    d._length                           = _length;
+    d._depth                            = _depth;
+    d._breadth                          = _breadth;
+    d._bShared                          = _bShared;
+    d._bTransposed                      = _bTransposed;
+    d._bLocked                          = _bLocked;
+    d._norm                             = _norm;
+    if (_bShared)
+    {
+        d._sourceInputLayer             = _pSharedWeight->_inputLayer._name;
+        d._sourceOutputLayer            = _pSharedWeight->_outputLayer._name;
+    }
+}
+
+// Overwrites freshly randomized weights and biases with values trained against smaller input and/or output
+// layers, so only the rows and columns of newly added units keep their initial values
+void NNWeight::CopyGrownWeights(const NNWeightDescriptor& wd)
+{
+    if (!_bShared && (wd._vWeight.size() != 0))
+    {
+        // Map local weights to their position in the full matrix, sharded across input or output layer as in the constructor
+        uint64_t rowOffset              = 0;
+        uint64_t columnOffset           = 0;
+        if (getGpu()._numprocs > 1)
+        {
+            uint32_t outgoingSize       = _outputLayer._stride * 3;
+            uint32_t incomingSize       = _inputLayer._stride * 2;
+            if (outgoingSize > incomingSize)
+                columnOffset            = _outputLayer._minX;
+            else
+                rowOffset               = _inputLayer._minX;
+        }
+        
+        _pbWeight->Download(_vWeight.data());
+        for (uint64_t j = 0; (j < _height) && (j + rowOffset < wd._inputStride); j++)
+        {
+            const NNFloat* pSrc         = wd._vWeight.data() + (j + rowOffset) * wd._outputStride;
+            NNFloat* pDst               = _vWeight.data() + j * _width;
+            for (uint64_t k = 0; (k < _width) && (k + columnOffset < wd._outputStride); k++)
+                pDst[k]                 = pSrc[k + columnOffset];
+        }
+        _pbWeight->Upload(_vWeight.data());
+    }
+
+    if (wd._vBias.size() != 0)
+    {
+        _pbBias->Download(_vBias.data());
+        for (uint64_t k = 0; (k < _biasSize) && (k + _outputLayer._minX < wd._outputStride); k++)
+            _vBias[k]                   = wd._vBias[k + _outputLayer._minX];
+        _pbBias->Upload(_vBias.data());
+    }
+}
+
 bool NNWeight::CopyWeights(NNWeight* pWeight)
 {
     bool bValid                 = true;
@@ -884,9 +1304,9 @@ void NNWeight::Dump(string fname, NNFloat* pBuffer)
                 {                        
                     uint64_t size;
                     MPI_Status status;                
-                    MPI_Recv(&size, 1, MPI_UINT64_T, i, 0, MPI_COMM_WORLD, &status);
+                    MPI_Recv(&size, 1, MPI_UINT64_T, i, 0, getGpu()._comm, &status);
                     vector<NNFloat> vTemp(size);
-                    MPI_Recv(vTemp.data(), size, MPI_FLOAT, i, 0, MPI_COMM_WORLD, &status);
+                    MPI_Recv(vTemp.data(), size, MPI_FLOAT, i, 0, getGpu()._comm, &status);
                     uint64_t lstride    = size / _inputLayer._stride;
                     NNFloat* pSrcWeight = vTemp.data();
                     NNFloat* pDstWeight = pWeight;
@@ -907,8 +1327,8 @@ void NNWeight::Dump(string fname, NNFloat* pBuffer)
                 {
                     uint64_t size;
                     MPI_Status status;                
-                    MPI_Recv(&size, 1, MPI_UINT64_T, i, 0, MPI_COMM_WORLD, &status);
-                    MPI_Recv(pWeight, size, MPI_FLOAT, i, 0, MPI_COMM_WORLD, &status);
+                    MPI_Recv(&size, 1, MPI_UINT64_T, i, 0, getGpu()._comm, &status);
+                    MPI_Recv(pWeight, size, MPI_FLOAT, i, 0, getGpu()._comm, &status);
                     pWeight            += size;
                 }                        
             }
@@ -916,8 +1336,8 @@ void NNWeight::Dump(string fname, NNFloat* pBuffer)
         else
         {
             uint64_t size               = _vWeight.size();
-            MPI_Send(&size, 1, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD);
-            MPI_Send(_vWeight.data(), size, MPI_FLOAT, 0, 0, MPI_COMM_WORLD);                  
+            MPI_Send(&size, 1, MPI_UINT64_T, 0, 0, getGpu()._comm);
+            MPI_Send(_vWeight.data(), size, MPI_FLOAT, 0, 0, getGpu()._comm);                  
         }
 
     }
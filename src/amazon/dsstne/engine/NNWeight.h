@@ -12,6 +12,8 @@
 
 #ifndef NNWEIGHT_H
 
+struct NNWeightDescriptor;
+
 class NNWeight {
 public:
     enum Transform
@@ -25,7 +27,8 @@ public:
 private:
     friend class NNNetwork;
     friend class NNLayer;
-    friend NNNetwork* LoadNeuralNetworkNetCDF(const string& fname, uint32_t batch);
+    friend NNNetwork* LoadNeuralNetworkNetCDF(const string& fname, uint32_t batch, const vector<NNDataSetBase*>& vDataSet);
+    friend NNNetwork* LoadNeuralNetworkModel(const string& fname, uint32_t batch, const vector<NNDataSetBase*>& vDataSet);
 
     NNLayer&                        _inputLayer;                // Source of activations
     NNLayer&                        _outputLayer;               // Output destination/Delta sources
@@ -57,6 +60,10 @@ private:
     cudnnConvolutionBwdDataAlgo_t   _convBWDeltaAlgo;           // CUDNN convolution delta backpropagation algorithm
     vector<NNFloat>                 _vWeight;                   // CPU weight array
     vector<NNFloat>                 _vBias;                     // CPU bias array
+    vector<NNFloat>                 _vWeightVelocity;           // CPU weight velocity restored from checkpoint, consumed by RefreshState
+    vector<NNFloat>                 _vBiasVelocity;             // CPU bias velocity restored from checkpoint, consumed by RefreshState
+    vector<NNFloat>                 _vWeightGradientVelocity;   // CPU weight gradient velocity restored from checkpoint, consumed by RefreshState
+    vector<NNFloat>                 _vBiasGradientVelocity;     // CPU bias gradient velocity restored from checkpoint, consumed by RefreshState
     GpuBuffer<NNFloat>*             _pbWeight;                  // GPU weight array 
     GpuBuffer<NNFloat>*             _pbBias;                    // GPU bias array
     GpuBuffer<NNFloat>*             _pbWeightGradient;          // Accumulated gradient per batch
@@ -65,6 +72,14 @@ private:
     GpuBuffer<NNFloat>*             _pbBiasVelocity;            // Velocity used for momentum and RMSProp
     GpuBuffer<NNFloat>*             _pbWeightGradientVelocity;  // Gradient velocity used for AdaDelta and Adam
     GpuBuffer<NNFloat>*             _pbBiasGradientVelocity;    // Gradient velocity used for AdaDelta and Adam    
+    uint32_t                        _sampledColumns;            // Output units the sampled buffers below have room for
+    GpuBuffer<NNFloat>*             _pbSampledWeight;           // Weight columns of the output units sampled for the current batch
+    GpuBuffer<NNFloat>*             _pbSampledBias;             // Biases of the sampled output units
+    GpuBuffer<NNFloat>*             _pbSampledWeightGradient;   // Gradient of the sampled weight columns
+    GpuBuffer<NNFloat>*             _pbSampledWeightVelocity;   // Sampled columns of the optimizer state, gathered only for updates
+    GpuBuffer<NNFloat>*             _pbSampledBiasVelocity;
+    GpuBuffer<NNFloat>*             _pbSampledWeightGradientVelocity;
+    GpuBuffer<NNFloat>*             _pbSampledBiasGradientVelocity;
     NNWeight(NNLayer& inputLayer, NNLayer& outputLayer, bool bShared = false, bool bTransposed = false, bool bLocked = false, NNFloat maxNorm = 0.0f);
     ~NNWeight();
     void ClearSharedGradient();
@@ -77,7 +92,16 @@ private:
     void Dump(string fname, NNFloat* pBuffer);
     void RefreshState(NNNetwork* pNetwork, TrainingMode trainingMode);
     void UpdateWeights(TrainingMode trainingMode, uint32_t batch, NNFloat alpha, NNFloat lambda, NNFloat mu);
+    void ReserveSampledColumns(uint32_t columns);
+    void UpdateSampledWeights(TrainingMode trainingMode, uint32_t batch, NNFloat alpha, NNFloat lambda, NNFloat mu);
     bool WriteNetCDF(netCDF::NcFile& nc, uint32_t index, NNFloat* pWeight = NULL, NNFloat* pBias = NULL);
+    bool WriteVelocityNetCDF(netCDF::NcFile& nc, uint32_t index, const NNWeightDescriptor& wd);
+    void ShardWeights(const vector<NNFloat>& vWeight, vector<NNFloat>& vLocalWeight);
+    void ShardBiases(const vector<NNFloat>& vBias, vector<NNFloat>& vLocalBias);
+    void CopyGrownWeights(const NNWeightDescriptor& wd);
+    bool UploadShardedWeights(const NNFloat* pWeight, uint64_t size);
+    bool UploadShardedBiases(const NNFloat* pBias, uint64_t size);
+    void GetDescriptor(NNWeightDescriptor& d);
     NNFloat* GetWeightBuffer() { return _pbWeight ? _pbWeight->_pDevData : NULL; }
     NNFloat* GetWeightGradientBuffer() { return _pbWeightGradient ? _pbWeightGradient->_pDevData : NULL; }
     uint64_t GetBufferSize() { return _size; }
@@ -98,12 +122,18 @@ struct NNWeightDescriptor
     uint64_t                _breadth;
     vector<NNFloat>         _vWeight;
     vector<NNFloat>         _vBias;
+    vector<NNFloat>         _vWeightVelocity;           // Optimizer state, only present in training checkpoints
+    vector<NNFloat>         _vBiasVelocity;
+    vector<NNFloat>         _vWeightGradientVelocity;
+    vector<NNFloat>         _vBiasGradientVelocity;
     bool                    _bShared;
     bool                    _bTransposed;
     bool                    _bLocked;
     NNFloat                 _norm;
     string                  _sourceInputLayer;     // _sourceInputLayer and _sourceOutputLayer collectively
     string                  _sourceOutputLayer;    // specify which weight matrix will be shared here
+    uint64_t                _inputStride;          // _inputStride and _outputStride are the layer sizes _vWeight
+    uint64_t                _outputStride;         // and _vBias were trained with if the layers have since grown (0 otherwise)
 
     NNWeightDescriptor();
 };
@@ -111,5 +141,7 @@ struct NNWeightDescriptor
 bool LoadNNWeightDescriptorNetCDF(const string& fname, netCDF::NcFile& nc, uint32_t index, NNWeightDescriptor& wd);
 ostream& operator<< (ostream& out, NNWeightDescriptor& d);
 uint32_t MPI_Bcast_NNWeightDescriptor(NNWeightDescriptor& d);
+void SaveNNWeightDescriptorBinary(NNBinaryWriter& w, const NNWeightDescriptor& d);
+bool LoadNNWeightDescriptorBinary(NNBinaryReader& r, NNWeightDescriptor& d);
 #define NNWEIGHT_H
 #endif
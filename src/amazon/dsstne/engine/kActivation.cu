@@ -193,3 +193,67 @@ void kCalculateSoftMaxActivation(NNFloat* pData, uint32_t batch, uint32_t stride
 }
 
 
+template<Activation A>
+__global__ void
+LAUNCH_BOUNDS()
+kCalculateFusedEpilogue_kernel(NNFloat* pUnit, uint32_t stride, uint64_t size, EpilogueSources sources, NNFloat* pRandom, NNFloat p, NNFloat scale)
+{
+    uint64_t pos                = blockIdx.x * blockDim.x + threadIdx.x;
+    if (pos < size)
+    {
+        uint32_t bpos           = pos % stride;
+        NNFloat a               = pUnit[pos];
+        for (uint32_t i = 0; i < sources._biases; i++)
+            a                  += sources._pBias[i][bpos];
+        for (uint32_t i = 0; i < sources._skips; i++)
+            a                  += sources._pSkip[i][pos];
+
+        // Activation is a template parameter so each instance only contains its own
+        if (A == Sigmoid)
+            a                   = 1.0f / (1.0f + exp(-a));
+        else if (A == Tanh)
+            a                   = tanh(a);
+        else if (A == RectifiedLinear)
+            a                   = max(0.0f, a);
+
+        if (pRandom != NULL)
+            a                   = (pRandom[pos] < p) ? (NNFloat)0.0 : scale * a;
+        pUnit[pos]              = a;
+    }
+}
+
+void kCalculateFusedEpilogue(Activation activation, NNFloat* pUnit, uint32_t stride, uint32_t batch, const EpilogueSources& sources, NNFloat* pRandom, NNFloat p)
+{
+    uint64_t size               = (uint64_t)stride * (uint64_t)batch;
+    uint32_t blocks             = CalculateBlocks(size);
+    NNFloat scale               = (NNFloat)1.0;
+    if (p > (NNFloat)0.0)
+    {
+        curandGenerateUniform(getGpu()._RNG, pRandom, size);
+        scale                   = (NNFloat)1.0 / ((NNFloat)1.0 - p);
+    }
+    else
+        pRandom                 = NULL;
+
+    switch (activation)
+    {
+        case Sigmoid:
+            kCalculateFusedEpilogue_kernel<Sigmoid><<<blocks, getGpu()._threadsPerBlock>>>(pUnit, stride, size, sources, pRandom, p, scale);
+            break;
+
+        case Tanh:
+            kCalculateFusedEpilogue_kernel<Tanh><<<blocks, getGpu()._threadsPerBlock>>>(pUnit, stride, size, sources, pRandom, p, scale);
+            break;
+
+        case RectifiedLinear:
+            kCalculateFusedEpilogue_kernel<RectifiedLinear><<<blocks, getGpu()._threadsPerBlock>>>(pUnit, stride, size, sources, pRandom, p, scale);
+            break;
+
+        // Anything else leaves the activation to a separate pass
+        default:
+            kCalculateFusedEpilogue_kernel<Linear><<<blocks, getGpu()._threadsPerBlock>>>(pUnit, stride, size, sources, pRandom, p, scale);
+            break;
+    }
+    LAUNCHERROR("kCalculateFusedEpilogue_kernel");
+}
+
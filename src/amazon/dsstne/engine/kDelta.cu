@@ -1092,6 +1092,74 @@ void kCalculateSparseCrossEntropyOutputDelta(Activation activation, uint32_t pos
     }
 }
 
+// Sampled output deltas index targets by batch row instead of through the data set, pTargetStart[row] to
+// pTargetStart[row + 1] holding the positions of each example's positives among the sampled outputs
+__global__ void
+LAUNCH_BOUNDS()
+kCalculateSampledNonZeroSigmoidCrossEntropyOutputDelta_kernel(uint32_t batch, uint32_t stride, NNFloat* pUnit, NNFloat* pDelta, uint32_t* pTargetStart, uint32_t* pTarget)
+{
+    uint64_t pos                = ((blockIdx.x * blockDim.x) + threadIdx.x) / cData._warpSize;
+    if (pos < batch)
+    {
+        uint64_t pos1           = pTargetStart[pos] + (threadIdx.x & cData._warpMask);
+        uint64_t end            = pTargetStart[pos + 1];
+        uint64_t offset         = pos * stride;
+        while (pos1 < end)
+        {
+            uint64_t pos2       = offset + pTarget[pos1];
+            NNFloat a           = pUnit[pos2];
+            pDelta[pos2]        = cData._deltaBoost_one * (a - (NNFloat)1.0);
+            pos1               += cData._warpSize;
+        }      
+    }
+}
+
+__global__ void
+LAUNCH_BOUNDS()
+kCalculateSampledNonZeroSoftMaxOutputDelta_kernel(uint32_t batch, uint32_t stride, NNFloat* pUnit, NNFloat* pDelta, uint32_t* pTargetStart, uint32_t* pTarget)
+{
+    uint64_t pos                = ((blockIdx.x * blockDim.x) + threadIdx.x) / cData._warpSize;
+    if (pos < batch)
+    {
+        uint64_t pos1           = pTargetStart[pos];
+        uint64_t end            = pTargetStart[pos + 1];
+        NNFloat t               = (NNFloat)1.0 / (end - pos1);
+        pos1                   += threadIdx.x & cData._warpMask;
+        uint64_t offset         = pos * stride;
+        while (pos1 < end)
+        {
+            uint64_t pos2       = offset + pTarget[pos1];
+            NNFloat a           = pUnit[pos2];
+            pDelta[pos2]        = a - t;   
+            pos1               += cData._warpSize;
+        }      
+    }
+}
+
+void kCalculateSampledCrossEntropyOutputDelta(Activation activation, uint32_t batch, uint32_t stride, NNFloat* pUnit, NNFloat* pDelta, uint32_t* pTargetStart, uint32_t* pTarget)
+{
+    uint64_t size               = (uint64_t)batch * (uint64_t)stride;
+    dim3 grid1(CalculateBlocks(size));
+    dim3 grid2(CalculateBlocks(batch * getGpu()._data._warpSize));
+
+    switch (activation)
+    {
+        case SoftMax:
+            kCalculateSparseRawSoftMaxOutputDelta_kernel<<<grid1, getGpu()._threadsPerBlock>>>(size, pUnit, pDelta);
+            LAUNCHERROR("kCalculateSparseRawSoftMaxOutputDelta_kernel");
+            kCalculateSampledNonZeroSoftMaxOutputDelta_kernel<<<grid2, getGpu()._threadsPerBlock>>>(batch, stride, pUnit, pDelta, pTargetStart, pTarget);
+            LAUNCHERROR("kCalculateSampledNonZeroSoftMaxOutputDelta_kernel");
+            break;    
+
+        case Sigmoid:
+            kCalculateSparseRawSigmoidCrossEntropyOutputDelta_kernel<<<grid1, getGpu()._threadsPerBlock>>>(size, pUnit, pDelta);
+            LAUNCHERROR("kCalculateSparseRawSigmoidCrossEntropyOutputDelta_kernel");
+            kCalculateSampledNonZeroSigmoidCrossEntropyOutputDelta_kernel<<<grid2, getGpu()._threadsPerBlock>>>(batch, stride, pUnit, pDelta, pTargetStart, pTarget);
+            LAUNCHERROR("kCalculateSampledNonZeroSigmoidCrossEntropyOutputDelta_kernel");
+            break;
+    }
+}
+
 template<typename T>
 __global__ void
 LAUNCH_BOUNDS()
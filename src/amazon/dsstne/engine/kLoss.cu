@@ -704,6 +704,79 @@ NNFloat kCalculateSparseCrossEntropyError(uint32_t position, uint32_t batch, uin
     return (NNFloat)((double)(getGpu()._pbAccumulator->_pSysData[0]) * ONEOVERERRORSCALE);
 }
 
+// Sampled output errors index targets by batch row, pTargetStart[row] to pTargetStart[row + 1] holding the
+// positions of each example's positives among the sampled outputs
+__global__ void
+LAUNCH_BOUNDS()
+kCalculateSampledNonZeroCrossEntropyError_kernel(uint32_t batch, uint32_t stride, NNFloat *pUnit, uint32_t* pTargetStart, uint32_t* pTarget)
+{
+
+    uint64_t pos                = (blockIdx.x * blockDim.x + threadIdx.x) / cData._warpSize;
+    NNFloat error               = (NNFloat)0.0;
+    if (pos < batch)
+    {
+        uint64_t pos1           = pTargetStart[pos] + (threadIdx.x & cData._warpMask);
+        uint64_t end            = pTargetStart[pos + 1];
+        uint64_t offset         = pos * stride;
+        while (pos1 < end)
+        {
+            uint64_t pos2       = offset + pTarget[pos1];
+            NNFloat a           = pUnit[pos2];
+            error              += -log(max(MIN_ERROR, a)) + log(max(MIN_ERROR, (NNFloat)1.0 - a));   
+            pos1               += cData._warpSize;
+        }
+    }  
+
+    REDUCE_ERROR()
+}
+
+__global__ void
+LAUNCH_BOUNDS()
+kCalculateSampledMultinomialCrossEntropyError_kernel(uint32_t batch, uint32_t stride, NNFloat *pUnit, uint32_t* pTargetStart, uint32_t* pTarget)
+{
+
+    uint64_t pos                = (blockIdx.x * blockDim.x + threadIdx.x) / cData._warpSize;
+    NNFloat error               = (NNFloat)0.0;
+    if (pos < batch)
+    {
+        uint64_t pos1           = pTargetStart[pos];
+        uint64_t end            = pTargetStart[pos + 1];
+        NNFloat t               = (NNFloat)1.0 / (NNFloat)(end - pos1);
+        pos1                   += threadIdx.x & cData._warpMask;
+        uint64_t offset         = pos * stride;
+        while (pos1 < end)
+        {
+            uint64_t pos2       = offset + pTarget[pos1];
+            NNFloat a           = pUnit[pos2];
+            error              += -t * log(max(MIN_ERROR, a));   
+            pos1               += cData._warpSize;
+        }
+    }  
+
+    REDUCE_ERROR()
+}
+
+NNFloat kCalculateSampledCrossEntropyError(Activation activation, uint32_t batch, uint32_t stride, NNFloat* pUnit, uint32_t* pTargetStart, uint32_t* pTarget)
+{
+    cudaMemset(getGpu()._data._pAccumulator, 0, sizeof(uint64_t));
+    uint32_t blocks             = CalculateBlocks(batch * getGpu()._warpSize);
+    if (activation == SoftMax)
+    {
+        kCalculateSampledMultinomialCrossEntropyError_kernel<<<blocks, getGpu()._threadsPerBlock>>>(batch, stride, pUnit, pTargetStart, pTarget);
+        LAUNCHERROR("kCalculateSampledMultinomialCrossEntropyError_kernel");
+    }
+    else
+    {
+        uint64_t size           = (uint64_t)batch * (uint64_t)stride;
+        kCalculateSparseRawCrossEntropyError_kernel<<<CalculateBlocks(size), getGpu()._threadsPerBlock>>>(pUnit, size);
+        LAUNCHERROR("kCalculateSparseRawCrossEntropyError_kernel");
+        kCalculateSampledNonZeroCrossEntropyError_kernel<<<blocks, getGpu()._threadsPerBlock>>>(batch, stride, pUnit, pTargetStart, pTarget);
+        LAUNCHERROR("kCalculateSampledNonZeroCrossEntropyError_kernel");
+    }
+    getGpu()._pbAccumulator->Download(); 
+    return (NNFloat)((double)(getGpu()._pbAccumulator->_pSysData[0]) * ONEOVERERRORSCALE);
+}
+
 __global__ void
 LAUNCH_BOUNDS()
 kCalculateSparseMultinomialCrossEntropyError_kernel(uint32_t position, uint32_t batch, uint32_t stride, NNFloat *pUnit, uint64_t* pSparseStart, uint64_t* pSparseEnd, uint32_t* pSparseIndex)
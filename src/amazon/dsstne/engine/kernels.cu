@@ -2719,4 +2719,44 @@ void kCopy2D(NNFloat* pDst, uint32_t dpitch, NNFloat* pSrc, uint32_t spitch, uin
     LAUNCHERROR("kCopy2D_kernel");
 }
 
+__global__ void
+LAUNCH_BOUNDS()
+kGatherColumns_kernel(uint32_t stride, uint32_t columns, uint32_t* pColumn, NNFloat* pSrc, NNFloat* pDst)
+{
+    uint64_t yOffset                        = blockIdx.y * blockDim.x + threadIdx.x;
+    if (yOffset < columns)
+    {
+        uint64_t dpos                       = blockIdx.x * columns + yOffset;
+        uint64_t spos                       = blockIdx.x * stride + pColumn[yOffset];
+        pDst[dpos]                          = pSrc[spos];
+    }
+}
+
+void kGatherColumns(uint32_t rows, uint32_t stride, uint32_t columns, uint32_t* pColumn, NNFloat* pSrc, NNFloat* pDst)
+{
+    dim3 grid(rows, (columns + getGpu()._threadsPerBlock - 1) / getGpu()._threadsPerBlock);       
+    kGatherColumns_kernel<<<grid, getGpu()._threadsPerBlock>>>(stride, columns, pColumn, pSrc, pDst);
+    LAUNCHERROR("kGatherColumns_kernel");
+}
+
+__global__ void
+LAUNCH_BOUNDS()
+kScatterColumns_kernel(uint32_t stride, uint32_t columns, uint32_t* pColumn, NNFloat* pSrc, NNFloat* pDst)
+{
+    uint64_t yOffset                        = blockIdx.y * blockDim.x + threadIdx.x;
+    if (yOffset < columns)
+    {
+        uint64_t dpos                       = blockIdx.x * stride + pColumn[yOffset];
+        uint64_t spos                       = blockIdx.x * columns + yOffset;
+        pDst[dpos]                          = pSrc[spos];
+    }
+}
+
+void kScatterColumns(uint32_t rows, uint32_t stride, uint32_t columns, uint32_t* pColumn, NNFloat* pSrc, NNFloat* pDst)
+{
+    dim3 grid(rows, (columns + getGpu()._threadsPerBlock - 1) / getGpu()._threadsPerBlock);       
+    kScatterColumns_kernel<<<grid, getGpu()._threadsPerBlock>>>(stride, columns, pColumn, pSrc, pDst);
+    LAUNCHERROR("kScatterColumns_kernel");
+}
+
 
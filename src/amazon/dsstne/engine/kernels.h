@@ -42,6 +42,10 @@ void kAddBuffers(NNFloat* pDest, NNFloat* pSrc, uint64_t size);
 void kAddBuffers2D(NNFloat* pDest, uint32_t dpitch, NNFloat* pSrc, uint32_t spitch, uint32_t width, uint32_t height);
 void kCopy2D(NNFloat* pDest, uint32_t dpitch, NNFloat* pSrc, uint32_t spitch, uint32_t width, uint32_t height);
 
+// Copies the listed columns of a [rows][stride] matrix into a packed [rows][columns] one and back again
+void kGatherColumns(uint32_t rows, uint32_t stride, uint32_t columns, uint32_t* pColumn, NNFloat* pSrc, NNFloat* pDst);
+void kScatterColumns(uint32_t rows, uint32_t stride, uint32_t columns, uint32_t* pColumn, NNFloat* pSrc, NNFloat* pDst);
+
 // Sorting kernels
 template<typename KeyType, typename ValueType> size_t kInitSort(uint32_t items, GpuBuffer<KeyType>* pbKey, GpuBuffer<ValueType>* pbValue);
 template<typename KeyType, typename ValueType> bool kSort(uint32_t items, KeyType* pKey0, KeyType* pKey1, ValueType* pValue0, ValueType* pValue1, char* pTemp, size_t tempBytes);
@@ -92,6 +96,9 @@ template<typename T> NNFloat kCalculateSparseAnalogMultinomialScaledMarginalCros
 
 template<typename T> NNFloat kCalculateSparseDataScaledMarginalCrossEntropyError(uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit, uint64_t* pSparseStart, uint64_t* pSparseEnd, uint32_t* pSparseIndex, T* pSparseData, bool bSparseIgnoreZero);
 
+// Error over the outputs sampled for a batch, targets given per batch row as positions among the sampled outputs
+NNFloat kCalculateSampledCrossEntropyError(Activation activation, uint32_t batch, uint32_t stride, NNFloat* pUnit, uint32_t* pTargetStart, uint32_t* pTarget);
+
 // Regularization error functions
 NNFloat kCalculateRegularizationError(NNFloat lambda, NNFloat* pWeight, uint64_t size);
 
@@ -122,6 +129,8 @@ template<typename T> void kCalculateSparseCrossEntropyOutputDelta(Activation act
 template<typename T> void kCalculateSparseScaledMarginalCrossEntropyOutputDelta(Activation activation, uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit,  NNFloat* pDelta, uint64_t* pSparseStart, uint64_t* pSparseEnd, uint32_t* pSparseIndex, T* pSparseData, bool bSparseIgnoreZero);
 template<typename T> void kCalculateSparseOutputDelta(Activation activation, uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit,  NNFloat* pDelta, uint64_t* pSparseStart, uint64_t* pSparseEnd, uint32_t* pSparseIndex, T* pSparseData, bool bSparseIgnoreZero);
 template<typename T> void kCalculateSparseDataScaledMarginalCrossEntropyOutputDelta(Activation activation, uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit,  NNFloat* pDelta, uint64_t* pSparseStart, uint64_t* pSparseEnd, uint32_t *pSparseIndex, T* pSparseData, bool bSparseIgnoreZero);
+// Delta function for the outputs sampled for a batch
+void kCalculateSampledCrossEntropyOutputDelta(Activation activation, uint32_t batch, uint32_t stride, NNFloat* pUnit, NNFloat* pDelta, uint32_t* pTargetStart, uint32_t* pTarget);
 // Delta functions for sparse output layers with analog output
 template<typename T> void kCalculateSparseAnalogOutputDelta(Activation activation, uint32_t position, uint32_t batch, uint32_t stride, NNFloat* pUnit,  NNFloat* pDelta, uint64_t* pSparseStart, uint64_t* pSparseEnd, uint32_t *pSparseIndex, T* pSparseData, bool bSparseIgnoreZero);
 
@@ -137,6 +146,22 @@ void kCalculateTanhActivation(NNFloat* pData, uint64_t size);
 void kCalculateReluActivation(NNFloat* pData, uint64_t size);
 void kCalculateSoftMaxActivation(NNFloat* pData, uint32_t batch, uint32_t stride);
 
+// Biases of incoming layers and units of incoming skip layers added to a fully connected layer's units by
+// kCalculateFusedEpilogue in the same pass that applies its activation
+static const uint32_t MaxEpilogueSources    = 4;
+struct EpilogueSources
+{
+    uint32_t        _biases;
+    uint32_t        _skips;
+    NNFloat*        _pBias[MaxEpilogueSources];
+    NNFloat*        _pSkip[MaxEpilogueSources];
+};
+
+// Adds biases and skip layer units to the output of a layer's SGEMMs, applies an elementwise (Sigmoid, Tanh,
+// RectifiedLinear or Linear) activation and, if p is non-zero, dropout with fresh random values in pRandom, reading
+// and writing each unit once instead of once per step
+void kCalculateFusedEpilogue(Activation activation, NNFloat* pUnit, uint32_t stride, uint32_t batch, const EpilogueSources& sources, NNFloat* pRandom, NNFloat p);
+
 // SGD/Momentum/AdaGrad/Nesterov weight update kernels
 void kSGDUpdateWeights(NNFloat alpha, NNFloat lambda, uint64_t size, NNFloat* pWeightGradient, NNFloat* pWeight);
 void kSGDUpdateBiases(NNFloat alpha, uint32_t batch, uint32_t width, NNFloat* pDelta, NNFloat* pBias);
@@ -26,11 +26,6 @@
 
 const string NNRecsGenerator::DEFAULT_LAYER_RECS_GEN_LABEL = "Output";
 const string NNRecsGenerator::DEFAULT_SCORE_PRECISION = "4.3f";
-// Multiplicative of xK. 
-// We sorting TOPK_SCALAR times of xK mainly in concern with multi GPU sorting
-// sorting the topK from xK* #GPUs has some glitches because xK*#GPUs are usually small
-// sorting the topK from xK* #GPUs * TOPK_SCALAR is OK though 
-const unsigned int NNRecsGenerator::TOPK_SCALAR = 5;
 
 /**
 We should allocate and deallocate the GPU memory once to save time on allocating and deallocating the
@@ -47,8 +42,8 @@ NNRecsGenerator::NNRecsGenerator(unsigned int xBatchSize,
 				 string precision)
 {
     
-    pbKey           = new GpuBuffer<NNFloat>(xBatchSize* xK * TOPK_SCALAR, true);
-    pbUIValue       = new GpuBuffer<unsigned int>(xBatchSize* xK * TOPK_SCALAR, true);
+    pbKey           = new GpuBuffer<NNFloat>(xBatchSize* xK, true);
+    pbUIValue       = new GpuBuffer<unsigned int>(xBatchSize* xK, true);
     pFilteredOutput = new GpuBuffer<NNFloat>(xOutputBufferSize, true);
     recsGenLayerLabel = layer;
     scorePrecision = precision;
@@ -75,17 +70,7 @@ void NNRecsGenerator::generateRecs(NNNetwork *xNetwork,
     if( lPosition + lBatch > lExamples)
         lBatch = lExamples - lPosition;
 
-    // Variables for multi GPU memory copy and sorting 
-    bool bMultiGPU                           = (getGpu()._numprocs > 1);
-    GpuBuffer<NNFloat>* pbMultiKey           = NULL;
-    GpuBuffer<unsigned int>* pbMultiUIValue  = NULL;
-    GpuBuffer<unsigned int>* pbUIValueCache  = NULL;
-    NNFloat* pMultiKey                       = NULL;
-    unsigned int* pMultiUIValue              = NULL;
-    unsigned int* pUIValueCache              = NULL;
- 
-    cudaIpcMemHandle_t keyMemHandle;
-    cudaIpcMemHandle_t valMemHandle;
+    bool bMultiGPU                 = (getGpu()._numprocs > 1);
     NNFloat* dOutput               = xNetwork->GetUnitBuffer(recsGenLayerLabel);
     
     NNLayer* pLayer                = xNetwork->GetLayer(recsGenLayerLabel);
@@ -103,38 +88,13 @@ void NNRecsGenerator::generateRecs(NNNetwork *xNetwork,
     }
 
     float *hOutputBuffer           = (float*)malloc(sizeof(float)*outputBufferSize);
-   
-    // Get P2P handles to multi-gpu data on node 0
-    if (bMultiGPU)
-    {
-        if (getGpu()._id == 0)
-            {
-                pbMultiKey                  = new GpuBuffer<NNFloat>(getGpu()._numprocs * lBatch * xK * TOPK_SCALAR, true);
-                pbMultiUIValue              = new GpuBuffer<unsigned int>(getGpu()._numprocs * lBatch * xK * TOPK_SCALAR, true);
-                pMultiKey                   = pbMultiKey->_pDevData;
-                pMultiUIValue               = pbMultiUIValue->_pDevData;
-                cudaError_t status          = cudaIpcGetMemHandle(&keyMemHandle, pMultiKey);
-                RTERROR(status, "cudaIpcGetMemHandle: Failed to get IPC mem handle on pMultiKey");
-                status                      = cudaIpcGetMemHandle(&valMemHandle, pMultiUIValue);
-                RTERROR(status, "cudaIpcGetMemHandle: Failed to get IPC mem handle on pMultiUIValue");
-            }
-            MPI_Bcast(&keyMemHandle, sizeof(cudaIpcMemHandle_t), MPI_BYTE, 0, MPI_COMM_WORLD);
-            MPI_Bcast(&valMemHandle, sizeof(cudaIpcMemHandle_t), MPI_BYTE, 0, MPI_COMM_WORLD);
-
-            // Open up pointers to GPU 0 memory buffers
-            if (getGpu()._id != 0)
-            {
-                cudaError_t status          = cudaIpcOpenMemHandle((void**)&pMultiKey, keyMemHandle, cudaIpcMemLazyEnablePeerAccess);
-                RTERROR(status, "cudaIpcOpenMemHandle: Unable to open key IPCMemHandle");
-                status                      = cudaIpcOpenMemHandle((void**)&pMultiUIValue, valMemHandle, cudaIpcMemLazyEnablePeerAccess);
-                RTERROR(status, "cudaIpcOpenMemHandle: Unable to open value IPCMemHandle");
-            }
-
-    }
     cudaMemcpy(hOutputBuffer, dOutput, outputBufferSize* sizeof(NNFloat), cudaMemcpyDeviceToHost);
-    // Iterate through all the filters and apply filters for each customer in the lBatch
 
+    // offSet is the starting FEATUREs in this GPU to the first one in global FEATURE Index, which the layer's
+    // model parallel split makes uneven when the FEATUREs do not divide evenly between GPUs
+    int offSet                      = pLayer->GetLocalOffset();
 
+    // Iterate through all the filters and apply filters for each customer in the lBatch
     //We dont need the memory buffer if we have only one filter as copying the memory effects performance	
     // TODO need to add a better time wrapper to measure the time duration of a  function call
     timeval timeStart;
@@ -142,117 +102,90 @@ void NNRecsGenerator::generateRecs(NNNetwork *xNetwork,
     for ( int j =0 ; j < lBatch ; j++)
     {
 	    int custIndex =  lPosition +j;
-
-	    // offSet is the starting FEATUREs in this GPU to the first one in global FEATURE Index 
-	    int offSet = getGpu()._id*lLocalOutputStride;
 	    xFilterSet->applySamplesFilter(hOutputBuffer + j * lLocalOutputStride, custIndex, offSet, lLocalOutputStride);
     }
 
     timeval timeEnd;
     pFilteredOutput->Upload(hOutputBuffer);
     // TODO: Add Node Filter support for multi GPU 
-    // Each GPU sorting its top xK * TOPK_SCALAR
-    kCalculateTopK(pFilteredOutput->_pDevData, pbKey->_pDevData, pbUIValue->_pDevData, lBatch, lLocalOutputStride, xK * TOPK_SCALAR);
-
+    // Each GPU sorting its own top xK
+    kCalculateTopK(pFilteredOutput->_pDevData, pbKey->_pDevData, pbUIValue->_pDevData, lBatch, lLocalOutputStride, xK);
+    pbKey->Download();
+    pbUIValue->Download();
+    NNFloat* pKey                   = pbKey->_pSysData;
+    unsigned int* pIndex            = pbUIValue->_pSysData;
+
+    // Customers whose recs this process writes
+    int start                       = 0;
+    int end                         = lBatch;
     if (bMultiGPU) {
 
-	    // P2P gather Top K data from all processes
-	    uint32_t offset             = xK * TOPK_SCALAR * getGpu()._id;
-	    uint32_t kstride            = xK * TOPK_SCALAR * getGpu()._numprocs;
-	    // Copy values to buffer which is on GPU 0
-	    cudaMemcpy2D(pMultiKey + offset, kstride * sizeof(NNFloat), pbKey->_pDevData, xK * TOPK_SCALAR * sizeof(NNFloat), xK * TOPK_SCALAR * sizeof(NNFloat), lBatch, cudaMemcpyDefault);
-	    // Copy indices ( local to each GPU ) to buffer which is on GPU0 
-	    cudaMemcpy2D(pMultiUIValue + offset, kstride * sizeof(unsigned int), pbUIValue->_pDevData, xK * TOPK_SCALAR * sizeof(unsigned int), xK * TOPK_SCALAR * sizeof(unsigned int), lBatch, cudaMemcpyDefault);
-	    cudaDeviceSynchronize();
-	    MPI_Barrier(MPI_COMM_WORLD);
-
-	    // Do final Top K calculation on process 0 to produce the top K out of the top numprocs * K
-	    if (getGpu()._id == 0)
-	    {
-		    // Sort for values for xK * TOPK_SCALAR, pbUIValue are positions on pbMultiKey
-		    kCalculateTopK(pbMultiKey->_pDevData, pbKey->_pDevData, pbUIValue->_pDevData, lBatch, kstride, xK * TOPK_SCALAR);
-
-		    // Buffer for local Indices
-		    pbUIValueCache              = new GpuBuffer<unsigned int>(getGpu()._numprocs * lBatch * xK * TOPK_SCALAR, true);
-
-		    // pbUIValueCache for local index of FEATUREs in its GPU
-		    kCalculateTopK(pbMultiKey->_pDevData, pbMultiUIValue->_pDevData, pbKey->_pDevData, pbUIValueCache->_pDevData, lBatch, kstride, xK * TOPK_SCALAR);
-	    }
-
+	    // Make FEATURE indices global, then merge the top xK of all processes exactly, each process ending up
+	    // with the final recs for its own block of customers
+	    for (int i = 0; i < lBatch * xK; i++)
+		    pIndex[i]              += offSet;
+	    RingMergeTopK(pKey, pIndex, lBatch, xK, MPI_UNSIGNED, getGpu()._comm);
+	    start                       = GetSliceStart(lBatch, getGpu()._id, getGpu()._numprocs);
+	    end                         = GetSliceStart(lBatch, getGpu()._id + 1, getGpu()._numprocs);
     }
 
-
+    string fileName                 = xFilterSet->getOutputFileName();
     if (getGpu()._id == 0)
     {
-
-	    const char  *fileName = xFilterSet->getOutputFileName().c_str();
 	    gettimeofday(&timeEnd, NULL);
 	    cout <<"Time Elapsed for Filtering and selecting Top " << xK << " recs"<< elapsed_time(timeEnd, timeStart) << endl;
 	    cout << "Writing to " << fileName<<endl;
-	    FILE *fp =  fopen(fileName,"a");
-	    pbKey->Download();
-	    pbUIValue->Download();
-	    NNFloat* pKey                   = pbKey->_pSysData;
-	    unsigned int* pIndex            = pbUIValue->_pSysData;
-
-	    if (bMultiGPU) {
-		    pbUIValueCache->Download();
-		    pUIValueCache               = pbUIValueCache->_pSysData;        
-	    }
+    }
 
-	    string strFormat = "%s,%" + scorePrecision + ":";
-	    for( int j =0 ; j < lBatch ; j++)
+    string strFormat = "%s,%" + scorePrecision + ":";
+    string recs;
+    vector<char> vLine(4096);
+    for( int j = start ; j < end ; j++)
+    {
+	    recs                       += xCustomerIndex[lPosition + j] + '\t';
+	    for(int x  = 0; x < xK; ++x)
 	    {
-		    int custIndex =  lPosition +j;
-		    fprintf(fp,"%s%c",xCustomerIndex[lPosition + j].c_str(),'\t');
-		    for(int x  = 0; x < xK; ++x)
-		    {
-			    // Single GPU case, FEATURE index is global		
-			    int finalIndex = pIndex[j* xK * TOPK_SCALAR + x];
-			    float value = pKey[j* xK * TOPK_SCALAR + x];
-			    if (bMultiGPU) {
-				    // Multi GPU case. Need to do two level look up
-				    // which GPU this index comes from
-				    int gpuId = finalIndex / (xK * TOPK_SCALAR);
-				    // Local index within one GPU
-				    int localIndex = pUIValueCache[j* xK * TOPK_SCALAR + x];
-				    int globalIndex = gpuId * lLocalOutputStride + localIndex; 
-				    if (globalIndex < xFeatureIndex.size()) {
-					    fprintf(fp,strFormat.c_str(),xFeatureIndex[globalIndex].c_str(),value);
-				    } 
-
-			    } else {
-
-				    if (finalIndex < xFeatureIndex.size()) {
-					    fprintf(fp,strFormat.c_str(),xFeatureIndex[finalIndex].c_str(),value);
-				    }
+		    unsigned int finalIndex = pIndex[j * xK + x];
+		    float value = pKey[j * xK + x];
+		    if (finalIndex < xFeatureIndex.size()) {
+			    int length = snprintf(vLine.data(), vLine.size(), strFormat.c_str(), xFeatureIndex[finalIndex].c_str(), value);
+			    if (length >= (int)vLine.size()) {
+				    vLine.resize(length + 1);
+				    snprintf(vLine.data(), vLine.size(), strFormat.c_str(), xFeatureIndex[finalIndex].c_str(), value);
 			    }
-
+			    recs               += vLine.data();
 		    }
-
-		    fprintf(fp,"\n");
 	    }
+	    recs                       += '\n';
+    }
+
+    if (bMultiGPU) {
+
+	    // Append every process's block of customers to the output file in parallel, in customer order
+	    MPI_File fh;
+	    MPI_File_open(getGpu()._comm, fileName.c_str(), MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &fh);
+	    MPI_Offset fileSize;
+	    if (getGpu()._id == 0)
+		    MPI_File_get_size(fh, &fileSize);
+	    MPI_Bcast(&fileSize, 1, MPI_OFFSET, 0, getGpu()._comm);
+	    long long length            = recs.size();
+	    long long offset            = 0;
+	    MPI_Exscan(&length, &offset, 1, MPI_LONG_LONG, MPI_SUM, getGpu()._comm);
+	    if (getGpu()._id == 0)
+		    offset              = 0;
+	    MPI_File_write_at_all(fh, fileSize + offset, recs.data(), recs.size(), MPI_CHAR, MPI_STATUS_IGNORE);
+	    MPI_File_close(&fh);
+    } else {
+	    FILE *fp =  fopen(fileName.c_str(),"a");
+	    fwrite(recs.data(), 1, recs.size(), fp);
 	    fclose(fp);
+    }
+
+    if (getGpu()._id == 0)
+    {
 	    gettimeofday(&timeEnd, NULL);
 	    cout <<"Time Elapsed for Writing to file" <<  elapsed_time(timeEnd,timeStart) << endl;
     }
 
-
     free(hOutputBuffer);
-
-    // Delete multi-GPU data and P2P handles if multi-GPU
-    if (bMultiGPU)
-    {
-	    if (getGpu()._id != 0)
-	    {
-		    cudaError_t status              = cudaIpcCloseMemHandle(pMultiKey);
-		    RTERROR(status, "cudaIpcCloseMemHandle: Error closing MultiKey IpcMemHandle");
-		    status                          = cudaIpcCloseMemHandle(pMultiUIValue);
-		    RTERROR(status, "cudaIpcCloseMemHandle: Error closing MultiFValue IpcMemHandle");
-            }
-        delete pbMultiKey;
-        delete pbMultiUIValue;
-        delete pbUIValueCache;
-     } 
 }
-
@@ -38,7 +38,6 @@ private :
     
 public:
     static const string DEFAULT_LAYER_RECS_GEN_LABEL;
-    static const unsigned int TOPK_SCALAR;
     static const string DEFAULT_SCORE_PRECISION;
 
     NNRecsGenerator(unsigned int,
@@ -11,8 +11,14 @@
  */
 
 #include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 #include <unordered_map>
+#include <mpi.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 
 #include "NetCDFhelper.h"
@@ -23,37 +29,355 @@ using namespace std;
 string DATASET_TYPE_INDICATOR("indicator");
 string DATASET_TYPE_ANALOG("analog");
 
+// Largest number of bytes sent in one MPI call, keeping counts within int range
+static const uint64_t MAX_MPI_MESSAGE_SIZE = 1ull << 30;
+
+static void sendBytes(const void *pData, uint64_t size, int destination) {
+    MPI_Send(&size, 1, MPI_UINT64_T, destination, 0, MPI_COMM_WORLD);
+    for (uint64_t offset = 0; offset < size; offset += MAX_MPI_MESSAGE_SIZE) {
+        MPI_Send((char *) pData + offset, min(size - offset, MAX_MPI_MESSAGE_SIZE), MPI_BYTE, destination, 0, MPI_COMM_WORLD);
+    }
+}
+
+static void receiveBytes(vector<char> &vData, int source) {
+    uint64_t size;
+    MPI_Recv(&size, 1, MPI_UINT64_T, source, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    vData.resize(size);
+    for (uint64_t offset = 0; offset < size; offset += MAX_MPI_MESSAGE_SIZE) {
+        MPI_Recv(vData.data() + offset, min(size - offset, MAX_MPI_MESSAGE_SIZE), MPI_BYTE, source, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+}
+
+static void sendIndices(const vector<unsigned int> &vIndex, int destination) {
+    sendBytes(vIndex.data(), vIndex.size() * sizeof(unsigned int), destination);
+}
+
+static void receiveIndices(vector<unsigned int> &vIndex, int source) {
+    vector<char> vData;
+    receiveBytes(vData, source);
+    vIndex.resize(vData.size() / sizeof(unsigned int));
+    memcpy(vIndex.data(), vData.data(), vData.size());
+}
+
+// Labels are sent back to back, each terminated by a NUL
+static void sendLabels(const vector<string> &vLabel, int destination) {
+    string buffer;
+    for (const auto &label : vLabel) {
+        buffer.append(label);
+        buffer.push_back('\0');
+    }
+    sendBytes(buffer.data(), buffer.size(), destination);
+}
+
+static void receiveLabels(vector<string> &vLabel, int source) {
+    vector<char> vData;
+    receiveBytes(vData, source);
+    vLabel.clear();
+    for (size_t start = 0; start < vData.size();) {
+        vLabel.push_back(string(vData.data() + start));
+        start += vLabel.back().size() + 1;
+    }
+}
+
+// Returns the labels an import added to an index that started out with loadedEntries entries, in index order
+static vector<string> getAddedLabels(const unordered_map<string, unsigned int> &mLabelToIndex, size_t loadedEntries) {
+    vector<string> vLabel(mLabelToIndex.size() - loadedEntries);
+    for (const auto &entry : mLabelToIndex) {
+        if (entry.second >= loadedEntries) {
+            vLabel[entry.second - loadedEntries] = entry.first;
+        }
+    }
+    return vLabel;
+}
+
+// Adds the labels to mLabelToIndex, returning the index of each of them
+static vector<unsigned int> mergeLabels(const vector<string> &vLabel, unordered_map<string, unsigned int> &mLabelToIndex) {
+    vector<unsigned int> vIndex(vLabel.size());
+    for (size_t i = 0; i < vLabel.size(); i++) {
+        auto result = mLabelToIndex.insert(make_pair(vLabel[i], (unsigned int) mLabelToIndex.size()));
+        vIndex[i] = result.first->second;
+    }
+    return vIndex;
+}
+
+/**
+ * Splits the sorted input files into contiguous runs of roughly equal total size, one per rank. Later files
+ * land on higher ranks, so letting the highest rank win for a sample found on several ranks matches the single
+ * process behaviour of keeping the last occurrence.
+ */
+static vector<string> getRankFiles(const vector<string> &files, int rank, int ranks) {
+    vector<uint64_t> vOffset(files.size() + 1, 0);
+    for (size_t i = 0; i < files.size(); i++) {
+        struct stat fileStat;
+        vOffset[i + 1] = vOffset[i] + ((stat(files[i].c_str(), &fileStat) == 0) ? fileStat.st_size : 0);
+    }
+
+    vector<string> rankFiles;
+    for (size_t i = 0; i < files.size(); i++) {
+        uint64_t fileRank = (vOffset.back() > 0) ? (vOffset[i] * ranks) / vOffset.back() : (i * ranks) / files.size();
+        if (fileRank == (uint64_t) rank) {
+            rankFiles.push_back(files[i]);
+        }
+    }
+    return rankFiles;
+}
+
+// Inserts a zero-padded rank before the .nc extension so that shards sort in rank order
+static string getShardFileName(const string &outputFile, int rank) {
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), "_%05d", rank);
+    if (outputFile.size() > NETCDF_FILE_EXTENTION.size() &&
+        outputFile.compare(outputFile.size() - NETCDF_FILE_EXTENTION.size(), NETCDF_FILE_EXTENTION.size(), NETCDF_FILE_EXTENTION) == 0) {
+        return outputFile.substr(0, outputFile.size() - NETCDF_FILE_EXTENTION.size()) + suffix + NETCDF_FILE_EXTENTION;
+    }
+    return outputFile + suffix + NETCDF_FILE_EXTENTION;
+}
+
+/**
+ * Parallel counterpart of generateNetCDFIndexes(), called by every rank. Each rank imports its share of the
+ * input files against its own copy of the loaded indices. Rank 0 then gathers the features and samples every
+ * rank added, assigns them global indices in rank order, and exports the merged indices. Every rank gets back
+ * its samples renumbered to global indices and sorted, without the samples that a higher rank also read, and
+ * the number of features in the merged feature index.
+ */
+static bool importSamplesInParallel(int rank,
+                                    int ranks,
+                                    const string &samplesPath,
+                                    const bool enableFeatureIndexUpdates,
+                                    const string &outFeatureIndexFileName,
+                                    const string &outSampleIndexFileName,
+                                    unordered_map<string, unsigned int> &mFeatureIndex,
+                                    unordered_map<string, unsigned int> &mSampleIndex,
+                                    vector<unsigned int> &vSparseStart,
+                                    vector<unsigned int> &vSparseEnd,
+                                    vector<unsigned int> &vSparseIndex,
+                                    vector<float> &vSparseData,
+                                    unsigned int &features,
+                                    FeatureHasher *pFeatureHasher) {
+    if (!fileExists(samplesPath)) {
+        cout << "Error: " << samplesPath << " not found." << endl;
+        return false;
+    }
+    vector<string> files;
+    listFiles(samplesPath, false, files);
+    vector<string> rankFiles = getRankFiles(files, rank, ranks);
+
+    // Ranks other than 0 only report their log if the import fails
+    size_t loadedFeatures = mFeatureIndex.size();
+    size_t loadedSamples = mSampleIndex.size();
+    bool featureIndexUpdated;
+    bool sampleIndexUpdated;
+    vector<unsigned int> vSampleIndex;
+    stringstream rankOutput;
+    bool result = importSamplesFromFiles(rankFiles,
+                                         enableFeatureIndexUpdates,
+                                         mFeatureIndex,
+                                         mSampleIndex,
+                                         featureIndexUpdated,
+                                         sampleIndexUpdated,
+                                         vSparseStart,
+                                         vSparseEnd,
+                                         vSparseIndex,
+                                         vSparseData,
+                                         vSampleIndex,
+                                         (rank == 0) ? cout : rankOutput,
+                                         pFeatureHasher);
+
+    // Rank 0 reports the log of every other rank that failed
+    int failed = result ? 0 : 1;
+    vector<int> vFailed(ranks);
+    MPI_Gather(&failed, 1, MPI_INT, vFailed.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        for (int r = 1; r < ranks; r++) {
+            if (vFailed[r]) {
+                vector<char> vLog;
+                receiveBytes(vLog, r);
+                cout << "Error: Rank " << r << " failed to import samples:" << endl << string(vLog.begin(), vLog.end());
+            }
+        }
+    } else if (!result) {
+        string log = rankOutput.str();
+        sendBytes(log.data(), log.size(), 0);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &result, 1, MPI_C_BOOL, MPI_LAND, MPI_COMM_WORLD);
+    if (!result) {
+        return false;
+    }
+    if (pFeatureHasher) {
+        pFeatureHasher->reportCollisions(cout);
+    }
+
+    // Rank 0's own additions already have the indices they'll keep, so merging starts from its indices
+    vector<unsigned int> vFeatureRemap;
+    if (rank == 0) {
+        vector<vector<unsigned int>> vRankSampleIndex(ranks);
+        vRankSampleIndex[0] = vSampleIndex;
+        for (int r = 1; r < ranks; r++) {
+            vector<string> vFeatureLabel;
+            vector<string> vSampleLabel;
+            receiveLabels(vFeatureLabel, r);
+            receiveLabels(vSampleLabel, r);
+            receiveIndices(vRankSampleIndex[r], r);
+            sendIndices(mergeLabels(vFeatureLabel, mFeatureIndex), r);
+            vector<unsigned int> vSampleRemap = mergeLabels(vSampleLabel, mSampleIndex);
+            for (auto &sampleIndex : vRankSampleIndex[r]) {
+                if (sampleIndex >= loadedSamples) {
+                    sampleIndex = vSampleRemap[sampleIndex - loadedSamples];
+                }
+            }
+        }
+
+        // Keep each sample on the highest rank that read it
+        vector<int> vOwner(mSampleIndex.size(), -1);
+        for (int r = 0; r < ranks; r++) {
+            for (auto sampleIndex : vRankSampleIndex[r]) {
+                vOwner[sampleIndex] = r;
+            }
+        }
+        for (int r = 0; r < ranks; r++) {
+            for (auto &sampleIndex : vRankSampleIndex[r]) {
+                if (vOwner[sampleIndex] != r) {
+                    sampleIndex = UINT32_MAX;
+                }
+            }
+            if (r > 0) {
+                sendIndices(vRankSampleIndex[r], r);
+            }
+        }
+        vSampleIndex = vRankSampleIndex[0];
+        for (size_t i = loadedFeatures; i < mFeatureIndex.size(); i++) {
+            vFeatureRemap.push_back(i);
+        }
+    } else {
+        sendLabels(getAddedLabels(mFeatureIndex, loadedFeatures), 0);
+        sendLabels(getAddedLabels(mSampleIndex, loadedSamples), 0);
+        sendIndices(vSampleIndex, 0);
+        receiveIndices(vFeatureRemap, 0);
+        receiveIndices(vSampleIndex, 0);
+    }
+
+    // Export the merged indices only if some rank updated them
+    MPI_Allreduce(MPI_IN_PLACE, &featureIndexUpdated, 1, MPI_C_BOOL, MPI_LOR, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &sampleIndexUpdated, 1, MPI_C_BOOL, MPI_LOR, MPI_COMM_WORLD);
+    if (rank == 0 && featureIndexUpdated) {
+        exportIndex(mFeatureIndex, outFeatureIndexFileName);
+        cout << "Exported " << outFeatureIndexFileName << " with " << mFeatureIndex.size() << " entries." << endl;
+    }
+    if (rank == 0 && sampleIndexUpdated) {
+        exportIndex(mSampleIndex, outSampleIndexFileName);
+        cout << "Exported " << outSampleIndexFileName << " with " << mSampleIndex.size() << " entries." << endl;
+    }
+
+    // Renumber features, then keep this rank's samples in global sample order
+    for (auto &featureIndex : vSparseIndex) {
+        if (!pFeatureHasher && featureIndex >= loadedFeatures) {
+            featureIndex = vFeatureRemap[featureIndex - loadedFeatures];
+        }
+    }
+    vector<size_t> vOrder;
+    for (size_t i = 0; i < vSampleIndex.size(); i++) {
+        if (vSampleIndex[i] != UINT32_MAX) {
+            vOrder.push_back(i);
+        }
+    }
+    sort(vOrder.begin(), vOrder.end(), [&vSampleIndex](size_t left, size_t right) {
+        return vSampleIndex[left] < vSampleIndex[right];
+    });
+    vector<unsigned int> vSortedStart;
+    vector<unsigned int> vSortedEnd;
+    vector<unsigned int> vSortedIndex;
+    vector<float> vSortedData;
+    for (auto i : vOrder) {
+        vSortedStart.push_back(vSortedIndex.size());
+        vSortedIndex.insert(vSortedIndex.end(), vSparseIndex.begin() + vSparseStart[i], vSparseIndex.begin() + vSparseEnd[i]);
+        vSortedData.insert(vSortedData.end(), vSparseData.begin() + vSparseStart[i], vSparseData.begin() + vSparseEnd[i]);
+        vSortedEnd.push_back(vSortedIndex.size());
+    }
+    vSparseStart.swap(vSortedStart);
+    vSparseEnd.swap(vSortedEnd);
+    vSparseIndex.swap(vSortedIndex);
+    vSparseData.swap(vSortedData);
+
+    // Every rank writes its shard with the global feature count as its width
+    features = mFeatureIndex.size();
+    MPI_Bcast(&features, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+    return true;
+}
+
 void printUsageNetCDFGenerator() {
     cout << "NetCDFGenerator: Converts a text dataset file into a more compressed NetCDF file." << endl;
     cout <<
-    "Usage: generateNetCDF -d <dataset_name> -i <input_text_file> -o <output_netcdf_file> -f <features_index> -s <samples_index> [-c] [-m]" <<
+    "Usage: generateNetCDF -d <dataset_name> -i <input_text_file> -o <output_netcdf_file> (-f <features_index> | -hash <buckets> [-signed]) -s <samples_index> [-c [-p <min_frequency>] [-k <max_features>]] [-m] [-z]" <<
     endl;
     cout << "    -d dataset_name: (required) name for the dataset within the netcdf file." << endl;
     cout << "    -i input_text_file: (required) path to the input text file with records in data format." << endl;
     cout << "    -o output_netcdf_file: (required) path to the output netcdf file that we generate." << endl;
-    cout << "    -f features_index: (required) path to the features index file to read-from/write-to." << endl;
+    cout << "    -f features_index: (required unless -hash is set) path to the features index file to read-from/write-to." << endl;
+    cout << "    -hash buckets: hash features into a fixed number of buckets instead of using a features index." << endl;
+    cout << "    -signed : with -hash, also hash the sign of each feature value (requires -t analog)." << endl;
     cout << "    -s samples_index: (required) path to the samples index file to read-from/write-to." << endl;
     cout <<
     "    -m : if set, we'll merge the feature index with new features found in the input_text_file. (Cannot be used with -c)." <<
     endl;
     cout << "    -c : if set, we'll create a new feature index from scratch. (Cannot be used with -m)." << endl;
     cout <<
+    "    -p min_frequency: (default = 1) with -c, drop features occurring in fewer than min_frequency datapoints." <<
+    endl;
+    cout <<
+    "    -k max_features: (default = 0, no limit) with -c, keep only the max_features most frequent features." <<
+    endl;
+    cout << "       When either is set, features are renumbered by descending frequency." << endl;
+    cout <<
     "    -t type: (default = 'indicator') the type of dataset to generate. Valid values are: ['indicator', 'analog']." <<
     endl;
+    cout << "    -z : if set, sparse indices are sorted and stored with delta + varint encoding to reduce file size." << endl;
     cout << endl;
+    cout << "When run with mpirun, the input files are split between the ranks, the feature and sample indices are" << endl;
+    cout << "merged across them, and each rank writes its samples to output_netcdf_file with its rank (e.g. _00001)" << endl;
+    cout << "inserted before the .nc extension. The shards can be trained on as a directory with train -stream." << endl;
+}
+
+/**
+ * Ends every rank after a bad argument. Every rank checks the same arguments and so gets here, and waiting for all
+ * of them before aborting makes sure rank 0 has reported the error.
+ */
+static void abortOnArgumentError() {
+    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+static void abortWithUsage() {
+    printUsageNetCDFGenerator();
+    abortOnArgumentError();
 }
 
 int main(int argc, char **argv) {
+    // Under mpirun every rank converts a share of the input files into its own shard; only rank 0 logs, and fatal
+    // errors abort every rank
+    int rank = 0;
+    int ranks = 1;
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+    if (rank > 0) {
+        cout.setstate(ios_base::badbit);
+    }
+
     if (isArgSet(argc, argv, "-h")) {
         printUsageNetCDFGenerator();
-        exit(1);
+        MPI_Finalize();
+        return 1;
     }
     // Check + fetch required arguments
-    string inputFile = getRequiredArgValue(argc, argv, "-i", "input text file to convert.", &printUsageNetCDFGenerator);
-    string outputFile = getRequiredArgValue(argc, argv, "-o", "output netcdf file to generate.", &printUsageNetCDFGenerator);
-    string datasetName = getRequiredArgValue(argc, argv, "-d", "dataset name for the netcdf metadata.", &printUsageNetCDFGenerator);
-    string featureIndexFile = getRequiredArgValue(argc, argv, "-f", "feature index file.", &printUsageNetCDFGenerator);
-    string sampleIndexFile = getRequiredArgValue(argc, argv, "-s", "samples index file.", &printUsageNetCDFGenerator);
+    string inputFile = getRequiredArgValue(argc, argv, "-i", "input text file to convert.", &abortWithUsage);
+    string outputFile = getRequiredArgValue(argc, argv, "-o", "output netcdf file to generate.", &abortWithUsage);
+    string datasetName = getRequiredArgValue(argc, argv, "-d", "dataset name for the netcdf metadata.", &abortWithUsage);
+    unsigned int hashBuckets = stoul(getOptionalArgValue(argc, argv, "-hash", "0"));
+    string featureIndexFile;
+    if (hashBuckets == 0) {
+        featureIndexFile = getRequiredArgValue(argc, argv, "-f", "feature index file.", &abortWithUsage);
+    }
+    string sampleIndexFile = getRequiredArgValue(argc, argv, "-s", "samples index file.", &abortWithUsage);
 
     bool createFeatureIndex = isArgSet(argc, argv, "-c");
     if (createFeatureIndex) {
@@ -66,20 +390,54 @@ int main(int argc, char **argv) {
     }
 
     if (createFeatureIndex && mergeFeatureIndex) {
-        cout << "Error: Cannot create (-c) and update existing (-u) feature index. Please select only one.";
-        printUsageNetCDFGenerator();
-        exit(1);
+        cout << "Error: Cannot create (-c) and update existing (-u) feature index. Please select only one." << endl;
+        abortWithUsage();
     }
     bool updateFeatureIndex = createFeatureIndex || mergeFeatureIndex;
 
+    // Pruning renumbers features, so it only applies to a feature index created from this input
+    unsigned int minFrequency = stoul(getOptionalArgValue(argc, argv, "-p", "1"));
+    unsigned int maxFeatures = stoul(getOptionalArgValue(argc, argv, "-k", "0"));
+    bool pruneFeatures = isArgSet(argc, argv, "-p") || isArgSet(argc, argv, "-k");
+    if (pruneFeatures && !createFeatureIndex) {
+        cout << "Error: Pruning the feature index (-p, -k) requires creating a new feature index (-c)." << endl;
+        abortWithUsage();
+    }
+    if (pruneFeatures && ranks > 1) {
+        cout << "Error: Pruning the feature index (-p, -k) needs every sample, so it can't be run on multiple ranks." << endl;
+        abortOnArgumentError();
+    }
+
     string dataType = getOptionalArgValue(argc, argv, "-t", "indicator");
     if (dataType.compare(DATASET_TYPE_INDICATOR) != 0 && dataType.compare(DATASET_TYPE_ANALOG) != 0) {
         cout << "Error: Unknown dataset type [" << dataType << "].";
         cout << " Please select one of {" << DATASET_TYPE_INDICATOR << "," << DATASET_TYPE_ANALOG << "}" << endl;
-        exit(1);
+        abortOnArgumentError();
     }
     cout << "Generating dataset of type: " << dataType << endl;
 
+    // Hashing replaces the feature index, so none of the feature index options apply
+    bool signedHashing = isArgSet(argc, argv, "-signed");
+    if (hashBuckets > 0) {
+        if (updateFeatureIndex || pruneFeatures) {
+            cout << "Error: Feature hashing (-hash) cannot be combined with feature index options (-c, -m, -p, -k)." << endl;
+            abortWithUsage();
+        }
+        if (signedHashing && dataType.compare(DATASET_TYPE_ANALOG) != 0) {
+            cout << "Error: Signed hashing (-signed) requires an analog dataset (-t analog)." << endl;
+            abortOnArgumentError();
+        }
+        cout << "Flag -hash is set. Will hash features into " << hashBuckets << (signedHashing ? " signed" : "") << " buckets." << endl;
+    } else if (signedHashing) {
+        cout << "Error: Signed hashing (-signed) requires feature hashing (-hash)." << endl;
+        abortWithUsage();
+    }
+
+    bool compressIndices = isArgSet(argc, argv, "-z");
+    if (compressIndices) {
+        cout << "Flag -z is set. Will write delta + varint encoded sparse indices." << endl;
+    }
+
     // maps for feature and samples index.
     unordered_map<string, unsigned int> mFeatureIndex;
     unordered_map<string, unsigned int> mSampleIndex;
@@ -95,19 +453,21 @@ int main(int argc, char **argv) {
     } else {
         cout << "Loading sample index from: " << sampleIndexFile << endl;
         if (!loadIndexFromFile(mSampleIndex, sampleIndexFile, cout)) {
-            exit(1);
+            MPI_Abort(MPI_COMM_WORLD, 1);
         }
     }
 
-    if (createFeatureIndex) {
+    if (hashBuckets > 0) {
+        // No feature index needed
+    } else if (createFeatureIndex) {
         cout << "Will create a new features index file: " << featureIndexFile << endl;
     } else if (!fileExists(featureIndexFile)) {
         cout << "Error: Cannnot find a valid feature index file: " << featureIndexFile << endl;
-        exit(1);
+        MPI_Abort(MPI_COMM_WORLD, 1);
     } else {
         cout << "Loading feature index from: " << featureIndexFile << endl;
         if (!loadIndexFromFile(mFeatureIndex, featureIndexFile, cout)) {
-            exit(1);
+            MPI_Abort(MPI_COMM_WORLD, 1);
         }
     }
 
@@ -118,8 +478,28 @@ int main(int argc, char **argv) {
     vector<float> vSparseData;
 
 
+    FeatureHasher featureHasher(hashBuckets, signedHashing);
+
     // collects indices into the provided index maps, and writes them to a file if updated
-    if (!generateNetCDFIndexes(inputFile,
+    unsigned int features = 0;
+    if (ranks > 1) {
+        if (!importSamplesInParallel(rank,
+                                     ranks,
+                                     inputFile,
+                                     updateFeatureIndex,
+                                     featureIndexFile,
+                                     sampleIndexFile,
+                                     mFeatureIndex,
+                                     mSampleIndex,
+                                     vSparseStart,
+                                     vSparseEnd,
+                                     vSparseIndex,
+                                     vSparseData,
+                                     features,
+                                     (hashBuckets > 0) ? &featureHasher : NULL)) {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    } else if (!generateNetCDFIndexes(inputFile,
                           updateFeatureIndex,
                           featureIndexFile,
                           sampleIndexFile,
@@ -129,25 +509,61 @@ int main(int argc, char **argv) {
                           vSparseEnd,
                           vSparseIndex,
                           vSparseData,
-                          cout)) {
-        exit(1);
+                          cout,
+                          (hashBuckets > 0) ? &featureHasher : NULL)) {
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    if (pruneFeatures) {
+        if (!pruneFeatureIndex(minFrequency,
+                               maxFeatures,
+                               mFeatureIndex,
+                               vSparseStart,
+                               vSparseEnd,
+                               vSparseIndex,
+                               vSparseData,
+                               cout)) {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        exportIndex(mFeatureIndex, featureIndexFile);
+        cout << "Exported " << featureIndexFile << " with " << mFeatureIndex.size() << " entries." << endl;
     }
 
 
-    if (dataType.compare(DATASET_TYPE_ANALOG) == 0) {
+    if (ranks == 1) {
+        features = mFeatureIndex.size();
+    } else {
+        // With more ranks than input files some have no samples, which rank 0 reports
+        int empty = vSparseStart.empty() ? 1 : 0;
+        vector<int> vEmpty(ranks);
+        MPI_Gather(&empty, 1, MPI_INT, vEmpty.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+        for (int r = 0; (rank == 0) && (r < ranks); r++) {
+            if (vEmpty[r]) {
+                cout << "Rank " << r << " has no samples, not writing " << getShardFileName(outputFile, r) << endl;
+            }
+        }
+        outputFile = getShardFileName(outputFile, rank);
+    }
+    unsigned int maxFeatureIndex = (hashBuckets > 0) ? hashBuckets : features;
+    if (ranks > 1 && vSparseStart.empty()) {
+        // Rank 0 has reported there is nothing to write
+    } else if (dataType.compare(DATASET_TYPE_ANALOG) == 0) {
         writeNetCDFFile(vSparseStart,
                         vSparseEnd,
                         vSparseIndex,
                         vSparseData,
                         outputFile,
                         datasetName,
-                        mFeatureIndex.size());
+                        maxFeatureIndex,
+                        compressIndices);
     } else {
         // Default type is to assume indicator, so we don't retain the data values in the NetCDF file.
-        writeNetCDFFile(vSparseStart, vSparseEnd, vSparseIndex, outputFile, datasetName, mFeatureIndex.size());
+        writeNetCDFFile(vSparseStart, vSparseEnd, vSparseIndex, outputFile, datasetName, maxFeatureIndex, compressIndices);
     }
 
+    MPI_Barrier(MPI_COMM_WORLD);
     timeval timeEnd;
     gettimeofday(&timeEnd, NULL);
     cout << "Total time for generating NetCDF: " << elapsed_time(timeEnd, timeStart) << " secs. " << endl;
+    MPI_Finalize();
 }
@@ -14,6 +14,7 @@
 #include <algorithm>
 #include <cerrno>
 #include <cstring>
+#include <cstdint>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -21,9 +22,12 @@
 #include <netcdf>
 #include <sys/time.h>
 #include <unordered_map>
+#include <utility>
 #include <stdexcept>
 
 #include "NNEnum.h"
+#include "NNSparseEncoding.h"
+#include "NetCDFhelper.h"
 #include "Utils.h"
 
 using namespace std;
@@ -32,6 +36,41 @@ using namespace netCDF::exceptions;
 
 int gLoggingRate = 10000;
 
+FeatureHasher::FeatureHasher(unsigned int buckets, bool signedHashing) :
+    buckets(buckets),
+    signedHashing(signedHashing),
+    vBucketUsed(buckets, false),
+    usedBuckets(0) {
+}
+
+unsigned int FeatureHasher::hash(const std::string &featureName, float &sign) {
+    // 64-bit FNV-1a followed by the MurmurHash3 finalizer, so both the low bits used for the bucket and the
+    // top bit used for the sign are well mixed
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : featureName) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+
+    unsigned int bucket = h % buckets;
+    sign = (signedHashing && (h >> 63)) ? -1.0f : 1.0f;
+    if (sFeatureHash.insert(h).second && !vBucketUsed[bucket]) {
+        vBucketUsed[bucket] = true;
+        usedBuckets++;
+    }
+    return bucket;
+}
+
+void FeatureHasher::reportCollisions(std::ostream &outputStream) const {
+    outputStream << "Hashed " << sFeatureHash.size() << " distinct features into " << usedBuckets << " of " << buckets
+                 << " buckets (" << sFeatureHash.size() - usedBuckets << " features collided)" << endl;
+}
+
 bool loadIndex(std::unordered_map<string, unsigned int> &labelsToIndices, std::istream &inputStream,
                std::ostream &outputStream) {
     string line;
@@ -92,7 +131,8 @@ bool parseSamples(std::istream &inputStream,
                   bool &sampleIndexUpdated,
                   std::map<unsigned int, std::vector<unsigned int>> &mSignals,
                   std::map<unsigned int, std::vector<float>> &mSignalValues,
-                  std::ostream &outputStream) {
+                  std::ostream &outputStream,
+                  FeatureHasher *pFeatureHasher) {
     timeval tBegin;
     gettimeofday(&tBegin, NULL);
     timeval tReported = tBegin;
@@ -158,21 +198,27 @@ bool parseSamples(std::istream &inputStream,
                 featureValue = stof(dataElems[1]);
             }
 
-            // Look up the index for the given feature.
+            // Look up the index for the given feature, or hash it into a bucket.
             unsigned int featureIndex = 0;
-            try {
-                featureIndex = mFeatureIndex.at(featureName);
-            }
-            catch (const std::out_of_range &oor) {
-                if (enableFeatureIndexUpdates) {
-                    unsigned int index = mFeatureIndex.size();
-                    mFeatureIndex[featureName] = index;
-                    featureIndex = index;
-                    featureIndexUpdated = true;
-                } else {
-                    // Ignore this data point if we are not allowed to
-                    // update the feature index.
-                    continue;
+            if (pFeatureHasher) {
+                float sign;
+                featureIndex = pFeatureHasher->hash(featureName, sign);
+                featureValue *= sign;
+            } else {
+                try {
+                    featureIndex = mFeatureIndex.at(featureName);
+                }
+                catch (const std::out_of_range &oor) {
+                    if (enableFeatureIndexUpdates) {
+                        unsigned int index = mFeatureIndex.size();
+                        mFeatureIndex[featureName] = index;
+                        featureIndex = index;
+                        featureIndexUpdated = true;
+                    } else {
+                        // Ignore this data point if we are not allowed to
+                        // update the feature index.
+                        continue;
+                    }
                 }
             }
             // Update signals with this feature index
@@ -201,57 +247,50 @@ bool parseSamples(std::istream &inputStream,
     return true;
 }
 
-bool importSamplesFromPath(const std::string &samplesPath,
-                           const bool enableFeatureIndexUpdates,
-                           std::unordered_map<string, unsigned int> &mFeatureIndex,
-                           std::unordered_map<string, unsigned int> &mSampleIndex,
-                           bool &featureIndexUpdated,
-                           bool &sampleIndexUpdated,
-                           std::vector<unsigned int> &vSparseStart,
-                           std::vector<unsigned int> &vSparseEnd,
-                           std::vector<unsigned int> &vSparseIndex,
-                           std::vector<float> &vSparseData,
-                           std::ostream &outputStream) {
+bool importSamplesFromFiles(const std::vector<std::string> &files,
+                            const bool enableFeatureIndexUpdates,
+                            std::unordered_map<string, unsigned int> &mFeatureIndex,
+                            std::unordered_map<string, unsigned int> &mSampleIndex,
+                            bool &featureIndexUpdated,
+                            bool &sampleIndexUpdated,
+                            std::vector<unsigned int> &vSparseStart,
+                            std::vector<unsigned int> &vSparseEnd,
+                            std::vector<unsigned int> &vSparseIndex,
+                            std::vector<float> &vSparseData,
+                            std::vector<unsigned int> &vSampleIndex,
+                            std::ostream &outputStream,
+                            FeatureHasher *pFeatureHasher) {
 
     featureIndexUpdated = false;
     sampleIndexUpdated = false;
 
-    if (!fileExists(samplesPath)) {
-        outputStream << "Error: " << samplesPath << " not found." << endl;
-        return false;
-    }
-
-    vector<string> files;
-
     // maps the index of samples -> signals
     // we buffer the entire content of the directory to align the samples when writing sparseIndex
     map<unsigned int, vector<unsigned int>> mSignals;
     map<unsigned int, vector<float>> mSignalValues;
 
-    if (listFiles(samplesPath, false, files) == 0) {
-        outputStream << "Indexing " << files.size() << " files" << endl;
+    outputStream << "Indexing " << files.size() << " files" << endl;
+    for (auto const &file: files) {
+        outputStream << "\tIndexing file: " << file << endl;
 
-        for (auto const &file: files) {
-            outputStream << "\tIndexing file: " << file << endl;
-
-            ifstream inputStream(file);
-            if (!inputStream.is_open()) {
-                outputStream << "Error: Failed to open index file" << endl;
-                return false;
-            }
+        ifstream inputStream(file);
+        if (!inputStream.is_open()) {
+            outputStream << "Error: Failed to open index file" << endl;
+            return false;
+        }
 
-            // read file and keep updating index maps
-            if (!parseSamples(inputStream,
-                              enableFeatureIndexUpdates,
-                              mFeatureIndex,
-                              mSampleIndex,
-                              featureIndexUpdated,
-                              sampleIndexUpdated,
-                              mSignals,
-                              mSignalValues,
-                              outputStream)) {
-                return false;
-            }
+        // read file and keep updating index maps
+        if (!parseSamples(inputStream,
+                          enableFeatureIndexUpdates,
+                          mFeatureIndex,
+                          mSampleIndex,
+                          featureIndexUpdated,
+                          sampleIndexUpdated,
+                          mSignals,
+                          mSignalValues,
+                          outputStream,
+                          pFeatureHasher)) {
+            return false;
         }
     }
 
@@ -260,6 +299,7 @@ bool importSamplesFromPath(const std::string &samplesPath,
     map<unsigned int, vector<unsigned int>>::iterator mSignalsIter;
     map<unsigned int, vector<float>>::iterator mSignalValuesIter;
     for (mSignalsIter = mSignals.begin(); mSignalsIter != mSignals.end(); mSignalsIter++) {
+        vSampleIndex.push_back(mSignalsIter->first);
         vSparseStart.push_back(vSparseIndex.size());
         vector<unsigned int> &signals = mSignalsIter->second;
 
@@ -279,6 +319,45 @@ bool importSamplesFromPath(const std::string &samplesPath,
     return true;
 }
 
+bool importSamplesFromPath(const std::string &samplesPath,
+                           const bool enableFeatureIndexUpdates,
+                           std::unordered_map<string, unsigned int> &mFeatureIndex,
+                           std::unordered_map<string, unsigned int> &mSampleIndex,
+                           bool &featureIndexUpdated,
+                           bool &sampleIndexUpdated,
+                           std::vector<unsigned int> &vSparseStart,
+                           std::vector<unsigned int> &vSparseEnd,
+                           std::vector<unsigned int> &vSparseIndex,
+                           std::vector<float> &vSparseData,
+                           std::ostream &outputStream,
+                           FeatureHasher *pFeatureHasher) {
+
+    featureIndexUpdated = false;
+    sampleIndexUpdated = false;
+
+    if (!fileExists(samplesPath)) {
+        outputStream << "Error: " << samplesPath << " not found." << endl;
+        return false;
+    }
+
+    vector<string> files;
+    listFiles(samplesPath, false, files);
+    vector<unsigned int> vSampleIndex;
+    return importSamplesFromFiles(files,
+                                  enableFeatureIndexUpdates,
+                                  mFeatureIndex,
+                                  mSampleIndex,
+                                  featureIndexUpdated,
+                                  sampleIndexUpdated,
+                                  vSparseStart,
+                                  vSparseEnd,
+                                  vSparseIndex,
+                                  vSparseData,
+                                  vSampleIndex,
+                                  outputStream,
+                                  pFeatureHasher);
+}
+
 bool generateNetCDFIndexes(const std::string &samplesPath,
                            const bool enableFeatureIndexUpdates,
                            const std::string &outFeatureIndexFileName,
@@ -289,7 +368,8 @@ bool generateNetCDFIndexes(const std::string &samplesPath,
                            std::vector<unsigned int> &vSparseEnd,
                            std::vector<unsigned int> &vSparseIndex,
                            std::vector<float> &vSparseData,
-                           std::ostream &outputStream) {
+                           std::ostream &outputStream,
+                           FeatureHasher *pFeatureHasher) {
 
     bool featureIndexUpdated;
     bool sampleIndexUpdated;
@@ -304,11 +384,16 @@ bool generateNetCDFIndexes(const std::string &samplesPath,
               vSparseEnd,
               vSparseIndex,
               vSparseData,
-              cout)) {
+              cout,
+              pFeatureHasher)) {
 
         return false;
     }
 
+    if (pFeatureHasher) {
+        pFeatureHasher->reportCollisions(cout);
+    }
+
     // Now export the updated indices files only if they were updated.
     if (featureIndexUpdated) {
         exportIndex(mFeatureIndex, outFeatureIndexFileName);
@@ -323,6 +408,80 @@ bool generateNetCDFIndexes(const std::string &samplesPath,
     return true;
 }
 
+bool pruneFeatureIndex(unsigned int minFrequency,
+                       unsigned int maxFeatures,
+                       std::unordered_map<std::string, unsigned int> &mFeatureIndex,
+                       std::vector<unsigned int> &vSparseStart,
+                       std::vector<unsigned int> &vSparseEnd,
+                       std::vector<unsigned int> &vSparseIndex,
+                       std::vector<float> &vSparseData,
+                       std::ostream &outputStream) {
+    vector<uint64_t> vFrequency(mFeatureIndex.size(), 0);
+    for (size_t i = 0; i < vSparseStart.size(); i++) {
+        for (unsigned int j = vSparseStart[i]; j < vSparseEnd[i]; j++) {
+            if (vSparseIndex[j] >= vFrequency.size()) {
+                outputStream << "Error: Sample " << i << " has feature index " << vSparseIndex[j] << " outside of the "
+                             << mFeatureIndex.size() << " entry feature index" << endl;
+                return false;
+            }
+            vFrequency[vSparseIndex[j]]++;
+        }
+    }
+
+    // Rank features by descending frequency and keep the leading ones that pass both limits
+    vector<unsigned int> vOrder(vFrequency.size());
+    for (unsigned int i = 0; i < vOrder.size(); i++) {
+        vOrder[i] = i;
+    }
+    stable_sort(vOrder.begin(), vOrder.end(), [&vFrequency](unsigned int left, unsigned int right) {
+        return vFrequency[left] > vFrequency[right];
+    });
+    size_t keptFeatures = 0;
+    while (keptFeatures < vOrder.size() && vFrequency[vOrder[keptFeatures]] >= minFrequency &&
+           (maxFeatures == 0 || keptFeatures < maxFeatures)) {
+        keptFeatures++;
+    }
+    vector<unsigned int> vRemap(vFrequency.size(), UINT32_MAX);
+    for (unsigned int i = 0; i < keptFeatures; i++) {
+        vRemap[vOrder[i]] = i;
+    }
+
+    // Rewrite the samples with the new indices, dropping datapoints of pruned features
+    bool hasData = (vSparseData.size() == vSparseIndex.size());
+    vector<unsigned int> vPrunedIndex;
+    vector<float> vPrunedData;
+    for (size_t i = 0; i < vSparseStart.size(); i++) {
+        unsigned int start = vSparseStart[i];
+        unsigned int end = vSparseEnd[i];
+        vSparseStart[i] = vPrunedIndex.size();
+        for (unsigned int j = start; j < end; j++) {
+            if (vRemap[vSparseIndex[j]] != UINT32_MAX) {
+                vPrunedIndex.push_back(vRemap[vSparseIndex[j]]);
+                if (hasData) {
+                    vPrunedData.push_back(vSparseData[j]);
+                }
+            }
+        }
+        vSparseEnd[i] = vPrunedIndex.size();
+    }
+    outputStream << "Pruned feature index from " << mFeatureIndex.size() << " to " << keptFeatures << " features, keeping "
+                 << vPrunedIndex.size() << " of " << vSparseIndex.size() << " datapoints" << endl;
+    vSparseIndex.swap(vPrunedIndex);
+    if (hasData) {
+        vSparseData.swap(vPrunedData);
+    }
+
+    for (auto iterator = mFeatureIndex.begin(); iterator != mFeatureIndex.end();) {
+        if (iterator->second >= vRemap.size() || vRemap[iterator->second] == UINT32_MAX) {
+            iterator = mFeatureIndex.erase(iterator);
+        } else {
+            iterator->second = vRemap[iterator->second];
+            iterator++;
+        }
+    }
+    return true;
+}
+
 unsigned int roundUpMaxIndex(unsigned int maxFeatureIndex) {
     // Make the maxFeatureIndex a Multiple of 32
     // Pre- Titan-X:
@@ -330,13 +489,158 @@ unsigned int roundUpMaxIndex(unsigned int maxFeatureIndex) {
     return ((maxFeatureIndex + 127) >> 7) << 7;
 }
 
+void sortSparseExamples(const vector<unsigned int> &vSparseStart,
+                        const vector<unsigned int> &vSparseEnd,
+                        const vector<unsigned int> &vSparseIndex,
+                        const vector<float> *pvSparseData,
+                        vector<uint64_t> &vSparseOffset,
+                        vector<unsigned int> &vSortedIndex,
+                        vector<float> *pvSortedData) {
+    vSparseOffset.resize(vSparseStart.size() + 1);
+    vSortedIndex.clear();
+    if (pvSortedData) {
+        pvSortedData->clear();
+    }
+
+    vector<pair<unsigned int, float>> vExample;
+    vSparseOffset[0] = 0;
+    for (size_t i = 0; i < vSparseStart.size(); i++) {
+        vExample.clear();
+        for (unsigned int j = vSparseStart[i]; j < vSparseEnd[i]; j++) {
+            vExample.push_back(make_pair(vSparseIndex[j], pvSparseData ? (*pvSparseData)[j] : 0.0f));
+        }
+        sort(vExample.begin(), vExample.end());
+        for (const auto &entry : vExample) {
+            vSortedIndex.push_back(entry.first);
+            if (pvSortedData) {
+                pvSortedData->push_back(entry.second);
+            }
+        }
+        vSparseOffset[i + 1] = vSortedIndex.size();
+    }
+}
+
+bool calculateSparseStatistics(const vector<unsigned int> &vSparseStart,
+                               const vector<unsigned int> &vSparseEnd,
+                               const vector<unsigned int> &vSparseIndex,
+                               unsigned int maxFeatureIndex,
+                               SparseStatistics &statistics) {
+    statistics.vFeatureCount.assign(maxFeatureIndex, 0);
+    statistics.vLengthHistogram.assign(1, 0);
+    statistics.maxSparseDatapoints = 0;
+    uint64_t sparseDataSize = 0;
+    for (size_t i = 0; i < vSparseStart.size(); i++) {
+        unsigned int length = vSparseEnd[i] - vSparseStart[i];
+        if (length > statistics.maxSparseDatapoints) {
+            statistics.maxSparseDatapoints = length;
+            statistics.vLengthHistogram.resize(length + 1, 0);
+        }
+        statistics.vLengthHistogram[length]++;
+        sparseDataSize += length;
+        for (unsigned int j = vSparseStart[i]; j < vSparseEnd[i]; j++) {
+            if (vSparseIndex[j] >= maxFeatureIndex) {
+                return false;
+            }
+            statistics.vFeatureCount[vSparseIndex[j]]++;
+        }
+    }
+    statistics.sparseDensity = (vSparseStart.empty() || maxFeatureIndex == 0) ? 0.0 :
+        (double) sparseDataSize / ((double) vSparseStart.size() * maxFeatureIndex);
+    return true;
+}
+
+/**
+ * Writes the SparseStatistics of dataset 0. Feature counts use 32 bits when they fit, like the sparse offsets.
+ */
+static void writeSparseStatistics(NcFile &nc,
+                                  vector<unsigned int> &vSparseStart,
+                                  vector<unsigned int> &vSparseEnd,
+                                  vector<unsigned int> &vSparseIndex,
+                                  unsigned int maxFeatureIndex) {
+    SparseStatistics statistics;
+    if (!calculateSparseStatistics(vSparseStart, vSparseEnd, vSparseIndex, maxFeatureIndex, statistics)) {
+        throw std::runtime_error("Sparse index out of range of the feature index.");
+    }
+
+    NcDim datapointCountDim = nc.addDim("sparseDatapointCountDim0", statistics.vFeatureCount.size());
+    if (statistics.vFeatureCount.empty() ||
+        *max_element(statistics.vFeatureCount.begin(), statistics.vFeatureCount.end()) <= UINT32_MAX) {
+        vector<unsigned int> vFeatureCount32(statistics.vFeatureCount.begin(), statistics.vFeatureCount.end());
+        NcVar datapointCountVar = nc.addVar("sparseDatapointCount0", ncUint, datapointCountDim);
+        datapointCountVar.putVar(&vFeatureCount32[0]);
+    } else {
+        NcVar datapointCountVar = nc.addVar("sparseDatapointCount0", ncUint64, datapointCountDim);
+        datapointCountVar.putVar((unsigned long long int*)&statistics.vFeatureCount[0]);
+    }
+    NcDim lengthHistogramDim = nc.addDim("sparseLengthHistogramDim0", statistics.vLengthHistogram.size());
+    NcVar lengthHistogramVar = nc.addVar("sparseLengthHistogram0", ncUint64, lengthHistogramDim);
+    lengthHistogramVar.putVar((unsigned long long int*)&statistics.vLengthHistogram[0]);
+    nc.putAtt("maxSparseDatapoints0", ncUint, statistics.maxSparseDatapoints);
+    nc.putAtt("sparseDensity0", ncDouble, statistics.sparseDensity);
+    cout << "Max datapoints per sample: " << statistics.maxSparseDatapoints << ", sparse density: " << statistics.sparseDensity << endl;
+}
+
+/**
+ * Writes the sparse layout of dataset 0, either as raw start/end/index arrays or as a single
+ * offsets array with per-example sorted, delta + varint encoded indices.
+ */
+static void writeSparseIndices(NcFile &nc,
+                               vector<unsigned int> &vSparseStart,
+                               vector<unsigned int> &vSparseEnd,
+                               vector<unsigned int> &vSparseIndex,
+                               vector<float> *pvSparseData,
+                               bool compressIndices) {
+    NcDim examplesDim = nc.addDim("examplesDim0", vSparseStart.size());
+    NcDim sparseDataDim = nc.addDim("sparseDataDim0", vSparseIndex.size());
+    if (!compressIndices) {
+        NcVar sparseStartVar = nc.addVar("sparseStart0", ncUint, examplesDim);
+        NcVar sparseEndVar = nc.addVar("sparseEnd0", ncUint, examplesDim);
+        NcVar sparseIndexVar = nc.addVar("sparseIndex0", ncUint, sparseDataDim);
+        sparseStartVar.putVar(&vSparseStart[0]);
+        sparseEndVar.putVar(&vSparseEnd[0]);
+        sparseIndexVar.putVar(&vSparseIndex[0]);
+        if (pvSparseData) {
+            NcVar sparseDataVar = nc.addVar("sparseData0", ncFloat, sparseDataDim);
+            sparseDataVar.putVar(&(*pvSparseData)[0]);
+        }
+        return;
+    }
+
+    vector<uint64_t> vSparseOffset;
+    vector<unsigned int> vSortedIndex;
+    vector<float> vSortedData;
+    sortSparseExamples(vSparseStart, vSparseEnd, vSparseIndex, pvSparseData, vSparseOffset, vSortedIndex, pvSparseData ? &vSortedData : NULL);
+    vector<uint8_t> vEncodedIndex;
+    EncodeSparseIndexDeltaVarint(vSparseOffset.data(), vSparseStart.size(), vSortedIndex.data(), vEncodedIndex);
+    cout << "Encoded " << vSortedIndex.size() * sizeof(unsigned int) << " bytes of sparse indices into " << vEncodedIndex.size() << " bytes" << endl;
+
+    nc.putAtt("sparseEncoding0", ncUint, NNDataSetEnums::DeltaVarint);
+    NcDim sparseOffsetDim = nc.addDim("sparseOffsetDim0", vSparseOffset.size());
+    NcDim sparseIndexBytesDim = nc.addDim("sparseIndexBytesDim0", vEncodedIndex.size());
+    if (vSparseOffset.back() <= UINT32_MAX) {
+        vector<unsigned int> vSparseOffset32(vSparseOffset.begin(), vSparseOffset.end());
+        NcVar sparseOffsetVar = nc.addVar("sparseOffset0", ncUint, sparseOffsetDim);
+        sparseOffsetVar.putVar(&vSparseOffset32[0]);
+    } else {
+        NcVar sparseOffsetVar = nc.addVar("sparseOffset0", ncUint64, sparseOffsetDim);
+        sparseOffsetVar.putVar((unsigned long long int*)&vSparseOffset[0]);
+    }
+    NcVar sparseIndexVar = nc.addVar("sparseIndex0", ncUbyte, sparseIndexBytesDim);
+    sparseIndexVar.putVar(&vEncodedIndex[0]);
+    if (pvSparseData) {
+        NcVar sparseDataVar = nc.addVar("sparseData0", ncFloat, sparseDataDim);
+        sparseDataVar.putVar(&vSortedData[0]);
+    }
+}
+
 void writeNetCDFFile(vector<unsigned int> &vSparseStart,
                      vector<unsigned int> &vSparseEnd,
                      vector<unsigned int> &vSparseIndex,
                      vector<float> &vSparseData,
                      string fileName,
                      string datasetName,
-                     unsigned int maxFeatureIndex) {
+                     unsigned int maxFeatureIndex,
+                     bool compressIndices) {
 
     cout << "Raw max index is: " << maxFeatureIndex << endl;
     maxFeatureIndex = roundUpMaxIndex(maxFeatureIndex);
@@ -355,16 +659,8 @@ void writeNetCDFFile(vector<unsigned int> &vSparseStart,
         nc.putAtt("dataType0", ncUint, NNDataSetEnums::Float);
         nc.putAtt("dimensions0", ncUint, 1);
         nc.putAtt("width0", ncUint, maxFeatureIndex);
-        NcDim examplesDim = nc.addDim("examplesDim0", vSparseStart.size());
-        NcDim sparseDataDim = nc.addDim("sparseDataDim0", vSparseIndex.size());
-        NcVar sparseStartVar = nc.addVar("sparseStart0", ncUint, examplesDim);
-        NcVar sparseEndVar = nc.addVar("sparseEnd0", ncUint, examplesDim);
-        NcVar sparseIndexVar = nc.addVar("sparseIndex0", ncUint, sparseDataDim);
-        NcVar sparseDataVar = nc.addVar("sparseData0", ncFloat, sparseDataDim);
-        sparseStartVar.putVar(&vSparseStart[0]);
-        sparseEndVar.putVar(&vSparseEnd[0]);
-        sparseIndexVar.putVar(&vSparseIndex[0]);
-        sparseDataVar.putVar(&vSparseData[0]);
+        writeSparseIndices(nc, vSparseStart, vSparseEnd, vSparseIndex, &vSparseData, compressIndices);
+        writeSparseStatistics(nc, vSparseStart, vSparseEnd, vSparseIndex, maxFeatureIndex);
 
         cout << "Created NetCDF file " << fileName << " " << "for dataset " << datasetName << endl;
     } catch (std::exception &e) {
@@ -378,7 +674,8 @@ void writeNetCDFFile(vector<unsigned int> &vSparseStart,
                      vector<unsigned int> &vSparseIndex,
                      string fileName,
                      string datasetName,
-                     unsigned int maxFeatureIndex) {
+                     unsigned int maxFeatureIndex,
+                     bool compressIndices) {
     // Make the maxFeatureIndex a Multuple of 32
     // Pre- Titan-X:
     // maxFeatureIndex = ((maxFeatureIndex + 31) >> 5) << 5;
@@ -399,14 +696,8 @@ void writeNetCDFFile(vector<unsigned int> &vSparseStart,
         nc.putAtt("dataType0", ncUint, NNDataSetEnums::UInt);
         nc.putAtt("dimensions0", ncUint, 1);
         nc.putAtt("width0", ncUint, maxFeatureIndex);
-        NcDim examplesDim = nc.addDim("examplesDim0", vSparseStart.size());
-        NcDim sparseDataDim = nc.addDim("sparseDataDim0", vSparseIndex.size());
-        NcVar sparseStartVar = nc.addVar("sparseStart0", ncUint, examplesDim);
-        NcVar sparseEndVar = nc.addVar("sparseEnd0", ncUint, examplesDim);
-        NcVar sparseIndexVar = nc.addVar("sparseIndex0", ncUint, sparseDataDim);
-        sparseStartVar.putVar(&vSparseStart[0]);
-        sparseEndVar.putVar(&vSparseEnd[0]);
-        sparseIndexVar.putVar(&vSparseIndex[0]);
+        writeSparseIndices(nc, vSparseStart, vSparseEnd, vSparseIndex, NULL, compressIndices);
+        writeSparseStatistics(nc, vSparseStart, vSparseEnd, vSparseIndex, maxFeatureIndex);
 
         cout << "Created NetCDF file " << fileName << " " << "for dataset " << datasetName << endl;
     } catch (std::exception &e) {
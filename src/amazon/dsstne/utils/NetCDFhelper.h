@@ -10,11 +10,45 @@
    or in the "license" file accompanying this file. This file is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the License for the specific language governing permissions and limitations under the License.
  */
 
+#include <cstdint>
 #include <iosfwd>
 #include <map>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
+
+/**
+ * Maps feature labels straight to one of a fixed number of buckets instead of looking them up in a feature index,
+ * so the input width stays fixed as new features appear and no global dictionary has to be built or kept. With
+ * signed hashing, a second hash bit flips the sign of the feature value so that colliding features tend to cancel
+ * instead of adding up. The hash is a fixed function of the label bytes, so every run and machine agrees on it.
+ */
+class FeatureHasher {
+public:
+    FeatureHasher(unsigned int buckets, bool signedHashing);
+
+    unsigned int getBuckets() const { return buckets; }
+
+    bool isSigned() const { return signedHashing; }
+
+    /**
+     * Returns the bucket of featureName and sets sign to -1 or +1 (always +1 without signed hashing).
+     */
+    unsigned int hash(const std::string &featureName, float &sign);
+
+    /**
+     * Reports how many distinct features were hashed, how many buckets they occupy and how many collided.
+     */
+    void reportCollisions(std::ostream &outputStream) const;
+
+private:
+    unsigned int buckets;
+    bool signedHashing;
+    std::unordered_set<uint64_t> sFeatureHash;  // 64-bit hashes of the distinct features seen
+    std::vector<bool> vBucketUsed;
+    unsigned int usedBuckets;
+};
 
 /**
  * Loads an index from the given input stream, assuming an entry on each line with a 
@@ -74,7 +108,8 @@ bool parseSamples(std::istream &inputStream,
                   bool &sampleIndexUpdated,
                   std::map<unsigned int, std::vector<unsigned int>> &mSignals,
                   std::map<unsigned int, std::vector<float>> &mSignalValues,
-                  std::ostream &outputStream);
+                  std::ostream &outputStream,
+                  FeatureHasher *pFeatureHasher = NULL);
 
 /**
  * Import samples from a given file or directory, and update the referenced data structures.
@@ -88,6 +123,8 @@ bool parseSamples(std::istream &inputStream,
  * If enableFeatureIndexUpdates is set, the existing feature index will be updated with any
  * new entries found. Otherwise only the samples index will be updated.
  *
+ * If pFeatureHasher is set, features are hashed into its buckets and mFeatureIndex is not used.
+ *
  * @return  \c true if the all input files were read successfully; \c false otherwise
  */
 bool importSamplesFromPath(const std::string &samplesPath,
@@ -100,7 +137,28 @@ bool importSamplesFromPath(const std::string &samplesPath,
                            std::vector<unsigned int> &vSparseEnd,
                            std::vector<unsigned int> &vSparseIndex,
                            std::vector<float> &vSparseData,
-                           std::ostream &outputStream);
+                           std::ostream &outputStream,
+                           FeatureHasher *pFeatureHasher = NULL);
+
+/**
+ * Import samples from the given files, as importSamplesFromPath() does for a file or directory. The sample index
+ * of each imported sample is appended to vSampleIndex, in the order the samples are stored in the sparse arrays.
+ *
+ * @return  \c true if the all input files were read successfully; \c false otherwise
+ */
+bool importSamplesFromFiles(const std::vector<std::string> &files,
+                            const bool enableFeatureIndexUpdates,
+                            std::unordered_map<std::string, unsigned int> &mFeatureIndex,
+                            std::unordered_map<std::string, unsigned int> &mSampleIndex,
+                            bool &featureIndexUpdated,
+                            bool &sampleIndexUpdated,
+                            std::vector<unsigned int> &vSparseStart,
+                            std::vector<unsigned int> &vSparseEnd,
+                            std::vector<unsigned int> &vSparseIndex,
+                            std::vector<float> &vSparseData,
+                            std::vector<unsigned int> &vSampleIndex,
+                            std::ostream &outputStream,
+                            FeatureHasher *pFeatureHasher = NULL);
 
 /**
  * Generates a NetCDF index for a given dataset and exports them to respective files with 
@@ -115,6 +173,7 @@ bool importSamplesFromPath(const std::string &samplesPath,
  * @param outFeatureIndexFileName - the name of the file to export the feature index to.
  * @param outSampleIndexFileName - the name of tile to export the samples index to.
  * @param outputStream - output stream to be used for any status or error messages.
+ * @param pFeatureHasher - if set, features are hashed into its buckets and mFeatureIndex is not used.
  *
  * @return  \c true if the all input files were read successfully; \c false otherwise
  */
@@ -128,11 +187,66 @@ bool generateNetCDFIndexes(const std::string &samplesPath,
                            std::vector<unsigned int> &vSparseEnd,
                            std::vector<unsigned int> &vSparseIndex,
                            std::vector<float> &vSparseData,
-                           std::ostream &outputStream);
+                           std::ostream &outputStream,
+                           FeatureHasher *pFeatureHasher = NULL);
+
+/**
+ * Prunes the vocabulary of a freshly created feature index: features occurring in fewer than minFrequency
+ * datapoints are dropped, and only the maxFeatures most frequent ones are kept (all of them if maxFeatures is 0).
+ * Surviving features are renumbered by descending frequency, ties keeping their original order, so popular
+ * features get the lowest indices. Samples are compacted in place and mFeatureIndex is updated to match.
+ *
+ * @return  \c false if a sample references an index outside mFeatureIndex; \c true otherwise
+ */
+bool pruneFeatureIndex(unsigned int minFrequency,
+                       unsigned int maxFeatures,
+                       std::unordered_map<std::string, unsigned int> &mFeatureIndex,
+                       std::vector<unsigned int> &vSparseStart,
+                       std::vector<unsigned int> &vSparseEnd,
+                       std::vector<unsigned int> &vSparseIndex,
+                       std::vector<float> &vSparseData,
+                       std::ostream &outputStream);
+
+/**
+ * Copies each sample's indices (and values, if pvSparseData is set) in ascending index order into
+ * contiguous vSortedIndex/pvSortedData, with sample i occupying [vSparseOffset[i], vSparseOffset[i + 1]).
+ */
+void sortSparseExamples(const std::vector<unsigned int> &vSparseStart,
+                        const std::vector<unsigned int> &vSparseEnd,
+                        const std::vector<unsigned int> &vSparseIndex,
+                        const std::vector<float> *pvSparseData,
+                        std::vector<uint64_t> &vSparseOffset,
+                        std::vector<unsigned int> &vSortedIndex,
+                        std::vector<float> *pvSortedData);
+
+/**
+ * Shape of a sparse dataset, computed while it is written so that NNDataSet can load it instead of rescanning
+ * the data: how often each feature index occurs, how many samples have each number of datapoints, the largest
+ * number of datapoints in a sample and the fraction of the samples x features matrix that is set.
+ */
+struct SparseStatistics {
+    std::vector<uint64_t> vFeatureCount;
+    std::vector<uint64_t> vLengthHistogram;
+    unsigned int maxSparseDatapoints;
+    double sparseDensity;
+};
+
+/**
+ * Calculates the statistics of the samples [vSparseStart[i], vSparseEnd[i]) over maxFeatureIndex features.
+ *
+ * @return  \c false if an index is not below maxFeatureIndex; \c true otherwise
+ */
+bool calculateSparseStatistics(const std::vector<unsigned int> &vSparseStart,
+                               const std::vector<unsigned int> &vSparseEnd,
+                               const std::vector<unsigned int> &vSparseIndex,
+                               unsigned int maxFeatureIndex,
+                               SparseStatistics &statistics);
 
 /**
  * Writes an NetCDFfile for a given sparse matrix of indices and values (start of sample, end of sample, samples array) for each sample.
  * The dataset within the file is indexed with dataset name. Note that maxFeatureIndex is the rounded up to multiple of 32.
+ * If compressIndices is set, indices are stored sorted and delta + varint encoded (NNDataSetEnums::DeltaVarint).
+ * The dataset's SparseStatistics are stored alongside the indices.
  */
 void writeNetCDFFile(std::vector<unsigned int> &vSparseStart,
                      std::vector<unsigned int> &vSparseEnd,
@@ -140,18 +254,22 @@ void writeNetCDFFile(std::vector<unsigned int> &vSparseStart,
                      std::vector<float> &vSparseValue,
                      std::string fileName,
                      std::string datasetName,
-                     unsigned int maxFeatureIndex);
+                     unsigned int maxFeatureIndex,
+                     bool compressIndices = false);
 
 /**
  * Writes an NetCDFfile for a given sparse matrix of indices only (start of sample, end of sample, samples array) for each sample.
  * The dataset within the file is indexed with dataset name. Note that maxFeatureIndex is the rounded up to multiple of 32.
+ * If compressIndices is set, indices are stored sorted and delta + varint encoded (NNDataSetEnums::DeltaVarint).
+ * The dataset's SparseStatistics are stored alongside the indices.
  */
 void writeNetCDFFile(std::vector<unsigned int> &vSparseStart,
                      std::vector<unsigned int> &vSparseEnd,
                      std::vector<unsigned int> &vSparseIndex,
                      std::string fileName,
                      std::string datasetName,
-                     unsigned int maxFeatureIndex);
+                     unsigned int maxFeatureIndex,
+                     bool compressIndices = false);
 
 /**
  * Rounds up the index to take advantage of aligned memory addressing.
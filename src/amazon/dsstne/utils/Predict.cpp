@@ -56,56 +56,104 @@ void extractNNMapsToVectors(vector<string> &vVectors,
 }
 
 /**
- * A wrapper function to convert the TSV text file into a NetCDF file. The mSignalIndex will return the mappings for
- * all instances/signals/samples/customer id that were found in the text dataset. This looks common enough to move
- * to common utils.
+ * Parses the TSV text file straight into an input dataset, without writing it out to NetCDF and reading it back.
+ * The mSignalIndex will return the mappings for all instances/signals/samples/customer id that were found in the
+ * text dataset.
  *
  * @param inputTextFile - input text file to process.
- * @param dataSetName - the name for the dataset to store in netcdf.
- * @param outputNCDFFile - the name of the output NetCDF file that we generate.
+ * @param dataSetName - the name for the dataset, matching the network input layer.
  * @param mFeatureIndex - feature index map used to translate features to indices for sparse representation.
- * @param mSignalsIndex - signals or instance index, updated as the text file is processed.
+ * @param mSignalIndex - signals or instance index, updated as the text file is processed.
+ * @param shard - the share of the samples to keep, out of shards contiguous shares in text file order.
+ * @param shards - number of shares the samples are split into; the default keeps all of them.
+ *
+ * @return the input dataset, in the form returned by LoadNetCDF, or no datasets if this share holds no samples.
  */
-void convertTextToNetCDF(string inputTextFile, 
-                         string dataSetName, 
-                         string outputNCDFFile, 
-                         unordered_map<string, unsigned int> &mFeatureIndex,
-                         unordered_map<string, unsigned int> &mSignalIndex,
-                         string featureIndexFile, 
-                         string sampleIndexFile)
+vector<NNDataSetBase*> loadTextDataSet(const string &inputTextFile,
+                                       const string &dataSetName,
+                                       unordered_map<string, unsigned int> &mFeatureIndex,
+                                       unordered_map<string, unsigned int> &mSignalIndex,
+                                       unsigned int shard = 0,
+                                       unsigned int shards = 1)
 {
     vector <unsigned int> vSparseStart;
     vector <unsigned int> vSparseEnd;
     vector <unsigned int> vSparseIndex;
     vector <float> vSparseData;
 
-    if (!generateNetCDFIndexes(inputTextFile, false, featureIndexFile, sampleIndexFile, mFeatureIndex, mSignalIndex, vSparseStart, vSparseEnd, vSparseIndex, vSparseData, cout)) {
+    bool featureIndexUpdated;
+    bool sampleIndexUpdated;
+    if (!importSamplesFromPath(inputTextFile, false, mFeatureIndex, mSignalIndex, featureIndexUpdated, sampleIndexUpdated,
+                               vSparseStart, vSparseEnd, vSparseIndex, vSparseData, cout)) {
         exit(1);
     }
 
-    // Only write binary data using a single CPU
-    if (getGpu()._id==0){
-        writeNetCDFFile(vSparseStart, vSparseEnd, vSparseIndex, 
-            outputNCDFFile, dataSetName, mFeatureIndex.size());
+    // Keep only this share of the samples, renumbered from 0 so mSignalIndex matches the dataset
+    if (shards > 1) {
+        size_t samples = vSparseStart.size();
+        unsigned int first = (samples * shard) / shards;
+        unsigned int last = (samples * (shard + 1)) / shards;
+        vSparseStart = vector<unsigned int>(vSparseStart.begin() + first, vSparseStart.begin() + last);
+        vSparseEnd = vector<unsigned int>(vSparseEnd.begin() + first, vSparseEnd.begin() + last);
+        for (auto it = mSignalIndex.begin(); it != mSignalIndex.end(); ) {
+            if ((it->second < first) || (it->second >= last)) {
+                it = mSignalIndex.erase(it);
+            } else {
+                it->second -= first;
+                ++it;
+            }
+        }
+
+        // With more shares than samples some are empty, which a dataset can't be
+        if (first == last) {
+            return vector<NNDataSetBase*>();
+        }
     }
 
-    // Delete unwanted memory now that we have produced the netCDF file.
+    // Signal values are ignored, the input layer is an indicator dataset
+    vector<NNDataSetBase*> vDataSet = LoadSparseData(dataSetName, roundUpMaxIndex(mFeatureIndex.size()), vSparseStart, vSparseEnd, vSparseIndex);
+
+    // Delete unwanted memory now that the dataset holds its own copy.
     forceClearVector(vSparseStart);
     forceClearVector(vSparseEnd);
     forceClearVector(vSparseIndex);
     forceClearVector(vSparseData);
+    return vDataSet;
+}
+
+/**
+ * Lists every data-parallel process's part of the recs, in sample order, in <baseFileName>.manifest once all
+ * processes have written them.
+ *
+ * @param baseFileName - recs file name the parts are named after.
+ * @param examples - number of samples this process wrote recs for.
+ */
+void writeManifest(const string &baseFileName, unsigned int examples) {
+    int process, processes;
+    MPI_Comm_rank(MPI_COMM_WORLD, &process);
+    MPI_Comm_size(MPI_COMM_WORLD, &processes);
+    vector<unsigned int> vExamples(processes);
+    MPI_Gather(&examples, 1, MPI_UNSIGNED, vExamples.data(), 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+    if (process == 0) {
+        ofstream manifest(baseFileName + ".manifest");
+        for (int i = 0; i < processes; i++) {
+            manifest << baseFileName << ".part-" << i << "\t" << vExamples[i] << endl;
+        }
+        cout << "Wrote " << baseFileName << ".manifest listing " << processes << " parts" << endl;
+    }
 }
 
 void printUsagePredict() {
     cout << "Predict: Generates predictions from a trained neural network given a signals/input dataset." << endl;
-    cout << "Usage: predict -d <dataset_name> -n <network_file> -r <input_text_file> -i <input_feature_index> -o <output_feature_index> -f <filters_json> [-b <batch_size>] [-k <num_recs>] [-l layer] [-s input_signals_index] [-p score_precision]" << endl;
+    cout << "Usage: predict -d <dataset_name> -n <network_file> -r <input_text_file> -i <input_feature_index> -o <output_feature_index> -f <filters_json> [-b <batch_size>] [-k <num_recs>] [-l layer] [-s input_signals_index] [-p score_precision] [-m parallelization]" << endl;
     cout << "    -b batch_size: (default = 1024) the number records/input rows to process in a batch." << endl;
     cout << "    -d dataset_name: (required) name for the dataset within the netcdf file." << endl;
     cout << "    -f samples filterFileName ." << endl;
     cout << "    -i input_feature_index: (required) path to the feature index file, used to tranform input signals to correct input feature vector." << endl;
     cout << "    -k num_recs: (default = 100) The number of predictions (sorted by score to generate). Ignored if -l flag is used." << endl;
     cout << "    -l layer: (default = Output) the network layer to use for predictions. If specified, the raw scores for each node in the layer is output in order." << endl;
-    cout << "    -n network_file: (required) the trained neural network in NetCDF file." << endl;
+    cout << "    -m parallelization: (default = model) model splits the network across processes, which predict all samples together. data runs the whole network in each process on its own share of the samples, writing recs to <filename>.part-<process>, listed in <filename>.manifest." << endl;
+    cout << "    -n network_file: (required) the trained neural network in NetCDF file, or a compact model file if it ends in .model." << endl;
     cout << "    -o output_feature_index: (required) path to the feature index file, used to tranform the network output feature vector to appropriate features." << endl;
     cout << "    -p score_precision: (default = 4.3f) precision of the scores in output" << endl;
     cout << "    -r input_text_file: (required) path to the file with input signal to use to generate predictions (i.e. recommendations)." << endl;
@@ -170,11 +218,27 @@ int main(int argc, char** argv)
 
     string scoreFormat = getOptionalArgValue(argc, argv, "-p", NNRecsGenerator::DEFAULT_SCORE_PRECISION);
 
+    string parallelization = getOptionalArgValue(argc, argv, "-m", "model");
+    if ((parallelization != "model") && (parallelization != "data")) {
+        cout << "Error: Unknown parallelization: " << parallelization << endl;
+        return 1;
+    }
+    bool bDataParallel = (parallelization == "data");
+
 
     // Initialize GPU network
     getGpu().Startup(argc, argv);
     getGpu().SetRandomSeed(FIXED_SEED);
 
+    // Data-parallel processes predict independently, each with the whole network
+    int process = getGpu()._id;
+    int processes = getGpu()._numprocs;
+    string baseFileName = recsOutputFileName;
+    if (bDataParallel) {
+        getGpu().Detach();
+        recsOutputFileName += ".part-" + to_string(process);
+    }
+
     // Start timing loading of data and network.
     timeval timePreProcessingStart;
     gettimeofday(&timePreProcessingStart, NULL);
@@ -185,26 +249,18 @@ int main(int argc, char** argv)
         exit(1);
     }
 
-    // Load the dataset text file and geneate the NetCDF
+    // Load the dataset text file
     unordered_map<string, unsigned int> mSignals;
-    string inputNetCDFFileName;
-
-    // Ensure we don't override other dataset files (i.e. from training)
-    string dataSetFilesPrefix = dataSetName + "_predict";
-    inputNetCDFFileName.assign(dataSetFilesPrefix + NETCDF_FILE_EXTENTION);
-
-    string featureIndexFile = dataSetFilesPrefix + ".featuresIndex";
-    string sampleIndexFile = dataSetFilesPrefix + ".samplesIndex";
-    convertTextToNetCDF(recsFileName,
-		    dataSetName,
-		    inputNetCDFFileName,
-		    mInput,
-		    mSignals,
-		    featureIndexFile,
-		    sampleIndexFile);
-    // TODO: We should look at avoiding generating/re-reading the netCDF since we have parsed it.
-    // TODO: convertTextToNetCDF needs a better name. Now it parse the text into NetCDF file and write them out. A function should have all input/output
-    // variables defined in the interface
+    vector <NNDataSetBase*> vDataSetInput = loadTextDataSet(recsFileName, dataSetName, mInput, mSignals, bDataParallel ? process : 0, bDataParallel ? processes : 1);
+
+    // With more processes than samples a process can have none, so it writes an empty part and lists it
+    if (vDataSetInput.empty()) {
+        cout << "No samples to generate predictions for in share " << process << " of " << processes << endl;
+        ofstream part(recsOutputFileName);
+        writeManifest(baseFileName, 0);
+        getGpu().Shutdown();
+        return 0;
+    }
 
     // Load the filter set
     if(getGpu()._id == 0 ){
@@ -213,8 +269,7 @@ int main(int argc, char** argv)
         CWMetric::updateMetrics("Signals_Size", mSignals.size());
     }
 
-    vector <NNDataSetBase*> vDataSetInput = LoadNetCDF(inputNetCDFFileName);
-    NNNetwork* pNetwork = LoadNeuralNetworkNetCDF(networkFileName, batchSize);
+    NNNetwork* pNetwork = isModelFile(networkFileName) ? LoadNeuralNetworkModel(networkFileName, batchSize) : LoadNeuralNetworkNetCDF(networkFileName, batchSize);
     pNetwork->LoadDataSets(vDataSetInput);
 
     // Generate an ordered vector of the signals/samples index, so that output are correctly labeled.
@@ -279,6 +334,10 @@ int main(int argc, char** argv)
         CWMetric::updateMetrics("Prediction_Time", elapsed_time(timeRecsGenerationEnd, timeRecsGenerationStart));
         cout << "Total time for Generating recs for " << pNetwork->GetExamples() << " was " <<  elapsed_time(timeRecsGenerationEnd, timeRecsGenerationStart) << endl;}
 
+    if (bDataParallel) {
+        writeManifest(baseFileName, pNetwork->GetExamples());
+    }
+
     delete(nnRecsGenerator);
     delete pNetwork;
     getGpu().Shutdown();
@@ -38,9 +38,23 @@ void printUsageTrain() {
     cout << "    -c config_file: (required) the JSON config files with network training parameters." << endl;
     cout << "    -i input_netcdf: (required) path to the netcdf with dataset for the input of the network." << endl;
     cout << "    -o output_netcdf: (required) path to the netcdf with dataset for expected output of the network." << endl;
-    cout << "    -n network_file: (required) the output trained neural network in NetCDF file." << endl;
+    cout << "    -n network_file: (required) the output trained neural network in NetCDF file, or a compact model file if it ends in .model." << endl;
     cout << "    -b batch_size: (default = 1024) the number records/input rows to process in a batch." << endl;
     cout << "    -e num_epochs: (default = 40) the number passes on the full dataset." << endl;
+    cout << "    -r checkpoint_file: (optional) resume training from a checkpoint written during an earlier run, in place of -c." << endl;
+    cout << "    -w network_file: (optional) warm start from a trained network in place of -c, growing input and output layers to match the data sets (e.g. generated with -m) and training for num_epochs more epochs." << endl;
+    cout << "    -schedule alpha_schedule: (default = fixed) learning rate schedule, one of fixed, step, exponential or cosine." << endl;
+    cout << "    -alphaInterval epochs: (default = 1) epochs between learning rate decays (annealing period for cosine)." << endl;
+    cout << "    -alphaMultiplier multiplier: (default = 0.9) learning rate decay per interval." << endl;
+    cout << "    -warmup epochs: (default = 0) epochs of linear learning rate warmup." << endl;
+    cout << "    -vi validation_input_netcdf: (optional) held-out dataset for the input of the network, evaluated during training." << endl;
+    cout << "    -vo validation_output_netcdf: (optional) held-out dataset for expected output of the network." << endl;
+    cout << "    -vinterval epochs: (default = 1) epochs between validation passes." << endl;
+    cout << "    -k top_k: (default = 0) K for validation precision@K, recall@K and NDCG@K on sparse output data (0 to only track validation error)." << endl;
+    cout << "    -patience passes: (default = 3) validation passes without improvement before stopping early (0 to disable)." << endl;
+    cout << "    -stream window_shards: (optional) treat -i and -o as directories of identically sized sparse NetCDF shards and stream them, keeping window_shards shards resident at a time." << endl;
+    cout << "    -cache directory: (optional) directory to cache network descriptors compiled from config_file in, so later runs with the same config and datasets skip parsing it." << endl;
+    cout << "    -negatives count: (default = 0) train sparse output layers on each batch's positives plus count negatives sampled by output frequency instead of on every output (0 to disable)." << endl;
     cout << endl;
 }
 
@@ -71,13 +85,33 @@ int main(int argc, char** argv)
    
     // Check all required arguments first. 
 
-    string configFileName = getRequiredArgValue(argc, argv, "-c", "config file was not specified.", &printUsageTrain);
-    if (! fileExists(configFileName)) {
-        cout << "Error: Cannot read config file: " << configFileName << endl;
+    string resumeFileName = getOptionalArgValue(argc, argv, "-r", "");
+    string warmStartFileName = getOptionalArgValue(argc, argv, "-w", "");
+    string configFileName;
+    if (!resumeFileName.empty() && !warmStartFileName.empty()) {
+        cout << "Error: Cannot resume (-r) and warm start (-w) training. Please select only one." << endl;
+        return 1;
+    } else if (!warmStartFileName.empty()) {
+        if (! fileExists(warmStartFileName)) {
+            cout << "Error: Cannot read warm start network file: " << warmStartFileName << endl;
+            return 1;
+        } else {
+            cout << "Train will warm start from network file: " << warmStartFileName << endl;
+        }
+    } else if (resumeFileName.empty()) {
+        configFileName = getRequiredArgValue(argc, argv, "-c", "config file was not specified.", &printUsageTrain);
+        if (! fileExists(configFileName)) {
+            cout << "Error: Cannot read config file: " << configFileName << endl;
+            return 1;
+        } else {
+            cout << "Train will use configuration file: " << configFileName << endl;
+        }
+    } else if (! fileExists(resumeFileName)) {
+        cout << "Error: Cannot read checkpoint file: " << resumeFileName << endl;
         return 1;
     } else {
-        cout << "Train will use configuration file: " << configFileName << endl;
-	}
+        cout << "Train will resume from checkpoint file: " << resumeFileName << endl;
+    }
 
     string inputDataFile = getRequiredArgValue(argc, argv, "-i", "input data file is not specified.", &printUsageTrain);
     if (! fileExists(inputDataFile)) {
@@ -110,43 +144,123 @@ int main(int argc, char** argv)
     unsigned int epoch =  stoi(getOptionalArgValue(argc, argv, "-e", "40"));
     cout << "Train will use number of epochs: " << epoch << endl;
     cout << "Train alpha " << alpha << ", lambda " << lambda <<", mu "<< mu <<".Please check CDL.txt for meanings" << endl;
+
+    string alphaSchedule = getOptionalArgValue(argc, argv, "-schedule", "fixed");
+    unsigned int alphaInterval = stoi(getOptionalArgValue(argc, argv, "-alphaInterval", "1"));
+    float alphaMultiplier = stof(getOptionalArgValue(argc, argv, "-alphaMultiplier", "0.9f"));
+    unsigned int warmup = stoi(getOptionalArgValue(argc, argv, "-warmup", "0"));
+    LearningRateSchedule schedule;
+    if (alphaSchedule == "fixed") {
+        schedule = FixedRate;
+    } else if (alphaSchedule == "step") {
+        schedule = StepDecay;
+    } else if (alphaSchedule == "exponential") {
+        schedule = ExponentialDecay;
+    } else if (alphaSchedule == "cosine") {
+        schedule = CosineAnnealing;
+    } else {
+        cout << "Error: Unknown learning rate schedule: " << alphaSchedule << endl;
+        return 1;
+    }
+
+    string validationInputFile = getOptionalArgValue(argc, argv, "-vi", "");
+    string validationOutputFile = getOptionalArgValue(argc, argv, "-vo", "");
+    unsigned int validationInterval = stoi(getOptionalArgValue(argc, argv, "-vinterval", "1"));
+    unsigned int validationK = stoi(getOptionalArgValue(argc, argv, "-k", "0"));
+    unsigned int patience = stoi(getOptionalArgValue(argc, argv, "-patience", "3"));
+    if (validationInputFile.empty() != validationOutputFile.empty()) {
+        cout << "Error: Both -vi and -vo must be specified for validation." << endl;
+        return 1;
+    }
+
+    unsigned int streamWindowShards = stoi(getOptionalArgValue(argc, argv, "-stream", "0"));
+    if (streamWindowShards > 0) {
+        cout << "Train will stream input and output shards, " << streamWindowShards << " at a time" << endl;
+    }
+
+    string descriptorCacheDirectory = getOptionalArgValue(argc, argv, "-cache", "");
+    unsigned int sampledNegatives = stoi(getOptionalArgValue(argc, argv, "-negatives", "0"));
 	
     // Initialize GPU network
     getGpu().Startup(argc, argv);
     getGpu().SetRandomSeed(FIXED_SEED);
 
     // Load the input and output dataset
-    vector <NNDataSetBase*> vDataSetInput = LoadNetCDF(inputDataFile);
-    vector <NNDataSetBase*> vDataSetOutput = LoadNetCDF(outputDataFile);
+    vector <NNDataSetBase*> vDataSetInput;
+    vector <NNDataSetBase*> vDataSetOutput;
+    if (streamWindowShards > 0) {
+        vDataSetInput = LoadStreamingNetCDF(inputDataFile, streamWindowShards);
+        vDataSetOutput = LoadStreamingNetCDF(outputDataFile, streamWindowShards);
+    } else {
+        vDataSetInput = LoadNetCDF(inputDataFile);
+        vDataSetOutput = LoadNetCDF(outputDataFile);
+    }
 
     // Merging to a single List for Loading it to Network
     vDataSetInput.insert(vDataSetInput.end(), vDataSetOutput.begin(), vDataSetOutput.end());
 
-    // Create a Neural network from the config
-    NNNetwork* pNetwork = LoadNeuralNetworkJSON(configFileName, batchSize, vDataSetInput);
+    // Create a Neural network from the config, or restore weights, optimizer state and epoch count from a checkpoint
+    NNNetwork* pNetwork;
+    if (!resumeFileName.empty()) {
+        pNetwork = LoadNeuralNetworkNetCDF(resumeFileName, batchSize);
+    } else if (!warmStartFileName.empty()) {
+        pNetwork = isModelFile(warmStartFileName) ? LoadNeuralNetworkModel(warmStartFileName, batchSize, vDataSetInput) : LoadNeuralNetworkNetCDF(warmStartFileName, batchSize, vDataSetInput);
+    } else {
+        pNetwork = LoadNeuralNetworkJSON(configFileName, batchSize, vDataSetInput, descriptorCacheDirectory);
+    }
     
     // Load training data
     pNetwork->LoadDataSets(vDataSetInput);
     pNetwork->LoadDataSets(vDataSetOutput);
     pNetwork->SetCheckpoint(networkFileName, 10);
 
-    // Save initialized network before train
-    pNetwork->SetPosition(0);
-    pNetwork->PredictBatch();
-    pNetwork->SaveNetCDF("initial_network.nc");
+    if (resumeFileName.empty()) {
+        // Save initialized network before train
+        if (warmStartFileName.empty()) {
+            pNetwork->SetPosition(0);
+            pNetwork->PredictBatch();
+            pNetwork->SaveNetCDF("initial_network.nc");
+        }
 
-    // Set to default training mode SGD.
-    TrainingMode mode=SGD;
-    pNetwork->SetTrainingMode(mode);
+        // Set to default training mode SGD.
+        TrainingMode mode=SGD;
+        pNetwork->SetTrainingMode(mode);
+    } else {
+        cout << "Train resuming after epoch " << pNetwork->GetEpochs() << endl;
+    }
+    if (!pNetwork->SetLearningRateSchedule(schedule, alphaInterval, alphaMultiplier, warmup)) {
+        cout << "Error: Unable to set the learning rate schedule." << endl;
+        printUsageTrain();
+        return 1;
+    }
+    if ((sampledNegatives > 0) && !pNetwork->SetSampledOutput(sampledNegatives)) {
+        cout << "Error: Unable to sample output layers." << endl;
+        return 1;
+    }
+
+    // Load held-out data for validation and early stopping
+    vector <NNDataSetBase*> vDataSetValidation;
+    if (!validationInputFile.empty()) {
+        vDataSetValidation = LoadNetCDF(validationInputFile);
+        vector <NNDataSetBase*> vDataSetValidationOutput = LoadNetCDF(validationOutputFile);
+        vDataSetValidation.insert(vDataSetValidation.end(), vDataSetValidationOutput.begin(), vDataSetValidationOutput.end());
+        if (!pNetwork->SetValidationDataSets(vDataSetValidation, validationInterval, validationK)) {
+            cout << "Error: Unable to use validation data." << endl;
+            return 1;
+        }
+        pNetwork->SetEarlyStopping(patience);
+    }
 	
     timeval trainingStart;
     gettimeofday(&trainingStart, NULL);
-    // Start Training
-    for(unsigned int x = 0 ; x < epoch; ++x) {
-        float error = pNetwork->Train(1, alpha, lambda, mu);
-        CWMetric::updateMetrics("Average_Error",error);
-        CWMetric::updateMetrics("Epochs",x+1);
+    // Start Training, counting epochs already completed by a resumed checkpoint towards the total
+    unsigned int remainingEpochs = epoch;
+    if (!resumeFileName.empty()) {
+        remainingEpochs = (epoch > pNetwork->GetEpochs()) ? epoch - pNetwork->GetEpochs() : 0;
     }
+    float error = pNetwork->Train(remainingEpochs, alpha, lambda, mu);
+    CWMetric::updateMetrics("Average_Error",error);
+    CWMetric::updateMetrics("Epochs",pNetwork->GetEpochs());
     timeval trainingEnd;
     gettimeofday(&trainingEnd,NULL);
     CWMetric::updateMetrics("Training_Time", elapsed_time(trainingEnd, trainingStart));
@@ -159,8 +273,13 @@ int main(int argc, char** argv)
     cout << "CPU Memory Usage: " << totalCPUMemory << " KB" << endl;
     CWMetric::updateMetrics("Training_GPU_usage", totalGPUMemory);
     // Save Neural network
-    pNetwork->SaveNetCDF(networkFileName);
+    if (isModelFile(networkFileName))
+        pNetwork->SaveModel(networkFileName);
+    else
+        pNetwork->SaveNetCDF(networkFileName);
     delete pNetwork;
+    for (auto p : vDataSetValidation)
+        delete p;
     getGpu().Shutdown();
     return 0;
 }
@@ -152,6 +152,17 @@ bool isNetCDFfile(const string &filename)
     return (ext.compare(NETCDF_FILE_EXTENTION) == 0);
 }
 
+bool isModelFile(const string &filename)
+{
+    size_t extIndex = filename.find_last_of(".");
+    if (extIndex == string::npos) {
+        return false;
+    }
+
+    string ext = filename.substr(extIndex);
+    return (ext.compare(MODEL_FILE_EXTENTION) == 0);
+}
+
 /*
 This is the splitter which is used to split a  string
 which is used majorly for splitting our data sets
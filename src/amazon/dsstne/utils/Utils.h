@@ -21,6 +21,7 @@ using std::vector;
 const string INPUT_DATASET_SUFFIX = "_input";
 const string OUTPUT_DATASET_SUFFIX = "_output";
 const string NETCDF_FILE_EXTENTION = ".nc";
+const string MODEL_FILE_EXTENTION = ".model";
 const unsigned long FIXED_SEED = 12134ull;
 
 class CWMetric
@@ -71,6 +72,11 @@ bool fileExists(const std::string &);
  */
 bool isNetCDFfile(const string &filename);
 
+/**
+ * Return true if the file is a compact model file written by NNNetwork::SaveModel.
+ */
+bool isModelFile(const string &filename);
+
 std::vector<std::string> &split(const std::string &s, char delim, std::vector<std::string> &elems);
 
 std::vector<std::string> split(const std::string &s, char delim);
@@ -32,7 +32,6 @@ int main(int argc, char** argv)
     int batch               = 1024;
     int total_epochs        = 60;
     int training_epochs     = 20;
-    int epochs              = 0;
     float alpha             = 0.025f;
     float lambda            = 0.0001f;
     float mu                = 0.5f;
@@ -81,14 +80,8 @@ int main(int argc, char** argv)
     else if (mode == Mode::Training)
     {
         pNetwork->SetTrainingMode(Nesterov);
-        while (epochs < total_epochs)
-        {
-            //float margin        = (float)phase * 0.01f;
-            //pNetwork->SetSMCE(1.0f - margin, margin, 30.0f, 1.0f); 
-            pNetwork->Train(training_epochs, alpha, lambda, mu);
-            alpha              *= 0.8f;
-            epochs             += training_epochs;
-        }
+        pNetwork->SetLearningRateSchedule(StepDecay, training_epochs, 0.8f);
+        pNetwork->Train(total_epochs, alpha, lambda, mu);
         
         // Save final Neural network
         pNetwork->SaveNetCDF("network.nc");
@@ -139,39 +132,6 @@ int main(int argc, char** argv)
         GpuBuffer<NNFloat>* pbFValue        = new GpuBuffer<NNFloat>(batch * K, true);
         NNFloat* pOutputValue               = pbOutput->_pSysData;
         bool bMultiGPU                      = (getGpu()._numprocs > 1);     
-        GpuBuffer<NNFloat>* pbMultiKey      = NULL;
-        GpuBuffer<NNFloat>* pbMultiFValue   = NULL;
-        NNFloat* pMultiKey                  = NULL;
-        NNFloat* pMultiFValue               = NULL;  
-        cudaIpcMemHandle_t keyMemHandle;
-        cudaIpcMemHandle_t valMemHandle;
-        
-        // Get P2P handles to multi-gpu data on node 0
-        if (bMultiGPU)
-        {
-            if (getGpu()._id == 0)
-            {   
-                pbMultiKey                  = new GpuBuffer<NNFloat>(getGpu()._numprocs * batch * K, true);
-                pbMultiFValue               = new GpuBuffer<NNFloat>(getGpu()._numprocs * batch * K, true);
-                pMultiKey                   = pbMultiKey->_pDevData;
-                pMultiFValue                = pbMultiFValue->_pDevData;
-                cudaError_t status          = cudaIpcGetMemHandle(&keyMemHandle, pMultiKey);
-                RTERROR(status, "cudaIpcGetMemHandle: Failed to get IPC mem handle on pMultiKey");
-                status                      = cudaIpcGetMemHandle(&valMemHandle, pMultiFValue);
-                RTERROR(status, "cudaIpcGetMemHandle: Failed to get IPC mem handle on pMultiFValue");                      
-            }
-            MPI_Bcast(&keyMemHandle, sizeof(cudaIpcMemHandle_t), MPI_BYTE, 0, MPI_COMM_WORLD);
-            MPI_Bcast(&valMemHandle, sizeof(cudaIpcMemHandle_t), MPI_BYTE, 0, MPI_COMM_WORLD);
-            
-            // Open up pointers to GPU 0 memory buffers
-            if (getGpu()._id != 0)
-            {
-                cudaError_t status          = cudaIpcOpenMemHandle((void**)&pMultiKey, keyMemHandle, cudaIpcMemLazyEnablePeerAccess);
-                RTERROR(status, "cudaIpcOpenMemHandle: Unable to open key IPCMemHandle");        
-                status                      = cudaIpcOpenMemHandle((void**)&pMultiFValue, valMemHandle, cudaIpcMemLazyEnablePeerAccess);
-                RTERROR(status, "cudaIpcOpenMemHandle: Unable to open value IPCMemHandle");    
-            }  
-        }
         
         for (unsigned long long int pos = 0; pos < pNetwork->GetExamples(); pos += pNetwork->GetBatch())
         {
@@ -190,16 +150,16 @@ int main(int argc, char** argv)
             for (int i = 0; i < batch; i++)
             {
                 int j                       = pos + i;
-                vDataPoints[i]              = pOutputDataSet->_vSparseEnd[j] - pOutputDataSet->_vSparseStart[j];
+                vDataPoints[i]              = pOutputDataSet->_vSparseOffset[j + 1] - pOutputDataSet->_vSparseOffset[j];
                 
-                for (size_t k = pOutputDataSet->_vSparseStart[j]; k < pOutputDataSet->_vSparseEnd[j]; k++)
+                for (size_t k = pOutputDataSet->_vSparseOffset[j]; k < pOutputDataSet->_vSparseOffset[j + 1]; k++)
                 {
                     pTarget[pOutputDataSet->_vSparseIndex[k]] = 1.0f;
                 }
                 
                 if (bFilterPast)
                 {
-                    for (size_t k = pInputDataSet->_vSparseStart[j]; k < pInputDataSet->_vSparseEnd[j]; k++)
+                    for (size_t k = pInputDataSet->_vSparseOffset[j]; k < pInputDataSet->_vSparseOffset[j + 1]; k++)
                     {
                         pOut[pInputDataSet->_vSparseIndex[k]] = 0.0f;
                     }
@@ -213,37 +173,25 @@ int main(int argc, char** argv)
             pbKey->Download();
             pbFValue->Download();
             
-            // Do second pass to grab top K from the top n * K outputs if running multi-GPU
+            // Merge the top K of all processes if running multi-GPU, each process ending up with the final top K
+            // of its own block of examples
+            uint32_t start                  = 0;
+            uint32_t end                    = batch;
             if (bMultiGPU)
             {
             
                 // Grab total datapoint counts
-                MPI_Reduce((getGpu()._id == 0) ? MPI_IN_PLACE : vDataPoints.data(), vDataPoints.data(), batch, MPI_UINT32_T, MPI_SUM, 0, MPI_COMM_WORLD);
-                
-                // P2P gather Top K data from all processes
-                uint32_t offset             = K * getGpu()._id;
-                uint32_t kstride            = K * getGpu()._numprocs;
-                cudaMemcpy2D(pMultiKey + offset, kstride * sizeof(NNFloat), pbKey->_pDevData, K * sizeof(NNFloat), K * sizeof(NNFloat), batch, cudaMemcpyDefault);
-                
-                cudaMemcpy2D(pMultiFValue + offset, kstride * sizeof(NNFloat), pbFValue->_pDevData, K * sizeof(NNFloat), K * sizeof(NNFloat), batch, cudaMemcpyDefault);
-                cudaDeviceSynchronize();
-                MPI_Barrier(MPI_COMM_WORLD);                
-                             
-                // Do final Top K calculation on process 0 to produce the top K out of the top numprocs * K
-                if (getGpu()._id == 0)
-                {
-                    kCalculateTopK(pbMultiKey->_pDevData, pbMultiFValue->_pDevData, pbKey->_pDevData, pbFValue->_pDevData, batch, getGpu()._numprocs * K, K);
-                }
+                MPI_Allreduce(MPI_IN_PLACE, vDataPoints.data(), batch, MPI_UINT32_T, MPI_SUM, getGpu()._comm);
+                RingMergeTopK(pbKey->_pSysData, pbFValue->_pSysData, batch, K, MPI_NNFLOAT, getGpu()._comm);
+                start                       = GetSliceStart(batch, getGpu()._id, getGpu()._numprocs);
+                end                         = GetSliceStart(batch, getGpu()._id + 1, getGpu()._numprocs);
             }
 
-            // Do P/R calculation entirely on process 0
-            if (getGpu()._id == 0)
+            // Do P/R calculation on each process's examples
             {
-                pbKey->Download();
-                pbFValue->Download();
-                NNFloat* pKey                   = pbKey->_pSysData;
-                NNFloat* pValue                 = pbFValue->_pSysData;
-                for (int i = 0; i < batch; i++)
+                NNFloat* pKey                   = pbKey->_pSysData + start * K;
+                NNFloat* pValue                 = pbFValue->_pSysData + start * K;
+                for (int i = start; i < end; i++)
                 {
                     NNFloat p                   = vDataPoints[i];
                     NNFloat tp                  = 0.0f;
@@ -281,18 +229,12 @@ int main(int argc, char** argv)
         delete pbTarget;
         delete pbOutput;
         
-        // Delete multi-GPU data and P2P handles if multi-GPU
+        // Sum P/R from all processes
         if (bMultiGPU)
         {
-            if (getGpu()._id != 0)
-            {
-                cudaError_t status              = cudaIpcCloseMemHandle(pMultiKey);
-                RTERROR(status, "cudaIpcCloseMemHandle: Error closing MultiKey IpcMemHandle");
-                status                          = cudaIpcCloseMemHandle(pMultiFValue);
-                RTERROR(status, "cudaIpcCloseMemHandle: Error closing MultiFValue IpcMemHandle");                
-            }
-            delete pbMultiKey;
-            delete pbMultiFValue;
+            MPI_Reduce((getGpu()._id == 0) ? MPI_IN_PLACE : vPrecision.data(), vPrecision.data(), K, MPI_NNFLOAT, MPI_SUM, 0, getGpu()._comm);
+            MPI_Reduce((getGpu()._id == 0) ? MPI_IN_PLACE : vRecall.data(), vRecall.data(), K, MPI_NNFLOAT, MPI_SUM, 0, getGpu()._comm);
+            MPI_Reduce((getGpu()._id == 0) ? MPI_IN_PLACE : vNDCG.data(), vNDCG.data(), K, MPI_NNFLOAT, MPI_SUM, 0, getGpu()._comm);
         }
 
         // Report results from process 0
@@ -0,0 +1,183 @@
+// CppUnit
+#include "cppunit/extensions/HelperMacros.h"
+#include "cppunit/ui/text/TestRunner.h"
+#include "cppunit/TestAssert.h"
+// STL
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "GpuTypes.h"
+#include "NNTypes.h"
+
+//
+// Checks that compiled network descriptor caches are reused for an unchanged config and data sets, missed when
+// either changes, and rebuilt when damaged
+//
+class TestDescriptorCache : public CppUnit::TestFixture {
+
+public:
+    std::string directory;
+    std::string config;
+
+    void setUp() {
+        char name[] = "/tmp/TestDescriptorCacheXXXXXX";
+        CPPUNIT_ASSERT(mkdtemp(name) != NULL);
+        directory = name;
+        config = directory + "/config.json";
+        WriteConfig(8);
+    }
+
+    void tearDown() {
+        for (auto& f : GetCacheFiles()) {
+            remove(f.c_str());
+        }
+        remove(config.c_str());
+        rmdir(directory.c_str());
+    }
+
+    // Writes a network sized by its input and output data sets around a hidden layer of hidden units
+    void WriteConfig(uint32_t hidden) {
+        FILE* fp = fopen(config.c_str(), "w");
+        CPPUNIT_ASSERT(fp != NULL);
+        fprintf(fp,
+                "{\n"
+                "    \"Version\" : 0.8,\n"
+                "    \"Name\" : \"TestDescriptorCache\",\n"
+                "    \"Kind\" : \"FeedForward\",\n"
+                "    \"Layers\" : [\n"
+                "        { \"Name\" : \"Input\", \"Kind\" : \"Input\", \"N\" : \"auto\", \"DataSet\" : \"input\", \"Sparse\" : true },\n"
+                "        { \"Name\" : \"Hidden\", \"Kind\" : \"Hidden\", \"Type\" : \"FullyConnected\", \"Source\" : \"Input\", \"N\" : %u, \"Activation\" : \"Sigmoid\" },\n"
+                "        { \"Name\" : \"Output\", \"Kind\" : \"Output\", \"Type\" : \"FullyConnected\", \"DataSet\" : \"output\", \"N\" : \"auto\", \"Activation\" : \"Sigmoid\", \"Sparse\" : true }\n"
+                "    ],\n"
+                "    \"ErrorFunction\" : \"ScaledMarginalCrossEntropy\"\n"
+                "}\n", hidden);
+        CPPUNIT_ASSERT_EQUAL(0, fclose(fp));
+    }
+
+    // Returns input and output data sets of inputs and outputs features
+    static std::vector<NNDataSetBase*> MakeDataSets(uint32_t inputs, uint32_t outputs) {
+        std::vector<uint32_t> vSparseStart = { 0, 1 };
+        std::vector<uint32_t> vSparseEnd = { 1, 2 };
+        std::vector<uint32_t> vSparseIndex = { 0, 1 };
+        std::vector<NNDataSetBase*> vDataSet = LoadSparseData("input", inputs, vSparseStart, vSparseEnd, vSparseIndex);
+        std::vector<NNDataSetBase*> vOutput = LoadSparseData("output", outputs, vSparseStart, vSparseEnd, vSparseIndex);
+        vDataSet.insert(vDataSet.end(), vOutput.begin(), vOutput.end());
+        return vDataSet;
+    }
+
+    static void DeleteDataSets(std::vector<NNDataSetBase*>& vDataSet) {
+        for (auto p : vDataSet) {
+            delete p;
+        }
+        vDataSet.clear();
+    }
+
+    std::vector<std::string> GetCacheFiles() {
+        std::vector<std::string> vFile;
+        DIR* pDir = opendir(directory.c_str());
+        if (pDir == NULL) {
+            return vFile;
+        }
+        while (struct dirent* pEntry = readdir(pDir)) {
+            std::string name = pEntry->d_name;
+            if ((name.size() > 4) && (name.compare(name.size() - 4, 4, ".nnd") == 0)) {
+                vFile.push_back(directory + "/" + name);
+            }
+        }
+        closedir(pDir);
+        return vFile;
+    }
+
+    // Loads the descriptor, checking it came from the cache or not as expected, and returns its binary encoding
+    std::vector<char> Load(const std::vector<NNDataSetBase*>& vDataSet, bool bExpectCached, NNNetworkDescriptor& nd) {
+        bool bCached = !bExpectCached;
+        CPPUNIT_ASSERT(LoadNNNetworkDescriptorCached(config, vDataSet, directory, nd, bCached));
+        CPPUNIT_ASSERT_EQUAL(bExpectCached, bCached);
+        NNBinaryWriter w;
+        SaveNNNetworkDescriptorBinary(w, nd);
+        return w.GetBuffer();
+    }
+
+    void testCacheHit() {
+        std::vector<NNDataSetBase*> vDataSet = MakeDataSets(20, 10);
+        NNNetworkDescriptor nd, nd1;
+        std::vector<char> vBuilt = Load(vDataSet, false, nd);
+        CPPUNIT_ASSERT_EQUAL((size_t)1, GetCacheFiles().size());
+        CPPUNIT_ASSERT_EQUAL((size_t)3, nd._vLayerDescriptor.size());
+        CPPUNIT_ASSERT_EQUAL((uint32_t)20, nd._vLayerDescriptor[0]._Nx);
+        CPPUNIT_ASSERT_EQUAL((uint32_t)8, nd._vLayerDescriptor[1]._Nx);
+        CPPUNIT_ASSERT_EQUAL((uint32_t)10, nd._vLayerDescriptor[2]._Nx);
+
+        // The cached descriptor is the one built from the config, and the descriptor the config builds is unchanged
+        CPPUNIT_ASSERT(Load(vDataSet, true, nd1) == vBuilt);
+        NNNetworkDescriptor nd2;
+        CPPUNIT_ASSERT(LoadNNNetworkDescriptorJSON(config, vDataSet, nd2));
+        NNBinaryWriter w;
+        SaveNNNetworkDescriptorBinary(w, nd2);
+        CPPUNIT_ASSERT(w.GetBuffer() == vBuilt);
+        CPPUNIT_ASSERT_EQUAL((size_t)1, GetCacheFiles().size());
+        DeleteDataSets(vDataSet);
+    }
+
+    void testCacheInvalidated() {
+        std::vector<NNDataSetBase*> vDataSet = MakeDataSets(20, 10);
+        NNNetworkDescriptor nd;
+        Load(vDataSet, false, nd);
+
+        // A changed config misses the cache
+        WriteConfig(9);
+        Load(vDataSet, false, nd);
+        CPPUNIT_ASSERT_EQUAL((uint32_t)9, nd._vLayerDescriptor[1]._Nx);
+        CPPUNIT_ASSERT_EQUAL((size_t)2, GetCacheFiles().size());
+
+        // So do data sets with other dimensions
+        std::vector<NNDataSetBase*> vWider = MakeDataSets(30, 10);
+        Load(vWider, false, nd);
+        CPPUNIT_ASSERT_EQUAL((uint32_t)30, nd._vLayerDescriptor[0]._Nx);
+        DeleteDataSets(vWider);
+        vWider = MakeDataSets(20, 11);
+        Load(vWider, false, nd);
+        CPPUNIT_ASSERT_EQUAL((uint32_t)11, nd._vLayerDescriptor[2]._Nx);
+        DeleteDataSets(vWider);
+        CPPUNIT_ASSERT_EQUAL((size_t)4, GetCacheFiles().size());
+
+        // Going back to the original config hits its cache again
+        WriteConfig(8);
+        Load(vDataSet, true, nd);
+        CPPUNIT_ASSERT_EQUAL((uint32_t)8, nd._vLayerDescriptor[1]._Nx);
+        DeleteDataSets(vDataSet);
+    }
+
+    void testTruncatedCache() {
+        std::vector<NNDataSetBase*> vDataSet = MakeDataSets(20, 10);
+        NNNetworkDescriptor nd;
+        std::vector<char> vBuilt = Load(vDataSet, false, nd);
+        std::vector<std::string> vFile = GetCacheFiles();
+        CPPUNIT_ASSERT_EQUAL((size_t)1, vFile.size());
+        FILE* fp = fopen(vFile[0].c_str(), "rb");
+        CPPUNIT_ASSERT(fp != NULL);
+        fseek(fp, 0, SEEK_END);
+        long size = ftell(fp);
+        fclose(fp);
+
+        // Truncated within the header, at its end and within the descriptor, the cache is rebuilt from the config
+        // and the rebuilt cache is used next time
+        std::vector<long> vSize = { 0, 16, 32, size / 2, size - 1 };
+        for (auto s : vSize) {
+            CPPUNIT_ASSERT_EQUAL(0, truncate(vFile[0].c_str(), s));
+            CPPUNIT_ASSERT(Load(vDataSet, false, nd) == vBuilt);
+            CPPUNIT_ASSERT(Load(vDataSet, true, nd) == vBuilt);
+        }
+        DeleteDataSets(vDataSet);
+    }
+
+    CPPUNIT_TEST_SUITE(TestDescriptorCache);
+    CPPUNIT_TEST(testCacheHit);
+    CPPUNIT_TEST(testCacheInvalidated);
+    CPPUNIT_TEST(testTruncatedCache);
+    CPPUNIT_TEST_SUITE_END();
+};
@@ -5,6 +5,10 @@
 #include <string>
 
 #include "TestSort.cpp"
+#include "TestFusedEpilogue.cpp"
+#include "TestSampledOutput.cpp"
+#include "TestModelFile.cpp"
+#include "TestDescriptorCache.cpp"
 
 /**
  * In order to write a new test case, create a Test<File>.cpp and write the test
@@ -21,6 +25,10 @@ int main() {
     getGpu().CopyConstants();
     CppUnit::TextUi::TestRunner runner;
     runner.addTest(TestSort::suite());
+    runner.addTest(TestFusedEpilogue::suite());
+    runner.addTest(TestSampledOutput::suite());
+    runner.addTest(TestModelFile::suite());
+    runner.addTest(TestDescriptorCache::suite());
     const bool result = runner.run();
     getGpu().Shutdown();
     return result ? EXIT_SUCCESS : EXIT_FAILURE;
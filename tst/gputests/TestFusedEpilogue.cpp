@@ -0,0 +1,201 @@
+// CppUnit
+#include "cppunit/extensions/HelperMacros.h"
+#include "cppunit/ui/text/TestRunner.h"
+#include "cppunit/TestAssert.h"
+// STL
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "GpuTypes.h"
+#include "NNTypes.h"
+#include "kernels.h"
+
+// Host reference of the forward propagation epilogue of a fully connected layer, computed the unfused way one step
+// at a time.  sources points to system memory here, and SoftMax, which kCalculateFusedEpilogue leaves to its own
+// kernel, is handled as well.  Dropout is applied if p is non-zero, dropping every unit whose value in pRandom is below p
+static void CalculateFusedEpilogueReference(Activation activation, NNFloat* pUnit, uint32_t stride, uint32_t batch, const EpilogueSources& sources, const NNFloat* pRandom, NNFloat p) {
+    uint64_t size = (uint64_t)stride * (uint64_t)batch;
+
+    // Biases, then skip layers
+    for (uint32_t i = 0; i < sources._biases; i++)
+        for (uint64_t pos = 0; pos < size; pos++)
+            pUnit[pos] += sources._pBias[i][pos % stride];
+    for (uint32_t i = 0; i < sources._skips; i++)
+        for (uint64_t pos = 0; pos < size; pos++)
+            pUnit[pos] += sources._pSkip[i][pos];
+
+    // Activation
+    switch (activation) {
+        case Sigmoid:
+            for (uint64_t pos = 0; pos < size; pos++)
+                pUnit[pos] = (NNFloat)1.0 / ((NNFloat)1.0 + exp(-pUnit[pos]));
+            break;
+
+        case Tanh:
+            for (uint64_t pos = 0; pos < size; pos++)
+                pUnit[pos] = tanh(pUnit[pos]);
+            break;
+
+        case RectifiedLinear:
+            for (uint64_t pos = 0; pos < size; pos++)
+                pUnit[pos] = std::max((NNFloat)0.0, pUnit[pos]);
+            break;
+
+        case SoftMax:
+            for (uint32_t i = 0; i < batch; i++) {
+                NNFloat* pRow = pUnit + (uint64_t)i * stride;
+                NNFloat maxValue = *std::max_element(pRow, pRow + stride);
+                NNFloat sum = (NNFloat)0.0;
+                for (uint32_t j = 0; j < stride; j++) {
+                    pRow[j] = exp(pRow[j] - maxValue);
+                    sum += pRow[j];
+                }
+                for (uint32_t j = 0; j < stride; j++)
+                    pRow[j] /= sum;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    // Dropout
+    if (p > (NNFloat)0.0) {
+        NNFloat scale = (NNFloat)1.0 / ((NNFloat)1.0 - p);
+        for (uint64_t pos = 0; pos < size; pos++)
+            pUnit[pos] = (pRandom[pos] < p) ? (NNFloat)0.0 : scale * pUnit[pos];
+    }
+}
+
+class TestFusedEpilogue : public CppUnit::TestFixture {
+
+public:
+    static const uint32_t batch = 7;
+    static const uint32_t stride = 300;
+
+    void setUp() {
+        size_t size = batch * stride;
+        pbUnit = new GpuBuffer<NNFloat>(size, true);
+        pbBias1 = new GpuBuffer<NNFloat>(stride, true);
+        pbBias2 = new GpuBuffer<NNFloat>(stride, true);
+        pbSkip = new GpuBuffer<NNFloat>(size, true);
+        pbRandom = new GpuBuffer<NNFloat>(size, true);
+        for (size_t i = 0; i < size; i++) {
+            pbUnit->_pSysData[i] = (NNFloat)(rand() % 2001 - 1000) / 250.0f;
+            pbSkip->_pSysData[i] = (NNFloat)(rand() % 2001 - 1000) / 1000.0f;
+        }
+        for (size_t i = 0; i < stride; i++) {
+            pbBias1->_pSysData[i] = (NNFloat)(rand() % 2001 - 1000) / 1000.0f;
+            pbBias2->_pSysData[i] = (NNFloat)(rand() % 2001 - 1000) / 1000.0f;
+        }
+        pbUnit->Upload();
+        pbBias1->Upload();
+        pbBias2->Upload();
+        pbSkip->Upload();
+        vInput.assign(pbUnit->_pSysData, pbUnit->_pSysData + size);
+    }
+
+    void tearDown() {
+        delete pbUnit;
+        delete pbBias1;
+        delete pbBias2;
+        delete pbSkip;
+        delete pbRandom;
+    }
+
+    // Unfused kernels, the way NNLayer ran them before the epilogue was fused
+    std::vector<NNFloat> RunUnfused(Activation activation, NNFloat p) {
+        pbUnit->Upload(vInput.data());
+        kAddDualBias(pbUnit->_pDevData, pbBias1->_pDevData, pbBias2->_pDevData, stride, batch);
+        kAddBuffers(pbUnit->_pDevData, pbSkip->_pDevData, batch * stride);
+        switch (activation) {
+            case Sigmoid:
+                kCalculateSigmoidActivation(pbUnit->_pDevData, batch * stride);
+                break;
+            case Tanh:
+                kCalculateTanhActivation(pbUnit->_pDevData, batch * stride);
+                break;
+            case RectifiedLinear:
+                kCalculateReluActivation(pbUnit->_pDevData, batch * stride);
+                break;
+            default:
+                break;
+        }
+        if (p > (NNFloat)0.0)
+            kCalculateDropout(pbUnit->_pDevData, pbRandom->_pDevData, batch, stride, p);
+        std::vector<NNFloat> vOutput(batch * stride);
+        pbUnit->Download(vOutput.data());
+        return vOutput;
+    }
+
+    std::vector<NNFloat> RunFused(Activation activation, NNFloat p) {
+        EpilogueSources sources;
+        sources._biases = 2;
+        sources._pBias[0] = pbBias1->_pDevData;
+        sources._pBias[1] = pbBias2->_pDevData;
+        sources._skips = 1;
+        sources._pSkip[0] = pbSkip->_pDevData;
+        pbUnit->Upload(vInput.data());
+        kCalculateFusedEpilogue(activation, pbUnit->_pDevData, stride, batch, sources, pbRandom->_pDevData, p);
+        std::vector<NNFloat> vOutput(batch * stride);
+        pbUnit->Download(vOutput.data());
+        return vOutput;
+    }
+
+    // CPU reference with the random values the last GPU dropout drew
+    std::vector<NNFloat> RunReference(Activation activation, NNFloat p) {
+        EpilogueSources sources;
+        sources._biases = 2;
+        sources._pBias[0] = pbBias1->_pSysData;
+        sources._pBias[1] = pbBias2->_pSysData;
+        sources._skips = 1;
+        sources._pSkip[0] = pbSkip->_pSysData;
+        pbRandom->Download();
+        std::vector<NNFloat> vOutput(vInput);
+        CalculateFusedEpilogueReference(activation, vOutput.data(), stride, batch, sources, pbRandom->_pSysData, p);
+        return vOutput;
+    }
+
+    void Compare(const std::vector<NNFloat>& vExpected, const std::vector<NNFloat>& vActual) {
+        for (size_t i = 0; i < vExpected.size(); i++) {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE("Unit is different", vExpected[i], vActual[i], 1.0e-5);
+        }
+    }
+
+    void TestActivations() {
+        Activation vActivation[] = {Sigmoid, Tanh, RectifiedLinear, Linear};
+        for (Activation activation : vActivation) {
+            std::vector<NNFloat> vUnfused = RunUnfused(activation, (NNFloat)0.0);
+            std::vector<NNFloat> vFused = RunFused(activation, (NNFloat)0.0);
+            Compare(vUnfused, vFused);
+            Compare(RunReference(activation, (NNFloat)0.0), vFused);
+        }
+    }
+
+    void TestDropout() {
+        const NNFloat p = (NNFloat)0.3;
+
+        // Reseeding makes both draw the same random values
+        getGpu().SetRandomSeed(12345);
+        std::vector<NNFloat> vUnfused = RunUnfused(RectifiedLinear, p);
+        getGpu().SetRandomSeed(12345);
+        std::vector<NNFloat> vFused = RunFused(RectifiedLinear, p);
+        Compare(vUnfused, vFused);
+        Compare(RunReference(RectifiedLinear, p), vFused);
+    }
+
+    CPPUNIT_TEST_SUITE(TestFusedEpilogue);
+    CPPUNIT_TEST(TestActivations);
+    CPPUNIT_TEST(TestDropout);
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+    GpuBuffer<NNFloat>* pbUnit;
+    GpuBuffer<NNFloat>* pbBias1;
+    GpuBuffer<NNFloat>* pbBias2;
+    GpuBuffer<NNFloat>* pbSkip;
+    GpuBuffer<NNFloat>* pbRandom;
+    std::vector<NNFloat> vInput;
+};
@@ -0,0 +1,365 @@
+// CppUnit
+#include "cppunit/extensions/HelperMacros.h"
+#include "cppunit/ui/text/TestRunner.h"
+#include "cppunit/TestAssert.h"
+// STL
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "GpuTypes.h"
+#include "NNTypes.h"
+
+//
+// Round trips network descriptors through the binary archive and compact model files, and checks that truncated
+// or corrupt input is rejected rather than misread
+//
+class TestModelFile : public CppUnit::TestFixture {
+
+public:
+    // Layout of the model file header
+    static const size_t MagicOffset = 0;
+    static const size_t VersionOffset = 8;
+    static const size_t MetadataSizeOffset = 16;
+    static const size_t HeaderSize = 64;
+
+    std::string fname;
+
+    void setUp() {
+        char name[] = "/tmp/TestModelFileXXXXXX";
+        int fd = mkstemp(name);
+        CPPUNIT_ASSERT(fd >= 0);
+        close(fd);
+        fname = name;
+    }
+
+    void tearDown() {
+        remove(fname.c_str());
+    }
+
+    // Builds a descriptor whose fields all differ from their defaults, with a hidden layer of weights, biases of
+    // an output layer and a weight sharing another's values
+    static NNNetworkDescriptor MakeDescriptor() {
+        NNNetworkDescriptor d;
+        d._name = "TestModelFile";
+        d._kind = NNNetwork::AutoEncoder;
+        d._errorFunction = ScaledMarginalCrossEntropy;
+        d._bShuffleIndices = false;
+        d._maxout_k = 3;
+        d._LRN_k = 1.5f;
+        d._LRN_n = 7;
+        d._LRN_alpha = 0.002f;
+        d._LRN_beta = 0.5f;
+        d._bSparsenessPenalty = true;
+        d._sparsenessPenalty_p = 0.25f;
+        d._sparsenessPenalty_beta = 0.125f;
+        d._bDenoising = true;
+        d._denoising_p = 0.3f;
+        d._deltaBoost_one = 2.0f;
+        d._deltaBoost_zero = 0.5f;
+        d._SMCE_oneTarget = 0.8f;
+        d._SMCE_zeroTarget = 0.2f;
+        d._SMCE_oneScale = 3.0f;
+        d._SMCE_zeroScale = 0.75f;
+        d._checkpoint_name = "checkpoint";
+        d._checkpoint_interval = 4;
+        d._checkpoint_epochs = 2;
+        d._trainingMode = Nesterov;
+        d._epochs = 17;
+        d._movingAverageError = 0.0625f;
+        d._brakeSteps = 5;
+        d._initSteps = 6;
+        d._bestValidationError = 0.375f;
+        d._validationStalls = 2;
+        d._validationEpochs = 1;
+        d._randomSeed = 0x123456789abcdefULL;
+        d._bConvLayersCalculated = true;
+
+        const char* vName[] = { "input", "hidden", "output" };
+        const NNLayer::Kind vKind[] = { NNLayer::Kind::Input, NNLayer::Kind::Hidden, NNLayer::Kind::Output };
+        for (uint32_t i = 0; i < 3; i++) {
+            NNLayerDescriptor ld;
+            ld._name = vName[i];
+            ld._kind = vKind[i];
+            ld._type = NNLayer::Type::FullyConnected;
+            ld._poolingFunction = PoolingFunction::Max;
+            ld._dataSet = (i == 1) ? "" : std::string(vName[i]) + "Data";
+            if (i > 0) {
+                ld._vSource.push_back(vName[i - 1]);
+            }
+            if (i == 2) {
+                ld._vSkip.push_back("input");
+            }
+            ld._Nx = 10 + i;
+            ld._Ny = 2;
+            ld._Nz = 3;
+            ld._Nw = 4 + i;
+            ld._dimensions = 1 + i;
+            ld._bDimensionsProvided = (i != 1);
+            ld._weightInit = Gaussian;
+            ld._weightInitScale = 0.5f + i;
+            ld._biasInit = 0.25f * i;
+            ld._kernelX = 3;
+            ld._kernelY = 4;
+            ld._kernelZ = 5;
+            ld._kernelStrideX = 6;
+            ld._kernelStrideY = 7;
+            ld._kernelStrideZ = 8;
+            ld._kernelPaddingX = 9;
+            ld._kernelPaddingY = 10;
+            ld._kernelPaddingZ = 11;
+            ld._kernelDimensions = 2;
+            ld._weightNorm = 1.5f;
+            ld._deltaNorm = 2.5f;
+            ld._pDropout = 0.1f * i;
+            ld._activation = (i == 2) ? Sigmoid : RectifiedLinear;
+            ld._sparsenessPenalty_p = 0.05f;
+            ld._sparsenessPenalty_beta = 0.75f;
+            ld._attributes = (i == 0) ? NNLayer::Attributes::Sparse : NNLayer::Attributes::None;
+            d._vLayerDescriptor.push_back(ld);
+        }
+
+        for (uint32_t i = 0; i < 3; i++) {
+            NNWeightDescriptor wd;
+            wd._inputLayer = (i == 0) ? "input" : "hidden";
+            wd._outputLayer = (i == 0) ? "hidden" : "output";
+            wd._width = 11 + i;
+            wd._height = 10;
+            wd._length = 1;
+            wd._depth = 2;
+            wd._breadth = 3;
+            wd._bShared = (i == 2);
+            wd._bTransposed = (i == 2);
+            wd._bLocked = (i == 1);
+            wd._norm = 0.5f * i;
+            if (wd._bShared) {
+                wd._sourceInputLayer = "input";
+                wd._sourceOutputLayer = "hidden";
+            } else {
+                // Sizes that are not multiples of the blob alignment, so blobs are padded
+                wd._vWeight.resize(wd._width * wd._height + 3 * i);
+                for (size_t j = 0; j < wd._vWeight.size(); j++) {
+                    wd._vWeight[j] = (NNFloat)((j * 37 + i * 11) % 101) / 16.0f - 3.0f;
+                }
+            }
+            wd._vBias.resize(wd._width);
+            for (size_t j = 0; j < wd._vBias.size(); j++) {
+                wd._vBias[j] = (NNFloat)j * 0.5f - (NNFloat)i;
+            }
+            d._vWeightDescriptor.push_back(wd);
+        }
+        return d;
+    }
+
+    static void CompareLayerDescriptors(const NNLayerDescriptor& a, const NNLayerDescriptor& b) {
+        CPPUNIT_ASSERT_EQUAL(a._name, b._name);
+        CPPUNIT_ASSERT(a._kind == b._kind);
+        CPPUNIT_ASSERT(a._type == b._type);
+        CPPUNIT_ASSERT(a._poolingFunction == b._poolingFunction);
+        CPPUNIT_ASSERT_EQUAL(a._dataSet, b._dataSet);
+        CPPUNIT_ASSERT(a._vSource == b._vSource);
+        CPPUNIT_ASSERT(a._vSkip == b._vSkip);
+        CPPUNIT_ASSERT_EQUAL(a._Nx, b._Nx);
+        CPPUNIT_ASSERT_EQUAL(a._Ny, b._Ny);
+        CPPUNIT_ASSERT_EQUAL(a._Nz, b._Nz);
+        CPPUNIT_ASSERT_EQUAL(a._Nw, b._Nw);
+        CPPUNIT_ASSERT_EQUAL(a._dimensions, b._dimensions);
+        CPPUNIT_ASSERT_EQUAL(a._bDimensionsProvided, b._bDimensionsProvided);
+        CPPUNIT_ASSERT(a._weightInit == b._weightInit);
+        CPPUNIT_ASSERT_EQUAL(a._weightInitScale, b._weightInitScale);
+        CPPUNIT_ASSERT_EQUAL(a._biasInit, b._biasInit);
+        CPPUNIT_ASSERT_EQUAL(a._kernelX, b._kernelX);
+        CPPUNIT_ASSERT_EQUAL(a._kernelY, b._kernelY);
+        CPPUNIT_ASSERT_EQUAL(a._kernelZ, b._kernelZ);
+        CPPUNIT_ASSERT_EQUAL(a._kernelStrideX, b._kernelStrideX);
+        CPPUNIT_ASSERT_EQUAL(a._kernelStrideY, b._kernelStrideY);
+        CPPUNIT_ASSERT_EQUAL(a._kernelStrideZ, b._kernelStrideZ);
+        CPPUNIT_ASSERT_EQUAL(a._kernelPaddingX, b._kernelPaddingX);
+        CPPUNIT_ASSERT_EQUAL(a._kernelPaddingY, b._kernelPaddingY);
+        CPPUNIT_ASSERT_EQUAL(a._kernelPaddingZ, b._kernelPaddingZ);
+        CPPUNIT_ASSERT_EQUAL(a._kernelDimensions, b._kernelDimensions);
+        CPPUNIT_ASSERT_EQUAL(a._weightNorm, b._weightNorm);
+        CPPUNIT_ASSERT_EQUAL(a._deltaNorm, b._deltaNorm);
+        CPPUNIT_ASSERT_EQUAL(a._pDropout, b._pDropout);
+        CPPUNIT_ASSERT(a._activation == b._activation);
+        CPPUNIT_ASSERT_EQUAL(a._sparsenessPenalty_p, b._sparsenessPenalty_p);
+        CPPUNIT_ASSERT_EQUAL(a._sparsenessPenalty_beta, b._sparsenessPenalty_beta);
+        CPPUNIT_ASSERT_EQUAL(a._attributes, b._attributes);
+    }
+
+    // Weight and bias values are stored as model file blobs rather than in the descriptor, so aren't compared here
+    static void CompareWeightDescriptors(const NNWeightDescriptor& a, const NNWeightDescriptor& b) {
+        CPPUNIT_ASSERT_EQUAL(a._inputLayer, b._inputLayer);
+        CPPUNIT_ASSERT_EQUAL(a._outputLayer, b._outputLayer);
+        CPPUNIT_ASSERT_EQUAL(a._width, b._width);
+        CPPUNIT_ASSERT_EQUAL(a._height, b._height);
+        CPPUNIT_ASSERT_EQUAL(a._length, b._length);
+        CPPUNIT_ASSERT_EQUAL(a._depth, b._depth);
+        CPPUNIT_ASSERT_EQUAL(a._breadth, b._breadth);
+        CPPUNIT_ASSERT_EQUAL(a._bShared, b._bShared);
+        CPPUNIT_ASSERT_EQUAL(a._bTransposed, b._bTransposed);
+        CPPUNIT_ASSERT_EQUAL(a._bLocked, b._bLocked);
+        CPPUNIT_ASSERT_EQUAL(a._norm, b._norm);
+        CPPUNIT_ASSERT_EQUAL(a._sourceInputLayer, b._sourceInputLayer);
+        CPPUNIT_ASSERT_EQUAL(a._sourceOutputLayer, b._sourceOutputLayer);
+    }
+
+    static void CompareDescriptors(const NNNetworkDescriptor& a, const NNNetworkDescriptor& b) {
+        CPPUNIT_ASSERT_EQUAL(a._name, b._name);
+        CPPUNIT_ASSERT(a._kind == b._kind);
+        CPPUNIT_ASSERT(a._errorFunction == b._errorFunction);
+        CPPUNIT_ASSERT_EQUAL(a._bShuffleIndices, b._bShuffleIndices);
+        CPPUNIT_ASSERT_EQUAL(a._maxout_k, b._maxout_k);
+        CPPUNIT_ASSERT_EQUAL(a._LRN_k, b._LRN_k);
+        CPPUNIT_ASSERT_EQUAL(a._LRN_n, b._LRN_n);
+        CPPUNIT_ASSERT_EQUAL(a._LRN_alpha, b._LRN_alpha);
+        CPPUNIT_ASSERT_EQUAL(a._LRN_beta, b._LRN_beta);
+        CPPUNIT_ASSERT_EQUAL(a._bSparsenessPenalty, b._bSparsenessPenalty);
+        CPPUNIT_ASSERT_EQUAL(a._sparsenessPenalty_p, b._sparsenessPenalty_p);
+        CPPUNIT_ASSERT_EQUAL(a._sparsenessPenalty_beta, b._sparsenessPenalty_beta);
+        CPPUNIT_ASSERT_EQUAL(a._bDenoising, b._bDenoising);
+        CPPUNIT_ASSERT_EQUAL(a._denoising_p, b._denoising_p);
+        CPPUNIT_ASSERT_EQUAL(a._deltaBoost_one, b._deltaBoost_one);
+        CPPUNIT_ASSERT_EQUAL(a._deltaBoost_zero, b._deltaBoost_zero);
+        CPPUNIT_ASSERT_EQUAL(a._SMCE_oneTarget, b._SMCE_oneTarget);
+        CPPUNIT_ASSERT_EQUAL(a._SMCE_zeroTarget, b._SMCE_zeroTarget);
+        CPPUNIT_ASSERT_EQUAL(a._SMCE_oneScale, b._SMCE_oneScale);
+        CPPUNIT_ASSERT_EQUAL(a._SMCE_zeroScale, b._SMCE_zeroScale);
+        CPPUNIT_ASSERT_EQUAL(a._checkpoint_name, b._checkpoint_name);
+        CPPUNIT_ASSERT_EQUAL(a._checkpoint_interval, b._checkpoint_interval);
+        CPPUNIT_ASSERT_EQUAL(a._checkpoint_epochs, b._checkpoint_epochs);
+        CPPUNIT_ASSERT(a._trainingMode == b._trainingMode);
+        CPPUNIT_ASSERT_EQUAL(a._epochs, b._epochs);
+        CPPUNIT_ASSERT_EQUAL(a._movingAverageError, b._movingAverageError);
+        CPPUNIT_ASSERT_EQUAL(a._brakeSteps, b._brakeSteps);
+        CPPUNIT_ASSERT_EQUAL(a._initSteps, b._initSteps);
+        CPPUNIT_ASSERT_EQUAL(a._bestValidationError, b._bestValidationError);
+        CPPUNIT_ASSERT_EQUAL(a._validationStalls, b._validationStalls);
+        CPPUNIT_ASSERT_EQUAL(a._validationEpochs, b._validationEpochs);
+        CPPUNIT_ASSERT_EQUAL(a._randomSeed, b._randomSeed);
+        CPPUNIT_ASSERT_EQUAL(a._bConvLayersCalculated, b._bConvLayersCalculated);
+        CPPUNIT_ASSERT_EQUAL(a._vLayerDescriptor.size(), b._vLayerDescriptor.size());
+        for (size_t i = 0; i < a._vLayerDescriptor.size(); i++) {
+            CompareLayerDescriptors(a._vLayerDescriptor[i], b._vLayerDescriptor[i]);
+        }
+        CPPUNIT_ASSERT_EQUAL(a._vWeightDescriptor.size(), b._vWeightDescriptor.size());
+        for (size_t i = 0; i < a._vWeightDescriptor.size(); i++) {
+            CompareWeightDescriptors(a._vWeightDescriptor[i], b._vWeightDescriptor[i]);
+        }
+    }
+
+    // Reads fname into 8 byte aligned memory, as the model file loader maps it, returning its size in bytes
+    uint64_t ReadFile(std::vector<uint64_t>& vFile) {
+        FILE* fp = fopen(fname.c_str(), "rb");
+        CPPUNIT_ASSERT(fp != NULL);
+        fseek(fp, 0, SEEK_END);
+        uint64_t size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        vFile.assign((size + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+        CPPUNIT_ASSERT_EQUAL((size_t)size, fread(vFile.data(), 1, size, fp));
+        fclose(fp);
+        return size;
+    }
+
+    void testDescriptorRoundTrip() {
+        NNNetworkDescriptor d = MakeDescriptor();
+        NNBinaryWriter w;
+        SaveNNNetworkDescriptorBinary(w, d);
+
+        NNNetworkDescriptor d1;
+        NNBinaryReader r(w.GetBuffer().data(), w.GetBuffer().size());
+        CPPUNIT_ASSERT(LoadNNNetworkDescriptorBinary(r, d1));
+        CPPUNIT_ASSERT(r.IsValid());
+        CPPUNIT_ASSERT_EQUAL((size_t)0, (size_t)r.GetRemaining());
+        CompareDescriptors(d, d1);
+    }
+
+    void testTruncatedDescriptor() {
+        NNNetworkDescriptor d = MakeDescriptor();
+        NNBinaryWriter w;
+        SaveNNNetworkDescriptorBinary(w, d);
+
+        // Every proper prefix runs out of data somewhere and must fail, not return a partial descriptor
+        for (size_t size = 0; size < w.GetBuffer().size(); size++) {
+            NNNetworkDescriptor d1;
+            NNBinaryReader r(w.GetBuffer().data(), size);
+            CPPUNIT_ASSERT(!LoadNNNetworkDescriptorBinary(r, d1));
+        }
+    }
+
+    void testModelFileRoundTrip() {
+        NNNetworkDescriptor d = MakeDescriptor();
+        CPPUNIT_ASSERT(WriteModelFile(fname, d));
+        std::vector<uint64_t> vFile;
+        uint64_t size = ReadFile(vFile);
+        const char* pFile = (const char*)vFile.data();
+
+        NNNetworkDescriptor d1;
+        std::vector<NNModelBlob> vBlob;
+        CPPUNIT_ASSERT(ReadModelFile(fname, pFile, size, d1, vBlob));
+        CompareDescriptors(d, d1);
+
+        // Every blob holds the values of its weight, shared weights holding only biases
+        CPPUNIT_ASSERT_EQUAL(d._vWeightDescriptor.size(), vBlob.size());
+        for (size_t i = 0; i < vBlob.size(); i++) {
+            const NNWeightDescriptor& wd = d._vWeightDescriptor[i];
+            CPPUNIT_ASSERT_EQUAL((uint64_t)wd._vWeight.size(), vBlob[i]._weights);
+            CPPUNIT_ASSERT_EQUAL((uint64_t)wd._vBias.size(), vBlob[i]._biases);
+            if (wd._bShared) {
+                CPPUNIT_ASSERT_EQUAL((uint64_t)0, vBlob[i]._weightOffset);
+            }
+            const NNFloat* pWeight = (const NNFloat*)(pFile + vBlob[i]._weightOffset);
+            const NNFloat* pBias = (const NNFloat*)(pFile + vBlob[i]._biasOffset);
+            for (size_t j = 0; j < wd._vWeight.size(); j++) {
+                CPPUNIT_ASSERT_EQUAL(wd._vWeight[j], pWeight[j]);
+            }
+            for (size_t j = 0; j < wd._vBias.size(); j++) {
+                CPPUNIT_ASSERT_EQUAL(wd._vBias[j], pBias[j]);
+            }
+        }
+    }
+
+    void testModelFileRejected() {
+        NNNetworkDescriptor d = MakeDescriptor();
+        CPPUNIT_ASSERT(WriteModelFile(fname, d));
+        std::vector<uint64_t> vFile;
+        uint64_t size = ReadFile(vFile);
+        NNNetworkDescriptor d1;
+        std::vector<NNModelBlob> vBlob;
+
+        // Bad magic
+        std::vector<uint64_t> vBad = vFile;
+        ((char*)vBad.data())[MagicOffset + 3] ^= 0x20;
+        CPPUNIT_ASSERT(!ReadModelFile(fname, (const char*)vBad.data(), size, d1, vBlob));
+
+        // Other versions
+        vBad = vFile;
+        uint32_t* pVersion = (uint32_t*)((char*)vBad.data() + VersionOffset);
+        (*pVersion)++;
+        CPPUNIT_ASSERT(!ReadModelFile(fname, (const char*)vBad.data(), size, d1, vBlob));
+        *pVersion -= 2;
+        CPPUNIT_ASSERT(!ReadModelFile(fname, (const char*)vBad.data(), size, d1, vBlob));
+
+        // Truncated within the header, the descriptor and the blobs
+        std::vector<uint64_t> vSize = { 0, 1, sizeof(NNModelBlob), 100, 200, size / 2, size - sizeof(NNFloat), size - 1 };
+        for (auto s : vSize) {
+            CPPUNIT_ASSERT(!ReadModelFile(fname, (const char*)vFile.data(), s, d1, vBlob));
+        }
+
+        // A blob table entry reaching past the end of the file, the last entry being last in the metadata
+        vBad = vFile;
+        uint64_t metadataSize = *(uint64_t*)((char*)vBad.data() + MetadataSizeOffset);
+        NNModelBlob* pBlob = (NNModelBlob*)((char*)vBad.data() + HeaderSize + metadataSize) - 1;
+        pBlob->_biases = size;
+        CPPUNIT_ASSERT(!ReadModelFile(fname, (const char*)vBad.data(), size, d1, vBlob));
+    }
+
+    CPPUNIT_TEST_SUITE(TestModelFile);
+    CPPUNIT_TEST(testDescriptorRoundTrip);
+    CPPUNIT_TEST(testTruncatedDescriptor);
+    CPPUNIT_TEST(testModelFileRoundTrip);
+    CPPUNIT_TEST(testModelFileRejected);
+    CPPUNIT_TEST_SUITE_END();
+};
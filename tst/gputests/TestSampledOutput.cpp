@@ -0,0 +1,235 @@
+// CppUnit
+#include "cppunit/extensions/HelperMacros.h"
+#include "cppunit/ui/text/TestRunner.h"
+#include "cppunit/TestAssert.h"
+// STL
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "GpuTypes.h"
+#include "NNTypes.h"
+#include "kernels.h"
+
+class TestSampledOutput : public CppUnit::TestFixture {
+
+public:
+    static const uint32_t rows = 5;
+    static const uint32_t stride = 300;
+    static const uint32_t columns = 20;
+    static const uint32_t batch = 4;
+    static const uint32_t targets = 6;
+
+    // Positions of each row's positives among the sampled outputs: row 0 has two positives, row 1 one, row 2 none
+    // and row 3 three
+    static const uint32_t vTargetStart[batch + 1];
+    static const uint32_t vTarget[targets];
+
+    void setUp() {
+        pbMatrix = new GpuBuffer<NNFloat>(rows * stride, true);
+        pbPacked = new GpuBuffer<NNFloat>(rows * columns, true);
+        pbColumn = new GpuBuffer<uint32_t>(columns, true);
+        for (size_t i = 0; i < rows * stride; i++) {
+            pbMatrix->_pSysData[i] = (NNFloat)(rand() % 2001 - 1000) / 1000.0f;
+        }
+        for (uint32_t j = 0; j < columns; j++) {
+            pbColumn->_pSysData[j] = (j * 37 + 11) % stride;
+        }
+        pbMatrix->Upload();
+        pbColumn->Upload();
+
+        pbUnit = new GpuBuffer<NNFloat>(batch * columns, true);
+        pbDelta = new GpuBuffer<NNFloat>(batch * columns, true);
+        pbTargetStart = new GpuBuffer<uint32_t>(batch + 1, true);
+        pbTarget = new GpuBuffer<uint32_t>(targets, true);
+        for (uint32_t i = 0; i <= batch; i++) {
+            pbTargetStart->_pSysData[i] = vTargetStart[i];
+        }
+        for (uint32_t i = 0; i < targets; i++) {
+            pbTarget->_pSysData[i] = vTarget[i];
+        }
+        pbTargetStart->Upload();
+        pbTarget->Upload();
+    }
+
+    void tearDown() {
+        delete pbMatrix;
+        delete pbPacked;
+        delete pbColumn;
+        delete pbUnit;
+        delete pbDelta;
+        delete pbTargetStart;
+        delete pbTarget;
+    }
+
+    void TestGatherScatter() {
+        std::vector<NNFloat> vMatrix(pbMatrix->_pSysData, pbMatrix->_pSysData + rows * stride);
+        kGatherColumns(rows, stride, columns, pbColumn->_pDevData, pbMatrix->_pDevData, pbPacked->_pDevData);
+        pbPacked->Download();
+        for (uint32_t r = 0; r < rows; r++) {
+            for (uint32_t j = 0; j < columns; j++) {
+                CPPUNIT_ASSERT_EQUAL_MESSAGE("Gathered value is different", vMatrix[r * stride + pbColumn->_pSysData[j]], pbPacked->_pSysData[r * columns + j]);
+                pbPacked->_pSysData[r * columns + j] += (NNFloat)1.0;
+                vMatrix[r * stride + pbColumn->_pSysData[j]] += (NNFloat)1.0;
+            }
+        }
+
+        // Scattering back only touches the gathered columns
+        pbPacked->Upload();
+        kScatterColumns(rows, stride, columns, pbColumn->_pDevData, pbPacked->_pDevData, pbMatrix->_pDevData);
+        pbMatrix->Download();
+        for (size_t i = 0; i < rows * stride; i++) {
+            CPPUNIT_ASSERT_EQUAL_MESSAGE("Scattered value is different", vMatrix[i], pbMatrix->_pSysData[i]);
+        }
+    }
+
+    void TestSoftMaxDelta() {
+        for (size_t i = 0; i < batch * columns; i++) {
+            pbUnit->_pSysData[i] = (NNFloat)(rand() % 1000) / 1000.0f;
+        }
+        pbUnit->Upload();
+
+        kCalculateSampledCrossEntropyOutputDelta(SoftMax, batch, columns, pbUnit->_pDevData, pbDelta->_pDevData, pbTargetStart->_pDevData, pbTarget->_pDevData);
+        pbDelta->Download();
+
+        std::vector<NNFloat> vExpected(pbUnit->_pSysData, pbUnit->_pSysData + batch * columns);
+        for (uint32_t r = 0; r < batch; r++) {
+            for (uint32_t t = vTargetStart[r]; t < vTargetStart[r + 1]; t++) {
+                vExpected[r * columns + vTarget[t]] -= (NNFloat)1.0 / (vTargetStart[r + 1] - vTargetStart[r]);
+            }
+        }
+        for (size_t i = 0; i < batch * columns; i++) {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE("Delta is different", vExpected[i], pbDelta->_pSysData[i], 1.0e-6);
+        }
+    }
+
+    void TestSigmoidDelta() {
+        for (size_t i = 0; i < batch * columns; i++) {
+            pbUnit->_pSysData[i] = (NNFloat)(rand() % 1000 + 1) / 1002.0f;
+        }
+        pbUnit->Upload();
+
+        // Distinct boosts so scaling positives and negatives the wrong way round shows up
+        NNFloat deltaBoostOne = getGpu()._data._deltaBoost_one;
+        NNFloat deltaBoostZero = getGpu()._data._deltaBoost_zero;
+        getGpu()._data._deltaBoost_one = 2.0f;
+        getGpu()._data._deltaBoost_zero = 0.5f;
+        getGpu().CopyConstants();
+        kCalculateSampledCrossEntropyOutputDelta(Sigmoid, batch, columns, pbUnit->_pDevData, pbDelta->_pDevData, pbTargetStart->_pDevData, pbTarget->_pDevData);
+        getGpu()._data._deltaBoost_one = deltaBoostOne;
+        getGpu()._data._deltaBoost_zero = deltaBoostZero;
+        getGpu().CopyConstants();
+        pbDelta->Download();
+
+        // Negatives are pulled towards 0 and positives towards 1
+        std::vector<NNFloat> vExpected(batch * columns);
+        for (size_t i = 0; i < batch * columns; i++) {
+            vExpected[i] = 0.5f * pbUnit->_pSysData[i];
+        }
+        for (uint32_t r = 0; r < batch; r++) {
+            for (uint32_t t = vTargetStart[r]; t < vTargetStart[r + 1]; t++) {
+                uint32_t pos = r * columns + vTarget[t];
+                vExpected[pos] = 2.0f * (pbUnit->_pSysData[pos] - 1.0f);
+            }
+        }
+        for (size_t i = 0; i < batch * columns; i++) {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE("Delta is different", vExpected[i], pbDelta->_pSysData[i], 1.0e-6);
+        }
+    }
+
+    void TestCrossEntropyError() {
+        for (size_t i = 0; i < batch * columns; i++) {
+            pbUnit->_pSysData[i] = (NNFloat)(rand() % 1000 + 1) / 1002.0f;
+        }
+
+        // Saturated units are clamped by MIN_ERROR
+        pbUnit->_pSysData[1 * columns + 1] = 1.0f;
+        pbUnit->_pSysData[3 * columns + 2] = 0.0f;
+        pbUnit->Upload();
+
+        // Sigmoid: every unit counts as a negative, then positives swap their term for a positive one
+        double expected = 0.0;
+        for (size_t i = 0; i < batch * columns; i++) {
+            expected -= log(std::max((double)MIN_ERROR, 1.0 - pbUnit->_pSysData[i]));
+        }
+        for (uint32_t r = 0; r < batch; r++) {
+            for (uint32_t t = vTargetStart[r]; t < vTargetStart[r + 1]; t++) {
+                double a = pbUnit->_pSysData[r * columns + vTarget[t]];
+                expected += -log(std::max((double)MIN_ERROR, a)) + log(std::max((double)MIN_ERROR, 1.0 - a));
+            }
+        }
+        NNFloat error = kCalculateSampledCrossEntropyError(Sigmoid, batch, columns, pbUnit->_pDevData, pbTargetStart->_pDevData, pbTarget->_pDevData);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE("Sigmoid error is different", expected, error, 1.0e-4 * fabs(expected));
+
+        // SoftMax: a row's positives share a target of 1 and negatives contribute nothing
+        expected = 0.0;
+        for (uint32_t r = 0; r < batch; r++) {
+            for (uint32_t t = vTargetStart[r]; t < vTargetStart[r + 1]; t++) {
+                double a = pbUnit->_pSysData[r * columns + vTarget[t]];
+                expected -= log(std::max((double)MIN_ERROR, a)) / (vTargetStart[r + 1] - vTargetStart[r]);
+            }
+        }
+        error = kCalculateSampledCrossEntropyError(SoftMax, batch, columns, pbUnit->_pDevData, pbTargetStart->_pDevData, pbTarget->_pDevData);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE("SoftMax error is different", expected, error, 1.0e-4 * fabs(expected));
+    }
+
+    void TestAliasTable() {
+        // Smoothed and flattened output frequencies as NNLayer::SampleOutputs weighs them, unseen outputs included
+        static const uint32_t outputs = 100;
+        static const uint32_t draws = 1000000;
+        std::vector<double> vWeight(outputs);
+        double sum = 0.0;
+        for (uint32_t i = 0; i < outputs; i++) {
+            uint32_t count = (i % 7 == 0) ? 0 : (i * i * 13) % 5000;
+            vWeight[i] = pow(count + 1.0, 0.75);
+            sum += vWeight[i];
+        }
+        std::vector<double> vThreshold;
+        std::vector<uint32_t> vAlias;
+        BuildAliasTable(vWeight, vThreshold, vAlias);
+
+        // Each output's own slot plus the slots aliasing it add up to its probability
+        std::vector<double> vTableProbability(outputs, 0.0);
+        for (uint32_t i = 0; i < outputs; i++) {
+            CPPUNIT_ASSERT(vAlias[i] < outputs);
+            CPPUNIT_ASSERT((vThreshold[i] >= 0.0) && (vThreshold[i] <= 1.0));
+            vTableProbability[i] += vThreshold[i] / outputs;
+            vTableProbability[vAlias[i]] += (1.0 - vThreshold[i]) / outputs;
+        }
+        for (uint32_t i = 0; i < outputs; i++) {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE("Alias table probability is different", vWeight[i] / sum, vTableProbability[i], 1.0e-9);
+        }
+
+        // And draws follow the distribution to within 5 standard deviations
+        srand(12345);
+        std::vector<uint32_t> vCount(outputs, 0);
+        for (uint32_t i = 0; i < draws; i++) {
+            vCount[DrawAlias(vThreshold, vAlias)]++;
+        }
+        for (uint32_t i = 0; i < outputs; i++) {
+            double p = vWeight[i] / sum;
+            double sigma = sqrt(p * (1.0 - p) / draws);
+            CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE("Sampled frequency is different", p, (double)vCount[i] / draws, 5.0 * sigma);
+        }
+    }
+
+    CPPUNIT_TEST_SUITE(TestSampledOutput);
+    CPPUNIT_TEST(TestGatherScatter);
+    CPPUNIT_TEST(TestSoftMaxDelta);
+    CPPUNIT_TEST(TestSigmoidDelta);
+    CPPUNIT_TEST(TestCrossEntropyError);
+    CPPUNIT_TEST(TestAliasTable);
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+    GpuBuffer<NNFloat>* pbMatrix;
+    GpuBuffer<NNFloat>* pbPacked;
+    GpuBuffer<uint32_t>* pbColumn;
+    GpuBuffer<NNFloat>* pbUnit;
+    GpuBuffer<NNFloat>* pbDelta;
+    GpuBuffer<uint32_t>* pbTargetStart;
+    GpuBuffer<uint32_t>* pbTarget;
+};
+
+const uint32_t TestSampledOutput::vTargetStart[] = {0, 2, 3, 3, 6};
+const uint32_t TestSampledOutput::vTarget[] = {0, 5, 1, 0, 7, 19};
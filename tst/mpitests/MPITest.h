@@ -0,0 +1,39 @@
+#ifndef MPITEST_H
+#define MPITEST_H
+
+#include <mpi.h>
+#include <cstdio>
+#include <cstdlib>
+
+//
+// Minimal harness for tests that have to run on several processes, where
+// CppUnit's single process runner does not fit.  Every process checks its own
+// part of the result and the test fails if any of them found a mismatch.
+//
+static int gFailures = 0;
+
+#define MPI_TEST_CHECK(condition)                                                       \
+    do                                                                                  \
+    {                                                                                   \
+        if (!(condition))                                                               \
+        {                                                                               \
+            int id;                                                                     \
+            MPI_Comm_rank(MPI_COMM_WORLD, &id);                                         \
+            if (gFailures++ < 10)                                                       \
+                printf("Process %d: %s:%d: check failed: %s\n", id, __FILE__, __LINE__, #condition); \
+        }                                                                               \
+    } while (0)
+
+// Returns the exit code of the test, reporting the failures of every process from process 0
+inline int FinishTest(const char* name)
+{
+    int id, failures;
+    MPI_Comm_rank(MPI_COMM_WORLD, &id);
+    MPI_Allreduce(&gFailures, &failures, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    if (id == 0)
+        printf("%s: %s (%d failed checks)\n", name, failures ? "FAILED" : "OK", failures);
+    MPI_Finalize();
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,108 @@
+#include <cstdint>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "MPITest.h"
+#include "NNDataShard.h"
+
+//
+// Checks the contiguous example ranges of data sharded datasets for example
+// counts that do not divide evenly between processes, including fewer
+// examples than processes.  Processes reading their range from a NetCDF file
+// and process 0 sending ranges out have to end up with the same examples,
+// every example has to be found at its local position on the process owning
+// it, in shuffled order too, and UnShard has to restore the original order.
+//
+
+static const uint64_t stride            = 3;
+
+// Value j of example in the dataset file
+static uint32_t Value(uint32_t example, uint64_t j)
+{
+    return example * 1000 + j;
+}
+
+static void TestExamples(uint32_t examples)
+{
+    int id, numprocs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &id);
+    MPI_Comm_size(MPI_COMM_WORLD, &numprocs);
+    std::vector<uint32_t> vFile(examples * stride);
+    for (uint32_t i = 0; i < examples; i++)
+        for (uint64_t j = 0; j < stride; j++)
+            vFile[i * stride + j]       = Value(i, j);
+
+    // Ranges tile the examples in process order and differ in size by at most one example
+    uint32_t first, localExamples;
+    GetDataShard(examples, id, numprocs, first, localExamples);
+    uint32_t expectedFirst              = 0;
+    MPI_Exscan(&localExamples, &expectedFirst, 1, MPI_UNSIGNED, MPI_SUM, MPI_COMM_WORLD);
+    if (id == 0)
+        expectedFirst                   = 0;
+    MPI_TEST_CHECK(first == expectedFirst);
+    uint32_t total, minExamples, maxExamples;
+    MPI_Allreduce(&localExamples, &total, 1, MPI_UNSIGNED, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&localExamples, &minExamples, 1, MPI_UNSIGNED, MPI_MIN, MPI_COMM_WORLD);
+    MPI_Allreduce(&localExamples, &maxExamples, 1, MPI_UNSIGNED, MPI_MAX, MPI_COMM_WORLD);
+    MPI_TEST_CHECK(total == examples);
+    MPI_TEST_CHECK(maxExamples - minExamples <= 1);
+
+    // Reading [first, first + localExamples) from the file, as ReadShardNetCDF does
+    std::vector<uint32_t> vFileShard(vFile.begin() + first * stride, vFile.begin() + (first + localExamples) * stride);
+
+    // Sending from process 0, as Shard does for datasets not backed by a file
+    std::vector<uint32_t> vSentShard;
+    if (id == 0)
+        vSentShard                      = vFile;
+    ScatterDataShards(vSentShard, examples, stride, MPI_UNSIGNED, MPI_COMM_WORLD);
+    MPI_TEST_CHECK(vSentShard == vFileShard);
+
+    // Every example, taken in shuffled order, is at its local position on the one process owning it
+    std::vector<uint32_t> vOrder(examples);
+    for (uint32_t i = 0; i < examples; i++)
+        vOrder[i]                       = i;
+    std::mt19937 rng(examples);
+    std::shuffle(vOrder.begin(), vOrder.end(), rng);
+    std::vector<uint32_t> vFound(examples, 0);
+    for (uint32_t example : vOrder)
+    {
+        if ((example >= first) && (example < first + localExamples))
+        {
+            uint32_t position           = example - first;
+            for (uint64_t j = 0; j < stride; j++)
+                MPI_TEST_CHECK(vSentShard[position * stride + j] == Value(example, j));
+            vFound[example]++;
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, vFound.data(), examples, MPI_UNSIGNED, MPI_SUM, MPI_COMM_WORLD);
+    MPI_TEST_CHECK(std::count(vFound.begin(), vFound.end(), 1u) == (long)examples);
+
+    // UnShard of either shard leaves process 0 with the file's examples in order
+    GatherDataShards(vFileShard, examples, stride, MPI_UNSIGNED, MPI_COMM_WORLD);
+    GatherDataShards(vSentShard, examples, stride, MPI_UNSIGNED, MPI_COMM_WORLD);
+    if (id == 0)
+    {
+        MPI_TEST_CHECK(vFileShard == vFile);
+        MPI_TEST_CHECK(vSentShard == vFile);
+    }
+    else
+    {
+        MPI_TEST_CHECK(vFileShard.empty());
+        MPI_TEST_CHECK(vSentShard.empty());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+    int numprocs;
+    MPI_Comm_size(MPI_COMM_WORLD, &numprocs);
+    TestExamples(1000 * numprocs);
+    TestExamples(1000 * numprocs + 1);
+    TestExamples(1000 * numprocs - 1);
+    TestExamples(17);
+    TestExamples(numprocs - 1);
+    TestExamples(0);
+    return FinishTest("TestDataShard");
+}
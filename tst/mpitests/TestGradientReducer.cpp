@@ -0,0 +1,270 @@
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <sys/time.h>
+
+#include "MPITest.h"
+#include "NNGradientReducer.h"
+
+//
+// Checks NNGradientReducer the way NNNetwork drives it for replicated weights:
+// gradients are added in backpropagation order, staged into their bucket as
+// the step completing them finishes, buckets are started in order as soon as
+// they are complete and everything is waited for and copied back at the end
+// of the minibatch.  Every bucketed sum is compared to an MPI_Allreduce of
+// each gradient on its own.
+//
+// Run with -t to time bucketed reduction against reducing each gradient with
+// its own blocking MPI_Allreduce instead:
+//
+//    mpirun -np 4 TestGradientReducer -t [iterations] [bucket size]
+//
+
+struct Gradient
+{
+    size_t              _size;
+    uint32_t            _step;                  // Backpropagation step completing the gradient
+    uint32_t            _bucket;
+    size_t              _offset;
+    std::vector<float>  _vValue;
+};
+
+// Gradients of a small network in backpropagation order, weights followed by biases, with some layers sharing a
+// step, scale widening its hidden layers
+static std::vector<Gradient> CreateGradients(size_t scale = 1)
+{
+    const size_t sSize[]                = { 128 * 100 * scale, 100 * scale, 100 * 1000 * scale * scale, 1000 * scale, 7,
+                                            300 * 100 * scale, 300, 33 * 300, 33, 500 * 33 * scale, 500 * scale };
+    static const uint32_t sStep[]       = { 0, 0, 1, 1, 1, 2, 2, 3, 3, 4, 4 };
+    std::vector<Gradient> vGradient(sizeof(sSize) / sizeof(sSize[0]));
+    for (size_t i = 0; i < vGradient.size(); i++)
+    {
+        vGradient[i]._size              = sSize[i];
+        vGradient[i]._step              = sStep[i];
+        vGradient[i]._vValue.resize(sSize[i]);
+    }
+    return vGradient;
+}
+
+// Multiples of 1/4 small enough that every order of summation is exact
+static void FillGradients(std::vector<Gradient>& vGradient, int id, uint32_t batch)
+{
+    for (size_t i = 0; i < vGradient.size(); i++)
+        for (size_t j = 0; j < vGradient[i]._size; j++)
+            vGradient[i]._vValue[j]     = 0.25f * (float)((int)((j * 31 + i * 17 + id * 7 + batch * 3) % 41) - 20);
+}
+
+static void AddGradients(NNGradientReducer<float>& reducer, std::vector<Gradient>& vGradient, std::vector<std::vector<float> >& vBuffer)
+{
+    for (auto& g : vGradient)
+        reducer.Add(g._size, g._step, g._bucket, g._offset);
+    vBuffer.resize(reducer.GetBuckets());
+    for (uint32_t i = 0; i < reducer.GetBuckets(); i++)
+    {
+        vBuffer[i].resize(reducer.GetBucketSize(i));
+        reducer.SetBuffer(i, vBuffer[i].data());
+    }
+}
+
+// Reduces one minibatch of gradients in place as NNNetwork::StageGradients and FinishGradientReduction do
+static void ReduceGradients(NNGradientReducer<float>& reducer, std::vector<Gradient>& vGradient, std::vector<std::vector<float> >& vBuffer)
+{
+    uint32_t steps                      = vGradient.back()._step + 1;
+    for (uint32_t step = 0; step < steps; step++)
+    {
+        for (auto& g : vGradient)
+        {
+            if (reducer.GetBucketStep(g._bucket) == step)
+                memcpy(vBuffer[g._bucket].data() + g._offset, g._vValue.data(), g._size * sizeof(float));
+        }
+        while ((reducer.GetNextBucket() < reducer.GetBuckets()) && (reducer.GetBucketStep(reducer.GetNextBucket()) <= step))
+            reducer.Start();
+        reducer.Test();
+    }
+    while (reducer.GetNextBucket() < reducer.GetBuckets())
+        reducer.Start();
+    reducer.Wait();
+    for (auto& g : vGradient)
+        memcpy(g._vValue.data(), vBuffer[g._bucket].data() + g._offset, g._size * sizeof(float));
+}
+
+static std::vector<Gradient> ReferenceGradients(const std::vector<Gradient>& vGradient)
+{
+    std::vector<Gradient> vReference    = vGradient;
+    for (auto& g : vReference)
+        MPI_Allreduce(MPI_IN_PLACE, g._vValue.data(), g._size, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
+    return vReference;
+}
+
+// Uncompressed and SparseTopK sending every value have to match the reference exactly
+static void TestExact(size_t bucketSize, GradientCompression compression)
+{
+    int id;
+    MPI_Comm_rank(MPI_COMM_WORLD, &id);
+    NNGradientReducer<float> reducer(MPI_FLOAT, bucketSize, MPI_COMM_WORLD);
+    std::vector<Gradient> vGradient     = CreateGradients();
+    std::vector<std::vector<float> > vBuffer;
+    AddGradients(reducer, vGradient, vBuffer);
+    reducer.SetCompression(compression, 1.0);
+
+    // Buckets have to be complete by the step of their last gradient
+    for (auto& g : vGradient)
+        MPI_TEST_CHECK(reducer.GetBucketStep(g._bucket) >= g._step);
+
+    // Several minibatches so buffers and requests are reused
+    for (uint32_t batch = 0; batch < 3; batch++)
+    {
+        FillGradients(vGradient, id, batch);
+        std::vector<Gradient> vReference = ReferenceGradients(vGradient);
+        ReduceGradients(reducer, vGradient, vBuffer);
+        size_t mismatches               = 0;
+        for (size_t i = 0; i < vGradient.size(); i++)
+            for (size_t j = 0; j < vGradient[i]._size; j++)
+                mismatches             += (vGradient[i]._vValue[j] != vReference[i]._vValue[j]);
+        MPI_TEST_CHECK(mismatches == 0);
+    }
+}
+
+// HalfPrecision only rounds each partial sum to half precision
+static void TestHalfPrecision(size_t bucketSize)
+{
+    int id, numprocs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &id);
+    MPI_Comm_size(MPI_COMM_WORLD, &numprocs);
+    NNGradientReducer<float> reducer(MPI_FLOAT, bucketSize, MPI_COMM_WORLD);
+    std::vector<Gradient> vGradient     = CreateGradients();
+    std::vector<std::vector<float> > vBuffer;
+    AddGradients(reducer, vGradient, vBuffer);
+    reducer.SetCompression(HalfPrecision);
+    FillGradients(vGradient, id, 0);
+    for (auto& g : vGradient)
+        for (size_t j = 0; j < g._size; j++)
+            g._vValue[j]               *= 1.0f / 3.0f;
+    std::vector<Gradient> vReference    = ReferenceGradients(vGradient);
+    std::vector<Gradient> vMagnitude    = vGradient;
+    for (auto& g : vMagnitude)
+        for (size_t j = 0; j < g._size; j++)
+            g._vValue[j]                = fabsf(g._vValue[j]);
+    vMagnitude                          = ReferenceGradients(vMagnitude);
+    ReduceGradients(reducer, vGradient, vBuffer);
+
+    size_t mismatches                   = 0;
+    for (size_t i = 0; i < vGradient.size(); i++)
+        for (size_t j = 0; j < vGradient[i]._size; j++)
+            mismatches                 += (fabsf(vGradient[i]._vValue[j] - vReference[i]._vValue[j]) > numprocs * vMagnitude[i]._vValue[j] / 1024.0f);
+    MPI_TEST_CHECK(mismatches == 0);
+}
+
+// SparseTopK only delays what it leaves out, so summed over minibatches it has to stay within the residuals
+// of the reference
+static void TestSparseTopK(size_t bucketSize)
+{
+    static const double ratio           = 0.1;
+    static const uint32_t batches       = 20;
+    int id, numprocs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &id);
+    MPI_Comm_size(MPI_COMM_WORLD, &numprocs);
+    NNGradientReducer<float> reducer(MPI_FLOAT, bucketSize, MPI_COMM_WORLD);
+    std::vector<Gradient> vGradient     = CreateGradients();
+    std::vector<std::vector<float> > vBuffer;
+    AddGradients(reducer, vGradient, vBuffer);
+    reducer.SetCompression(SparseTopK, ratio);
+
+    std::vector<Gradient> vTotal        = vGradient;
+    std::vector<Gradient> vReferenceTotal = vGradient;
+    for (uint32_t batch = 0; batch < batches; batch++)
+    {
+        FillGradients(vGradient, id, batch);
+        std::vector<Gradient> vReference = ReferenceGradients(vGradient);
+        ReduceGradients(reducer, vGradient, vBuffer);
+        for (size_t i = 0; i < vGradient.size(); i++)
+        {
+            for (size_t j = 0; j < vGradient[i]._size; j++)
+            {
+                vTotal[i]._vValue[j]   += vGradient[i]._vValue[j];
+                vReferenceTotal[i]._vValue[j] += vReference[i]._vValue[j];
+            }
+        }
+    }
+
+    // Each gradient value is at most 5 in magnitude per process and minibatch
+    float bound                         = numprocs * 5.0f * (float)(2.0 / ratio);
+    size_t mismatches                   = 0;
+    for (size_t i = 0; i < vTotal.size(); i++)
+        for (size_t j = 0; j < vTotal[i]._size; j++)
+            mismatches                 += (fabsf(vTotal[i]._vValue[j] - vReferenceTotal[i]._vValue[j]) > bound);
+    MPI_TEST_CHECK(mismatches == 0);
+}
+
+static double Elapsed(const timeval& start)
+{
+    timeval end;
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start.tv_sec) + 1.0e-6 * (end.tv_usec - start.tv_usec);
+}
+
+static void Time(uint32_t iterations, size_t bucketSize)
+{
+    int id;
+    MPI_Comm_rank(MPI_COMM_WORLD, &id);
+    std::vector<Gradient> vGradient     = CreateGradients(10);
+    size_t values                       = 0;
+    for (auto& g : vGradient)
+        values                         += g._size;
+    FillGradients(vGradient, id, 0);
+    if (id == 0)
+        printf("TestGradientReducer: %lu gradients, %lu values, bucket size %lu, %u iterations\n", vGradient.size(), values, bucketSize, iterations);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    timeval start;
+    gettimeofday(&start, NULL);
+    for (uint32_t i = 0; i < iterations; i++)
+        for (auto& g : vGradient)
+            MPI_Allreduce(MPI_IN_PLACE, g._vValue.data(), g._size, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
+    double elapsed                      = Elapsed(start);
+    if (id == 0)
+        printf("TestGradientReducer: MPI_Allreduce per gradient %10.3f ms\n", 1000.0 * elapsed / iterations);
+
+    static const GradientCompression sCompression[] = { Uncompressed, HalfPrecision, SparseTopK };
+    static const char* sName[]          = { "Uncompressed", "HalfPrecision", "SparseTopK" };
+    for (int c = 0; c < 3; c++)
+    {
+        NNGradientReducer<float> reducer(MPI_FLOAT, bucketSize, MPI_COMM_WORLD);
+        std::vector<std::vector<float> > vBuffer;
+        AddGradients(reducer, vGradient, vBuffer);
+        reducer.SetCompression(sCompression[c], 0.01);
+        MPI_Barrier(MPI_COMM_WORLD);
+        gettimeofday(&start, NULL);
+        for (uint32_t i = 0; i < iterations; i++)
+            ReduceGradients(reducer, vGradient, vBuffer);
+        elapsed                         = Elapsed(start);
+        if (id == 0)
+            printf("TestGradientReducer: %-25s %10.3f ms in %u buckets\n", sName[c], 1000.0 * elapsed / iterations, reducer.GetBuckets());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+    if ((argc > 1) && (strcmp(argv[1], "-t") == 0))
+    {
+        uint32_t iterations             = (argc > 2) ? atoi(argv[2]) : 20;
+        size_t bucketSize               = (argc > 3) ? atol(argv[3]) : 4 * 1024 * 1024;
+        Time(iterations, bucketSize);
+        MPI_Finalize();
+        return EXIT_SUCCESS;
+    }
+
+    // Single bucket, buckets spanning steps and one bucket per gradient
+    static const size_t sBucketSize[]   = { 4 * 1024 * 1024, 16 * 1024, 1 };
+    for (size_t bucketSize : sBucketSize)
+    {
+        TestExact(bucketSize, Uncompressed);
+        TestExact(bucketSize, SparseTopK);
+        TestHalfPrecision(bucketSize);
+        TestSparseTopK(bucketSize);
+    }
+    return FinishTest("TestGradientReducer");
+}
@@ -0,0 +1,110 @@
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "MPITest.h"
+#include "NNRingCollectives.h"
+
+//
+// Checks the model parallel top K merge NNRecsGenerator relies on: every
+// process holds the [minX, maxX) slice of an output layer that NNLayer assigns
+// it, picks the top K of that slice, offsets the indices by the slice's first
+// unit and merges them with RingMergeTopK.  Widths that do not divide evenly
+// between processes leave slices of different sizes, so the offset is not
+// a multiple of the local width.  GetSliceStart, which computes the split for
+// NNLayer, the ring collectives and the merged rows, is checked on its own too.
+//
+
+// Distinct score of feature of example row
+static float Score(uint32_t row, uint32_t feature)
+{
+    return (float)((feature * 7919u + row * 104729u) % 100003u);
+}
+
+// Checks that the slices of width columns split between slices processes tile them in order, differ in width by
+// at most one and are no wider than the maximum NNLayer sizes model parallel buffers for
+static void TestSlices(uint64_t width, uint32_t slices)
+{
+    uint32_t maxWidth                   = (width + slices - 1) / slices;
+    uint32_t minWidth                   = width / slices;
+    MPI_TEST_CHECK(GetSliceStart(width, 0, slices) == 0);
+    MPI_TEST_CHECK(GetSliceStart(width, slices, slices) == width);
+    for (uint32_t i = 0; i < slices; i++)
+    {
+        uint32_t span                   = GetSliceStart(width, i + 1, slices) - GetSliceStart(width, i, slices);
+        MPI_TEST_CHECK((span >= minWidth) && (span <= maxWidth));
+    }
+}
+
+static void TestWidth(uint32_t width, uint32_t batch, uint32_t k)
+{
+    int id, numprocs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &id);
+    MPI_Comm_size(MPI_COMM_WORLD, &numprocs);
+
+    // Split as NNLayer does for model parallel layers
+    uint32_t minX                       = GetSliceStart(width, id, numprocs);
+    uint32_t maxX                       = GetSliceStart(width, id + 1, numprocs);
+    uint32_t localWidth                 = maxX - minX;
+
+    // Slices have to tile the layer: each starts where the ones of lower processes end
+    uint32_t expectedOffset             = 0;
+    MPI_Exscan(&localWidth, &expectedOffset, 1, MPI_UNSIGNED, MPI_SUM, MPI_COMM_WORLD);
+    if (id == 0)
+        expectedOffset                  = 0;
+    MPI_TEST_CHECK(minX == expectedOffset);
+
+    // Local top K with indices made global
+    std::vector<float> vKey((size_t)batch * k);
+    std::vector<uint32_t> vIndex((size_t)batch * k);
+    std::vector<uint32_t> vLocal(localWidth);
+    for (uint32_t row = 0; row < batch; row++)
+    {
+        for (uint32_t i = 0; i < localWidth; i++)
+            vLocal[i]                   = i;
+        std::sort(vLocal.begin(), vLocal.end(),
+                  [minX, row](uint32_t a, uint32_t b) { return Score(row, minX + a) > Score(row, minX + b); });
+        for (uint32_t j = 0; j < k; j++)
+        {
+            vKey[row * k + j]           = Score(row, minX + vLocal[j]);
+            vIndex[row * k + j]         = vLocal[j] + minX;
+        }
+    }
+    RingMergeTopK(vKey.data(), vIndex.data(), batch, k, MPI_UNSIGNED, MPI_COMM_WORLD);
+
+    // Each process ends up with the exact top K of its own block of examples
+    uint32_t start                      = GetSliceStart(batch, id, numprocs);
+    uint32_t end                        = GetSliceStart(batch, id + 1, numprocs);
+    std::vector<uint32_t> vGlobal(width);
+    for (uint32_t row = start; row < end; row++)
+    {
+        for (uint32_t i = 0; i < width; i++)
+            vGlobal[i]                  = i;
+        std::sort(vGlobal.begin(), vGlobal.end(),
+                  [row](uint32_t a, uint32_t b) { return Score(row, a) > Score(row, b); });
+        for (uint32_t j = 0; j < k; j++)
+        {
+            MPI_TEST_CHECK(vIndex[row * k + j] == vGlobal[j]);
+            MPI_TEST_CHECK(vKey[row * k + j] == Score(row, vGlobal[j]));
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+    for (uint32_t slices = 1; slices <= 17; slices++)
+    {
+        for (uint64_t width : { 0, 1, 2, 10, 16, 1003, 4096 })
+            TestSlices(width, slices);
+    }
+
+    // Products of width and slice overflow 32 bits
+    TestSlices(4000000000u, 3);
+    TestSlices(4294967295u, 16);
+    TestWidth(10, 6, 2);
+    TestWidth(1003, 7, 16);
+    TestWidth(4096, 8, 32);
+    return FinishTest("TestRecsOffset");
+}
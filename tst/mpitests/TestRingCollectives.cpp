@@ -0,0 +1,79 @@
+#include <cstdint>
+#include <vector>
+
+#include "MPITest.h"
+#include "NNRingCollectives.h"
+
+//
+// Checks the ring collectives NNLayer reduces and gathers model parallel
+// units with against MPI_Allreduce and MPI_Allgather, for strides that do not
+// divide evenly between processes, including strides narrower than the
+// number of processes, where some column slices are empty.
+//
+
+// Value of matrix element (row, column) on process id, small enough that every order of summation is exact
+template<typename T> static T Value(uint32_t row, uint32_t column, int id)
+{
+    return (T)((int)((row * 131 + column * 17 + id * 7) % 61) - 30) * (T)0.5;
+}
+
+template<typename T> static void TestStride(uint32_t rows, uint32_t stride, MPI_Datatype type)
+{
+    int id, numprocs;
+    MPI_Comm_rank(MPI_COMM_WORLD, &id);
+    MPI_Comm_size(MPI_COMM_WORLD, &numprocs);
+    uint32_t minX                       = GetSliceStart(stride, id, numprocs);
+    uint32_t maxX                       = GetSliceStart(stride, id + 1, numprocs);
+    uint32_t maxWidth                   = (stride + numprocs - 1) / numprocs;
+
+    std::vector<T> vMatrix((size_t)rows * stride);
+    for (uint32_t i = 0; i < rows; i++)
+        for (uint32_t j = 0; j < stride; j++)
+            vMatrix[(size_t)i * stride + j] = Value<T>(i, j, id);
+
+    // Reduce scatter leaves this process's slice holding the sum over all processes
+    std::vector<T> vSum(vMatrix);
+    MPI_Allreduce(MPI_IN_PLACE, vSum.data(), vSum.size(), type, MPI_SUM, MPI_COMM_WORLD);
+    std::vector<T> vReduced(vMatrix);
+    std::vector<T> vReceive((size_t)rows * maxWidth);
+    RingReduceScatter(vReduced.data(), rows, stride, vReceive.data(), type, MPI_COMM_WORLD);
+    for (uint32_t i = 0; i < rows; i++)
+        for (uint32_t j = minX; j < maxX; j++)
+            MPI_TEST_CHECK(vReduced[(size_t)i * stride + j] == vSum[(size_t)i * stride + j]);
+
+    // All gather gives every process each slice from the process owning it, whatever the other processes held there
+    std::vector<T> vAll((size_t)numprocs * rows * stride);
+    MPI_Allgather(vMatrix.data(), rows * stride, type, vAll.data(), rows * stride, type, MPI_COMM_WORLD);
+    std::vector<T> vGathered(vMatrix);
+    for (uint32_t i = 0; i < rows; i++)
+    {
+        for (uint32_t j = 0; j < stride; j++)
+        {
+            if ((j < minX) || (j >= maxX))
+                vGathered[(size_t)i * stride + j] = (T)-1000;
+        }
+    }
+    RingAllGather(vGathered.data(), rows, stride, type, MPI_COMM_WORLD);
+    for (int p = 0; p < numprocs; p++)
+    {
+        uint32_t pMinX                  = GetSliceStart(stride, p, numprocs);
+        uint32_t pMaxX                  = GetSliceStart(stride, p + 1, numprocs);
+        for (uint32_t i = 0; i < rows; i++)
+            for (uint32_t j = pMinX; j < pMaxX; j++)
+                MPI_TEST_CHECK(vGathered[(size_t)i * stride + j] == vAll[((size_t)p * rows + i) * stride + j]);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+    int numprocs;
+    MPI_Comm_size(MPI_COMM_WORLD, &numprocs);
+    TestStride<float>(5, 64 * numprocs, MPI_FLOAT);
+    TestStride<float>(5, 64 * numprocs + 3, MPI_FLOAT);
+    TestStride<float>(1, 1001, MPI_FLOAT);
+    TestStride<double>(7, 10 * numprocs - 1, MPI_DOUBLE);
+    TestStride<float>(3, numprocs - 1, MPI_FLOAT);
+    TestStride<float>(3, 1, MPI_FLOAT);
+    return FinishTest("TestRingCollectives");
+}
@@ -0,0 +1,244 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/TestAssert.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "NNDataSetStream.h"
+
+//
+// Streams two sets of identically sized shards, as inputs and outputs are, and
+// checks every position of several passes against the example it should hold.
+// Example i of shard s has id s * 100 + i and datapoints at indices id and
+// SliceOffset + id, each valued id plus the set's data offset.
+//
+class TestNNDataSetStream : public CppUnit::TestFixture
+{
+    static const uint32_t SliceOffset   = 5000;
+    static const uint32_t OutputOffset  = 1000000;
+
+    // Synthesizes the examples of each shard file instead of reading them
+    class ShardSet : public NNStreamGroups<uint32_t>
+    {
+    public:
+        std::map<std::string, uint32_t> _mShard;
+        uint32_t _dataOffset;
+
+        void ReadShard(netCDF::NcFile&, const std::string& fname, uint32_t examples)
+        {
+            uint32_t shard = _mShard.at(fname);
+            std::vector<uint64_t> vOffset(1, 0);
+            std::vector<uint32_t> vIndex;
+            std::vector<uint32_t> vData;
+            for (uint32_t i = 0; i < examples; i++)
+            {
+                uint32_t id = shard * 100 + i;
+                vIndex.push_back(id);
+                vIndex.push_back(SliceOffset + id);
+                vData.push_back(_dataOffset + id);
+                vData.push_back(_dataOffset + id);
+                vOffset.push_back(vIndex.size());
+            }
+            AppendShard(vOffset, vIndex, vData, examples);
+        }
+    };
+
+    // A stream and the one dataset read from it
+    struct Stream
+    {
+        ShardSet _set;
+        NNDataSetStream _stream;
+
+        Stream(const std::vector<std::string>& vFile, const std::vector<uint32_t>& vExamples, uint32_t windowShards, bool bShuffle, uint32_t dataOffset) :
+            _stream(vFile, vExamples, windowShards, bShuffle)
+        {
+            for (uint32_t s = 0; s < vFile.size(); s++)
+                _set._mShard[vFile[s]] = s;
+            _set._dataOffset = dataOffset;
+            _stream.AddDataSet(&_set);
+        }
+
+        ~Stream()
+        {
+            _stream.RemoveDataSet(&_set);
+        }
+    };
+
+    std::string _directory;
+    std::vector<std::string> _vInputFile;
+    std::vector<std::string> _vOutputFile;
+
+    // Seven shards read two at a time, so the last group holds a single shard
+    std::vector<uint32_t> _vExamples = {7, 3, 10, 1, 6, 5, 4};
+    uint32_t _totalExamples = 36;
+
+    // Checks one pass in batches of batch examples and returns the ids it visited in order
+    std::vector<uint32_t> RunPass(Stream& input, Stream& output, uint32_t batch, uint64_t seed, uint32_t& maxResidentGroups)
+    {
+        std::vector<uint32_t> vOrder;
+        for (uint32_t position = 0; position < _totalExamples; position += batch)
+        {
+            CPPUNIT_ASSERT(input._stream.Advance(position, batch, seed));
+            CPPUNIT_ASSERT(output._stream.Advance(position, batch, seed));
+            CPPUNIT_ASSERT(input._stream.GetResidentGroups() == output._stream.GetResidentGroups());
+            maxResidentGroups = std::max(maxResidentGroups, (uint32_t)input._stream.GetResidentGroups().size());
+
+            std::vector<uint64_t> vInputOffset, vOutputOffset;
+            std::vector<uint32_t> vInputIndex, vOutputIndex, vInputData, vOutputData;
+            input._set.GatherResident(input._stream.GetResidentGroups(), false, 0, 0, vInputOffset, vInputIndex, vInputData);
+            output._set.GatherResident(output._stream.GetResidentGroups(), false, 0, 0, vOutputOffset, vOutputIndex, vOutputData);
+            CPPUNIT_ASSERT(vInputOffset.size() == vOutputOffset.size());
+            uint32_t windowExamples = vInputOffset.size() - 1;
+
+            // Every position of the batch is resident, and inputs and outputs hold the same example there
+            uint32_t start = input._stream.GetWindowPosition(position);
+            CPPUNIT_ASSERT_EQUAL(start, output._stream.GetWindowPosition(position));
+            for (uint32_t j = 0; (j < batch) && (position + j < _totalExamples); j++)
+            {
+                uint32_t w = start + j;
+                CPPUNIT_ASSERT(w < windowExamples);
+                CPPUNIT_ASSERT_EQUAL((uint64_t)2, vInputOffset[w + 1] - vInputOffset[w]);
+                CPPUNIT_ASSERT_EQUAL((uint64_t)2, vOutputOffset[w + 1] - vOutputOffset[w]);
+                uint32_t id = vInputIndex[vInputOffset[w]];
+                CPPUNIT_ASSERT_EQUAL(SliceOffset + id, vInputIndex[vInputOffset[w] + 1]);
+                CPPUNIT_ASSERT_EQUAL(id, vInputData[vInputOffset[w]]);
+                CPPUNIT_ASSERT_EQUAL(id, vOutputIndex[vOutputOffset[w]]);
+                CPPUNIT_ASSERT_EQUAL(OutputOffset + id, vOutputData[vOutputOffset[w]]);
+                vOrder.push_back(id);
+            }
+        }
+        return vOrder;
+    }
+
+    // Checks that vOrder visits every example exactly once
+    void CheckCoverage(const std::vector<uint32_t>& vOrder)
+    {
+        CPPUNIT_ASSERT_EQUAL((size_t)_totalExamples, vOrder.size());
+        std::map<uint32_t, uint32_t> mCount;
+        for (auto id : vOrder)
+            mCount[id]++;
+        for (uint32_t s = 0; s < _vExamples.size(); s++)
+        {
+            for (uint32_t i = 0; i < _vExamples[s]; i++)
+                CPPUNIT_ASSERT_EQUAL((uint32_t)1, mCount[s * 100 + i]);
+        }
+    }
+
+public:
+    void setUp()
+    {
+        char directory[] = "/tmp/TestNNDataSetStreamXXXXXX";
+        CPPUNIT_ASSERT(mkdtemp(directory) != NULL);
+        _directory = directory;
+
+        // The stream opens each shard, so both sets need real (empty) NetCDF files
+        _vInputFile.clear();
+        _vOutputFile.clear();
+        for (uint32_t s = 0; s < _vExamples.size(); s++)
+        {
+            _vInputFile.push_back(_directory + "/input" + std::to_string(s) + ".nc");
+            _vOutputFile.push_back(_directory + "/output" + std::to_string(s) + ".nc");
+            netCDF::NcFile input(_vInputFile.back(), netCDF::NcFile::replace);
+            netCDF::NcFile output(_vOutputFile.back(), netCDF::NcFile::replace);
+        }
+    }
+
+    void tearDown()
+    {
+        for (auto& f : _vInputFile)
+            remove(f.c_str());
+        for (auto& f : _vOutputFile)
+            remove(f.c_str());
+        rmdir(_directory.c_str());
+    }
+
+    void TestUnshuffled()
+    {
+        // Without shuffling examples come in shard order
+        Stream input(_vInputFile, _vExamples, 2, false, 0);
+        Stream output(_vOutputFile, _vExamples, 2, false, OutputOffset);
+        uint32_t maxResidentGroups = 0;
+        std::vector<uint32_t> vOrder = RunPass(input, output, 5, 1, maxResidentGroups);
+        CheckCoverage(vOrder);
+        std::vector<uint32_t> vExpected;
+        for (uint32_t s = 0; s < _vExamples.size(); s++)
+        {
+            for (uint32_t i = 0; i < _vExamples[s]; i++)
+                vExpected.push_back(s * 100 + i);
+        }
+        CPPUNIT_ASSERT(vOrder == vExpected);
+
+        // Groups start at positions 0, 10, 21 and 32, so a batch at 8 spans three of them and one at 24 the last two
+        CPPUNIT_ASSERT(input._stream.Advance(8, 16, 1));
+        CPPUNIT_ASSERT_EQUAL((size_t)3, input._stream.GetResidentGroups().size());
+        CPPUNIT_ASSERT_EQUAL((uint32_t)8, input._stream.GetWindowPosition(8));
+        CPPUNIT_ASSERT(input._stream.Advance(24, 12, 1));
+        CPPUNIT_ASSERT_EQUAL((size_t)2, input._stream.GetResidentGroups().size());
+        CPPUNIT_ASSERT_EQUAL((uint32_t)3, input._stream.GetWindowPosition(24));
+    }
+
+    void TestShuffledPasses()
+    {
+        // Batches of 5 and 16 straddle group boundaries
+        static const uint32_t passes = 4;
+        std::vector<uint32_t> vBatch = {5, 1, 16, 5};
+        std::vector<std::vector<uint32_t> > vOrder;
+        uint32_t maxResidentGroups = 0;
+        {
+            Stream input(_vInputFile, _vExamples, 2, true, 0);
+            Stream output(_vOutputFile, _vExamples, 2, true, OutputOffset);
+            for (uint32_t p = 0; p < passes; p++)
+            {
+                vOrder.push_back(RunPass(input, output, vBatch[p], 1234, maxResidentGroups));
+                CheckCoverage(vOrder.back());
+            }
+        }
+        CPPUNIT_ASSERT(maxResidentGroups >= 2);
+
+        // Each pass is reshuffled
+        for (uint32_t p = 1; p < passes; p++)
+            CPPUNIT_ASSERT(vOrder[p] != vOrder[0]);
+
+        // The same seed gives the same passes whatever the batch size, and another seed different ones
+        {
+            Stream input(_vInputFile, _vExamples, 2, true, 0);
+            Stream output(_vOutputFile, _vExamples, 2, true, OutputOffset);
+            for (uint32_t p = 0; p < passes; p++)
+                CPPUNIT_ASSERT(RunPass(input, output, 7, 1234, maxResidentGroups) == vOrder[p]);
+        }
+        {
+            Stream input(_vInputFile, _vExamples, 2, true, 0);
+            Stream output(_vOutputFile, _vExamples, 2, true, OutputOffset);
+            CPPUNIT_ASSERT(RunPass(input, output, 5, 4321, maxResidentGroups) != vOrder[0]);
+        }
+    }
+
+    void TestModelSlice()
+    {
+        // A model sharded window keeps only the indices in its slice, shifted to start at 0
+        Stream input(_vInputFile, _vExamples, 3, true, 0);
+        CPPUNIT_ASSERT(input._stream.Advance(10, 8, 99));
+        std::vector<uint64_t> vAllOffset, vSliceOffset;
+        std::vector<uint32_t> vAllIndex, vSliceIndex, vAllData, vSliceData;
+        input._set.GatherResident(input._stream.GetResidentGroups(), false, 0, 0, vAllOffset, vAllIndex, vAllData);
+        input._set.GatherResident(input._stream.GetResidentGroups(), true, SliceOffset, 2 * SliceOffset, vSliceOffset, vSliceIndex, vSliceData);
+        CPPUNIT_ASSERT_EQUAL(vAllOffset.size(), vSliceOffset.size());
+        for (size_t w = 0; w + 1 < vSliceOffset.size(); w++)
+        {
+            CPPUNIT_ASSERT_EQUAL((uint64_t)1, vSliceOffset[w + 1] - vSliceOffset[w]);
+            CPPUNIT_ASSERT_EQUAL(vAllIndex[vAllOffset[w]], vSliceIndex[vSliceOffset[w]]);
+            CPPUNIT_ASSERT_EQUAL(vAllData[vAllOffset[w] + 1], vSliceData[vSliceOffset[w]]);
+        }
+    }
+
+    CPPUNIT_TEST_SUITE(TestNNDataSetStream);
+    CPPUNIT_TEST(TestUnshuffled);
+    CPPUNIT_TEST(TestShuffledPasses);
+    CPPUNIT_TEST(TestModelSlice);
+    CPPUNIT_TEST_SUITE_END();
+};
@@ -0,0 +1,130 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/TestAssert.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include "NNGradientReducer.h"
+
+class TestNNGradientReducer : public CppUnit::TestFixture
+{
+    typedef NNGradientReducer<float> Reducer;
+
+public:
+    void TestHalfRoundTrip()
+    {
+        // Every finite half precision value, denormals and signed zeros included, survives a round trip
+        for (uint32_t h = 0; h < 0x10000; h++)
+        {
+            if (((h >> 10) & 0x1f) != 0x1f)
+                CPPUNIT_ASSERT_EQUAL((uint16_t)h, Reducer::FloatToHalf(Reducer::HalfToFloat(h)));
+        }
+        CPPUNIT_ASSERT_EQUAL(std::ldexp(1.0f, -24), Reducer::HalfToFloat(0x0001));
+        CPPUNIT_ASSERT_EQUAL(std::ldexp(1023.0f, -24), Reducer::HalfToFloat(0x03ff));
+        CPPUNIT_ASSERT_EQUAL(-std::ldexp(1.0f, -14), Reducer::HalfToFloat(0x8400));
+
+        // Rounding to nearest, ties to even, among denormals and normals
+        CPPUNIT_ASSERT_EQUAL((uint16_t)0x0000, Reducer::FloatToHalf(std::ldexp(1.0f, -25)));
+        CPPUNIT_ASSERT_EQUAL((uint16_t)0x0001, Reducer::FloatToHalf(std::ldexp(1.5f, -25)));
+        CPPUNIT_ASSERT_EQUAL((uint16_t)0x0002, Reducer::FloatToHalf(std::ldexp(1.5f, -24)));
+        CPPUNIT_ASSERT_EQUAL((uint16_t)0x3c00, Reducer::FloatToHalf(1.0f + std::ldexp(1.0f, -11)));
+        CPPUNIT_ASSERT_EQUAL((uint16_t)0x3c02, Reducer::FloatToHalf(1.0f + std::ldexp(3.0f, -11)));
+        CPPUNIT_ASSERT_EQUAL((uint16_t)0x0400, Reducer::FloatToHalf(std::ldexp(2047.0f, -25)));
+
+        // Infinities decode as such but values too large for half precision, infinities included, saturate
+        float inf = std::numeric_limits<float>::infinity();
+        CPPUNIT_ASSERT_EQUAL(inf, Reducer::HalfToFloat(0x7c00));
+        CPPUNIT_ASSERT_EQUAL(-inf, Reducer::HalfToFloat(0xfc00));
+        CPPUNIT_ASSERT_EQUAL((uint16_t)0x7bff, Reducer::FloatToHalf(65504.0f));
+        CPPUNIT_ASSERT_EQUAL((uint16_t)0x7bff, Reducer::FloatToHalf(65520.0f));
+        CPPUNIT_ASSERT_EQUAL((uint16_t)0x7bff, Reducer::FloatToHalf(inf));
+        CPPUNIT_ASSERT_EQUAL((uint16_t)0xfbff, Reducer::FloatToHalf(-inf));
+
+        // NaNs stay NaNs both ways
+        uint16_t h = Reducer::FloatToHalf(std::numeric_limits<float>::quiet_NaN());
+        CPPUNIT_ASSERT(((h & 0x7c00) == 0x7c00) && ((h & 0x03ff) != 0));
+        CPPUNIT_ASSERT(std::isnan(Reducer::HalfToFloat(0x7e00)));
+        CPPUNIT_ASSERT(std::isnan(Reducer::HalfToFloat(0xfc01)));
+    }
+
+    void TestTopKSelection()
+    {
+        CPPUNIT_ASSERT_EQUAL((size_t)3, Reducer::GetTopK(10, 0.25));
+        CPPUNIT_ASSERT_EQUAL((size_t)1, Reducer::GetTopK(10, 0.0));
+        CPPUNIT_ASSERT_EQUAL((size_t)3, Reducer::GetTopK(3, 2.0));
+
+        // Second gradient of a bucket, so indices are offsets within the bucket
+        std::vector<float> vValue = {9.0f, 9.0f, 0.5f, -4.0f, 1.0f, 3.0f, -0.25f, 2.0f};
+        std::vector<float> vResidual(vValue.size(), 0.0f);
+        vResidual[6] = -3.0f;
+        std::vector<size_t> vIndex;
+        std::vector<Reducer::Entry> vEntry;
+        Reducer::SelectTopK(vValue.data(), vResidual.data(), 2, 6, 3, vIndex, vEntry);
+
+        CPPUNIT_ASSERT_EQUAL((size_t)3, vEntry.size());
+        std::sort(vEntry.begin(), vEntry.end(), [](const Reducer::Entry& a, const Reducer::Entry& b) { return a._index < b._index; });
+        CPPUNIT_ASSERT_EQUAL((uint32_t)3, vEntry[0]._index);
+        CPPUNIT_ASSERT_EQUAL(-4.0f, vEntry[0]._value);
+        CPPUNIT_ASSERT_EQUAL((uint32_t)5, vEntry[1]._index);
+        CPPUNIT_ASSERT_EQUAL(3.0f, vEntry[1]._value);
+        CPPUNIT_ASSERT_EQUAL((uint32_t)6, vEntry[2]._index);
+        CPPUNIT_ASSERT_EQUAL(-3.25f, vEntry[2]._value);
+
+        // Values sent are cleared, the rest kept and values outside the gradient untouched
+        std::vector<float> vExpected = {0.0f, 0.0f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 2.0f};
+        CPPUNIT_ASSERT(vResidual == vExpected);
+    }
+
+    void TestResidualAccumulation()
+    {
+        // SparseTopK sends everything eventually: sent values plus residuals always add up to the gradients so far
+        static const uint32_t steps = 16;
+        std::vector<float> vValue = {0.5f, -0.25f, 2.0f, 0.125f, -1.0f};
+        std::vector<float> vResidual(vValue.size(), 0.0f);
+        std::vector<float> vSent(vValue.size(), 0.0f);
+        std::vector<size_t> vIndex;
+        for (uint32_t step = 1; step <= steps; step++)
+        {
+            std::vector<Reducer::Entry> vEntry;
+            Reducer::SelectTopK(vValue.data(), vResidual.data(), 0, vValue.size(), 2, vIndex, vEntry);
+            CPPUNIT_ASSERT_EQUAL((size_t)2, vEntry.size());
+            for (const Reducer::Entry& e : vEntry)
+                vSent[e._index] += e._value;
+            for (size_t i = 0; i < vValue.size(); i++)
+                CPPUNIT_ASSERT_EQUAL(step * vValue[i], vSent[i] + vResidual[i]);
+        }
+
+        // Small values build up until they get sent
+        for (size_t i = 0; i < vValue.size(); i++)
+            CPPUNIT_ASSERT(vSent[i] != 0.0f);
+
+        // HalfPrecision carries each rounding error, at most half a unit in the last place, over to the next step
+        std::vector<float> vHalfValue = {1.0f / 3.0f, -1.0e-6f, 1000.1f, std::ldexp(1.0f, -26)};
+        std::vector<float> vHalfResidual(vHalfValue.size(), 0.0f);
+        std::vector<uint16_t> vHalf(vHalfValue.size());
+        std::vector<double> vHalfSent(vHalfValue.size(), 0.0);
+        for (uint32_t step = 1; step <= steps; step++)
+        {
+            Reducer::CompressHalf(vHalfValue.data(), vHalfResidual.data(), vHalf.data(), vHalfValue.size());
+            for (size_t i = 0; i < vHalfValue.size(); i++)
+            {
+                vHalfSent[i] += Reducer::HalfToFloat(vHalf[i]);
+                double total = (double)step * vHalfValue[i];
+                CPPUNIT_ASSERT_DOUBLES_EQUAL(total, vHalfSent[i] + vHalfResidual[i], 1.0e-6 * std::fabs(total));
+                CPPUNIT_ASSERT(std::fabs(vHalfResidual[i]) <= std::max(std::ldexp(std::fabs(Reducer::HalfToFloat(vHalf[i])), -11), std::ldexp(1.0f, -25)));
+            }
+        }
+
+        // Values below the smallest denormal still get through once their residual is large enough
+        CPPUNIT_ASSERT(vHalfSent[3] > 0.0);
+    }
+
+    CPPUNIT_TEST_SUITE(TestNNGradientReducer);
+    CPPUNIT_TEST(TestHalfRoundTrip);
+    CPPUNIT_TEST(TestTopKSelection);
+    CPPUNIT_TEST(TestResidualAccumulation);
+    CPPUNIT_TEST_SUITE_END();
+};
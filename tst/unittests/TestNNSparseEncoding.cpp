@@ -0,0 +1,47 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/TestAssert.h>
+
+#include <vector>
+
+#include "NNSparseEncoding.h"
+
+class TestNNSparseEncoding : public CppUnit::TestFixture
+{
+public:
+    void TestRoundTrip()
+    {
+        // Multi-byte deltas, an empty example and a run long enough for the 8-byte fast path
+        std::vector<uint64_t> vOffset = {0, 3, 3, 15};
+        std::vector<uint32_t> vIndex = {5, 200, 70000,
+                                        1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 4000000000u};
+        std::vector<uint8_t> vEncoded;
+        EncodeSparseIndexDeltaVarint(vOffset.data(), vOffset.size() - 1, vIndex.data(), vEncoded);
+
+        std::vector<uint32_t> vDecoded(vIndex.size());
+        bool result = DecodeSparseIndexDeltaVarint(vEncoded.data(), vEncoded.size(), vOffset.data(), vOffset.size() - 1, vDecoded.data());
+        CPPUNIT_ASSERT(result);
+        CPPUNIT_ASSERT(vDecoded == vIndex);
+    }
+
+    void TestMalformedInput()
+    {
+        std::vector<uint64_t> vOffset = {0, 2};
+        std::vector<uint32_t> vIndex = {10, 300};
+        std::vector<uint8_t> vEncoded;
+        EncodeSparseIndexDeltaVarint(vOffset.data(), 1, vIndex.data(), vEncoded);
+
+        std::vector<uint32_t> vDecoded(vIndex.size());
+        bool result = DecodeSparseIndexDeltaVarint(vEncoded.data(), vEncoded.size() - 1, vOffset.data(), 1, vDecoded.data());
+        CPPUNIT_ASSERT(!result);
+
+        vEncoded.push_back(0);
+        result = DecodeSparseIndexDeltaVarint(vEncoded.data(), vEncoded.size(), vOffset.data(), 1, vDecoded.data());
+        CPPUNIT_ASSERT(!result);
+    }
+
+    CPPUNIT_TEST_SUITE(TestNNSparseEncoding);
+    CPPUNIT_TEST(TestRoundTrip);
+    CPPUNIT_TEST(TestMalformedInput);
+    CPPUNIT_TEST_SUITE_END();
+};
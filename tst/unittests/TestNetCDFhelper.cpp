@@ -1,7 +1,9 @@
+#include <cstdint>
 #include <map>
 #include <string>
 #include <sstream>
 #include <unordered_map>
+#include <vector>
 
 #include <cppunit/extensions/HelperMacros.h>
 #include <cppunit/ui/text/TestRunner.h>
@@ -106,6 +108,72 @@ public:
             outputStream.str().find("Error") != string::npos);
     }
 
+    void TestCalculateSparseStatistics() {
+        // Samples {1, 3}, {}, {3, 0, 3} over 4 features
+        vector<unsigned int> vSparseStart = {0, 2, 2};
+        vector<unsigned int> vSparseEnd = {2, 2, 5};
+        vector<unsigned int> vSparseIndex = {1, 3, 3, 0, 3};
+        SparseStatistics statistics;
+        CPPUNIT_ASSERT(calculateSparseStatistics(vSparseStart, vSparseEnd, vSparseIndex, 4, statistics));
+        CPPUNIT_ASSERT(statistics.vFeatureCount == vector<uint64_t>({1, 1, 0, 3}));
+        CPPUNIT_ASSERT(statistics.vLengthHistogram == vector<uint64_t>({1, 0, 1, 1}));
+        CPPUNIT_ASSERT_EQUAL(3u, statistics.maxSparseDatapoints);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(5.0 / 12.0, statistics.sparseDensity, 1e-12);
+
+        // An index past the feature count is rejected
+        CPPUNIT_ASSERT(!calculateSparseStatistics(vSparseStart, vSparseEnd, vSparseIndex, 3, statistics));
+    }
+
+    void TestPruneFeatureIndex() {
+        // Feature "c" occurs 3 times, "a" twice, "b" and "d" once
+        unordered_map<string, unsigned int> mFeatureIndex = {{"a", 0}, {"b", 1}, {"c", 2}, {"d", 3}};
+        vector<unsigned int> vSparseStart = {0, 3};
+        vector<unsigned int> vSparseEnd = {3, 7};
+        vector<unsigned int> vSparseIndex = {0, 1, 2, 2, 3, 0, 2};
+        vector<float> vSparseData = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f};
+        stringstream outputStream;
+        CPPUNIT_ASSERT(pruneFeatureIndex(2, 0, mFeatureIndex, vSparseStart, vSparseEnd, vSparseIndex, vSparseData, outputStream));
+
+        // Survivors are renumbered by descending frequency
+        CPPUNIT_ASSERT(mFeatureIndex == (unordered_map<string, unsigned int>{{"c", 0}, {"a", 1}}));
+        CPPUNIT_ASSERT(vSparseStart == vector<unsigned int>({0, 2}));
+        CPPUNIT_ASSERT(vSparseEnd == vector<unsigned int>({2, 5}));
+        CPPUNIT_ASSERT(vSparseIndex == vector<unsigned int>({1, 0, 0, 1, 0}));
+        CPPUNIT_ASSERT(vSparseData == vector<float>({1.0f, 3.0f, 4.0f, 6.0f, 7.0f}));
+
+        // Keeping only the most frequent feature
+        CPPUNIT_ASSERT(pruneFeatureIndex(1, 1, mFeatureIndex, vSparseStart, vSparseEnd, vSparseIndex, vSparseData, outputStream));
+        CPPUNIT_ASSERT(mFeatureIndex == (unordered_map<string, unsigned int>{{"c", 0}}));
+        CPPUNIT_ASSERT(vSparseIndex == vector<unsigned int>({0, 0, 0}));
+        CPPUNIT_ASSERT(vSparseEnd == vector<unsigned int>({1, 3}));
+    }
+
+    void TestFeatureHasher() {
+        FeatureHasher featureHasher(16, true);
+        FeatureHasher unsignedFeatureHasher(16, false);
+        bool negative = false;
+        for (int i = 0; i < 100; i++) {
+            string featureName = "feature" + to_string(i);
+            float sign;
+            unsigned int bucket = featureHasher.hash(featureName, sign);
+            CPPUNIT_ASSERT(bucket < 16);
+            CPPUNIT_ASSERT(sign == 1.0f || sign == -1.0f);
+            negative |= (sign < 0.0f);
+
+            // Hashing is deterministic, and the sign doesn't change the bucket
+            float unsignedSign;
+            CPPUNIT_ASSERT_EQUAL(bucket, unsignedFeatureHasher.hash(featureName, unsignedSign));
+            CPPUNIT_ASSERT_EQUAL(1.0f, unsignedSign);
+        }
+        CPPUNIT_ASSERT_MESSAGE("Signed hashing should flip the sign of some features", negative);
+
+        // 100 features can't fit in 16 buckets without collisions
+        stringstream outputStream;
+        featureHasher.reportCollisions(outputStream);
+        CPPUNIT_ASSERT_MESSAGE("Collision report should count the distinct features",
+            outputStream.str().find("Hashed 100 distinct features") != string::npos);
+    }
+
     CPPUNIT_TEST_SUITE(TestNetCDFhelper);
     CPPUNIT_TEST(TestLoadIndexWithValidInput);
     CPPUNIT_TEST(TestLoadIndexWithDuplicateEntry);
@@ -113,6 +181,9 @@ public:
     CPPUNIT_TEST(TestLoadIndexWithMissingLabel);
     CPPUNIT_TEST(TestLoadIndexWithMissingLabelAndTab);
     CPPUNIT_TEST(TestLoadIndexWithExtraTab);
+    CPPUNIT_TEST(TestCalculateSparseStatistics);
+    CPPUNIT_TEST(TestPruneFeatureIndex);
+    CPPUNIT_TEST(TestFeatureHasher);
     CPPUNIT_TEST_SUITE_END();
 };
 
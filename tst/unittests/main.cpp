@@ -5,6 +5,9 @@
 
 // Test files
 #include "TestNetCDFhelper.cpp"
+#include "TestNNDataSetStream.cpp"
+#include "TestNNGradientReducer.cpp"
+#include "TestNNSparseEncoding.cpp"
 #include "TestUtils.cpp"
 
 //
@@ -19,6 +22,9 @@ int main()
 {
     CppUnit::TextUi::TestRunner runner;
     runner.addTest(TestNetCDFhelper::suite());
+    runner.addTest(TestNNDataSetStream::suite());
+    runner.addTest(TestNNGradientReducer::suite());
+    runner.addTest(TestNNSparseEncoding::suite());
     runner.addTest(TestUtils::suite());
     return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
 }